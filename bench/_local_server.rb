@@ -0,0 +1,58 @@
+require 'socket'
+require 'zlib'
+
+# Minimal keep-alive HTTP/1.1 server used by the multi benchmarks so they can
+# run without an external web server. The server runs in a forked child and
+# answers every request with a fixed size body, optionally gzip encoded and
+# optionally after a delay: a number of seconds, or a lambda returning the
+# delay for each request. +status+ may likewise be a lambda; any status other
+# than 200 is sent with an empty body. +headers+ are added to every 200.
+module LocalServer
+  def self.start(body_size: 2048, gzip: false, delay: 0, status: 200, headers: {})
+    server = TCPServer.new('127.0.0.1', 0)
+    port = server.addr[1]
+    body = '0' * body_size
+    encoding = ''
+    if gzip
+      body = Zlib.gzip(body)
+      encoding = "Content-Encoding: gzip\r\n"
+    end
+    extra = headers.map { |name, value| "#{name}: #{value}\r\n" }.join
+    response = "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\n#{extra}#{encoding}Content-Length: #{body.bytesize}\r\n\r\n#{body}"
+
+    pid = fork do
+      trap('TERM') { exit!(0) }
+      loop do
+        client = server.accept
+        Thread.new(client) do |sock|
+          begin
+            while (line = sock.gets)
+              next unless line.start_with?('GET ', 'HEAD ')
+              while (header = sock.gets) && header != "\r\n"; end
+              pause = delay.respond_to?(:call) ? delay.call : delay
+              sleep(pause) if pause > 0
+              code = status.respond_to?(:call) ? status.call : status
+              if code != 200
+                sock.write("HTTP/1.1 #{code} Error\r\nContent-Length: 0\r\n\r\n")
+                next
+              end
+              sock.write(line.start_with?('HEAD ') ? response.sub(/\r\n\r\n.*\z/m, "\r\n\r\n") : response)
+            end
+          rescue IOError, SystemCallError
+          ensure
+            sock.close rescue nil
+          end
+        end
+      end
+    end
+    server.close
+
+    url = "http://127.0.0.1:#{port}/"
+    yield url
+  ensure
+    if pid
+      Process.kill('TERM', pid) rescue nil
+      Process.wait(pid) rescue nil
+    end
+  end
+end
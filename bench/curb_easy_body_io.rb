@@ -0,0 +1,52 @@
+# Downloads a large body to a file repeatedly, once through an on_body block
+# that writes each chunk from Ruby and once with Curl::Easy#body_io, and
+# reports wall time, process CPU time, allocated objects and GC runs.
+#
+#   ruby bench/curb_easy_body_io.rb [requests] [body_bytes]
+$:.unshift File.expand_path(File.dirname(__FILE__))
+$:.unshift File.expand_path(File.join(File.dirname(__FILE__),'..','ext'))
+$:.unshift File.expand_path(File.join(File.dirname(__FILE__),'..','lib'))
+
+require 'curb'
+require 'tempfile'
+require '_local_server'
+
+N = (ARGV.shift || 20).to_i
+BODY = (ARGV.shift || 64 << 20).to_i
+
+def run(url, file, mode)
+  easy = Curl::Easy.new(url)
+  if mode == :body_io
+    easy.body_io = file
+  else
+    easy.on_body { |data| file.write(data); data.bytesize }
+  end
+
+  GC.start
+  gc_count = GC.count
+  objects = GC.stat(:total_allocated_objects)
+  cpu = Process.clock_gettime(Process::CLOCK_PROCESS_CPUTIME_ID)
+  t = Process.clock_gettime(Process::CLOCK_MONOTONIC)
+  N.times do
+    file.rewind
+    file.truncate(0)
+    easy.perform
+  end
+  file.flush
+  duration = Process.clock_gettime(Process::CLOCK_MONOTONIC) - t
+  cpu = Process.clock_gettime(Process::CLOCK_PROCESS_CPUTIME_ID) - cpu
+  raise "short download: #{file.size}" unless file.size == BODY
+
+  printf "%-8s %d x %d MB in %.3f sec (%.0f MB/s), cpu %.3f sec, %d objects, %d GC runs\n",
+         mode, N, BODY >> 20, duration, N * BODY / duration / (1 << 20), cpu,
+         GC.stat(:total_allocated_objects) - objects, GC.count - gc_count
+ensure
+  easy.close if easy
+end
+
+LocalServer.start(body_size: BODY) do |url|
+  Tempfile.create('curb-body-io') do |file|
+    file.binmode
+    [:on_body, :body_io].each { |mode| run(url, file, mode) }
+  end
+end
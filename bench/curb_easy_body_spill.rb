@@ -0,0 +1,45 @@
+# Fetches one large body into body_str, once held in memory and once with
+# Curl::Easy#body_spill_threshold, and reports how far the resident set grew
+# while the transfer ran. Each run happens in a forked child whose peak RSS
+# is reset first (Linux only: /proc/self/clear_refs).
+#
+#   ruby bench/curb_easy_body_spill.rb [body_bytes] [threshold]
+$:.unshift File.expand_path(File.dirname(__FILE__))
+$:.unshift File.expand_path(File.join(File.dirname(__FILE__),'..','ext'))
+$:.unshift File.expand_path(File.join(File.dirname(__FILE__),'..','lib'))
+
+require 'curb'
+require '_local_server'
+
+BODY = (ARGV.shift || 256 << 20).to_i
+THRESHOLD = (ARGV.shift || 1 << 20).to_i
+
+def status_kb(field)
+  File.read('/proc/self/status')[/^#{field}:\s+(\d+)/, 1].to_i
+end
+
+LocalServer.start(body_size: BODY) do |url|
+  [0, THRESHOLD].each do |threshold|
+    reader, writer = IO.pipe
+    pid = fork do
+      reader.close
+      GC.start
+      File.write('/proc/self/clear_refs', '5')
+      base = status_kb('VmRSS')
+      t = Process.clock_gettime(Process::CLOCK_MONOTONIC)
+      easy = Curl::Easy.new(url)
+      easy.body_spill_threshold = threshold
+      easy.perform
+      duration = Process.clock_gettime(Process::CLOCK_MONOTONIC) - t
+      size = easy.body_spilled? ? easy.body_spill_io.size : easy.body_str.bytesize
+      raise "short body: #{size}" unless size == BODY
+      writer.puts format("threshold=%-8d %d MB in %.3f sec, spilled=%-5s peak RSS +%d MB",
+                         threshold, BODY >> 20, duration, easy.body_spilled?,
+                         (status_kb('VmHWM') - base) >> 10)
+      exit! 0
+    end
+    writer.close
+    print reader.read
+    Process.wait(pid)
+  end
+end
@@ -0,0 +1,32 @@
+# Repeats small requests on one Curl::Easy and reports throughput and GC
+# activity, with fresh response buffers per request and with
+# Curl::Easy#reuse_buffers.
+#
+#   ruby bench/curb_easy_buffers.rb [requests] [body_bytes]
+$:.unshift File.expand_path(File.dirname(__FILE__))
+$:.unshift File.expand_path(File.join(File.dirname(__FILE__),'..','ext'))
+$:.unshift File.expand_path(File.join(File.dirname(__FILE__),'..','lib'))
+
+require 'curb'
+require '_local_server'
+
+N = (ARGV.shift || 20_000).to_i
+BODY = (ARGV.shift || 256).to_i
+
+LocalServer.start(body_size: BODY) do |url|
+  [false, true].each do |reuse|
+    easy = Curl::Easy.new(url)
+    easy.reuse_buffers = reuse if easy.respond_to?(:reuse_buffers=)
+    easy.perform
+
+    GC.start
+    gc_count = GC.count
+    t = Process.clock_gettime(Process::CLOCK_MONOTONIC)
+    N.times { easy.perform }
+    duration = Process.clock_gettime(Process::CLOCK_MONOTONIC) - t
+
+    printf "reuse_buffers=%-5s %d x %d bytes in %.3f sec (%.0f req/s), %d GC runs\n",
+           reuse, N, BODY, duration, N / duration, GC.count - gc_count
+    easy.close
+  end
+end
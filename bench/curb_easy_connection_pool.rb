@@ -0,0 +1,38 @@
+# Times back-to-back Curl.get calls, each on a new Curl::Easy, with and
+# without Curl::Easy.connection_pool. Without the pool every call connects
+# anew; with it the calls share the thread's keep-alive connections.
+#
+#   ruby bench/curb_easy_connection_pool.rb [requests] [threads]
+$:.unshift File.expand_path(File.dirname(__FILE__))
+$:.unshift File.expand_path(File.join(File.dirname(__FILE__),'..','ext'))
+$:.unshift File.expand_path(File.join(File.dirname(__FILE__),'..','lib'))
+
+require 'curb'
+require '_local_server'
+
+N = (ARGV.shift || 5000).to_i
+THREADS = (ARGV.shift || 1).to_i
+
+def run(url)
+  connects = 0
+  lock = Mutex.new
+  t = Process.clock_gettime(Process::CLOCK_MONOTONIC)
+  THREADS.times.map do
+    Thread.new do
+      mine = (N / THREADS).times.sum { Curl.get(url).num_connects }
+      lock.synchronize { connects += mine }
+    end
+  end.each(&:join)
+  [Process.clock_gettime(Process::CLOCK_MONOTONIC) - t, connects]
+end
+
+LocalServer.start do |url|
+  [nil, true].each do |pool|
+    Curl::Easy.connection_pool = pool
+    duration, connects = run(url)
+    printf "%-5s requests=%d threads=%d %.3f sec %.0f req/s connects=%d\n",
+           pool ? 'pool' : 'plain', N, THREADS, duration, N / duration, connects
+  end
+ensure
+  Curl::Easy.connection_pool = nil
+end
@@ -0,0 +1,38 @@
+# Streams a large body through on_body, once per libcurl write and once
+# coalesced with on_body(min_chunk:), and reports block calls, process CPU
+# time, allocated objects and GC runs.
+#
+#   ruby bench/curb_easy_on_body_min_chunk.rb [requests] [body_bytes] [min_chunk]
+$:.unshift File.expand_path(File.dirname(__FILE__))
+$:.unshift File.expand_path(File.join(File.dirname(__FILE__),'..','ext'))
+$:.unshift File.expand_path(File.join(File.dirname(__FILE__),'..','lib'))
+
+require 'curb'
+require '_local_server'
+
+N = (ARGV.shift || 20).to_i
+BODY = (ARGV.shift || 64 << 20).to_i
+MIN_CHUNK = (ARGV.shift || 256 * 1024).to_i
+
+LocalServer.start(body_size: BODY) do |url|
+  [0, MIN_CHUNK].each do |min_chunk|
+    easy = Curl::Easy.new(url)
+    calls = bytes = 0
+    easy.on_body(min_chunk: min_chunk) { |data| calls += 1; bytes += data.bytesize; data.bytesize }
+
+    GC.start
+    gc_count = GC.count
+    objects = GC.stat(:total_allocated_objects)
+    cpu = Process.clock_gettime(Process::CLOCK_PROCESS_CPUTIME_ID)
+    t = Process.clock_gettime(Process::CLOCK_MONOTONIC)
+    N.times { easy.perform }
+    duration = Process.clock_gettime(Process::CLOCK_MONOTONIC) - t
+    cpu = Process.clock_gettime(Process::CLOCK_PROCESS_CPUTIME_ID) - cpu
+    raise "short read: #{bytes}" unless bytes == N * BODY
+
+    printf "min_chunk=%-7d %d x %d MB in %.3f sec, %d calls, cpu %.3f sec, %d objects, %d GC runs\n",
+           min_chunk, N, BODY >> 20, duration, calls, cpu,
+           GC.stat(:total_allocated_objects) - objects, GC.count - gc_count
+    easy.close
+  end
+end
@@ -0,0 +1,47 @@
+# CPU spent turning the response headers of small API-style replies into a
+# lookup table: the usual Ruby split of header_str against the native
+# Curl::Easy#response_headers index.
+#
+#   ruby bench/curb_easy_response_headers.rb [requests]
+$:.unshift File.expand_path(File.dirname(__FILE__))
+$:.unshift File.expand_path(File.join(File.dirname(__FILE__),'..','ext'))
+$:.unshift File.expand_path(File.join(File.dirname(__FILE__),'..','lib'))
+
+require 'curb'
+require '_local_server'
+
+N = (ARGV.shift || 20_000).to_i
+
+HEADERS = {
+  'Date' => 'Sat, 17 Oct 2026 12:00:00 GMT', 'Server' => 'bench', 'Cache-Control' => 'no-cache, private',
+  'ETag' => '"5d8c72a5edda8d6a"', 'Vary' => 'Accept-Encoding', 'X-Request-Id' => 'f9b1c2d3-4e5f',
+  'Strict-Transport-Security' => 'max-age=31536000', 'X-Content-Type-Options' => 'nosniff',
+  'Set-Cookie' => 'session=abc; Path=/; HttpOnly', 'X-RateLimit-Remaining' => '4999',
+}
+
+def ruby_index(header_str)
+  header_str.split(/\r?\n/).drop(1).each_with_object({}) do |line, h|
+    name, value = line.split(':', 2)
+    next unless value
+    (h[name.strip.downcase] ||= []) << value.strip
+  end
+end
+
+def cpu
+  Process.clock_gettime(Process::CLOCK_PROCESS_CPUTIME_ID)
+end
+
+LocalServer.start(body_size: 64, headers: HEADERS) do |url|
+  easy = Curl::Easy.new(url)
+  { 'ruby split' => ->(e) { ruby_index(e.header_str)['content-type'] },
+    'response_headers' => ->(e) { e.response_headers['content-type'] } }.each do |label, lookup|
+    spent = 0.0
+    N.times do
+      easy.perform
+      t = cpu
+      lookup.call(easy)
+      spent += cpu - t
+    end
+    printf "%-17s %d responses, %.2f us per response\n", label, N, spent / N * 1e6
+  end
+end
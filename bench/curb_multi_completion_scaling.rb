@@ -0,0 +1,41 @@
+# Measures the per-completion cost of Curl::Multi as the number of attached
+# easy handles grows. Every handle is added up front and carries an
+# on_complete callback, so any work the multi does per completion that is
+# proportional to the attached set shows up as superlinear growth here.
+#
+#   ruby bench/curb_multi_completion_scaling.rb [sizes] [connections]
+$:.unshift File.expand_path(File.dirname(__FILE__))
+$:.unshift File.expand_path(File.join(File.dirname(__FILE__),'..','ext'))
+$:.unshift File.expand_path(File.join(File.dirname(__FILE__),'..','lib'))
+
+require 'curb'
+require '_local_server'
+
+SIZES = (ARGV.shift || '100,1000,10000').split(',').map(&:to_i)
+CONNECTIONS = (ARGV.shift || 64).to_i
+
+def run(url, size)
+  multi = Curl::Multi.new
+  multi.max_host_connections = CONNECTIONS
+  completed = 0
+
+  size.times do
+    easy = Curl::Easy.new(url)
+    easy.on_complete { completed += 1 }
+    multi.add(easy)
+  end
+
+  t = Process.clock_gettime(Process::CLOCK_MONOTONIC)
+  multi.perform
+  duration = Process.clock_gettime(Process::CLOCK_MONOTONIC) - t
+  multi.close
+  [duration, completed]
+end
+
+LocalServer.start(body_size: 256) do |url|
+  SIZES.each do |size|
+    duration, completed = run(url, size)
+    printf "easies=%-6d completed=%-6d %.4f sec %.2f usec/completion\n",
+           size, completed, duration, duration * 1_000_000 / completed
+  end
+end
@@ -0,0 +1,59 @@
+# Compares collecting results through per-easy on_complete procs (with every
+# request built up front) against Multi#each_completed pulling requests from
+# a lazy source. Reports throughput, objects allocated and peak live easies.
+#
+#   ruby bench/curb_multi_each_completed.rb [requests] [concurrency]
+$:.unshift File.expand_path(File.dirname(__FILE__))
+$:.unshift File.expand_path(File.join(File.dirname(__FILE__),'..','ext'))
+$:.unshift File.expand_path(File.join(File.dirname(__FILE__),'..','lib'))
+
+require 'curb'
+require '_local_server'
+
+N = (ARGV.shift || 20000).to_i
+CONCURRENCY = (ARGV.shift || 50).to_i
+
+def measure
+  GC.start
+  allocated = GC.stat(:total_allocated_objects)
+  peak = 0
+  t = Process.clock_gettime(Process::CLOCK_MONOTONIC)
+  yield(lambda { peak = [peak, ObjectSpace.each_object(Curl::Easy).count].max })
+  [Process.clock_gettime(Process::CLOCK_MONOTONIC) - t,
+   GC.stat(:total_allocated_objects) - allocated, peak]
+end
+
+def on_complete_procs(url)
+  done = 0
+  measure do |sample|
+    multi = Curl::Multi.new
+    multi.max_in_flight = CONCURRENCY
+    N.times do
+      easy = Curl::Easy.new(url)
+      easy.on_complete { |c| done += 1; sample.call if (done % 1000).zero? }
+      multi.enqueue(easy)
+    end
+    multi.perform
+    multi.close
+  end
+end
+
+def each_completed(url)
+  done = 0
+  measure do |sample|
+    multi = Curl::Multi.new
+    multi.each_completed(Array.new(N, url).lazy, concurrency: CONCURRENCY) do
+      done += 1
+      sample.call if (done % 1000).zero?
+    end
+    multi.close
+  end
+end
+
+LocalServer.start do |url|
+  [:on_complete_procs, :each_completed].each do |mode|
+    duration, allocated, peak = send(mode, url)
+    printf "%-18s requests=%d %.4f sec %.0f req/s allocated=%d peak_live_easies=%d\n",
+           mode, N, duration, N / duration, allocated, peak
+  end
+end
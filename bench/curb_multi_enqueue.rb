@@ -0,0 +1,66 @@
+# Compares refilling a Curl::Multi from a perform block (the pattern
+# Curl::Multi.http used to follow) against Multi#enqueue with max_in_flight,
+# which admits the next handle from the drive loop as each transfer ends.
+#
+#   ruby bench/curb_multi_enqueue.rb [requests] [max_in_flight,...]
+$:.unshift File.expand_path(File.dirname(__FILE__))
+$:.unshift File.expand_path(File.join(File.dirname(__FILE__),'..','ext'))
+$:.unshift File.expand_path(File.join(File.dirname(__FILE__),'..','lib'))
+
+require 'curb'
+require '_local_server'
+
+N = (ARGV.shift || 2000).to_i
+LIMITS = (ARGV.shift || '1,10,50').split(',').map(&:to_i)
+
+def timed
+  t = Process.clock_gettime(Process::CLOCK_MONOTONIC)
+  yield
+  Process.clock_gettime(Process::CLOCK_MONOTONIC) - t
+end
+
+def block_refill(url, limit)
+  multi = Curl::Multi.new
+  pending = N
+  free = 0
+  add = lambda do
+    pending -= 1
+    easy = Curl::Easy.new(url)
+    easy.on_complete { free += 1 }
+    multi.add(easy)
+  end
+  timed do
+    [limit, N].min.times { add.call }
+    until pending.zero? && multi.idle?
+      multi.perform do
+        while free > 0 && pending > 0
+          free -= 1
+          add.call
+        end
+      end
+    end
+  end
+ensure
+  multi.close
+end
+
+def enqueue(url, limit)
+  multi = Curl::Multi.new
+  multi.max_in_flight = limit
+  timed do
+    N.times { multi.enqueue(Curl::Easy.new(url)) }
+    multi.perform
+  end
+ensure
+  multi.close
+end
+
+LocalServer.start do |url|
+  LIMITS.each do |limit|
+    [:block_refill, :enqueue].each do |mode|
+      duration = send(mode, url, limit)
+      printf "%-12s max_in_flight=%-4d requests=%d %.4f sec %.0f req/s\n",
+             mode, limit, N, duration, N / duration
+    end
+  end
+end
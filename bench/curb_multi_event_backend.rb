@@ -0,0 +1,53 @@
+# Compares the fdset based Curl::Multi loop against the epoll backed
+# socket-action loop at increasing levels of concurrency.
+#
+#   ruby bench/curb_multi_event_backend.rb [requests] [concurrency,...]
+$:.unshift File.expand_path(File.dirname(__FILE__))
+$:.unshift File.expand_path(File.join(File.dirname(__FILE__),'..','ext'))
+$:.unshift File.expand_path(File.join(File.dirname(__FILE__),'..','lib'))
+
+require 'curb'
+require '_local_server'
+
+N = (ARGV.shift || 2000).to_i
+CONCURRENCY = (ARGV.shift || '10,100,500').split(',').map(&:to_i)
+
+def run(url, backend, concurrency)
+  multi = Curl::Multi.new
+  multi.event_backend = backend
+  multi.max_connects = concurrency
+  pending = N
+  bytes = 0
+
+  refill = lambda do
+    easy = Curl::Easy.new(url)
+    easy.on_body { |d| bytes += d.bytesize; d.bytesize }
+    easy.on_complete { refill.call if (pending -= 1) >= concurrency }
+    multi.add(easy)
+  end
+
+  t = Process.clock_gettime(Process::CLOCK_MONOTONIC)
+  [concurrency, N].min.times { refill.call }
+  multi.perform
+  duration = Process.clock_gettime(Process::CLOCK_MONOTONIC) - t
+  multi.close
+  [duration, bytes]
+end
+
+backends = [:select]
+begin
+  Curl::Multi.new.event_backend = :epoll
+  backends << :epoll
+rescue NotImplementedError
+  warn "epoll backend unavailable, only measuring :select"
+end
+
+LocalServer.start do |url|
+  CONCURRENCY.each do |concurrency|
+    backends.each do |backend|
+      duration, bytes = run(url, backend, concurrency)
+      printf "%-7s concurrency=%-5d requests=%d %.4f sec %.0f req/s (%d bytes)\n",
+             backend, concurrency, N, duration, N / duration, bytes
+    end
+  end
+end
@@ -0,0 +1,55 @@
+# One slow origin with a deep backlog is enqueued ahead of several fast
+# origins. With a single shared FIFO the fast work waits behind the slow
+# backlog; with per-host queues and max_in_flight_per_host the hosts take
+# turns, so the fast origins finish in bounded time.
+#
+#   ruby bench/curb_multi_fair_queue.rb [slow_requests] [fast_hosts] [fast_requests_per_host]
+$:.unshift File.expand_path(File.dirname(__FILE__))
+$:.unshift File.expand_path(File.join(File.dirname(__FILE__),'..','ext'))
+$:.unshift File.expand_path(File.join(File.dirname(__FILE__),'..','lib'))
+
+require 'curb'
+require '_local_server'
+
+SLOW = (ARGV.shift || 400).to_i
+FAST_HOSTS = (ARGV.shift || 8).to_i
+FAST_PER_HOST = (ARGV.shift || 50).to_i
+MAX_IN_FLIGHT = 16
+
+def run(slow_url, fast_url, fair)
+  multi = Curl::Multi.new
+  multi.max_in_flight = MAX_IN_FLIGHT
+  multi.max_in_flight_per_host = MAX_IN_FLIGHT / 4 if fair
+  started = Process.clock_gettime(Process::CLOCK_MONOTONIC)
+  fast_left = FAST_HOSTS * FAST_PER_HOST
+  fast_done_at = nil
+
+  SLOW.times do
+    multi.enqueue(Curl::Easy.new(slow_url), host: fair ? 'slow' : 'all')
+  end
+  FAST_HOSTS.times do |h|
+    FAST_PER_HOST.times do
+      easy = Curl::Easy.new(fast_url)
+      easy.on_complete do
+        fast_left -= 1
+        fast_done_at = Process.clock_gettime(Process::CLOCK_MONOTONIC) if fast_left.zero?
+      end
+      multi.enqueue(easy, host: fair ? "fast#{h}" : 'all')
+    end
+  end
+
+  multi.perform
+  [fast_done_at - started, Process.clock_gettime(Process::CLOCK_MONOTONIC) - started]
+ensure
+  multi.close
+end
+
+LocalServer.start(delay: 0.02) do |slow_url|
+  LocalServer.start do |fast_url|
+    [false, true].each do |fair|
+      fast, total = run(slow_url, fast_url, fair)
+      printf "%-11s fast origins done after %.3f sec, everything after %.3f sec\n",
+             fair ? 'per-host' : 'shared fifo', fast, total
+    end
+  end
+end
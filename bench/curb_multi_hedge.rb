@@ -0,0 +1,58 @@
+# Measures request latency percentiles against a server that answers one
+# request in SLOW_EVERY after SLOW_DELAY seconds instead of FAST_DELAY, with
+# and without Curl::Easy#hedge_after. Hedging trades a few duplicate
+# requests for a shorter tail.
+#
+#   ruby bench/curb_multi_hedge.rb [requests] [concurrency] [hedge_after_ms] [slow_every]
+$:.unshift File.expand_path(File.dirname(__FILE__))
+$:.unshift File.expand_path(File.join(File.dirname(__FILE__),'..','ext'))
+$:.unshift File.expand_path(File.join(File.dirname(__FILE__),'..','lib'))
+
+require 'curb'
+require '_local_server'
+
+N = (ARGV.shift || 2000).to_i
+CONCURRENCY = (ARGV.shift || 20).to_i
+HEDGE_AFTER = (ARGV.shift || 50).to_i
+SLOW_EVERY = (ARGV.shift || 50).to_i
+FAST_DELAY = 0.005
+SLOW_DELAY = 0.5
+
+def percentile(sorted, pct)
+  sorted[[(sorted.size * pct / 100.0).ceil - 1, 0].max]
+end
+
+def now
+  Process.clock_gettime(Process::CLOCK_MONOTONIC)
+end
+
+# Latency runs from the moment each request is pulled into the multi.
+def run(url, hedge_after)
+  latencies = []
+  pulled_at = {}.compare_by_identity
+  multi = Curl::Multi.new
+  source = (0...N).lazy.map do
+    easy = Curl::Easy.new(url)
+    easy.hedge_after = hedge_after
+    pulled_at[easy] = now
+    easy
+  end
+  started = now
+  multi.each_completed(source, concurrency: CONCURRENCY) do |easy|
+    latencies << now - pulled_at.delete(easy)
+  end
+  [now - started, latencies.sort, multi.hedge_stats]
+ensure
+  multi.close if multi
+end
+
+slow_delay = lambda { rand(SLOW_EVERY).zero? ? SLOW_DELAY : FAST_DELAY }
+LocalServer.start(delay: slow_delay) do |url|
+  [nil, HEDGE_AFTER].each do |hedge_after|
+    duration, latencies, stats = run(url, hedge_after)
+    printf "hedge_after=%-5s requests=%d %.3f sec p50=%.1fms p99=%.1fms max=%.1fms fired=%d won=%d\n",
+           hedge_after || 'off', N, duration,
+           percentile(latencies, 50) * 1000, percentile(latencies, 99) * 1000, latencies.last * 1000,
+           stats[:fired], stats[:won]
+  end
+end
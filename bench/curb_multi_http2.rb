@@ -0,0 +1,94 @@
+# Compares a burst of small HTTP/2 requests to one local origin sent with one
+# connection per request against the same burst multiplexed over a shared
+# connection (pipeline = 2, pipewait, max_concurrent_streams). Needs
+# nghttpd from nghttp2 on PATH, or its path in NGHTTPD. The server runs over
+# TLS with a throwaway self-signed certificate: libcurl 7.88 cannot multiplex
+# prior-knowledge h2c streams.
+#
+#   ruby bench/curb_multi_http2.rb [requests] [concurrency] [body_size]
+$:.unshift File.expand_path(File.dirname(__FILE__))
+$:.unshift File.expand_path(File.join(File.dirname(__FILE__),'..','ext'))
+$:.unshift File.expand_path(File.join(File.dirname(__FILE__),'..','lib'))
+
+require 'curb'
+require 'openssl'
+require 'socket'
+require 'tmpdir'
+
+N = (ARGV.shift || 5000).to_i
+CONCURRENCY = (ARGV.shift || 100).to_i
+BODY_SIZE = (ARGV.shift || 512).to_i
+
+NGHTTPD = ENV['NGHTTPD'] || ENV['PATH'].split(File::PATH_SEPARATOR).map { |dir| File.join(dir, 'nghttpd') }.find { |path| File.executable?(path) }
+abort 'nghttpd not found; install nghttp2 or set NGHTTPD' unless NGHTTPD
+abort 'this libcurl was built without HTTP/2' unless Curl.http2?
+
+def write_self_signed(key_path, cert_path)
+  key = OpenSSL::PKey::RSA.new(2048)
+  cert = OpenSSL::X509::Certificate.new
+  cert.version = 2
+  cert.serial = 1
+  cert.subject = cert.issuer = OpenSSL::X509::Name.parse('/CN=127.0.0.1')
+  cert.public_key = key.public_key
+  cert.not_before = Time.now - 60
+  cert.not_after = Time.now + 3600
+  cert.sign(key, OpenSSL::Digest::SHA256.new)
+  File.write(key_path, key.to_pem)
+  File.write(cert_path, cert.to_pem)
+end
+
+def with_h2_server
+  Dir.mktmpdir do |root|
+    File.binwrite(File.join(root, 'body'), 'x' * BODY_SIZE)
+    key_path, cert_path = File.join(root, 'key.pem'), File.join(root, 'cert.pem')
+    write_self_signed(key_path, cert_path)
+    port = TCPServer.open('127.0.0.1', 0) { |s| s.addr[1] }
+    pid = spawn(NGHTTPD, '-d', root, port.to_s, key_path, cert_path, out: File::NULL, err: File::NULL)
+    begin
+      50.times do
+        break if (TCPSocket.new('127.0.0.1', port).close rescue nil)
+        sleep 0.05
+      end
+      yield "https://127.0.0.1:#{port}/body"
+    ensure
+      Process.kill(:TERM, pid)
+      Process.wait(pid)
+    end
+  end
+end
+
+def run(url, multiplex)
+  multi = Curl::Multi.new
+  multi.max_in_flight = CONCURRENCY
+  if multiplex
+    multi.pipeline = 2
+    multi.pipewait = true
+    multi.max_concurrent_streams = CONCURRENCY
+  else
+    multi.pipeline = false
+  end
+
+  N.times do
+    easy = Curl::Easy.new(url)
+    easy.http_version = Curl::HTTP_2_0
+    easy.ssl_verify_peer = false
+    easy.ssl_verify_host = false
+    easy.setopt(Curl::CURLOPT_FORBID_REUSE, 1) unless multiplex
+    multi.enqueue(easy)
+  end
+
+  t = Process.clock_gettime(Process::CLOCK_MONOTONIC)
+  multi.perform
+  [Process.clock_gettime(Process::CLOCK_MONOTONIC) - t, multi.stats]
+ensure
+  multi.close if multi
+end
+
+with_h2_server do |url|
+  { per_request: false, multiplexed: true }.each do |mode, multiplex|
+    duration, stats = run(url, multiplex)
+    printf "%-12s requests=%d concurrency=%d %.4f sec %.0f req/s ok=%d connections=%d multiplexed=%d\n",
+           mode, N, CONCURRENCY, duration, N / duration, stats[:results][0].to_i,
+           stats[:connections][:created], stats[:connections][:multiplexed]
+  end
+end
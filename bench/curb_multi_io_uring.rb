@@ -0,0 +1,51 @@
+# Compares the epoll and io_uring event backends of the socket-action loop
+# (and the legacy select loop) on the same batch of requests. Reports
+# throughput, event-loop system calls per request as counted by Multi#stats,
+# and process CPU time per request.
+#
+#   ruby bench/curb_multi_io_uring.rb [requests] [concurrency] [body_size] [delay]
+$:.unshift File.expand_path(File.dirname(__FILE__))
+$:.unshift File.expand_path(File.join(File.dirname(__FILE__),'..','ext'))
+$:.unshift File.expand_path(File.join(File.dirname(__FILE__),'..','lib'))
+
+require 'curb'
+require '_local_server'
+
+N = (ARGV.shift || 5000).to_i
+CONCURRENCY = (ARGV.shift || 100).to_i
+BODY_SIZE = (ARGV.shift || 1024).to_i
+DELAY = (ARGV.shift || 0.0).to_f
+
+def run(url, backend)
+  multi = Curl::Multi.new
+  multi.event_backend = backend
+  multi.max_in_flight = CONCURRENCY
+  N.times { multi.enqueue(Curl::Easy.new(url)) }
+
+  cpu = Process.clock_gettime(Process::CLOCK_PROCESS_CPUTIME_ID)
+  t = Process.clock_gettime(Process::CLOCK_MONOTONIC)
+  multi.perform
+  duration = Process.clock_gettime(Process::CLOCK_MONOTONIC) - t
+  cpu = Process.clock_gettime(Process::CLOCK_PROCESS_CPUTIME_ID) - cpu
+
+  [duration, cpu, multi.stats[:event_loop]]
+ensure
+  multi.close if multi
+end
+
+backends = [:select, :epoll, :io_uring].select do |backend|
+  begin
+    Curl::Multi.new.event_backend = backend
+  rescue NotImplementedError
+    puts "#{backend}: not available in this build"
+  end
+end
+
+LocalServer.start(body_size: BODY_SIZE, delay: DELAY) do |url|
+  backends.each do |backend|
+    duration, cpu, event_loop = run(url, backend)
+    printf "%-9s used=%-9s requests=%d %.4f sec %.0f req/s syscalls/req=%.2f cpu/req=%.1fus\n",
+           backend, event_loop[:backend], N, duration, N / duration,
+           event_loop[:syscalls].to_f / N, cpu * 1_000_000 / N
+  end
+end
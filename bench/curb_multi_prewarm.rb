@@ -0,0 +1,51 @@
+# Measures the latency of the first batch of requests sent through a fresh
+# Curl::Multi, cold and after Curl::Multi#prewarm opened the connections.
+# Against a remote TLS origin pass its URL to see the handshake cost moved
+# off the critical path; by default a local plain HTTP server is used.
+#
+#   ruby bench/curb_multi_prewarm.rb [batch] [rounds] [url]
+$:.unshift File.expand_path(File.dirname(__FILE__))
+$:.unshift File.expand_path(File.join(File.dirname(__FILE__),'..','ext'))
+$:.unshift File.expand_path(File.join(File.dirname(__FILE__),'..','lib'))
+
+require 'curb'
+require '_local_server'
+
+BATCH = (ARGV.shift || 16).to_i
+ROUNDS = (ARGV.shift || 50).to_i
+URL = ARGV.shift
+
+def percentile(sorted, pct)
+  sorted[[(sorted.size * pct / 100.0).ceil - 1, 0].max]
+end
+
+def now
+  Process.clock_gettime(Process::CLOCK_MONOTONIC)
+end
+
+def first_batch(url, prewarm)
+  latencies = []
+  ROUNDS.times do
+    multi = Curl::Multi.new
+    multi.prewarm([url], per_host: BATCH) if prewarm
+    started = now
+    BATCH.times do
+      easy = Curl::Easy.new(url)
+      easy.on_complete { latencies << now - started }
+      multi.add(easy)
+    end
+    multi.perform
+    multi.close
+  end
+  latencies.sort
+end
+
+run = lambda do |url|
+  [false, true].each do |prewarm|
+    latencies = first_batch(url, prewarm)
+    printf "%-9s batch=%d rounds=%d p50=%.2fms p99=%.2fms\n", prewarm ? 'prewarmed' : 'cold',
+           BATCH, ROUNDS, percentile(latencies, 50) * 1000, percentile(latencies, 99) * 1000
+  end
+end
+
+URL ? run.call(URL) : LocalServer.start(&run)
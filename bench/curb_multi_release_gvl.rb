@@ -0,0 +1,43 @@
+# Measures how much a CPU-bound Ruby thread is slowed down by a concurrent
+# Curl::Multi batch, with and without Curl::Multi#release_gvl. Bodies are
+# gzip encoded so libcurl spends real time decompressing.
+#
+#   ruby bench/curb_multi_release_gvl.rb [requests] [body_bytes]
+$:.unshift File.expand_path(File.dirname(__FILE__))
+$:.unshift File.expand_path(File.join(File.dirname(__FILE__),'..','ext'))
+$:.unshift File.expand_path(File.join(File.dirname(__FILE__),'..','lib'))
+
+require 'curb'
+require '_local_server'
+
+N = (ARGV.shift || 200).to_i
+BODY = (ARGV.shift || 4 * 1024 * 1024).to_i
+
+def batch(url, release_gvl)
+  multi = Curl::Multi.new
+  multi.release_gvl = release_gvl
+  N.times do
+    easy = Curl::Easy.new(url)
+    easy.encoding = 'gzip'
+    multi.add(easy)
+  end
+  multi.perform
+  multi.close
+end
+
+LocalServer.start(body_size: BODY, gzip: true) do |url|
+  [false, true].each do |release_gvl|
+    iterations = 0
+    stop = false
+    worker = Thread.new { iterations += 1 until stop }
+
+    t = Process.clock_gettime(Process::CLOCK_MONOTONIC)
+    batch(url, release_gvl)
+    duration = Process.clock_gettime(Process::CLOCK_MONOTONIC) - t
+    stop = true
+    worker.join
+
+    printf "release_gvl=%-5s %d x %d bytes in %.3f sec, ruby thread progressed %.1fM iterations/sec\n",
+           release_gvl, N, BODY, duration, iterations / duration / 1_000_000.0
+  end
+end
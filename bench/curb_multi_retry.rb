@@ -0,0 +1,70 @@
+# Runs requests against a server that answers one request in FAIL_EVERY with
+# a 503, retrying failures either from Ruby (collect the failures, sleep the
+# backoff, perform them again) or with Curl::Easy#retry_policy, which waits
+# out the backoff on the multi's own timers while other transfers proceed.
+#
+#   ruby bench/curb_multi_retry.rb [requests] [concurrency] [backoff] [fail_every]
+$:.unshift File.expand_path(File.dirname(__FILE__))
+$:.unshift File.expand_path(File.join(File.dirname(__FILE__),'..','ext'))
+$:.unshift File.expand_path(File.join(File.dirname(__FILE__),'..','lib'))
+
+require 'curb'
+require '_local_server'
+
+N = (ARGV.shift || 2000).to_i
+CONCURRENCY = (ARGV.shift || 20).to_i
+BACKOFF = (ARGV.shift || 0.1).to_f
+FAIL_EVERY = (ARGV.shift || 10).to_i
+ATTEMPTS = 3
+
+def now
+  Process.clock_gettime(Process::CLOCK_MONOTONIC)
+end
+
+def ruby_retry(url)
+  multi = Curl::Multi.new
+  multi.max_in_flight = CONCURRENCY
+  pending = Array.new(N) { Curl::Easy.new(url) }
+  succeeded = 0
+  (ATTEMPTS + 1).times do |attempt|
+    break if pending.empty?
+    sleep(BACKOFF * 2**(attempt - 1)) if attempt > 0
+    failed = []
+    pending.each do |easy|
+      easy.on_complete { |c| c.response_code == 200 ? succeeded += 1 : failed << c }
+      multi.enqueue(easy)
+    end
+    multi.perform
+    pending = failed
+  end
+  succeeded
+ensure
+  multi.close if multi
+end
+
+def native_retry(url)
+  multi = Curl::Multi.new
+  multi.max_in_flight = CONCURRENCY
+  succeeded = 0
+  N.times do
+    easy = Curl::Easy.new(url)
+    easy.retry_policy = { attempts: ATTEMPTS, backoff: BACKOFF, statuses: [503] }
+    easy.on_complete { |c| succeeded += 1 if c.response_code == 200 }
+    multi.enqueue(easy)
+  end
+  multi.perform
+  succeeded
+ensure
+  multi.close if multi
+end
+
+flaky = lambda { rand(FAIL_EVERY).zero? ? 503 : 200 }
+LocalServer.start(status: flaky) do |url|
+  [:ruby_retry, :native_retry].each do |mode|
+    started = now
+    succeeded = send(mode, url)
+    duration = now - started
+    printf "%-13s requests=%d succeeded=%d %.3f sec %.0f req/s\n",
+           mode, N, succeeded, duration, N / duration
+  end
+end
@@ -0,0 +1,55 @@
+# Compares one Curl::Multi against Curl::RactorPool for a batch of gzip
+# encoded responses. libcurl inflates each body on the thread that drives the
+# multi, so a single multi is bound to one core while the pool spreads the
+# work over its worker Ractors.
+#
+#   ruby bench/curb_ractor_pool.rb [requests] [body_bytes] [workers]
+$:.unshift File.expand_path(File.dirname(__FILE__))
+$:.unshift File.expand_path(File.join(File.dirname(__FILE__),'..','ext'))
+$:.unshift File.expand_path(File.join(File.dirname(__FILE__),'..','lib'))
+
+require 'curb'
+require 'etc'
+require '_local_server'
+
+abort 'Curl::RactorPool is not supported by this Ruby or curb build' unless Curl::RactorPool.supported?
+
+N = (ARGV.shift || 400).to_i
+BODY = (ARGV.shift || 4 * 1024 * 1024).to_i
+WORKERS = (ARGV.shift || [Etc.nprocessors, 4].min).to_i
+IN_FLIGHT = 16
+
+def timed
+  t = Process.clock_gettime(Process::CLOCK_MONOTONIC)
+  bytes = yield
+  [Process.clock_gettime(Process::CLOCK_MONOTONIC) - t, bytes]
+end
+
+LocalServer.start(body_size: BODY, gzip: true) do |url|
+  requests = Array.new(N) { { url: url, encoding: 'gzip' } }
+
+  duration, bytes = timed do
+    total = 0
+    multi = Curl::Multi.new
+    multi.max_in_flight = IN_FLIGHT
+    requests.each do |request|
+      easy = Curl::Easy.new(request[:url])
+      easy.encoding = request[:encoding]
+      easy.on_complete { |c| total += c.body_str.bytesize }
+      multi.enqueue(easy)
+    end
+    multi.perform
+    multi.close
+    total
+  end
+  printf "%-18s %d x %d bytes in %.3f sec (%.0f MB/s)\n", 'multi', N, BODY, duration, bytes / duration / 1e6
+
+  Curl::RactorPool.open(WORKERS, max_in_flight: IN_FLIGHT) do |pool|
+    duration, bytes = timed do
+      total = 0
+      pool.each(requests) { |result| total += result.body.bytesize }
+      total
+    end
+    printf "%-18s %d x %d bytes in %.3f sec (%.0f MB/s)\n", "ractor_pool(#{WORKERS})", N, BODY, duration, bytes / duration / 1e6
+  end
+end
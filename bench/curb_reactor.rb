@@ -0,0 +1,71 @@
+# Compares Ruby threads that each fan out batches of requests through their
+# own Curl::Multi against the same threads submitting the batches to one
+# shared Curl::Reactor. While the transfers run, a CPU-bound Ruby thread
+# counts iterations to show how much of the GVL is left for application code.
+#
+#   ruby bench/curb_reactor.rb [threads] [requests_per_thread] [batch] [delay]
+$:.unshift File.expand_path(File.dirname(__FILE__))
+$:.unshift File.expand_path(File.join(File.dirname(__FILE__),'..','ext'))
+$:.unshift File.expand_path(File.join(File.dirname(__FILE__),'..','lib'))
+
+require 'curb'
+require '_local_server'
+
+abort 'Curl::Reactor is not available in this build' unless defined?(Curl::Reactor)
+
+THREADS = (ARGV.shift || 16).to_i
+PER_THREAD = (ARGV.shift || 200).to_i
+BATCH = (ARGV.shift || 10).to_i
+DELAY = (ARGV.shift || 0.0).to_f
+
+def timed
+  spins = 0
+  stop = false
+  spinner = Thread.new { spins += 1 until stop }
+  t = Process.clock_gettime(Process::CLOCK_MONOTONIC)
+  yield
+  [Process.clock_gettime(Process::CLOCK_MONOTONIC) - t, spins]
+ensure
+  stop = true
+  spinner.join
+end
+
+def multi_per_thread(url)
+  timed do
+    THREADS.times.map do
+      Thread.new do
+        multi = Curl::Multi.new
+        easies = BATCH.times.map { Curl::Easy.new(url) }
+        (PER_THREAD / BATCH).times do
+          easies.each { |easy| multi.add(easy) }
+          multi.perform
+        end
+        multi.close
+      end
+    end.each(&:join)
+  end
+end
+
+def reactor(url)
+  Curl::Reactor.open do |reactor|
+    timed do
+      THREADS.times.map do
+        Thread.new do
+          easies = BATCH.times.map { Curl::Easy.new(url) }
+          (PER_THREAD / BATCH).times do
+            easies.map { |easy| reactor.submit(easy) }.each(&:value)
+          end
+        end
+      end.each(&:join)
+    end
+  end
+end
+
+LocalServer.start(delay: DELAY) do |url|
+  total = THREADS * (PER_THREAD / BATCH) * BATCH
+  [:multi_per_thread, :reactor].each do |mode|
+    duration, spins = send(mode, url)
+    printf "%-16s threads=%-3d batch=%-3d requests=%d %.4f sec %.0f req/s spinner=%.0f iter/s\n",
+           mode, THREADS, BATCH, total, duration, total / duration, spins / duration
+  end
+end
@@ -7,6 +7,9 @@
 
 #include "curb.h"
 #include "curb_upload.h"
+#include "curb_reactor.h"
+#include "curb_share.h"
+#include "curb_cancel.h"
 
 VALUE mCurl;
 
@@ -1339,4 +1342,7 @@ void Init_curb_core() {
   init_curb_postfield();
   init_curb_multi();
   init_curb_upload();
+  init_curb_reactor();
+  init_curb_share();
+  init_curb_cancel();
 }
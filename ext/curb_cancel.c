@@ -0,0 +1,115 @@
+/* curb_cancel.c - Cancellation tokens for Curl::Multi#perform
+ * Licensed under the Ruby License. See LICENSE for details.
+ *
+ * A Curl::CancelToken is a flag one thread raises and a running
+ * Curl::Multi#perform polls between socket actions. The flag is only ever
+ * set, never cleared, so a plain atomic store/load is all the
+ * synchronisation it needs, including from drive loops that run without
+ * the GVL.
+ */
+#include "curb_config.h"
+#include <ruby.h>
+
+#include "curb_cancel.h"
+
+extern VALUE mCurl;
+VALUE cCurlCancelToken;
+
+#ifdef RDOC_NEVER_DEFINED
+  mCurl = rb_define_module("Curl");
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define curb_cancel_load(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define curb_cancel_exchange(p, v) __atomic_exchange_n((p), (v), __ATOMIC_ACQ_REL)
+#else
+/* Without atomics every caller holds the GVL, except the drive loop's read
+ * of a word-sized flag. */
+#define curb_cancel_load(p) (*(volatile int *)(p))
+static int curb_cancel_exchange(int *p, int v) {
+  int old = *p;
+  *p = v;
+  return old;
+}
+#endif
+
+static size_t curl_cancel_token_memsize(const void *ptr) {
+  (void)ptr;
+  return sizeof(ruby_curl_cancel_token);
+}
+
+static const rb_data_type_t ruby_curl_cancel_token_data_type = {
+  "Curl::CancelToken",
+  {
+    NULL,
+    RUBY_TYPED_DEFAULT_FREE,
+    curl_cancel_token_memsize,
+#ifdef RUBY_TYPED_FREE_IMMEDIATELY
+    NULL, /* compact */
+#endif
+  },
+#ifdef RUBY_TYPED_FREE_IMMEDIATELY
+  NULL, NULL, /* parent, data */
+  RUBY_TYPED_FREE_IMMEDIATELY
+#endif
+};
+
+static VALUE ruby_curl_cancel_token_alloc(VALUE klass) {
+  ruby_curl_cancel_token *token;
+  return TypedData_Make_Struct(klass, ruby_curl_cancel_token, &ruby_curl_cancel_token_data_type, token);
+}
+
+ruby_curl_cancel_token *ruby_curl_cancel_token_get(VALUE token) {
+  ruby_curl_cancel_token *rbct;
+
+  TypedData_Get_Struct(token, ruby_curl_cancel_token, &ruby_curl_cancel_token_data_type, rbct);
+  return rbct;
+}
+
+/* Safe to call without the GVL. */
+int ruby_curl_cancel_token_cancelled_p(const ruby_curl_cancel_token *token) {
+  return token && curb_cancel_load(&token->cancelled);
+}
+
+/*
+ * call-seq:
+ *   token.cancel!                                    => true or false
+ *
+ * Cancel every Curl::Multi#perform running (or later started) with this
+ * token: the next time its drive loop looks, its remaining transfers are
+ * aborted with Curl::Err::AbortedByCallbackError. Returns true for the call
+ * that cancelled the token and false if it already was. May be called from
+ * any thread, a signal trap or a perform callback.
+ */
+static VALUE ruby_curl_cancel_token_cancel(VALUE self) {
+  ruby_curl_cancel_token *token = ruby_curl_cancel_token_get(self);
+  return curb_cancel_exchange(&token->cancelled, 1) ? Qfalse : Qtrue;
+}
+
+/*
+ * call-seq:
+ *   token.cancelled?                                 => true or false
+ *
+ * True once cancel! has been called.
+ */
+static VALUE ruby_curl_cancel_token_cancelled(VALUE self) {
+  return ruby_curl_cancel_token_cancelled_p(ruby_curl_cancel_token_get(self)) ? Qtrue : Qfalse;
+}
+
+void init_curb_cancel() {
+  /*
+   * Document-class: Curl::CancelToken
+   *
+   * A thread-safe, one-way flag for aborting Curl::Multi#perform:
+   *
+   *   token = Curl::CancelToken.new
+   *   Thread.new { sleep 2; token.cancel! }
+   *   multi.perform(cancel: token)
+   *
+   * One token may be handed to any number of performs.
+   */
+  cCurlCancelToken = rb_define_class_under(mCurl, "CancelToken", rb_cObject);
+  rb_define_alloc_func(cCurlCancelToken, ruby_curl_cancel_token_alloc);
+  rb_define_method(cCurlCancelToken, "cancel!", ruby_curl_cancel_token_cancel, 0);
+  rb_define_method(cCurlCancelToken, "cancelled?", ruby_curl_cancel_token_cancelled, 0);
+}
@@ -0,0 +1,19 @@
+/* curb_cancel.h - Cancellation tokens for Curl::Multi#perform
+ * Licensed under the Ruby License. See LICENSE for details.
+ */
+#ifndef __CURB_CANCEL_H
+#define __CURB_CANCEL_H
+
+#include <ruby.h>
+
+typedef struct {
+  int cancelled; /* read with atomic loads by drive loops running without the GVL */
+} ruby_curl_cancel_token;
+
+extern VALUE cCurlCancelToken;
+
+ruby_curl_cancel_token *ruby_curl_cancel_token_get(VALUE token);
+int ruby_curl_cancel_token_cancelled_p(const ruby_curl_cancel_token *token);
+void init_curb_cancel();
+
+#endif
@@ -9,10 +9,16 @@
 #include "curb_postfield.h"
 #include "curb_upload.h"
 #include "curb_multi.h"
+#include "curb_share.h"
+#include "curb_reactor.h"
 
 #include <errno.h>
 #include <stdlib.h>
 #include <string.h>
+#include <ruby/encoding.h>
+#ifdef HAVE_RB_THREAD_CALL_WITHOUT_GVL
+  #include <ruby/thread.h>
+#endif
 #ifndef _WIN32
 #include <sys/types.h>
 #include <sys/socket.h>
@@ -24,6 +30,12 @@
 #endif
 #ifndef _WIN32
 #include <strings.h>
+#include <unistd.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#else
+#include <io.h>
 #endif
 
 #if defined(HAVE_CURLOPT_OPENSOCKETFUNCTION) && defined(HAVE_CURLOPT_OPENSOCKETDATA)
@@ -341,7 +353,10 @@ static char *curb_normalized_host_from_range(const char *start, const char *end,
   }
 
   len = (size_t)(end - start);
-  host = ALLOC_N(char, len + 1);
+  /* The non-raising path runs from libcurl callbacks, possibly off any
+   * Ruby thread, so it must not allocate through Ruby. */
+  host = raise_errors ? ALLOC_N(char, len + 1) : (char *)malloc(len + 1);
+  if (!host) return NULL;
   for (i = 0; i < len; i++) {
     host[i] = curb_ascii_downcase(start[i]);
   }
@@ -641,11 +656,11 @@ static int curb_host_allowlist_prereq(void *clientp,
 
   if (!curb_host_rules_match(rbce, host)) {
     curb_store_host_allowlist_error(rbce, host);
-    xfree(host);
+    free(host);
     return CURL_PREREQFUNC_ABORT;
   }
 
-  xfree(host);
+  free(host);
   return CURL_PREREQFUNC_OK;
 }
 #endif
@@ -839,6 +854,294 @@ static VALUE rescue_easy_callback(ruby_curl_easy *rbce, VALUE (*func)(VALUE), VA
   return rb_rescue(call_with_easy_callback_active, (VALUE)&dispatch_args, callback_exception_store_on_easy, (VALUE)rbce);
 }
 
+/* Response buffers are created on the first write rather than at setup, so
+ * HEAD, 204 and 304 replies allocate nothing. A body whose length libcurl
+ * knows is sized for it up front, up to CURB_BODY_PRESIZE_MAX (a
+ * Content-Length is not trusted beyond that, or beyond max_body_bytes). */
+#define CURB_BODY_BUFFER_CAPA 32768
+#define CURB_BODY_PRESIZE_MAX (16L * 1024 * 1024)
+#define CURB_HEADER_BUFFER_CAPA 1024
+
+static long curb_body_buffer_capa(ruby_curl_easy *rbce, size_t incoming) {
+  curl_off_t length = -1;
+#ifdef HAVE_CURLINFO_CONTENT_LENGTH_DOWNLOAD_T
+  curl_easy_getinfo(rbce->curl, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &length);
+#else
+  double bytes = -1;
+  curl_easy_getinfo(rbce->curl, CURLINFO_CONTENT_LENGTH_DOWNLOAD, &bytes);
+  length = (curl_off_t)bytes;
+#endif
+
+  if (length <= 0) length = CURB_BODY_BUFFER_CAPA;
+  if (rbce->max_body_bytes > 0 && length > rbce->max_body_bytes) length = rbce->max_body_bytes;
+  if (rbce->body_spill_threshold > 0 && length > rbce->body_spill_threshold) length = rbce->body_spill_threshold;
+  if (length > CURB_BODY_PRESIZE_MAX) length = CURB_BODY_PRESIZE_MAX;
+  if (length < (curl_off_t)incoming) length = (curl_off_t)incoming;
+  return (long)length;
+}
+
+/* Requires the GVL: the string +incoming+ bytes for +key+ go to. A string
+ * kept by reuse_buffers is grown once to the expected size instead. */
+static VALUE curb_response_buffer(ruby_curl_easy *rbce, const char *key, long capa) {
+  VALUE out = rb_easy_get(key);
+
+  if (NIL_P(out)) {
+    return rb_easy_set(key, rb_str_buf_new(capa));
+  }
+  if (RSTRING_LEN(out) == 0 && (long)rb_str_capacity(out) < capa) {
+    rb_str_modify_expand(out, capa);
+  }
+  return out;
+}
+
+static VALUE curb_body_buffer(ruby_curl_easy *rbce, size_t incoming) {
+  return curb_response_buffer(rbce, "body_data", curb_body_buffer_capa(rbce, incoming));
+}
+
+static VALUE curb_header_buffer(ruby_curl_easy *rbce, size_t incoming) {
+  return curb_response_buffer(rbce, "header_data", incoming > CURB_HEADER_BUFFER_CAPA ? (long)incoming : CURB_HEADER_BUFFER_CAPA);
+}
+
+/* Setup: forget the previous response, or with reuse_buffers empty its
+ * strings in place so their capacity serves the next one. */
+static void curb_clear_response_buffer(ruby_curl_easy *rbce, const char *key) {
+  VALUE out = rb_easy_get(key);
+
+  if (rbce->reuse_buffers && RB_TYPE_P(out, T_STRING) && !OBJ_FROZEN(out)) {
+    rb_str_modify(out);
+    rb_str_set_len(out, 0);
+    rb_enc_associate_index(out, rb_ascii8bit_encindex());
+  } else {
+    rb_easy_del(key);
+  }
+}
+
+static int curb_native_buffer_append(curb_native_buffer *buf, const char *data, size_t len) {
+  if (buf->len + len > buf->capa) {
+    size_t capa = buf->capa ? buf->capa : 16384;
+    char *ptr;
+
+    while (capa < buf->len + len) capa *= 2;
+    ptr = (char *)realloc(buf->ptr, capa);
+    if (!ptr) return 0;
+    buf->ptr = ptr;
+    buf->capa = capa;
+  }
+
+  memcpy(buf->ptr + buf->len, data, len);
+  buf->len += len;
+  return 1;
+}
+
+static void curb_native_buffer_release(curb_native_buffer *buf) {
+  if (buf->ptr) free(buf->ptr);
+  buf->ptr = NULL;
+  buf->len = 0;
+  buf->capa = 0;
+}
+
+#ifdef CURB_HAVE_TRANSFER_WITHOUT_GVL
+/* Easies whose default handlers staged bytes natively during the current
+ * GVL-free stretch of a multi drive loop. */
+typedef struct {
+  ruby_curl_easy **easies;
+  size_t len;
+  size_t capa;
+  int jump_state; /* non-zero once a Ruby callback raised past its rescue */
+  char foreign; /* a native thread with no Ruby thread to call back into */
+} curb_transfer_staging;
+
+/* Set only while the owning thread runs libcurl without the GVL. */
+static CURB_THREAD_LOCAL_SPECIFIER curb_transfer_staging *curb_active_staging;
+
+/* Runs without the GVL: queue +bytes+ for +rbce+ and remember the easy so
+ * the drive loop can flush it once it is back in Ruby. */
+static int curb_stage_bytes(curb_transfer_staging *staging, ruby_curl_easy *rbce, curb_native_buffer *buf, const char *bytes, size_t len) {
+  if (!staging->foreign && !rbce->staged_pending) {
+    if (staging->len == staging->capa) {
+      size_t capa = staging->capa ? staging->capa * 2 : 16;
+      ruby_curl_easy **easies = (ruby_curl_easy **)realloc(staging->easies, capa * sizeof(ruby_curl_easy *));
+      if (!easies) return 0;
+      staging->easies = easies;
+      staging->capa = capa;
+    }
+    staging->easies[staging->len++] = rbce;
+    rbce->staged_pending = 1;
+  }
+
+  return curb_native_buffer_append(buf, bytes, len);
+}
+
+static void curb_flush_staged_buffer(ruby_curl_easy *rbce, curb_native_buffer *buf, VALUE (*target)(ruby_curl_easy *, size_t)) {
+  if (buf->len == 0) {
+    curb_native_buffer_release(buf);
+    return;
+  }
+
+  rb_str_buf_cat(target(rbce, buf->len), buf->ptr, buf->len);
+  curb_native_buffer_release(buf);
+}
+
+/* Requires the GVL: move every staged chunk into its Ruby buffer. */
+static void curb_flush_staged(curb_transfer_staging *staging) {
+  while (staging->len > 0) {
+    ruby_curl_easy *rbce = staging->easies[--staging->len];
+    rbce->staged_pending = 0;
+    curb_flush_staged_buffer(rbce, &rbce->staged_header, curb_header_buffer);
+    curb_flush_staged_buffer(rbce, &rbce->staged_body, curb_body_buffer);
+  }
+}
+
+struct transfer_gvl_call {
+  void *(*func)(void *);
+  void *data;
+  curb_transfer_staging *staging;
+};
+
+static VALUE transfer_gvl_call_protected(VALUE argp) {
+  struct transfer_gvl_call *call = (struct transfer_gvl_call *)argp;
+  /* Ruby callbacks must observe everything received before them. */
+  curb_flush_staged(call->staging);
+  call->func(call->data);
+  return Qnil;
+}
+
+static void *transfer_gvl_call_i(void *argp) {
+  struct transfer_gvl_call *call = (struct transfer_gvl_call *)argp;
+  curb_active_staging = NULL;
+  rb_protect(transfer_gvl_call_protected, (VALUE)call, &call->staging->jump_state);
+  curb_active_staging = call->staging;
+  return NULL;
+}
+
+/* Called from a libcurl callback running without the GVL. Returns 0 without
+ * calling +func+ when an earlier callback already raised, so the caller can
+ * abort the transfer instead. */
+static int curb_transfer_call_with_gvl(void *(*func)(void *), void *data) {
+  struct transfer_gvl_call call;
+
+  if (curb_active_staging->jump_state || curb_active_staging->foreign) return 0;
+
+  call.func = func;
+  call.data = data;
+  call.staging = curb_active_staging;
+  rb_thread_call_with_gvl(transfer_gvl_call_i, &call);
+  return call.staging->jump_state == 0;
+}
+
+typedef size_t (*curb_data_handler_func)(char *, size_t, size_t, ruby_curl_easy *);
+
+struct data_handler_gvl_args {
+  curb_data_handler_func handler;
+  char *stream;
+  size_t size;
+  size_t nmemb;
+  ruby_curl_easy *rbce;
+  size_t result;
+};
+
+static void *data_handler_gvl_i(void *argp) {
+  struct data_handler_gvl_args *args = (struct data_handler_gvl_args *)argp;
+  args->result = args->handler(args->stream, args->size, args->nmemb, args->rbce);
+  return NULL;
+}
+
+static size_t curb_data_handler_with_gvl(curb_data_handler_func handler, char *stream, size_t size, size_t nmemb, ruby_curl_easy *rbce, size_t abort_result) {
+  struct data_handler_gvl_args args;
+  args.handler = handler;
+  args.stream = stream;
+  args.size = size;
+  args.nmemb = nmemb;
+  args.rbce = rbce;
+  args.result = abort_result;
+  return curb_transfer_call_with_gvl(data_handler_gvl_i, &args) ? args.result : abort_result;
+}
+
+struct transfer_without_gvl_args {
+  void *(*func)(void *);
+  void *data;
+  rb_unblock_function_t *ubf;
+  void *ubf_data;
+  curb_transfer_staging *staging;
+  void *result;
+};
+
+static void *transfer_without_gvl_i(void *argp) {
+  struct transfer_without_gvl_args *args = (struct transfer_without_gvl_args *)argp;
+  curb_active_staging = args->staging;
+  args->result = args->func(args->data);
+  curb_active_staging = NULL;
+  return NULL;
+}
+
+static VALUE transfer_without_gvl_body(VALUE argp) {
+  struct transfer_without_gvl_args *args = (struct transfer_without_gvl_args *)argp;
+  rb_thread_call_without_gvl(transfer_without_gvl_i, args, args->ubf, args->ubf_data);
+  return Qnil;
+}
+
+static VALUE transfer_without_gvl_ensure(VALUE argp) {
+  struct transfer_without_gvl_args *args = (struct transfer_without_gvl_args *)argp;
+  curb_active_staging = NULL;
+  curb_flush_staged(args->staging);
+  return Qnil;
+}
+
+static VALUE transfer_without_gvl_run(VALUE argp) {
+  return rb_ensure(transfer_without_gvl_body, argp, transfer_without_gvl_ensure, argp);
+}
+
+/*
+ * Run +func+ (which drives libcurl) with the GVL released. The default
+ * body/header handlers stage their bytes natively meanwhile and any Ruby
+ * callback reacquires the GVL for its own duration. Staged bytes are
+ * flushed before this returns, and an exception that escaped a callback is
+ * re-raised here.
+ */
+void *rb_curl_easy_transfer_without_gvl(void *(*func)(void *), void *data, rb_unblock_function_t *ubf, void *ubf_data) {
+  curb_transfer_staging staging;
+  struct transfer_without_gvl_args args;
+  int state = 0;
+
+  memset(&staging, 0, sizeof(staging));
+  args.func = func;
+  args.data = data;
+  args.ubf = ubf;
+  args.ubf_data = ubf_data;
+  args.staging = &staging;
+  args.result = NULL;
+
+  rb_protect(transfer_without_gvl_run, (VALUE)&args, &state);
+  if (staging.easies) free(staging.easies);
+  if (state) rb_jump_tag(state);
+  if (staging.jump_state) rb_jump_tag(staging.jump_state);
+  return args.result;
+}
+
+/* True once a Ruby callback raised while the GVL was released; the drive
+ * loop stops early so the exception can surface. */
+int rb_curl_easy_transfer_interrupted_p(void) {
+  return curb_active_staging && curb_active_staging->jump_state;
+}
+
+/* Shared by every foreign thread: nothing in it is written while foreign. */
+static curb_transfer_staging curb_foreign_staging = { NULL, 0, 0, 0, 1 };
+
+/*
+ * Mark the calling native thread (one Ruby does not know about) as driving
+ * libcurl. The default handlers stage their bytes on each easy until
+ * rb_curl_easy_collect_native is called with the GVL, and anything that
+ * would need a Ruby callback aborts the transfer instead.
+ */
+void rb_curl_easy_enter_foreign_transfer(void) {
+  curb_active_staging = &curb_foreign_staging;
+}
+
+void rb_curl_easy_leave_foreign_transfer(void) {
+  curb_active_staging = NULL;
+}
+#endif
+
 static size_t curl_read_abort_result(void) {
 #ifdef CURL_READFUNC_ABORT
   return CURL_READFUNC_ABORT;
@@ -855,23 +1158,45 @@ static int curl_seek_fail_result(void) {
 #endif
 }
 
-static int ruby_curl_easy_body_limit_exceeded(ruby_curl_easy *rbce, size_t total) {
-  VALUE max_body_bytes = rb_easy_get("max_body_bytes");
-  curl_off_t limit;
+static void *store_body_limit_error(void *arg) {
+  ruby_curl_easy *rbce = (ruby_curl_easy *)arg;
+  if (NIL_P(rbce->callback_error)) {
+    rbce->callback_error = rb_exc_new_cstr(eCurlErrFileSizeExceeded, "Maximum body size exceeded");
+  }
+  return NULL;
+}
 
-  if (NIL_P(max_body_bytes)) {
-    return 0;
+static void *store_body_write_error(void *arg) {
+  ruby_curl_easy *rbce = (ruby_curl_easy *)arg;
+  if (NIL_P(rbce->callback_error)) {
+    if (rbce->body_fd >= 0) {
+      rbce->callback_error = rb_exc_new_str(eCurlErrWriteError,
+        rb_sprintf("Failed writing body to fd %d: %s", rbce->body_fd, strerror(rbce->body_fd_errno)));
+    } else {
+      rbce->callback_error = rb_exc_new_str(eCurlErrWriteError,
+        rb_sprintf("Failed spilling body to disk: %s", strerror(rbce->body_fd_errno)));
+    }
   }
+  return NULL;
+}
 
-  limit = (curl_off_t)NUM2LL(max_body_bytes);
-  if (limit <= 0) {
+static int ruby_curl_easy_body_limit_exceeded(ruby_curl_easy *rbce, size_t total) {
+  if (rbce->max_body_bytes <= 0) {
     return 0;
   }
 
-  if ((curl_off_t)total > limit - rbce->downloaded_body_bytes) {
-    if (NIL_P(rbce->callback_error)) {
-      rbce->callback_error = rb_exc_new_cstr(eCurlErrFileSizeExceeded, "Maximum body size exceeded");
+  if ((curl_off_t)total > rbce->max_body_bytes - rbce->downloaded_body_bytes) {
+#ifdef CURB_HAVE_TRANSFER_WITHOUT_GVL
+    if (curb_active_staging && curb_active_staging->foreign) {
+      rbce->native_body_limit_exceeded = 1;
+      return 1;
+    }
+    if (curb_active_staging) {
+      curb_transfer_call_with_gvl(store_body_limit_error, rbce);
+      return 1;
     }
+#endif
+    store_body_limit_error(rbce);
     return 1;
   }
 
@@ -879,23 +1204,266 @@ static int ruby_curl_easy_body_limit_exceeded(ruby_curl_easy *rbce, size_t total
   return 0;
 }
 
-/* Default body handler appends to easy.body_data buffer */
+/* Requires the GVL: take what a foreign transfer left on +rbce+. */
+void rb_curl_easy_collect_native(ruby_curl_easy *rbce) {
+#ifdef CURB_HAVE_TRANSFER_WITHOUT_GVL
+  rbce->staged_pending = 0;
+  curb_flush_staged_buffer(rbce, &rbce->staged_header, curb_header_buffer);
+  curb_flush_staged_buffer(rbce, &rbce->staged_body, curb_body_buffer);
+#endif
+  if (rbce->native_body_limit_exceeded) {
+    rbce->native_body_limit_exceeded = 0;
+    store_body_limit_error(rbce);
+  }
+  if (rbce->body_fd_errno) {
+    store_body_write_error(rbce);
+  }
+}
+
+/* True when a transfer of +rbce+ would have to call back into Ruby. */
+int rb_curl_easy_ruby_transfer_callbacks_p(ruby_curl_easy *rbce) {
+  return !rb_easy_nil("body_proc") || !rb_easy_nil("header_proc") ||
+         !rb_easy_nil("progress_proc") || !rb_easy_nil("debug_proc") ||
+         !rb_easy_nil("upload");
+}
+
+struct curb_write_args {
+  int fd;
+  const char *data;
+  size_t len;
+  size_t written;
+  int err;
+};
+
+/* Needs no GVL: write(2) the rest of +args+, retrying short writes and
+ * waiting out a full non-blocking pipe or socket. Stops with EINTR when a
+ * signal (such as Ruby's unblocking function) interrupts it. */
+static void *curb_write_loop(void *argp) {
+  struct curb_write_args *args = (struct curb_write_args *)argp;
+
+  args->err = 0;
+  while (args->written < args->len) {
+#ifdef _WIN32
+    int n = _write(args->fd, args->data + args->written, (unsigned int)(args->len - args->written));
+#else
+    ssize_t n = write(args->fd, args->data + args->written, args->len - args->written);
+#endif
+    if (n > 0) {
+      args->written += (size_t)n;
+      continue;
+    }
+#ifndef _WIN32
+#ifdef EWOULDBLOCK
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+#else
+    if (n < 0 && errno == EAGAIN) {
+#endif
+      struct pollfd pfd;
+      pfd.fd = args->fd;
+      pfd.events = POLLOUT;
+      pfd.revents = 0;
+      if (poll(&pfd, 1, -1) >= 0) continue;
+    }
+#endif
+    args->err = n < 0 ? errno : EIO;
+    break;
+  }
+  return NULL;
+}
+
+static VALUE curb_write_check_ints(VALUE unused) {
+  rb_thread_check_ints();
+  return Qtrue;
+}
+
+#ifdef CURB_HAVE_TRANSFER_WITHOUT_GVL
+static void *curb_write_check_ints_i(void *unused) {
+  rb_thread_check_ints();
+  return NULL;
+}
+#endif
+
+/* A write was interrupted: run whatever interrupt is pending for this
+ * thread. Returns 0 when that raised, so the write gives up; an exception
+ * is then reported the way a callback's would be. */
+static int curb_write_interrupt_handled(ruby_curl_easy *rbce) {
+#ifdef CURB_HAVE_TRANSFER_WITHOUT_GVL
+  if (curb_active_staging) {
+    return curb_active_staging->foreign || curb_transfer_call_with_gvl(curb_write_check_ints_i, NULL);
+  }
+#endif
+  return rescue_easy_callback(rbce, curb_write_check_ints, Qnil) == Qtrue;
+}
+
+/* write(2) all of +data+ to +fd+, never holding the GVL while it may block
+ * on a slow reader. Returns 0, or the errno that stopped it. */
+static int curb_write_all(ruby_curl_easy *rbce, int fd, const char *data, size_t len) {
+  struct curb_write_args args;
+
+  args.fd = fd;
+  args.data = data;
+  args.len = len;
+  args.written = 0;
+  for (;;) {
+#ifdef CURB_HAVE_TRANSFER_WITHOUT_GVL
+    if (curb_active_staging) {
+      curb_write_loop(&args);
+    } else
+#endif
+    {
+#ifdef HAVE_RB_THREAD_CALL_WITHOUT_GVL
+      rb_thread_call_without_gvl(curb_write_loop, &args, RUBY_UBF_IO, NULL);
+#else
+      curb_write_loop(&args);
+#endif
+    }
+    if (args.err != EINTR) return args.err;
+    if (!curb_write_interrupt_handled(rbce)) return EINTR;
+  }
+}
+
+/* Record a failed body write as Curl::Err::WriteError; returns 0 so write
+ * callbacks can abort the transfer with it. A foreign thread leaves the
+ * errno for rb_curl_easy_collect_native. */
+static size_t curb_body_write_failed(ruby_curl_easy *rbce, int err) {
+  rbce->body_fd_errno = err;
+#ifdef CURB_HAVE_TRANSFER_WITHOUT_GVL
+  if (curb_active_staging && !curb_active_staging->foreign) {
+    curb_transfer_call_with_gvl(store_body_write_error, rbce);
+  } else if (!curb_active_staging)
+#endif
+  {
+    store_body_write_error(rbce);
+  }
+  return 0;
+}
+
+/* Body handler for body_fd. Touches no Ruby objects, so it runs as is
+ * while a multi drives transfers without the GVL. */
+static size_t fd_body_handler(char *stream,
+                              size_t size,
+                              size_t nmemb,
+                              void *userdata) {
+  ruby_curl_easy *rbce = (ruby_curl_easy *)userdata;
+  size_t total = size * nmemb;
+  int err;
+
+  if (ruby_curl_easy_body_limit_exceeded(rbce, total)) {
+    return 0;
+  }
+
+  err = curb_write_all(rbce, rbce->body_fd, stream, total);
+  return err ? curb_body_write_failed(rbce, err) : total;
+}
+
+#ifndef _WIN32
+static void curb_spill_close(ruby_curl_easy *rbce) {
+  if (rbce->spill_fd >= 0) {
+    close(rbce->spill_fd);
+    rbce->spill_fd = -1;
+  }
+}
+
+/* Create the spill file: unlinked straight away, so the body disappears
+ * with its last descriptor. Needs no GVL. */
+static int curb_spill_open(ruby_curl_easy *rbce) {
+  const char *dir = rbce->body_spill_dir;
+  char path[4096];
+  int fd;
+
+  if (!dir || !*dir) dir = getenv("TMPDIR");
+  if (!dir || !*dir) dir = "/tmp";
+  if (snprintf(path, sizeof(path), "%s/curb-body-XXXXXX", dir) >= (int)sizeof(path)) {
+    return ENAMETOOLONG;
+  }
+
+  fd = mkstemp(path);
+  if (fd < 0) return errno;
+  unlink(path);
+  fcntl(fd, F_SETFD, FD_CLOEXEC);
+  rbce->spill_fd = fd;
+  return 0;
+}
+
+/* Requires the GVL: switch to the spill file, moving what body_data holds. */
+static void *curb_spill_body_data(void *arg) {
+  ruby_curl_easy *rbce = (ruby_curl_easy *)arg;
+  VALUE out = rb_easy_get("body_data");
+  int err = curb_spill_open(rbce);
+
+  if (!err && RB_TYPE_P(out, T_STRING) && RSTRING_LEN(out) > 0) {
+    err = curb_write_all(rbce, rbce->spill_fd, RSTRING_PTR(out), (size_t)RSTRING_LEN(out));
+  }
+  if (err) {
+    rbce->body_fd_errno = err;
+    store_body_write_error(rbce);
+    return NULL;
+  }
+  curb_clear_response_buffer(rbce, "body_data");
+  return NULL;
+}
+
+/* The body just outgrew body_spill_threshold: carry on in a temp file. */
+static int curb_spill_start(ruby_curl_easy *rbce) {
+#ifdef CURB_HAVE_TRANSFER_WITHOUT_GVL
+  if (curb_active_staging && curb_active_staging->foreign) {
+    /* Everything so far is staged: body_data is only filled on collect. */
+    int err = curb_spill_open(rbce);
+    if (!err) err = curb_write_all(rbce, rbce->spill_fd, rbce->staged_body.ptr, rbce->staged_body.len);
+    if (err) {
+      curb_body_write_failed(rbce, err);
+      return 0;
+    }
+    curb_native_buffer_release(&rbce->staged_body);
+    return 1;
+  }
+  if (curb_active_staging) {
+    /* Staged bytes are moved into body_data before the call. */
+    return curb_transfer_call_with_gvl(curb_spill_body_data, rbce) && rbce->spill_fd >= 0;
+  }
+#endif
+  curb_spill_body_data(rbce);
+  return rbce->spill_fd >= 0;
+}
+#else
+static void curb_spill_close(ruby_curl_easy *rbce) {
+  (void)rbce;
+}
+#endif
+
+/* Default body handler appends to easy.body_data buffer, or to the spill
+ * file once the body has outgrown body_spill_threshold */
 static size_t default_body_handler(char *stream,
                                    size_t size,
                                    size_t nmemb,
                                    void *userdata) {
   ruby_curl_easy *rbce = (ruby_curl_easy *)userdata;
   size_t total = size * nmemb;
-  VALUE out = rb_easy_get("body_data");
 
   if (ruby_curl_easy_body_limit_exceeded(rbce, total)) {
     return 0;
   }
 
-  if (NIL_P(out)) {
-    out = rb_easy_set("body_data", rb_str_buf_new(32768));
+#ifndef _WIN32
+  if (rbce->spill_fd < 0 && rbce->body_spill_threshold > 0 &&
+      (curl_off_t)total > rbce->body_spill_threshold - rbce->body_collected &&
+      !curb_spill_start(rbce)) {
+    return 0;
+  }
+  rbce->body_collected += (curl_off_t)total;
+  if (rbce->spill_fd >= 0) {
+    int err = curb_write_all(rbce, rbce->spill_fd, stream, total);
+    return err ? curb_body_write_failed(rbce, err) : total;
+  }
+#endif
+
+#ifdef CURB_HAVE_TRANSFER_WITHOUT_GVL
+  if (curb_active_staging) {
+    return curb_stage_bytes(curb_active_staging, rbce, &rbce->staged_body, stream, total) ? total : 0;
   }
-  rb_str_buf_cat(out, stream, total);
+#endif
+
+  rb_str_buf_cat(curb_body_buffer(rbce, total), stream, total);
   return total;
 }
 
@@ -906,11 +1474,15 @@ static size_t default_header_handler(char *stream,
                                      void *userdata) {
   ruby_curl_easy *rbce = (ruby_curl_easy *)userdata;
   size_t total = size * nmemb;
-  VALUE out = rb_easy_get("header_data");
-  if (NIL_P(out)) {
-    out = rb_easy_set("header_data", rb_str_buf_new(16384));
+
+  rbce->header_lines++;
+#ifdef CURB_HAVE_TRANSFER_WITHOUT_GVL
+  if (curb_active_staging) {
+    return curb_stage_bytes(curb_active_staging, rbce, &rbce->staged_header, stream, total) ? total : 0;
   }
-  rb_str_buf_cat(out, stream, total);
+#endif
+
+  rb_str_buf_cat(curb_header_buffer(rbce, total), stream, total);
   return total;
 }
 
@@ -919,10 +1491,18 @@ static size_t read_data_handler(void *ptr,
                                 size_t size,
                                 size_t nmemb,
                                 ruby_curl_easy *rbce) {
-  VALUE upload = rb_easy_get("upload");
+  VALUE upload;
   size_t read_bytes = (size*nmemb);
   VALUE stream;
 
+#ifdef CURB_HAVE_TRANSFER_WITHOUT_GVL
+  if (curb_active_staging) {
+    return curb_data_handler_with_gvl((curb_data_handler_func)read_data_handler, (char *)ptr, size, nmemb, rbce, curl_read_abort_result());
+  }
+#endif
+
+  upload = rb_easy_get("upload");
+
   if (NIL_P(upload)) {
     return curl_read_abort_result();
   }
@@ -996,13 +1576,39 @@ static size_t read_data_handler(void *ptr,
   }
 }
 
+#ifdef CURB_HAVE_TRANSFER_WITHOUT_GVL
+int seek_data_handler(ruby_curl_easy *rbce, curl_off_t offset, int origin);
+
+struct seek_handler_gvl_args {
+  ruby_curl_easy *rbce;
+  curl_off_t offset;
+  int origin;
+  int result;
+};
+
+static void *seek_handler_gvl_i(void *argp) {
+  struct seek_handler_gvl_args *args = (struct seek_handler_gvl_args *)argp;
+  args->result = seek_data_handler(args->rbce, args->offset, args->origin);
+  return NULL;
+}
+#endif
+
 int seek_data_handler(ruby_curl_easy *rbce,
                       curl_off_t offset,
                       int origin) {
 
-  VALUE upload = rb_easy_get("upload");
+  VALUE upload;
   VALUE stream;
 
+#ifdef CURB_HAVE_TRANSFER_WITHOUT_GVL
+  if (curb_active_staging) {
+    struct seek_handler_gvl_args args = { rbce, offset, origin, curl_seek_fail_result() };
+    return curb_transfer_call_with_gvl(seek_handler_gvl_i, &args) ? args.result : curl_seek_fail_result();
+  }
+#endif
+
+  upload = rb_easy_get("upload");
+
   if (NIL_P(upload)) {
     return curl_seek_fail_result();
   }
@@ -1055,6 +1661,13 @@ static size_t proc_data_handler_body(char *stream,
   struct proc_data_call_args args;
   struct easy_callback_dispatch_args dispatch_args;
   VALUE procret;
+
+#ifdef CURB_HAVE_TRANSFER_WITHOUT_GVL
+  if (curb_active_staging) {
+    return curb_data_handler_with_gvl(proc_data_handler_body, stream, size, nmemb, rbce, 0);
+  }
+#endif
+
   args.stream = stream;
   args.size = size;
   args.nmemb = nmemb;
@@ -1071,6 +1684,83 @@ static size_t proc_data_handler_body(char *stream,
 
   return ((procret == Qfalse) || (procret == Qnil)) ? 0 : NUM2ULONG(procret);
 }
+
+/* Requires the GVL: hand the coalesced bytes to on_body in one call. Returns
+ * 0 when the block raised or did not take all of them. */
+static int curb_deliver_body_chunk(ruby_curl_easy *rbce) {
+  struct proc_data_call_args args;
+  struct easy_callback_dispatch_args dispatch_args;
+  VALUE procret;
+  size_t len = rbce->body_chunk.len;
+
+  if (len == 0) {
+    return 1;
+  }
+
+  /* Emptied first: the block may perform again on this handle. */
+  rbce->body_chunk.len = 0;
+  args.stream = rbce->body_chunk.ptr;
+  args.size = 1;
+  args.nmemb = len;
+  args.proc = rb_easy_get("body_proc");
+
+  dispatch_args.rbce = rbce;
+  dispatch_args.func = call_proc_data_handler_wrapped;
+  dispatch_args.arg = (VALUE)&args;
+  procret = rb_rescue(call_with_easy_callback_active, (VALUE)&dispatch_args, callback_exception_store_on_easy, (VALUE)rbce);
+
+  return procret != Qfalse && procret != Qnil && NUM2ULONG(procret) == len;
+}
+
+#ifdef CURB_HAVE_TRANSFER_WITHOUT_GVL
+struct deliver_body_chunk_args {
+  ruby_curl_easy *rbce;
+  int delivered;
+};
+
+static void *deliver_body_chunk_i(void *argp) {
+  struct deliver_body_chunk_args *args = (struct deliver_body_chunk_args *)argp;
+  args->delivered = curb_deliver_body_chunk(args->rbce);
+  return NULL;
+}
+#endif
+
+/* on_body(min_chunk:): collect libcurl's writes natively and call the block
+ * only once min_chunk bytes are waiting. The rest is delivered when the
+ * transfer completes (rb_curl_easy_flush_body_chunk). */
+static size_t coalesced_body_handler(char *stream,
+                                     size_t size,
+                                     size_t nmemb,
+                                     void *userdata) {
+  ruby_curl_easy *rbce = (ruby_curl_easy *)userdata;
+  size_t total = size * nmemb;
+
+  if (ruby_curl_easy_body_limit_exceeded(rbce, total)) {
+    return 0;
+  }
+  if (!curb_native_buffer_append(&rbce->body_chunk, stream, total)) {
+    return 0;
+  }
+  if (rbce->body_chunk.len < rbce->body_min_chunk) {
+    return total;
+  }
+
+#ifdef CURB_HAVE_TRANSFER_WITHOUT_GVL
+  if (curb_active_staging) {
+    struct deliver_body_chunk_args args = { rbce, 0 };
+    return curb_transfer_call_with_gvl(deliver_body_chunk_i, &args) && args.delivered ? total : 0;
+  }
+#endif
+
+  return curb_deliver_body_chunk(rbce) ? total : 0;
+}
+
+/* Requires the GVL: pass on_body(min_chunk:) whatever is left once the
+ * transfer is over. Returns 0 if the block raised or rejected the bytes. */
+int rb_curl_easy_flush_body_chunk(ruby_curl_easy *rbce) {
+  return curb_deliver_body_chunk(rbce);
+}
+
 static size_t proc_data_handler_header(char *stream,
                                        size_t size,
                                        size_t nmemb,
@@ -1079,6 +1769,14 @@ static size_t proc_data_handler_header(char *stream,
   struct proc_data_call_args args;
   struct easy_callback_dispatch_args dispatch_args;
   VALUE procret;
+
+#ifdef CURB_HAVE_TRANSFER_WITHOUT_GVL
+  if (curb_active_staging) {
+    return curb_data_handler_with_gvl(proc_data_handler_header, stream, size, nmemb, rbce, 0);
+  }
+#endif
+  rbce->header_lines++;
+
   args.stream = stream;
   args.size = size;
   args.nmemb = nmemb;
@@ -1103,13 +1801,36 @@ static VALUE call_progress_handler(VALUE ary) {
 
 /* CURLOPT_PROGRESSFUNCTION callback (deprecated since 7.32.0) */
 #ifndef HAVE_CURLOPT_XFERINFOFUNCTION
+#ifdef CURB_HAVE_TRANSFER_WITHOUT_GVL
+static int proc_progress_handler(void *clientp, double dltotal, double dlnow, double ultotal, double ulnow);
+
+struct progress_handler_gvl_args {
+  void *clientp;
+  double dltotal, dlnow, ultotal, ulnow;
+  int result;
+};
+
+static void *progress_handler_gvl_i(void *argp) {
+  struct progress_handler_gvl_args *args = (struct progress_handler_gvl_args *)argp;
+  args->result = proc_progress_handler(args->clientp, args->dltotal, args->dlnow, args->ultotal, args->ulnow);
+  return NULL;
+}
+#endif
+
 static int proc_progress_handler(void *clientp,
                                  double dltotal,
                                  double dlnow,
                                  double ultotal,
                                  double ulnow) {
   ruby_curl_easy *rbce = (ruby_curl_easy *)clientp;
-  VALUE proc = rb_easy_get("progress_proc");
+  VALUE proc;
+#ifdef CURB_HAVE_TRANSFER_WITHOUT_GVL
+  if (curb_active_staging) {
+    struct progress_handler_gvl_args args = { clientp, dltotal, dlnow, ultotal, ulnow, -1 };
+    return curb_transfer_call_with_gvl(progress_handler_gvl_i, &args) ? args.result : -1;
+  }
+#endif
+  proc = rb_easy_get("progress_proc");
   if (proc == Qnil) {
     return 0;
   }
@@ -1134,13 +1855,36 @@ static int proc_progress_handler(void *clientp,
 
 /* CURLOPT_XFERINFOFUNCTION callback (since 7.32.0, replaces PROGRESSFUNCTION) */
 #ifdef HAVE_CURLOPT_XFERINFOFUNCTION
+#ifdef CURB_HAVE_TRANSFER_WITHOUT_GVL
+static int proc_xferinfo_handler(void *clientp, curl_off_t dltotal, curl_off_t dlnow, curl_off_t ultotal, curl_off_t ulnow);
+
+struct xferinfo_handler_gvl_args {
+  void *clientp;
+  curl_off_t dltotal, dlnow, ultotal, ulnow;
+  int result;
+};
+
+static void *xferinfo_handler_gvl_i(void *argp) {
+  struct xferinfo_handler_gvl_args *args = (struct xferinfo_handler_gvl_args *)argp;
+  args->result = proc_xferinfo_handler(args->clientp, args->dltotal, args->dlnow, args->ultotal, args->ulnow);
+  return NULL;
+}
+#endif
+
 static int proc_xferinfo_handler(void *clientp,
                                  curl_off_t dltotal,
                                  curl_off_t dlnow,
                                  curl_off_t ultotal,
                                  curl_off_t ulnow) {
   ruby_curl_easy *rbce = (ruby_curl_easy *)clientp;
-  VALUE proc = rb_easy_get("progress_proc");
+  VALUE proc;
+#ifdef CURB_HAVE_TRANSFER_WITHOUT_GVL
+  if (curb_active_staging) {
+    struct xferinfo_handler_gvl_args args = { clientp, dltotal, dlnow, ultotal, ulnow, -1 };
+    return curb_transfer_call_with_gvl(xferinfo_handler_gvl_i, &args) ? args.result : -1;
+  }
+#endif
+  proc = rb_easy_get("progress_proc");
   if (proc == Qnil) {
     return 0;
   }
@@ -1168,13 +1912,39 @@ static VALUE call_debug_handler(VALUE ary) {
                     rb_ary_entry(ary, 1), // INT2NUM(type),
                     rb_ary_entry(ary, 2)); // rb_str_new(data, data_len)
 }
+#ifdef CURB_HAVE_TRANSFER_WITHOUT_GVL
+static int proc_debug_handler(CURL *curl, curl_infotype type, char *data, size_t data_len, void *clientp);
+
+struct debug_handler_gvl_args {
+  CURL *curl;
+  curl_infotype type;
+  char *data;
+  size_t data_len;
+  void *clientp;
+};
+
+static void *debug_handler_gvl_i(void *argp) {
+  struct debug_handler_gvl_args *args = (struct debug_handler_gvl_args *)argp;
+  proc_debug_handler(args->curl, args->type, args->data, args->data_len, args->clientp);
+  return NULL;
+}
+#endif
+
 static int proc_debug_handler(CURL *curl,
                               curl_infotype type,
                               char *data,
                               size_t data_len,
                               void *clientp) {
   ruby_curl_easy *rbce = (ruby_curl_easy *)clientp;
-  VALUE proc = rb_easy_get("debug_proc");
+  VALUE proc;
+#ifdef CURB_HAVE_TRANSFER_WITHOUT_GVL
+  if (curb_active_staging) {
+    struct debug_handler_gvl_args args = { curl, type, data, data_len, clientp };
+    curb_transfer_call_with_gvl(debug_handler_gvl_i, &args);
+    return 0;
+  }
+#endif
+  proc = rb_easy_get("debug_proc");
   if (proc == Qnil) {
     return 0;
   }
@@ -1333,6 +2103,22 @@ static void ruby_curl_easy_free(ruby_curl_easy *rbce) {
   ruby_curl_easy_clear_connect_to_list(rbce);
   curb_clear_network_allowed_cidr_rules(rbce);
   curb_clear_network_allowed_hosts(rbce);
+#ifdef CURB_HAVE_TRANSFER_WITHOUT_GVL
+  curb_native_buffer_release(&rbce->staged_body);
+  curb_native_buffer_release(&rbce->staged_header);
+#endif
+  curb_native_buffer_release(&rbce->body_chunk);
+  curb_spill_close(rbce);
+  if (rbce->body_spill_dir) {
+    free(rbce->body_spill_dir);
+    rbce->body_spill_dir = NULL;
+  }
+  if (rbce->retry_policy) {
+    xfree(rbce->retry_policy);
+    rbce->retry_policy = NULL;
+  }
+
+  ruby_curl_share_detach(rbce);
 
   if (rbce->curl) {
     /* disable any progress or debug events */
@@ -1359,6 +2145,12 @@ static void ruby_curl_easy_free(ruby_curl_easy *rbce) {
 /* TypedData-compatible free function */
 static void curl_easy_free(void *ptr) {
   ruby_curl_easy *rbce = (ruby_curl_easy *)ptr;
+#ifdef CURB_HAVE_REACTOR
+  /* Still being transferred: the reactor frees it once its thread lets go. */
+  if (rbce && rbce->reactor_job && rb_curl_reactor_disown_easy(rbce)) {
+    return;
+  }
+#endif
   if (rbce) {
     ruby_curl_easy_free(rbce);
     free(rbce);
@@ -1437,6 +2229,29 @@ static void ruby_curl_easy_zero(ruby_curl_easy *rbce) {
   rbce->use_ssl = -1;
   rbce->ftp_filemethod = -1;
   rbce->http_version = CURL_HTTP_VERSION_NONE;
+  rbce->priority = 0;
+  rbce->stream_weight = 0;
+  rbce->pipewait = -1;
+  rbce->stream_exclusive = 0;
+  rbce->reuse_buffers = 0;
+  rbce->collect_body = 0;
+  rbce->collect_header = 0;
+  rbce->header_lines = 0;
+  rbce->response_headers_lines = 0;
+  rbce->body_fd = -1;
+  rbce->body_fd_errno = 0;
+  rbce->body_fd_start = -1;
+  rbce->spill_fd = -1;
+  rbce->body_spill_threshold = 0;
+  rbce->body_collected = 0;
+  rbce->body_spill_dir = NULL;
+  rbce->hedge_after_ms = 0;
+  rbce->hedge_peer = NULL;
+  rbce->hedge_clone = 0;
+  rbce->hedge_waiting = 0;
+  rbce->retry_policy = NULL;
+  rbce->retry_count = 0;
+  rbce->retry_pending = 0;
   rbce->resolve_mode = CURL_IPRESOLVE_WHATEVER;
   rbce->network_policy = CURB_NETWORK_POLICY_NONE;
 
@@ -1459,8 +2274,18 @@ static void ruby_curl_easy_zero(ruby_curl_easy *rbce) {
   rbce->allow_proxy = 0;
   rbce->allow_unix_socket = 0;
   rbce->forbid_reuse_set = 0;
+  rbce->staged_pending = 0;
+  rbce->reactor_active = 0;
+  rbce->reactor_job = NULL;
+  rbce->attached_share = NULL;
+  rbce->native_body_limit_exceeded = 0;
   rbce->native_active = 0;
   rbce->forbid_reuse = 0;
+  rbce->max_body_bytes = 0;
+  memset(&rbce->staged_body, 0, sizeof(rbce->staged_body));
+  memset(&rbce->staged_header, 0, sizeof(rbce->staged_header));
+  memset(&rbce->body_chunk, 0, sizeof(rbce->body_chunk));
+  rbce->body_min_chunk = 0;
   rbce->callback_error = Qnil;
   rbce->last_result = 0;
 }
@@ -1606,9 +2431,36 @@ static VALUE ruby_curl_easy_clone(VALUE self) {
   newrbce->unsafe_destination_blocked = 0;
   memset(newrbce->unsafe_destination_error, 0, CURL_ERROR_SIZE);
   newrbce->native_active = 0;
+  newrbce->staged_pending = 0;
+  newrbce->reactor_active = 0;
+  newrbce->reactor_job = NULL;
+  newrbce->attached_share = NULL;
+  newrbce->native_body_limit_exceeded = 0;
+  newrbce->hedge_peer = NULL;
+  newrbce->hedge_clone = 0;
+  newrbce->hedge_waiting = 0;
+  newrbce->retry_count = 0;
+  newrbce->retry_pending = 0;
+  if (rbce->retry_policy) {
+    newrbce->retry_policy = ALLOC(curb_retry_policy);
+    *newrbce->retry_policy = *rbce->retry_policy;
+  }
+  memset(&newrbce->staged_body, 0, sizeof(newrbce->staged_body));
+  memset(&newrbce->staged_header, 0, sizeof(newrbce->staged_header));
+  memset(&newrbce->body_chunk, 0, sizeof(newrbce->body_chunk));
+#ifndef _WIN32
+  /* The copy reads the same spilled body; both descriptors survive the other. */
+  newrbce->spill_fd = rbce->spill_fd >= 0 ? fcntl(rbce->spill_fd, F_DUPFD_CLOEXEC, 0) : -1;
+#endif
+  newrbce->body_spill_dir = rbce->body_spill_dir ? strdup(rbce->body_spill_dir) : NULL;
 
   if (rbce->opts != Qnil) {
     newrbce->opts = rb_funcall(rbce->opts, rb_intern("dup"), 0);
+    /* The copies would share response strings that reuse_buffers empties. */
+    if (rbce->reuse_buffers) {
+      rb_hash_delete(newrbce->opts, rb_easy_hkey("body_data"));
+      rb_hash_delete(newrbce->opts, rb_easy_hkey("header_data"));
+    }
   }
 
   /* Set the error buffer on the new curl handle using the new err_buf */
@@ -1713,6 +2565,12 @@ static VALUE ruby_curl_easy_reset(VALUE self) {
 
   ruby_curl_easy_cleanup(self, rbce);
   curl_easy_reset(rbce->curl);
+  if (rbce->retry_policy) {
+    xfree(rbce->retry_policy);
+  }
+  curb_native_buffer_release(&rbce->body_chunk);
+  curb_spill_close(rbce);
+  if (rbce->body_spill_dir) free(rbce->body_spill_dir);
   ruby_curl_easy_zero(rbce);
   rbce->self = self;
 
@@ -3346,6 +4204,27 @@ static VALUE ruby_curl_easy_enable_cookies_q(VALUE self) {
   CURB_BOOLEAN_GETTER(ruby_curl_easy, enable_cookies);
 }
 
+/*
+ * call-seq:
+ *   easy.reuse_buffers = boolean                     => boolean
+ *
+ * With reuse_buffers on, each +perform+ empties the strings returned by
+ * +body_str+ and +header_str+ in place and writes the new response into
+ * them, keeping the memory they already hold. Copy a body you need to keep
+ * past the next perform. Off by default.
+ */
+static VALUE ruby_curl_easy_reuse_buffers_set(VALUE self, VALUE reuse_buffers) {
+  CURB_BOOLEAN_SETTER(ruby_curl_easy, reuse_buffers);
+}
+
+/*
+ * call-seq:
+ *   easy.reuse_buffers?                              => boolean
+ */
+static VALUE ruby_curl_easy_reuse_buffers_q(VALUE self) {
+  CURB_BOOLEAN_GETTER(ruby_curl_easy, reuse_buffers);
+}
+
 /*
  * call-seq:
  *   easy.ignore_content_length = boolean
@@ -3552,6 +4431,369 @@ static VALUE ruby_curl_easy_http_version_set(VALUE self, VALUE version) {
   return version;
 }
 
+/*
+ * call-seq:
+ *   easy.priority = 256                              => 256
+ *   easy.priority = nil                              => nil
+ *
+ * Set this request's priority, from 1 (lowest) to 256 (highest). When the
+ * easy is queued with Curl::Multi#enqueue, higher priorities are admitted
+ * before lower ones, so interactive requests do not wait behind a bulk
+ * backlog. Over HTTP/2 the value is also sent as the stream weight. nil
+ * (the default) behaves like 16, HTTP/2's default weight.
+ */
+static VALUE ruby_curl_easy_priority_set(VALUE self, VALUE priority) {
+  ruby_curl_easy *rbce;
+  long value = 0;
+
+  TypedData_Get_Struct(self, ruby_curl_easy, &ruby_curl_easy_data_type, rbce);
+
+  if (!NIL_P(priority)) {
+    value = NUM2LONG(priority);
+    if (value < 1 || value > 256) {
+      rb_raise(rb_eArgError, "priority must be between 1 and 256");
+    }
+  }
+
+  rbce->priority = value;
+
+  return priority;
+}
+
+/*
+ * call-seq:
+ *   easy.priority                                    => integer or nil
+ *
+ * Returns the priority set with +priority=+, or nil.
+ */
+static VALUE ruby_curl_easy_priority_get(VALUE self) {
+  ruby_curl_easy *rbce;
+
+  TypedData_Get_Struct(self, ruby_curl_easy, &ruby_curl_easy_data_type, rbce);
+
+  return rbce->priority > 0 ? LONG2NUM(rbce->priority) : Qnil;
+}
+
+/*
+ * call-seq:
+ *   easy.stream_weight = 256                         => 256
+ *   easy.stream_weight = nil                         => nil
+ *
+ * Set the HTTP/2 stream weight, from 1 to 256, independently of +priority+
+ * (which it overrides on the wire but not for queue admission). nil, the
+ * default, sends the priority.
+ */
+static VALUE ruby_curl_easy_stream_weight_set(VALUE self, VALUE weight) {
+  ruby_curl_easy *rbce;
+  long value = 0;
+
+  TypedData_Get_Struct(self, ruby_curl_easy, &ruby_curl_easy_data_type, rbce);
+
+  if (!NIL_P(weight)) {
+    value = NUM2LONG(weight);
+    if (value < 1 || value > 256) {
+      rb_raise(rb_eArgError, "stream weight must be between 1 and 256");
+    }
+  }
+
+  rbce->stream_weight = value;
+
+  return weight;
+}
+
+/*
+ * call-seq:
+ *   easy.stream_weight                               => integer or nil
+ *
+ * Returns the weight set with +stream_weight=+, or nil.
+ */
+static VALUE ruby_curl_easy_stream_weight_get(VALUE self) {
+  ruby_curl_easy *rbce;
+
+  TypedData_Get_Struct(self, ruby_curl_easy, &ruby_curl_easy_data_type, rbce);
+
+  return rbce->stream_weight > 0 ? LONG2NUM(rbce->stream_weight) : Qnil;
+}
+
+/*
+ * call-seq:
+ *   easy.stream_depends = parent_easy                => parent_easy
+ *   easy.stream_depends = nil                        => nil
+ *
+ * Make this request's HTTP/2 stream depend on +parent_easy+'s, which
+ * should run in the same Curl::Multi over the same connection. With
+ * +stream_exclusive+ set, it becomes the parent's only dependency and the
+ * parent's other dependents move under it.
+ */
+static VALUE ruby_curl_easy_stream_depends_set(VALUE self, VALUE parent) {
+  ruby_curl_easy *rbce;
+
+  TypedData_Get_Struct(self, ruby_curl_easy, &ruby_curl_easy_data_type, rbce);
+
+  if (!NIL_P(parent) && !rb_obj_is_kind_of(parent, cCurlEasy)) {
+    rb_raise(rb_eTypeError, "stream_depends must be a Curl::Easy or nil");
+  }
+  if (parent == self) {
+    rb_raise(rb_eArgError, "a stream cannot depend on itself");
+  }
+  if (NIL_P(parent)) {
+    rb_easy_del("stream_depends");
+  } else {
+    rb_easy_set("stream_depends", parent);
+  }
+
+  return parent;
+}
+
+/*
+ * call-seq:
+ *   easy.stream_depends                              => Curl::Easy or nil
+ */
+static VALUE ruby_curl_easy_stream_depends_get(VALUE self) {
+  ruby_curl_easy *rbce;
+
+  TypedData_Get_Struct(self, ruby_curl_easy, &ruby_curl_easy_data_type, rbce);
+
+  return rb_easy_nil("stream_depends") ? Qnil : rb_easy_get("stream_depends");
+}
+
+/*
+ * call-seq:
+ *   easy.stream_exclusive = true                     => true
+ *
+ * Make the dependency set with +stream_depends=+ exclusive.
+ */
+static VALUE ruby_curl_easy_stream_exclusive_set(VALUE self, VALUE stream_exclusive) {
+  CURB_BOOLEAN_SETTER(ruby_curl_easy, stream_exclusive);
+}
+
+/*
+ * call-seq:
+ *   easy.stream_exclusive?                           => boolean
+ */
+static VALUE ruby_curl_easy_stream_exclusive_q(VALUE self) {
+  CURB_BOOLEAN_GETTER(ruby_curl_easy, stream_exclusive);
+}
+
+/*
+ * call-seq:
+ *   easy.pipewait = true                             => true
+ *   easy.pipewait = nil                              => nil
+ *
+ * With pipewait on, a request to an origin whose connection is still being
+ * set up waits for it, to multiplex over it, instead of opening another
+ * connection. nil (the default) follows Curl::Multi#pipewait= of the multi
+ * the transfer runs in, which is off unless set.
+ */
+static VALUE ruby_curl_easy_pipewait_set(VALUE self, VALUE pipewait) {
+  ruby_curl_easy *rbce;
+
+  TypedData_Get_Struct(self, ruby_curl_easy, &ruby_curl_easy_data_type, rbce);
+  rbce->pipewait = NIL_P(pipewait) ? -1 : RTEST(pipewait) ? 1 : 0;
+
+  return pipewait;
+}
+
+/*
+ * call-seq:
+ *   easy.pipewait                                    => true, false or nil
+ */
+static VALUE ruby_curl_easy_pipewait_get(VALUE self) {
+  ruby_curl_easy *rbce;
+
+  TypedData_Get_Struct(self, ruby_curl_easy, &ruby_curl_easy_data_type, rbce);
+
+  return rbce->pipewait < 0 ? Qnil : rbce->pipewait ? Qtrue : Qfalse;
+}
+
+/*
+ * call-seq:
+ *   easy.share = Curl::Share.new(:dns, :ssl_session) => #<Curl::Share>
+ *   easy.share = nil                                 => nil
+ *
+ * Use the caches of a Curl::Share for this easy's transfers. The share is
+ * attached for the length of each transfer, so one share can serve easies
+ * in any number of multis and threads.
+ */
+static VALUE ruby_curl_easy_share_set(VALUE self, VALUE share) {
+  ruby_curl_easy *rbce;
+
+  TypedData_Get_Struct(self, ruby_curl_easy, &ruby_curl_easy_data_type, rbce);
+
+  if (!NIL_P(share) && !rb_obj_is_kind_of(share, cCurlShare)) {
+    rb_raise(rb_eTypeError, "share must be a Curl::Share or nil");
+  }
+  if (NIL_P(share)) {
+    rb_easy_del("share");
+  } else {
+    rb_easy_set("share", share);
+  }
+
+  return share;
+}
+
+/*
+ * call-seq:
+ *   easy.share                                       => #<Curl::Share> or nil
+ */
+static VALUE ruby_curl_easy_share_get(VALUE self) {
+  ruby_curl_easy *rbce;
+
+  TypedData_Get_Struct(self, ruby_curl_easy, &ruby_curl_easy_data_type, rbce);
+
+  return rb_easy_nil("share") ? Qnil : rb_easy_get("share");
+}
+
+/*
+ * call-seq:
+ *   easy.hedge_after = 250                           => 250
+ *   easy.hedge_after = nil                           => nil
+ *
+ * Hedge this request when it runs in a Curl::Multi: if it has not finished
+ * after this many milliseconds, the multi starts a clone of it and keeps
+ * whichever transfer succeeds first. The result (body, headers, getinfo and
+ * errors) always lands on this easy; the slower transfer is dropped. A
+ * transfer that fails while the other is still running waits for it, so an
+ * error is only reported once both failed.
+ *
+ * Only use this for idempotent requests. Requests with a POST body, an
+ * upload or Ruby transfer callbacks (on_body, on_header, on_progress,
+ * on_debug) are never hedged. See Curl::Multi#hedge_stats.
+ */
+static VALUE ruby_curl_easy_hedge_after_set(VALUE self, VALUE ms) {
+  ruby_curl_easy *rbce;
+  long value = 0;
+
+  TypedData_Get_Struct(self, ruby_curl_easy, &ruby_curl_easy_data_type, rbce);
+
+  if (!NIL_P(ms)) {
+    value = NUM2LONG(ms);
+    if (value < 0) {
+      rb_raise(rb_eArgError, "hedge_after must be >= 0");
+    }
+  }
+
+  rbce->hedge_after_ms = value;
+
+  return ms;
+}
+
+/*
+ * call-seq:
+ *   easy.hedge_after                                 => integer or nil
+ *
+ * Returns the hedging delay in milliseconds set with +hedge_after=+, or nil.
+ */
+static VALUE ruby_curl_easy_hedge_after_get(VALUE self) {
+  ruby_curl_easy *rbce;
+
+  TypedData_Get_Struct(self, ruby_curl_easy, &ruby_curl_easy_data_type, rbce);
+
+  return rbce->hedge_after_ms > 0 ? LONG2NUM(rbce->hedge_after_ms) : Qnil;
+}
+
+static void curb_retry_policy_set_bits(uint64_t *bits, long nbits, VALUE values, const char *name) {
+  long i;
+
+  Check_Type(values, T_ARRAY);
+  for (i = 0; i < RARRAY_LEN(values); i++) {
+    long value = NUM2LONG(rb_ary_entry(values, i));
+    if (value < 0 || value >= nbits) {
+      rb_raise(rb_eArgError, "retry_policy %s: %ld is out of range", name, value);
+    }
+    bits[value / 64] |= (uint64_t)1 << (value % 64);
+  }
+}
+
+static long curb_retry_policy_ms(VALUE seconds, const char *name) {
+  double value = NUM2DBL(seconds);
+  if (value < 0) {
+    rb_raise(rb_eArgError, "retry_policy %s must be >= 0", name);
+  }
+  return (long)(value * 1000.0);
+}
+
+/*
+ * call-seq:
+ *   easy._retry_policy = { attempts: 3, backoff: 0.1, max_backoff: 30.0,
+ *                          jitter: 0.5, on: [7, 28], statuses: [503],
+ *                          retry_after: true }       => hash
+ *   easy._retry_policy = nil                          => nil
+ *
+ * Install a retry policy normalized by Easy#retry_policy=.
+ */
+static VALUE ruby_curl_easy_retry_policy_set(VALUE self, VALUE policy) {
+  ruby_curl_easy *rbce;
+  curb_retry_policy parsed;
+
+  TypedData_Get_Struct(self, ruby_curl_easy, &ruby_curl_easy_data_type, rbce);
+
+  if (NIL_P(policy)) {
+    if (rbce->retry_policy) {
+      xfree(rbce->retry_policy);
+      rbce->retry_policy = NULL;
+    }
+    rb_easy_del("retry_policy");
+    return policy;
+  }
+
+  Check_Type(policy, T_HASH);
+  MEMZERO(&parsed, curb_retry_policy, 1);
+  parsed.attempts = NUM2LONG(rb_hash_fetch(policy, ID2SYM(rb_intern("attempts"))));
+  if (parsed.attempts < 0) {
+    rb_raise(rb_eArgError, "retry_policy attempts must be >= 0");
+  }
+  parsed.base_delay_ms = curb_retry_policy_ms(rb_hash_fetch(policy, ID2SYM(rb_intern("backoff"))), "backoff");
+  parsed.max_delay_ms = curb_retry_policy_ms(rb_hash_fetch(policy, ID2SYM(rb_intern("max_backoff"))), "max_backoff");
+  if (parsed.max_delay_ms < parsed.base_delay_ms) {
+    rb_raise(rb_eArgError, "retry_policy max_backoff must be >= backoff");
+  }
+  parsed.jitter = NUM2DBL(rb_hash_fetch(policy, ID2SYM(rb_intern("jitter"))));
+  if (parsed.jitter < 0.0 || parsed.jitter > 1.0) {
+    rb_raise(rb_eArgError, "retry_policy jitter must be between 0 and 1");
+  }
+  parsed.retry_after = RTEST(rb_hash_fetch(policy, ID2SYM(rb_intern("retry_after"))));
+  curb_retry_policy_set_bits(parsed.codes, CURB_RETRY_CODE_BITS, rb_hash_fetch(policy, ID2SYM(rb_intern("on"))), "on");
+  curb_retry_policy_set_bits(parsed.statuses, CURB_RETRY_STATUS_BITS, rb_hash_fetch(policy, ID2SYM(rb_intern("statuses"))), "statuses");
+
+  if (!rbce->retry_policy) {
+    rbce->retry_policy = ALLOC(curb_retry_policy);
+  }
+  *rbce->retry_policy = parsed;
+  rb_easy_set("retry_policy", policy);
+
+  return policy;
+}
+
+/*
+ * call-seq:
+ *   easy.retry_policy                                => hash or nil
+ *
+ * The retry policy set with +retry_policy=+, with every default filled in.
+ */
+static VALUE ruby_curl_easy_retry_policy_get(VALUE self) {
+  ruby_curl_easy *rbce;
+
+  TypedData_Get_Struct(self, ruby_curl_easy, &ruby_curl_easy_data_type, rbce);
+
+  return rb_easy_get("retry_policy");
+}
+
+/*
+ * call-seq:
+ *   easy.retry_count                                 => integer
+ *
+ * How many times the last request was retried under the easy's retry
+ * policy, see +retry_policy=+.
+ */
+static VALUE ruby_curl_easy_retry_count_get(VALUE self) {
+  ruby_curl_easy *rbce;
+
+  TypedData_Get_Struct(self, ruby_curl_easy, &ruby_curl_easy_data_type, rbce);
+
+  return LONG2NUM(rbce->retry_count);
+}
+
 /*
  * call-seq:
  *   easy.http_version                                => integer
@@ -3569,9 +4811,23 @@ static VALUE ruby_curl_easy_http_version_get(VALUE self) {
 
 /* ================= EVENT PROCS ================== */
 
+static size_t curb_body_min_chunk_value(VALUE bytes) {
+  long value;
+
+  if (NIL_P(bytes)) {
+    return 0;
+  }
+  value = NUM2LONG(bytes);
+  if (value < 0) {
+    rb_raise(rb_eArgError, "min_chunk must be non-negative");
+  }
+  return (size_t)value;
+}
+
 /*
  * call-seq:
  *   easy.on_body { |body_data| ... }                 => <old handler>
+ *   easy.on_body(min_chunk: bytes) { |body_data| ... } => <old handler>
  *
  * Assign or remove the +on_body+ handler for this Curl::Easy instance.
  * To remove a previously-supplied handler, call this method with no
@@ -3583,9 +4839,65 @@ static VALUE ruby_curl_easy_http_version_get(VALUE self) {
  * equal the length of the data string, and CURL will continue processing.
  * If the returned length does not equal the input length, CURL will abort
  * the processing with a Curl::Err::AbortedByCallbackError.
+ *
+ * libcurl writes a few KB at a time. With +min_chunk+, the chunks are
+ * collected natively and the handler is only called once at least that many
+ * bytes are waiting, plus once more with the remainder when the transfer
+ * ends. Rejecting that final chunk fails the request with
+ * Curl::Err::WriteError. See also #body_min_chunk=.
  */
 static VALUE ruby_curl_easy_on_body_set(int argc, VALUE *argv, VALUE self) {
-  CURB_HANDLER_PROC_HSETTER(ruby_curl_easy, body_proc);
+  ruby_curl_easy *rbce;
+  VALUE oldproc, newproc, opts = Qnil;
+  size_t min_chunk = 0;
+
+  TypedData_Get_Struct(self, ruby_curl_easy, &ruby_curl_easy_data_type, rbce);
+  rb_scan_args(argc, argv, "0:&", &opts, &newproc);
+  if (!NIL_P(opts)) {
+    ID key = rb_intern("min_chunk");
+    VALUE value = Qundef;
+
+    rb_get_kwargs(opts, &key, 0, 1, &value);
+    if (value != Qundef) {
+      min_chunk = curb_body_min_chunk_value(value);
+    }
+  }
+
+  oldproc = rb_easy_get("body_proc");
+  rb_easy_set("body_proc", newproc);
+  rbce->body_min_chunk = min_chunk;
+
+  return oldproc;
+}
+
+/*
+ * call-seq:
+ *   easy.body_min_chunk = bytes                      => bytes
+ *
+ * Coalesce body data for the +on_body+ handler into chunks of at least
+ * +bytes+, as on_body(min_chunk:) does. 0 or nil hands the handler every
+ * write libcurl makes. Assigning a handler with #on_body resets this.
+ */
+static VALUE ruby_curl_easy_body_min_chunk_set(VALUE self, VALUE bytes) {
+  ruby_curl_easy *rbce;
+
+  TypedData_Get_Struct(self, ruby_curl_easy, &ruby_curl_easy_data_type, rbce);
+  rbce->body_min_chunk = curb_body_min_chunk_value(bytes);
+  return bytes;
+}
+
+/*
+ * call-seq:
+ *   easy.body_min_chunk                              => integer
+ *
+ * The smallest chunk the +on_body+ handler is called with before the
+ * transfer ends, or 0 when every libcurl write is passed on.
+ */
+static VALUE ruby_curl_easy_body_min_chunk_get(VALUE self) {
+  ruby_curl_easy *rbce;
+
+  TypedData_Get_Struct(self, ruby_curl_easy, &ruby_curl_easy_data_type, rbce);
+  return SIZET2NUM(rbce->body_min_chunk);
 }
 
 /*
@@ -3883,6 +5195,14 @@ static VALUE ruby_curl_easy_setup_body(VALUE arg) {
   url = rb_check_string_type(_url);
   curl_easy_setopt(curl, CURLOPT_URL, StringValuePtr(url));
 
+#ifdef HAVE_CURLOPT_SHARE
+  if (!rb_easy_nil("share")) {
+    ruby_curl_share_attach(rbce, rb_easy_get("share"));
+  } else {
+    ruby_curl_share_detach(rbce);
+  }
+#endif
+
 #ifdef HAVE_CURLOPT_DOH_URL
   curl_easy_setopt(curl, CURLOPT_DOH_URL, rb_easy_nil("doh_url") ? NULL : rb_easy_get_str("doh_url"));
 #endif
@@ -3991,28 +5311,61 @@ static VALUE ruby_curl_easy_setup_body(VALUE arg) {
     curl_easy_setopt(curl, CURLOPT_NOPROXY, rb_easy_get_str("noproxy"));
   }
 #endif
-
-  // body/header procs
-  rbce->downloaded_body_bytes = 0;
-
-  if (!rb_easy_nil("body_proc")) {
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, (curl_write_callback)&proc_data_handler_body);
+
+  // body/header procs
+  rbce->downloaded_body_bytes = 0;
+  rbce->native_body_limit_exceeded = 0;
+
+  rbce->body_fd_errno = 0;
+  rbce->body_collected = 0;
+  curb_spill_close(rbce);
+  if (rbce->body_fd >= 0) {
+    VALUE io = rb_easy_get("body_io");
+    /* bytes the IO buffered itself must land before ours */
+    if (!NIL_P(io)) rb_io_flush(io);
+#ifndef _WIN32
+    if (rbce->retry_pending && rbce->body_fd_start >= 0) {
+      /* a retry replaces what the failed attempt wrote */
+      if (ftruncate(rbce->body_fd, (off_t)rbce->body_fd_start) == 0) {
+        lseek(rbce->body_fd, (off_t)rbce->body_fd_start, SEEK_SET);
+      }
+    } else if (!rbce->retry_pending) {
+      rbce->body_fd_start = (curl_off_t)lseek(rbce->body_fd, 0, SEEK_CUR);
+    }
+#endif
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, (curl_write_callback)&fd_body_handler);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, rbce);
+    rb_easy_del("body_data");
+    rbce->collect_body = 0;
+  } else if (!rb_easy_nil("body_proc")) {
+    if (rbce->body_min_chunk > 0) {
+      rbce->body_chunk.len = 0;
+      curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, (curl_write_callback)&coalesced_body_handler);
+    } else {
+      curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, (curl_write_callback)&proc_data_handler_body);
+    }
     curl_easy_setopt(curl, CURLOPT_WRITEDATA, rbce);
     /* clear out the body_data if it was set */
     rb_easy_del("body_data");
+    rbce->collect_body = 0;
   } else {
-    rb_easy_set("body_data", rb_str_buf_new(32768));
+    curb_clear_response_buffer(rbce, "body_data");
+    rbce->collect_body = 1;
     curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, (curl_write_callback)&default_body_handler);
     curl_easy_setopt(curl, CURLOPT_WRITEDATA, rbce);
   }
 
+  rb_easy_del("response_headers");
+  rbce->header_lines = 0;
   if (!rb_easy_nil("header_proc")) {
     curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, (curl_write_callback)&proc_data_handler_header);
     curl_easy_setopt(curl, CURLOPT_HEADERDATA, rbce);
     /* clear out the header_data if it was set */
     rb_easy_del("header_data");
+    rbce->collect_header = 0;
   } else {
-    rb_easy_set("header_data", rb_str_buf_new(16384));
+    curb_clear_response_buffer(rbce, "header_data");
+    rbce->collect_header = 1;
     curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, (curl_write_callback)&default_header_handler);
     curl_easy_setopt(curl, CURLOPT_HEADERDATA, rbce);
   }
@@ -4095,6 +5448,25 @@ static VALUE ruby_curl_easy_setup_body(VALUE arg) {
 #if HAVE_CURLOPT_HTTP_VERSION
   curl_easy_setopt(curl, CURLOPT_HTTP_VERSION, rbce->http_version);
 #endif
+#ifdef HAVE_CURLOPT_STREAM_WEIGHT
+  curl_easy_setopt(curl, CURLOPT_STREAM_WEIGHT,
+                   rbce->stream_weight > 0 ? rbce->stream_weight : rbce->priority > 0 ? rbce->priority : 16L);
+#endif
+#ifdef HAVE_CURLOPT_STREAM_DEPENDS
+  if (!rb_easy_nil("stream_depends")) {
+    ruby_curl_easy *parent;
+    TypedData_Get_Struct(rb_easy_get("stream_depends"), ruby_curl_easy, &ruby_curl_easy_data_type, parent);
+#ifdef HAVE_CURLOPT_STREAM_DEPENDS_E
+    curl_easy_setopt(curl, rbce->stream_exclusive ? CURLOPT_STREAM_DEPENDS_E : CURLOPT_STREAM_DEPENDS, parent->curl);
+#else
+    curl_easy_setopt(curl, CURLOPT_STREAM_DEPENDS, parent->curl);
+#endif
+  }
+#endif
+#ifdef HAVE_CURLOPT_PIPEWAIT
+  /* A multi with pipewait on sets it again when the easy is added. */
+  curl_easy_setopt(curl, CURLOPT_PIPEWAIT, rbce->pipewait > 0 ? 1L : 0L);
+#endif
 
 
 #if LIBCURL_VERSION_NUM >= 0x070a08
@@ -4383,6 +5755,17 @@ VALUE ruby_curl_easy_cleanup( VALUE self, ruby_curl_easy *rbce ) {
   curb_clear_network_allowed_cidr_rules(rbce);
   curb_clear_network_allowed_hosts(rbce);
 
+#ifdef HAVE_CURLOPT_SHARE
+  /* only hold a share while transferring; see curl_share_free */
+  ruby_curl_share_detach(rbce);
+#endif
+#ifdef HAVE_CURLOPT_STREAM_DEPENDS
+  /* the parent's handle may not outlive this transfer */
+  if (!rb_easy_nil("stream_depends")) {
+    curl_easy_setopt(curl, CURLOPT_STREAM_DEPENDS, NULL);
+  }
+#endif
+
   /* clean up a PUT request's curl options. */
   if (!rb_easy_nil("upload")) {
     rb_easy_del("upload"); // set the upload object to Qnil to let the GC clean up
@@ -4768,6 +6151,30 @@ static VALUE ruby_curl_easy_perform_put(int argc, VALUE *argv, VALUE self) {
 
 /* =================== DATA FUNCS =============== */
 
+#ifndef _WIN32
+/* body_str for a spilled body: read the file back into body_data. */
+static VALUE curb_read_spilled_body(ruby_curl_easy *rbce) {
+  struct stat st;
+  VALUE out;
+  off_t done = 0;
+
+  if (fstat(rbce->spill_fd, &st) != 0) {
+    rb_sys_fail("fstat");
+  }
+  out = curb_response_buffer(rbce, "body_data", (long)st.st_size);
+  rb_str_modify_expand(out, (long)st.st_size);
+  while (done < st.st_size) {
+    ssize_t n = pread(rbce->spill_fd, RSTRING_PTR(out) + done, (size_t)(st.st_size - done), done);
+    if (n < 0 && errno == EINTR) continue;
+    if (n < 0) rb_sys_fail("pread");
+    if (n == 0) break;
+    done += n;
+  }
+  rb_str_set_len(out, (long)done);
+  return out;
+}
+#endif
+
 /*
  * call-seq:
  *   easy.body_str                                    => "response body"
@@ -4777,11 +6184,207 @@ static VALUE ruby_curl_easy_perform_put(int argc, VALUE *argv, VALUE self) {
  * your own body handler, this string will be empty.
  */
 static VALUE ruby_curl_easy_body_str_get(VALUE self) {
+  ruby_curl_easy *rbce;
   /*
      TODO: can we force_encoding on the return here if we see charset=utf-8 in the content-type header?
      Content-Type: application/json; charset=utf-8
   */
-  CURB_OBJECT_HGETTER(ruby_curl_easy, body_data);
+  TypedData_Get_Struct(self, ruby_curl_easy, &ruby_curl_easy_data_type, rbce);
+#ifndef _WIN32
+  if (rbce->spill_fd >= 0 && (rb_easy_nil("body_data") || RSTRING_LEN(rb_easy_get("body_data")) == 0)) {
+    return curb_read_spilled_body(rbce);
+  }
+#endif
+  if (rbce->collect_body && rb_easy_nil("body_data")) {
+    return rb_easy_set("body_data", rb_str_new(NULL, 0));
+  }
+  return rb_easy_get("body_data");
+}
+
+/*
+ * call-seq:
+ *   easy.body_io = io                                => io
+ *   easy.body_io = nil                               => nil
+ *
+ * Write the response body straight to the file descriptor of +io+ with
+ * write(2). While set this replaces both +body_str+ and +on_body+. No Ruby
+ * object is made per chunk, so a multi with release_gvl enabled streams the
+ * body without taking the GVL. Whatever +io+ buffered itself is flushed
+ * before each perform. max_body_bytes still applies, and a failed write
+ * raises Curl::Err::WriteError. When a retry policy restarts the request,
+ * a seekable file is cut back to where the first attempt began.
+ */
+static VALUE ruby_curl_easy_body_io_set(VALUE self, VALUE io) {
+  ruby_curl_easy *rbce;
+  int fd;
+
+  TypedData_Get_Struct(self, ruby_curl_easy, &ruby_curl_easy_data_type, rbce);
+  if (NIL_P(io)) {
+    rb_easy_del("body_io");
+    rbce->body_fd = -1;
+    return Qnil;
+  }
+
+  io = rb_io_get_io(io);
+  fd = NUM2INT(rb_funcall(io, rb_intern("fileno"), 0));
+  rb_easy_set("body_io", io);
+  rbce->body_fd = fd;
+  return io;
+}
+
+/*
+ * call-seq:
+ *   easy.body_io                                     => io or nil
+ */
+static VALUE ruby_curl_easy_body_io_get(VALUE self) {
+  CURB_OBJECT_HGETTER(ruby_curl_easy, body_io);
+}
+
+/*
+ * call-seq:
+ *   easy.body_fd = fd                                => fd
+ *   easy.body_fd = nil                               => nil
+ *
+ * Like body_io=, for a raw descriptor the caller keeps open for the
+ * duration of the transfer.
+ */
+static VALUE ruby_curl_easy_body_fd_set(VALUE self, VALUE fd) {
+  ruby_curl_easy *rbce;
+
+  TypedData_Get_Struct(self, ruby_curl_easy, &ruby_curl_easy_data_type, rbce);
+  rb_easy_del("body_io");
+  if (NIL_P(fd)) {
+    rbce->body_fd = -1;
+    return Qnil;
+  }
+  if (NUM2INT(fd) < 0) {
+    rb_raise(rb_eArgError, "body_fd must be a non-negative file descriptor");
+  }
+  rbce->body_fd = NUM2INT(fd);
+  return fd;
+}
+
+/*
+ * call-seq:
+ *   easy.body_fd                                     => integer or nil
+ */
+static VALUE ruby_curl_easy_body_fd_get(VALUE self) {
+  ruby_curl_easy *rbce;
+
+  TypedData_Get_Struct(self, ruby_curl_easy, &ruby_curl_easy_data_type, rbce);
+  return rbce->body_fd >= 0 ? INT2NUM(rbce->body_fd) : Qnil;
+}
+
+/*
+ * call-seq:
+ *   easy.body_spill_threshold = bytes                => bytes
+ *
+ * Keep a response body collected by the default handler in memory only
+ * up to +bytes+. Past that, what arrived so far and everything after it is
+ * written to an unlinked temp file (see #body_spill_dir=), so a rare huge
+ * response costs disk instead of RAM. #body_spill_io streams it back;
+ * +body_str+ still works, but reads the whole file into memory. The file
+ * goes away with the next perform or #close. 0 or nil keeps every body in
+ * memory. Not supported on Windows.
+ */
+static VALUE ruby_curl_easy_body_spill_threshold_set(VALUE self, VALUE bytes) {
+  ruby_curl_easy *rbce;
+  long long threshold = NIL_P(bytes) ? 0 : NUM2LL(bytes);
+
+  TypedData_Get_Struct(self, ruby_curl_easy, &ruby_curl_easy_data_type, rbce);
+  if (threshold < 0) {
+    rb_raise(rb_eArgError, "body_spill_threshold must be non-negative");
+  }
+#ifdef _WIN32
+  if (threshold > 0) {
+    rb_raise(rb_eNotImpError, "spilling response bodies to disk is not supported on this platform");
+  }
+#endif
+  rbce->body_spill_threshold = (curl_off_t)threshold;
+  return bytes;
+}
+
+/*
+ * call-seq:
+ *   easy.body_spill_threshold                        => integer
+ */
+static VALUE ruby_curl_easy_body_spill_threshold_get(VALUE self) {
+  ruby_curl_easy *rbce;
+
+  TypedData_Get_Struct(self, ruby_curl_easy, &ruby_curl_easy_data_type, rbce);
+  return LL2NUM((long long)rbce->body_spill_threshold);
+}
+
+/*
+ * call-seq:
+ *   easy.body_spill_dir = path                       => path
+ *
+ * Directory for spill files. nil (the default) uses $TMPDIR, or /tmp.
+ */
+static VALUE ruby_curl_easy_body_spill_dir_set(VALUE self, VALUE dir) {
+  ruby_curl_easy *rbce;
+  char *copy = NULL;
+
+  TypedData_Get_Struct(self, ruby_curl_easy, &ruby_curl_easy_data_type, rbce);
+  if (!NIL_P(dir)) {
+    dir = rb_get_path(dir);
+    copy = strdup(StringValueCStr(dir));
+    if (!copy) rb_memerror();
+  }
+  if (rbce->body_spill_dir) free(rbce->body_spill_dir);
+  rbce->body_spill_dir = copy;
+  return dir;
+}
+
+/*
+ * call-seq:
+ *   easy.body_spill_dir                              => string or nil
+ */
+static VALUE ruby_curl_easy_body_spill_dir_get(VALUE self) {
+  ruby_curl_easy *rbce;
+
+  TypedData_Get_Struct(self, ruby_curl_easy, &ruby_curl_easy_data_type, rbce);
+  return rbce->body_spill_dir ? rb_str_new_cstr(rbce->body_spill_dir) : Qnil;
+}
+
+/*
+ * call-seq:
+ *   easy.body_spilled?                               => true or false
+ *
+ * True when the last response body outgrew body_spill_threshold and is
+ * held in a temp file.
+ */
+static VALUE ruby_curl_easy_body_spilled_q(VALUE self) {
+  ruby_curl_easy *rbce;
+
+  TypedData_Get_Struct(self, ruby_curl_easy, &ruby_curl_easy_data_type, rbce);
+  return rbce->spill_fd >= 0 ? Qtrue : Qfalse;
+}
+
+/*
+ * call-seq:
+ *   easy.body_spill_io                               => File or nil
+ *
+ * A File reading the spilled body from its first byte, or nil when the
+ * body is in memory. It stays readable after the next perform; close it
+ * when done. Files returned by repeated calls share one read position.
+ */
+static VALUE ruby_curl_easy_body_spill_io(VALUE self) {
+  ruby_curl_easy *rbce;
+#ifndef _WIN32
+  int fd;
+#endif
+
+  TypedData_Get_Struct(self, ruby_curl_easy, &ruby_curl_easy_data_type, rbce);
+#ifndef _WIN32
+  if (rbce->spill_fd >= 0) {
+    fd = fcntl(rbce->spill_fd, F_DUPFD_CLOEXEC, 0);
+    if (fd < 0) rb_sys_fail("dup");
+    lseek(fd, 0, SEEK_SET);
+    return rb_funcall(rb_cFile, rb_intern("for_fd"), 2, INT2NUM(fd), rb_str_new_cstr("rb"));
+  }
+#endif
+  return Qnil;
 }
 
 /*
@@ -4799,6 +6402,7 @@ static VALUE ruby_curl_easy_max_body_bytes_set(VALUE self, VALUE val) {
 
   if (NIL_P(val)) {
     rb_hash_delete(rbce->opts, rb_easy_hkey("max_body_bytes"));
+    rbce->max_body_bytes = 0;
     return Qnil;
   }
 
@@ -4813,6 +6417,7 @@ static VALUE ruby_curl_easy_max_body_bytes_set(VALUE self, VALUE val) {
     val = LL2NUM(limit);
     rb_hash_aset(rbce->opts, rb_easy_hkey("max_body_bytes"), val);
   }
+  rbce->max_body_bytes = (curl_off_t)limit;
 
   return val;
 }
@@ -4834,7 +6439,308 @@ static VALUE ruby_curl_easy_max_body_bytes_get(VALUE self) {
  * your own header handler, this string will be empty.
  */
 static VALUE ruby_curl_easy_header_str_get(VALUE self) {
-  CURB_OBJECT_HGETTER(ruby_curl_easy, header_data);
+  ruby_curl_easy *rbce;
+
+  TypedData_Get_Struct(self, ruby_curl_easy, &ruby_curl_easy_data_type, rbce);
+  if (rbce->collect_header && rb_easy_nil("header_data")) {
+    return rb_easy_set("header_data", rb_str_new(NULL, 0));
+  }
+  return rb_easy_get("header_data");
+}
+
+
+/* ============== RESPONSE HEADERS ============== */
+
+static VALUE cCurlResponseHeaders;
+static ID id_response_headers_index;
+static VALUE curb_no_header_values;
+
+/* Lower-cased names of the fields most responses carry. Their keys are
+ * built once and shared by every index instead of allocated per response. */
+static const char *const curb_common_header_names[] = {
+  "accept-ranges", "access-control-allow-origin", "age", "alt-svc",
+  "cache-control", "connection", "content-disposition", "content-encoding",
+  "content-language", "content-length", "content-type", "date", "etag",
+  "expires", "keep-alive", "last-modified", "link", "location",
+  "retry-after", "server", "set-cookie", "strict-transport-security",
+  "transfer-encoding", "vary", "via", "www-authenticate", "x-cache",
+  "x-content-type-options", "x-frame-options", "x-request-id"
+};
+#define CURB_COMMON_HEADER_COUNT (sizeof(curb_common_header_names) / sizeof(curb_common_header_names[0]))
+static VALUE curb_common_header_keys[CURB_COMMON_HEADER_COUNT];
+static size_t curb_common_header_lens[CURB_COMMON_HEADER_COUNT];
+
+#define CURB_ASCII_DOWNCASE(c) (((c) >= 'A' && (c) <= 'Z') ? (char)((c) + ('a' - 'A')) : (c))
+
+/* The frozen, lower-cased index key for a field called +name+. */
+static VALUE curb_header_key(const char *name, size_t len) {
+  char lower[32];
+  VALUE key;
+  char *ptr;
+  size_t i;
+
+  if (len < sizeof(lower)) {
+    for (i = 0; i < len; i++) lower[i] = CURB_ASCII_DOWNCASE(name[i]);
+    for (i = 0; i < CURB_COMMON_HEADER_COUNT; i++) {
+      if (curb_common_header_lens[i] == len && memcmp(curb_common_header_names[i], lower, len) == 0) {
+        return curb_common_header_keys[i];
+      }
+    }
+    return rb_obj_freeze(rb_usascii_str_new(lower, (long)len));
+  }
+
+  key = rb_usascii_str_new(name, (long)len);
+  ptr = RSTRING_PTR(key);
+  for (i = 0; i < len; i++) ptr[i] = CURB_ASCII_DOWNCASE(ptr[i]);
+  return rb_obj_freeze(key);
+}
+
+static void curb_header_index_add(VALUE index, const char *name, size_t name_len, const char *value, size_t value_len) {
+  VALUE key = curb_header_key(name, name_len);
+  VALUE val = rb_obj_freeze(rb_str_new(value, (long)value_len));
+  VALUE values = rb_hash_lookup2(index, key, Qundef);
+
+  if (values == Qundef) {
+    rb_hash_aset(index, key, rb_ary_new_from_args(1, val));
+  } else {
+    rb_ary_push(values, val);
+  }
+}
+
+#ifndef HAVE_CURL_EASY_NEXTHEADER
+/* Index the last response in +raw+, the header_str of the transfer. */
+static void curb_header_index_parse(VALUE index, const char *raw, size_t len) {
+  const char *end = raw + len;
+
+  while (raw < end) {
+    const char *eol = memchr(raw, '\n', end - raw);
+    const char *line_end = eol ? eol : end;
+    const char *colon, *value;
+
+    if (line_end > raw && line_end[-1] == '\r') line_end--;
+    if (line_end - raw >= 5 && memcmp(raw, "HTTP/", 5) == 0) {
+      /* a new status line: redirects and 1xx replies come before it */
+      rb_hash_clear(index);
+    } else if (raw < line_end && raw[0] != ' ' && raw[0] != '\t' &&
+               (colon = memchr(raw, ':', line_end - raw)) != NULL) {
+      value = colon + 1;
+      while (value < line_end && (*value == ' ' || *value == '\t')) value++;
+      while (line_end > value && (line_end[-1] == ' ' || line_end[-1] == '\t')) line_end--;
+      curb_header_index_add(index, raw, colon - raw, value, line_end - value);
+    }
+    raw = eol ? eol + 1 : end;
+  }
+}
+#endif
+
+static int curb_header_index_freeze_i(VALUE key, VALUE values, VALUE arg) {
+  rb_obj_freeze(values);
+  return ST_CONTINUE;
+}
+
+static VALUE curb_response_headers_build(ruby_curl_easy *rbce) {
+  VALUE headers = rb_obj_alloc(cCurlResponseHeaders);
+  VALUE index = rb_hash_new();
+
+#ifdef HAVE_CURL_EASY_NEXTHEADER
+  if (rbce->curl) {
+    struct curl_header *header = NULL;
+    /* request -1 is the last one of the transfer, i.e. after redirects */
+    while ((header = curl_easy_nextheader(rbce->curl, CURLH_HEADER, -1, header)) != NULL) {
+      curb_header_index_add(index, header->name, strlen(header->name), header->value, strlen(header->value));
+    }
+  }
+#else
+  {
+    VALUE raw = rb_easy_get("header_data");
+    if (RB_TYPE_P(raw, T_STRING)) {
+      curb_header_index_parse(index, RSTRING_PTR(raw), (size_t)RSTRING_LEN(raw));
+    }
+  }
+#endif
+
+  rb_hash_foreach(index, curb_header_index_freeze_i, Qnil);
+  rb_ivar_set(headers, id_response_headers_index, rb_obj_freeze(index));
+  return rb_obj_freeze(headers);
+}
+
+/*
+ * call-seq:
+ *   easy.response_headers                            => Curl::Easy::ResponseHeaders
+ *
+ * The headers of the final response of the previous +perform+ (after any
+ * redirects), indexed natively when first asked for. Names match
+ * case-insensitively and repeated fields keep every value:
+ *
+ *   easy.response_headers['Content-Type']          # => "application/json"
+ *   easy.response_headers.values('set-cookie')     # => ["a=1", "b=2"]
+ *
+ * The index is frozen and works whether or not +on_header+ is set.
+ */
+static VALUE ruby_curl_easy_response_headers_get(VALUE self) {
+  ruby_curl_easy *rbce;
+  VALUE headers;
+
+  TypedData_Get_Struct(self, ruby_curl_easy, &ruby_curl_easy_data_type, rbce);
+  headers = rb_easy_get("response_headers");
+  /* built mid-transfer from a callback: more headers arrived since */
+  if (NIL_P(headers) || rbce->response_headers_lines != rbce->header_lines) {
+    headers = rb_easy_set("response_headers", curb_response_headers_build(rbce));
+    rbce->response_headers_lines = rbce->header_lines;
+  }
+  return headers;
+}
+
+static VALUE curb_response_headers_fetch(VALUE self, VALUE name) {
+  VALUE index = rb_ivar_get(self, id_response_headers_index);
+
+  if (SYMBOL_P(name)) {
+    /* :content_type names Content-Type */
+    char *ptr;
+    long i;
+    name = rb_str_dup(rb_sym2str(name));
+    ptr = RSTRING_PTR(name);
+    for (i = 0; i < RSTRING_LEN(name); i++) {
+      if (ptr[i] == '_') ptr[i] = '-';
+    }
+  }
+  StringValue(name);
+  return rb_hash_lookup2(index, curb_header_key(RSTRING_PTR(name), (size_t)RSTRING_LEN(name)), Qnil);
+}
+
+static VALUE curb_header_values_joined(VALUE values) {
+  if (RARRAY_LEN(values) == 1) return rb_ary_entry(values, 0);
+  return rb_obj_freeze(rb_ary_join(values, rb_str_new_cstr(", ")));
+}
+
+/*
+ * call-seq:
+ *   headers[name]                                    => "value" or nil
+ *
+ * The value of the field +name+, in any case; a Symbol may use "_" for
+ * "-". Repeated fields are joined with ", "; see #values for Set-Cookie.
+ */
+static VALUE curb_response_headers_aref(VALUE self, VALUE name) {
+  VALUE values = curb_response_headers_fetch(self, name);
+  return NIL_P(values) ? Qnil : curb_header_values_joined(values);
+}
+
+/*
+ * call-seq:
+ *   headers.values(name)                             => ["value", ...]
+ *
+ * Every value received for the field +name+, in order; empty if none.
+ */
+static VALUE curb_response_headers_values(VALUE self, VALUE name) {
+  VALUE values = curb_response_headers_fetch(self, name);
+  return NIL_P(values) ? curb_no_header_values : values;
+}
+
+/*
+ * call-seq:
+ *   headers.key?(name)                               => true or false
+ */
+static VALUE curb_response_headers_key_p(VALUE self, VALUE name) {
+  return NIL_P(curb_response_headers_fetch(self, name)) ? Qfalse : Qtrue;
+}
+
+static int curb_response_headers_each_i(VALUE key, VALUE values, VALUE arg) {
+  long i;
+  for (i = 0; i < RARRAY_LEN(values); i++) {
+    rb_yield_values(2, key, rb_ary_entry(values, i));
+  }
+  return ST_CONTINUE;
+}
+
+/*
+ * call-seq:
+ *   headers.each { |name, value| ... }               => headers
+ *
+ * Yield each field with its lower-cased name, once per value.
+ */
+static VALUE curb_response_headers_each(VALUE self) {
+  RETURN_ENUMERATOR(self, 0, 0);
+  rb_hash_foreach(rb_ivar_get(self, id_response_headers_index), curb_response_headers_each_i, Qnil);
+  return self;
+}
+
+/*
+ * call-seq:
+ *   headers.keys                                     => ["content-type", ...]
+ */
+static VALUE curb_response_headers_keys(VALUE self) {
+  return rb_funcall(rb_ivar_get(self, id_response_headers_index), rb_intern("keys"), 0);
+}
+
+/*
+ * call-seq:
+ *   headers.size                                     => integer
+ *
+ * The number of distinct field names.
+ */
+static VALUE curb_response_headers_size(VALUE self) {
+  return ULONG2NUM((unsigned long)RHASH_SIZE(rb_ivar_get(self, id_response_headers_index)));
+}
+
+static VALUE curb_response_headers_empty_p(VALUE self) {
+  return RHASH_SIZE(rb_ivar_get(self, id_response_headers_index)) == 0 ? Qtrue : Qfalse;
+}
+
+static int curb_response_headers_to_h_i(VALUE key, VALUE values, VALUE hash) {
+  rb_hash_aset(hash, key, curb_header_values_joined(values));
+  return ST_CONTINUE;
+}
+
+/*
+ * call-seq:
+ *   headers.to_h                                     => { "content-type" => "...", ... }
+ *
+ * A plain Hash of lower-cased names to values, repeated fields joined as
+ * by #[].
+ */
+static VALUE curb_response_headers_to_h(VALUE self) {
+  VALUE hash = rb_hash_new();
+  rb_hash_foreach(rb_ivar_get(self, id_response_headers_index), curb_response_headers_to_h_i, hash);
+  return hash;
+}
+
+static VALUE curb_response_headers_inspect(VALUE self) {
+  return rb_sprintf("#<%"PRIsVALUE" %"PRIsVALUE">", rb_class_name(CLASS_OF(self)),
+                    rb_inspect(rb_ivar_get(self, id_response_headers_index)));
+}
+
+static void init_curb_response_headers(void) {
+  size_t i;
+
+  id_response_headers_index = rb_intern("__curb_index");
+  for (i = 0; i < CURB_COMMON_HEADER_COUNT; i++) {
+    VALUE key = rb_usascii_str_new_cstr(curb_common_header_names[i]);
+#ifdef HAVE_RB_STR_TO_INTERNED_STR
+    key = rb_str_to_interned_str(key);
+#else
+    key = rb_obj_freeze(key);
+#endif
+    curb_common_header_lens[i] = strlen(curb_common_header_names[i]);
+    curb_common_header_keys[i] = key;
+    rb_gc_register_mark_object(key);
+  }
+  curb_no_header_values = rb_obj_freeze(rb_ary_new());
+  rb_gc_register_mark_object(curb_no_header_values);
+
+  cCurlResponseHeaders = rb_define_class_under(cCurlEasy, "ResponseHeaders", rb_cObject);
+  rb_undef_method(CLASS_OF(cCurlResponseHeaders), "new");
+  rb_include_module(cCurlResponseHeaders, rb_mEnumerable);
+  rb_define_method(cCurlResponseHeaders, "[]", curb_response_headers_aref, 1);
+  rb_define_method(cCurlResponseHeaders, "values", curb_response_headers_values, 1);
+  rb_define_method(cCurlResponseHeaders, "key?", curb_response_headers_key_p, 1);
+  rb_define_method(cCurlResponseHeaders, "include?", curb_response_headers_key_p, 1);
+  rb_define_method(cCurlResponseHeaders, "each", curb_response_headers_each, 0);
+  rb_define_method(cCurlResponseHeaders, "keys", curb_response_headers_keys, 0);
+  rb_define_method(cCurlResponseHeaders, "size", curb_response_headers_size, 0);
+  rb_define_method(cCurlResponseHeaders, "length", curb_response_headers_size, 0);
+  rb_define_method(cCurlResponseHeaders, "empty?", curb_response_headers_empty_p, 0);
+  rb_define_method(cCurlResponseHeaders, "to_h", curb_response_headers_to_h, 0);
+  rb_define_method(cCurlResponseHeaders, "inspect", curb_response_headers_inspect, 0);
 }
 
 
@@ -5647,14 +7553,17 @@ static VALUE ruby_curl_easy_set_opt(VALUE self, VALUE opt, VALUE val) {
     VALUE interface_hm = val;
     CURB_OBJECT_HSETTER(ruby_curl_easy, interface_hm);
     } break;
+#ifdef HAVE_CURLOPT_PIPEWAIT
+  case CURLOPT_PIPEWAIT: {
+    rbce->pipewait = RTEST(val) && val != INT2FIX(0) ? 1 : 0;
+    curl_easy_setopt(rbce->curl, CURLOPT_PIPEWAIT, (long)rbce->pipewait);
+    } break;
+#endif
   case CURLOPT_HEADER:
   case CURLOPT_NOPROGRESS:
   case CURLOPT_NOSIGNAL:
 #ifdef HAVE_CURLOPT_PATH_AS_IS
   case CURLOPT_PATH_AS_IS:
-#endif
-#ifdef HAVE_CURLOPT_PIPEWAIT
-  case CURLOPT_PIPEWAIT:
 #endif
   case CURLOPT_HTTPGET:
   case CURLOPT_NOBODY: {
@@ -6150,6 +8059,7 @@ void init_curb_easy() {
   rb_global_variable(&rbstrAmp);
 
   cCurlEasy = rb_define_class_under(mCurl, "Easy", rb_cObject);
+  init_curb_response_headers();
 
   /* Class methods */
   rb_define_alloc_func(cCurlEasy, ruby_curl_easy_allocate);
@@ -6163,6 +8073,23 @@ void init_curb_easy() {
   rb_define_method(cCurlEasy, "proxy_url", ruby_curl_easy_proxy_url_get, 0);
   rb_define_method(cCurlEasy, "http_version=", ruby_curl_easy_http_version_set, 1);
   rb_define_method(cCurlEasy, "http_version", ruby_curl_easy_http_version_get, 0);
+  rb_define_method(cCurlEasy, "priority=", ruby_curl_easy_priority_set, 1);
+  rb_define_method(cCurlEasy, "priority", ruby_curl_easy_priority_get, 0);
+  rb_define_method(cCurlEasy, "stream_weight=", ruby_curl_easy_stream_weight_set, 1);
+  rb_define_method(cCurlEasy, "stream_weight", ruby_curl_easy_stream_weight_get, 0);
+  rb_define_method(cCurlEasy, "stream_depends=", ruby_curl_easy_stream_depends_set, 1);
+  rb_define_method(cCurlEasy, "stream_depends", ruby_curl_easy_stream_depends_get, 0);
+  rb_define_method(cCurlEasy, "stream_exclusive=", ruby_curl_easy_stream_exclusive_set, 1);
+  rb_define_method(cCurlEasy, "stream_exclusive?", ruby_curl_easy_stream_exclusive_q, 0);
+  rb_define_method(cCurlEasy, "pipewait=", ruby_curl_easy_pipewait_set, 1);
+  rb_define_method(cCurlEasy, "pipewait", ruby_curl_easy_pipewait_get, 0);
+  rb_define_method(cCurlEasy, "share=", ruby_curl_easy_share_set, 1);
+  rb_define_method(cCurlEasy, "share", ruby_curl_easy_share_get, 0);
+  rb_define_method(cCurlEasy, "hedge_after=", ruby_curl_easy_hedge_after_set, 1);
+  rb_define_method(cCurlEasy, "hedge_after", ruby_curl_easy_hedge_after_get, 0);
+  rb_define_private_method(cCurlEasy, "_retry_policy=", ruby_curl_easy_retry_policy_set, 1);
+  rb_define_method(cCurlEasy, "retry_policy", ruby_curl_easy_retry_policy_get, 0);
+  rb_define_method(cCurlEasy, "retry_count", ruby_curl_easy_retry_count_get, 0);
 
   rb_define_method(cCurlEasy, "proxy_headers=", ruby_curl_easy_proxy_headers_set, 1);
   rb_define_method(cCurlEasy, "proxy_headers", ruby_curl_easy_proxy_headers_get, 0);
@@ -6281,6 +8208,10 @@ void init_curb_easy() {
   rb_define_method(cCurlEasy, "enable_cookies?", ruby_curl_easy_enable_cookies_q, 0);
   rb_define_method(cCurlEasy, "ignore_content_length=", ruby_curl_easy_ignore_content_length_set, 1);
   rb_define_method(cCurlEasy, "ignore_content_length?", ruby_curl_easy_ignore_content_length_q, 0);
+  rb_define_method(cCurlEasy, "reuse_buffers=", ruby_curl_easy_reuse_buffers_set, 1);
+  rb_define_method(cCurlEasy, "reuse_buffers?", ruby_curl_easy_reuse_buffers_q, 0);
+  rb_define_method(cCurlEasy, "body_min_chunk=", ruby_curl_easy_body_min_chunk_set, 1);
+  rb_define_method(cCurlEasy, "body_min_chunk", ruby_curl_easy_body_min_chunk_get, 0);
   rb_define_method(cCurlEasy, "resolve_mode", ruby_curl_easy_resolve_mode, 0);
   rb_define_method(cCurlEasy, "resolve_mode=", ruby_curl_easy_resolve_mode_set, 1);
   rb_define_method(cCurlEasy, "network_policy", ruby_curl_easy_network_policy_get, 0);
@@ -6303,9 +8234,20 @@ void init_curb_easy() {
 
   /* Post-perform info methods */
   rb_define_method(cCurlEasy, "body_str", ruby_curl_easy_body_str_get, 0);
+  rb_define_method(cCurlEasy, "body_io=", ruby_curl_easy_body_io_set, 1);
+  rb_define_method(cCurlEasy, "body_io", ruby_curl_easy_body_io_get, 0);
+  rb_define_method(cCurlEasy, "body_fd=", ruby_curl_easy_body_fd_set, 1);
+  rb_define_method(cCurlEasy, "body_fd", ruby_curl_easy_body_fd_get, 0);
+  rb_define_method(cCurlEasy, "body_spill_threshold=", ruby_curl_easy_body_spill_threshold_set, 1);
+  rb_define_method(cCurlEasy, "body_spill_threshold", ruby_curl_easy_body_spill_threshold_get, 0);
+  rb_define_method(cCurlEasy, "body_spill_dir=", ruby_curl_easy_body_spill_dir_set, 1);
+  rb_define_method(cCurlEasy, "body_spill_dir", ruby_curl_easy_body_spill_dir_get, 0);
+  rb_define_method(cCurlEasy, "body_spilled?", ruby_curl_easy_body_spilled_q, 0);
+  rb_define_method(cCurlEasy, "body_spill_io", ruby_curl_easy_body_spill_io, 0);
   rb_define_method(cCurlEasy, "max_body_bytes=", ruby_curl_easy_max_body_bytes_set, 1);
   rb_define_method(cCurlEasy, "max_body_bytes", ruby_curl_easy_max_body_bytes_get, 0);
   rb_define_method(cCurlEasy, "header_str", ruby_curl_easy_header_str_get, 0);
+  rb_define_method(cCurlEasy, "response_headers", ruby_curl_easy_response_headers_get, 0);
 
   rb_define_method(cCurlEasy, "last_effective_url", ruby_curl_easy_last_effective_url_get, 0);
   rb_define_method(cCurlEasy, "response_code", ruby_curl_easy_response_code_get, 0);
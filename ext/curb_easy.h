@@ -10,6 +10,7 @@
 #include "curb.h"
 
 #include <curl/easy.h>
+#include <stdint.h>
 
 #define CURB_NETWORK_POLICY_NONE 0
 #define CURB_NETWORK_POLICY_PUBLIC 1
@@ -41,6 +42,41 @@ typedef struct {
 #endif
 #endif
 
+/* Thread-local storage for the GVL-free transfer state: Ruby's own
+ * specifier where it is public (3.3+), else the one extconf found. */
+#if defined(RB_THREAD_LOCAL_SPECIFIER)
+#define CURB_THREAD_LOCAL_SPECIFIER RB_THREAD_LOCAL_SPECIFIER
+#elif defined(CURB_THREAD_LOCAL)
+#define CURB_THREAD_LOCAL_SPECIFIER CURB_THREAD_LOCAL
+#endif
+
+#if defined(HAVE_RB_THREAD_CALL_WITH_GVL) && defined(HAVE_RB_THREAD_CALL_WITHOUT_GVL) && defined(CURB_THREAD_LOCAL_SPECIFIER)
+#define CURB_HAVE_TRANSFER_WITHOUT_GVL 1
+#endif
+
+/* Bytes held natively for Ruby: what the default body/header handlers
+ * receive while a multi drives transfers without the GVL, and body data an
+ * on_body(min_chunk:) block has not been handed yet. */
+typedef struct {
+  char *ptr;
+  size_t len;
+  size_t capa;
+} curb_native_buffer;
+
+#define CURB_RETRY_CODE_BITS 128
+#define CURB_RETRY_STATUS_BITS 640
+
+/* Set with Easy#retry_policy=; a multi consults it when a transfer ends. */
+typedef struct {
+  long attempts;       /* retries after the first attempt */
+  long base_delay_ms;  /* backoff before the first retry, doubled for each next one */
+  long max_delay_ms;   /* backoff cap, and the longest Retry-After honoured */
+  double jitter;       /* 0..1: fraction of each backoff taken off at random */
+  char retry_after;    /* wait at least as long as a Retry-After header asks */
+  uint64_t codes[CURB_RETRY_CODE_BITS / 64];      /* retryable CURLcodes */
+  uint64_t statuses[CURB_RETRY_STATUS_BITS / 64]; /* retryable HTTP statuses */
+} curb_retry_policy;
+
 /* a lot of this *could* be kept in the handler itself,
  * but then we lose the ability to query it's status.
  */
@@ -79,6 +115,9 @@ typedef struct {
   long use_ssl;
   long ftp_filemethod;
   long http_version;
+  long priority; /* 1..256 for queue admission and HTTP/2 stream weight, 0 = unset */
+  long stream_weight; /* 1..256, overrides priority as the HTTP/2 stream weight, 0 = unset */
+  long hedge_after_ms; /* start a duplicate transfer after this long in a multi, 0 = never */
   unsigned short resolve_mode;
   unsigned short network_policy;
 
@@ -101,6 +140,23 @@ typedef struct {
   char allow_proxy;
   char allow_unix_socket;
   char forbid_reuse_set;
+  char staged_pending; /* queued for a flush of staged_body/staged_header */
+  char reactor_active; /* owned by a Curl::Reactor thread until its future is resolved */
+  char native_body_limit_exceeded; /* max_body_bytes tripped where no exception could be built */
+  char pipewait; /* CURLOPT_PIPEWAIT: 0 or 1, -1 = use the multi's default */
+  char stream_exclusive; /* depend on opts "stream_depends" exclusively */
+  char reuse_buffers; /* clear body_data/header_data in place on setup instead of dropping them */
+  char collect_body; /* the default handler fills body_data: a missing buffer reads as "" */
+  char collect_header; /* likewise for header_data */
+  int body_fd; /* -1 unless the body is written straight to a descriptor (body_fd=, body_io=) */
+  int body_fd_errno; /* errno of a failed write to body_fd or the spill file */
+  curl_off_t body_fd_start; /* body_fd offset when the request began, -1 if not seekable */
+  int spill_fd; /* unlinked temp file holding a body that outgrew body_spill_threshold, else -1 */
+  curl_off_t body_spill_threshold; /* default handler moves the body to disk past this, 0 = never */
+  curl_off_t body_collected; /* bytes the default body handler took this transfer */
+  char *body_spill_dir; /* where spill files go, NULL = $TMPDIR or /tmp */
+  unsigned long header_lines; /* header callbacks seen this transfer */
+  unsigned long response_headers_lines; /* header_lines when opts[:response_headers] was built */
   unsigned int native_active;
   long forbid_reuse;
 
@@ -113,7 +169,20 @@ typedef struct {
   char **network_allowed_hosts;
 
   unsigned long multi_attachment_generation;
+  void *hedge_peer; /* the other ruby_curl_easy of a hedged pair while both are attached */
+  char hedge_clone; /* set on the duplicate a multi started for a hedged request */
+  char hedge_waiting; /* the original failed first and waits for its clone's result */
+  void *reactor_job; /* the Curl::Reactor job transferring this easy, until its future collects it */
+  void *attached_share; /* ruby_curl_share the handle holds CURLOPT_SHARE on, NULL between transfers */
+  curb_retry_policy *retry_policy; /* NULL unless retries are enabled */
+  long retry_count; /* retries made for the current request */
+  char retry_pending; /* a multi will attach this easy again for another attempt */
   curl_off_t downloaded_body_bytes;
+  curl_off_t max_body_bytes; /* native mirror of opts[:max_body_bytes], 0 = unlimited */
+  curb_native_buffer staged_body;
+  curb_native_buffer staged_header;
+  curb_native_buffer body_chunk; /* on_body(min_chunk:) bytes not yet passed to the block */
+  size_t body_min_chunk; /* 0 = call on_body for every libcurl write */
   size_t network_allowed_cidr_rule_count;
   size_t network_allowed_host_count;
   int last_result; /* last result code from multi loop */
@@ -126,6 +195,16 @@ extern const rb_data_type_t ruby_curl_easy_data_type;
 VALUE ruby_curl_easy_setup(ruby_curl_easy *rbce);
 VALUE ruby_curl_easy_cleanup(VALUE self, ruby_curl_easy *rbce);
 VALUE rb_curl_easy_take_callback_error(ruby_curl_easy *rbce);
+void ruby_curl_easy_free_wrapper(ruby_curl_easy *rbce);
+#ifdef CURB_HAVE_TRANSFER_WITHOUT_GVL
+void *rb_curl_easy_transfer_without_gvl(void *(*func)(void *), void *data, rb_unblock_function_t *ubf, void *ubf_data);
+int rb_curl_easy_transfer_interrupted_p(void);
+void rb_curl_easy_enter_foreign_transfer(void);
+void rb_curl_easy_leave_foreign_transfer(void);
+#endif
+void rb_curl_easy_collect_native(ruby_curl_easy *rbce);
+int rb_curl_easy_flush_body_chunk(ruby_curl_easy *rbce);
+int rb_curl_easy_ruby_transfer_callbacks_p(ruby_curl_easy *rbce);
 
 void init_curb_easy();
 
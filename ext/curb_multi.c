@@ -25,15 +25,41 @@
 #include "curb_errors.h"
 #include "curb_postfield.h"
 #include "curb_multi.h"
+#include "curb_uring.h"
 
 #include <errno.h>
 #include <fcntl.h>
+#include <math.h>
 #ifndef _WIN32
 #include <sys/time.h>
 #include <time.h>
 #endif
 #include <stdint.h>
 #include <stdarg.h>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+#if defined(HAVE_SYS_EVENTFD_H) && defined(HAVE_EVENTFD)
+#define CURB_HAVE_EVENTFD 1
+#include <sys/eventfd.h>
+#endif
+
+#if defined(HAVE_SYS_EPOLL_H) && defined(HAVE_EPOLL_CREATE1) && defined(HAVE_RB_THREAD_CALL_WITHOUT_GVL)
+#define CURB_HAVE_EPOLL 1
+#include <sys/epoll.h>
+#include <unistd.h>
+#endif
+
+/* Readiness backend used by perform when no fiber scheduler is active. */
+#define CURB_MULTI_EVENT_BACKEND_AUTO   0
+#define CURB_MULTI_EVENT_BACKEND_SELECT 1
+#define CURB_MULTI_EVENT_BACKEND_EPOLL  2
+#define CURB_MULTI_EVENT_BACKEND_IO_URING 3
+
+/* io_uring falls back to epoll when the kernel refuses to create a ring. */
+#if defined(CURB_HAVE_IO_URING) && !defined(CURB_HAVE_EPOLL)
+#undef CURB_HAVE_IO_URING
+#endif
 
 /*
  * Optional socket-action debug logging. Enabled by defining CURB_SOCKET_DEBUG=1
@@ -65,12 +91,14 @@
 #if defined(HAVE_CURL_MULTI_WAIT) && !defined(HAVE_RB_THREAD_FD_SELECT)
 struct wait_args {
   CURLM *handle;
+  struct curl_waitfd *extra_fds;
+  unsigned int extra_nfds;
   long timeout_ms;
   int numfds;
 };
 static void *curl_multi_wait_wrapper(void *p) {
   struct wait_args *args = p;
-  CURLMcode code = curl_multi_wait(args->handle, NULL, 0, args->timeout_ms, &args->numfds);
+  CURLMcode code = curl_multi_wait(args->handle, args->extra_fds, args->extra_nfds, args->timeout_ms, &args->numfds);
   return (void *)(intptr_t)code;
 }
 #endif
@@ -86,6 +114,7 @@ static ID id_ractor_aref;
 static ID id_ractor_aset;
 static ID id_ractor_default_timeout_key;
 static ID id_ractor_autoclose_key;
+static ID id_ractor_release_gvl_key;
 
 /*
  * Ruby 3.0 introduced the Fiber scheduler at the Ruby level, but did not ship
@@ -178,6 +207,7 @@ VALUE cCurlMulti;
 
 static long cCurlMutiDefaulttimeout = 100; /* milliseconds */
 static char cCurlMutiAutoClose = 0;
+static char cCurlMutiReleaseGVL = 0;
 
 /* Ruby 3.0+ provides storage owned by the current Ractor. Keep configurable
  * defaults there so separate Ractors never race on process-global C values.
@@ -205,10 +235,79 @@ static int curb_multi_autoclose_enabled(void) {
   return (UNDEF_P(value) || NIL_P(value)) ? cCurlMutiAutoClose == 1 : RTEST(value);
 }
 
+static int curb_multi_release_gvl_default(void) {
+#ifdef CURB_HAVE_TRANSFER_WITHOUT_GVL
+  VALUE value = curb_multi_ractor_setting(id_ractor_release_gvl_key);
+  return (UNDEF_P(value) || NIL_P(value)) ? cCurlMutiReleaseGVL == 1 : RTEST(value);
+#else
+  /* Nothing to release on this build: multis keep the GVL. */
+  return 0;
+#endif
+}
+
 static void rb_curl_mutli_handle_complete(VALUE self, CURL *easy_handle, int result);
 static void rb_curl_multi_remove(ruby_curl_multi *rbcm, VALUE easy);
 static void rb_curl_multi_read_info(VALUE self, CURLM *mptr);
+static void rb_curl_multi_log_callback_add(ruby_curl_multi *rbcm, ruby_curl_easy *rbce);
+/* Admission queue records; see rb_curl_multi_admit_queued. */
+#define CURB_PRIORITY_LEVELS 256
+#define CURB_DEFAULT_PRIORITY 16
+
+typedef struct curb_host {
+  char *key;
+  long in_flight;                  /* admitted from the queue and still attached */
+  long max_in_flight;              /* Multi#limit_host override, -1 for the multi default */
+  struct curb_host_queue *queues;  /* this host's FIFOs, one per priority in use */
+} curb_host;
+
+typedef struct curb_host_queue {
+  curb_host *host;
+  int priority;                    /* 1..CURB_PRIORITY_LEVELS */
+  st_table *pending;               /* easy struct -> easy VALUE, in enqueue order */
+  char ready;
+  struct curb_host_queue *prev;    /* ready ring for this priority */
+  struct curb_host_queue *next;
+  struct curb_host_queue *host_next;
+} curb_host_queue;
+
+typedef struct curb_ready_rings {
+  uint64_t levels[CURB_PRIORITY_LEVELS / 64]; /* bit p-1 set while ring p is non-empty */
+  curb_host_queue *head[CURB_PRIORITY_LEVELS];
+  curb_host_queue *tail[CURB_PRIORITY_LEVELS];
+} curb_ready_rings;
+
+enum { CURB_TIMER_HEDGE, CURB_TIMER_RETRY };
+
+typedef struct curb_multi_timer {
+  long long deadline_ms;
+  ruby_curl_easy *rbce;              /* only trusted while tracked with the same generation */
+  unsigned long generation;
+  char kind;                         /* CURB_TIMER_HEDGE or CURB_TIMER_RETRY */
+  char requeue;                      /* retry: go back through the admission queue */
+} curb_multi_timer;
+
+static void rb_curl_multi_admit_queued(VALUE self, ruby_curl_multi *rbcm);
+static void rb_curl_multi_release_host_slot(ruby_curl_multi *rbcm, ruby_curl_easy *rbce);
+static void rb_curl_multi_reset_queue(ruby_curl_multi *rbcm, int detached);
+static void rb_curl_multi_free_queue(ruby_curl_multi *rbcm);
 static void rb_curl_multi_run(VALUE self, CURLM *multi_handle, int *still_running);
+static void rb_curl_multi_schedule_timer(ruby_curl_multi *rbcm, ruby_curl_easy *rbce, int kind, long delay_ms, int requeue);
+static void rb_curl_multi_fire_timers(VALUE self, ruby_curl_multi *rbcm);
+static void rb_curl_multi_install_step_hooks(ruby_curl_multi *rbcm);
+static long rb_curl_multi_timer_wait_ms(ruby_curl_multi *rbcm, long wait_ms);
+static void rb_curl_multi_unhedge(ruby_curl_multi *rbcm, ruby_curl_easy *rbce);
+static int rb_curl_multi_busy_p(ruby_curl_multi *rbcm);
+static void rb_curl_multi_wakeup_close(ruby_curl_multi *rbcm);
+static void rb_curl_multi_wakeup(ruby_curl_multi *rbcm);
+#ifdef CURB_HAVE_TRANSFER_WITHOUT_GVL
+static int rb_curl_multi_limit_reached_p(ruby_curl_multi *rbcm);
+#endif
+static int rb_curl_multi_stop_if_limited(VALUE self, ruby_curl_multi *rbcm);
+static long rb_curl_multi_retry_delay_ms(VALUE self, ruby_curl_multi *rbcm, ruby_curl_easy *rbce, int result);
+static void rb_curl_multi_schedule_retry(ruby_curl_multi *rbcm, VALUE easy, ruby_curl_easy *rbce, long delay_ms);
+static int rb_curl_multi_cancel_retry(ruby_curl_multi *rbcm, ruby_curl_easy *rbce);
+static void rb_curl_multi_release_retrying(ruby_curl_multi *rbcm);
+static VALUE ruby_curl_multi_enqueue(VALUE self, VALUE easy, VALUE name);
 
 static int detach_easy_entry(st_data_t key, st_data_t val, st_data_t arg);
 static void rb_curl_multi_detach_all(ruby_curl_multi *rbcm);
@@ -224,6 +323,15 @@ static VALUE ruby_curl_multi_perform_impl(int argc, VALUE *argv, VALUE self);
 static VALUE ruby_curl_multi_socket_perform_impl(int argc, VALUE *argv, VALUE self);
 #endif
 
+/* libcurl multi handles are not thread-safe: while perform runs libcurl
+ * without the GVL, other threads (and callbacks nested in that run) must
+ * leave the handle alone. */
+static void rb_curl_multi_check_transfer_without_gvl(ruby_curl_multi *rbcm) {
+  if (rbcm->transfer_without_gvl) {
+    rb_raise(rb_eRuntimeError, "Cannot modify a Curl::Multi handle while it transfers without the GVL");
+  }
+}
+
 static ruby_curl_multi *ruby_curl_multi_pointer_if_compatible(VALUE multi_val) {
   if (NIL_P(multi_val) || !RB_TYPE_P(multi_val, T_DATA)) {
     return NULL;
@@ -369,7 +477,14 @@ struct multi_handle_complete_args {
 
 static VALUE rb_curl_mutli_handle_complete_protected(VALUE argp) {
   struct multi_handle_complete_args *args = (struct multi_handle_complete_args *)argp;
+  ruby_curl_multi *rbcm;
+
   rb_curl_mutli_handle_complete(args->self, args->easy_handle, args->result);
+
+  /* A slot just opened up: start the next queued transfer right away rather
+   * than waiting for the caller's perform block to refill it. */
+  TypedData_Get_Struct(args->self, ruby_curl_multi, &ruby_curl_multi_data_type, rbcm);
+  rb_curl_multi_admit_queued(args->self, rbcm);
   return Qnil;
 }
 
@@ -391,6 +506,8 @@ static int detach_easy_entry(st_data_t key, st_data_t val, st_data_t arg) {
   }
 
   rbce->multi = Qnil;
+  rbce->hedge_peer = NULL;
+  rbce->hedge_waiting = 0;
 
   return ST_CONTINUE;
 }
@@ -398,7 +515,20 @@ static int detach_easy_entry(st_data_t key, st_data_t val, st_data_t arg) {
 void rb_curl_multi_forget_easy(ruby_curl_multi *rbcm, void *rbce_ptr) {
   ruby_curl_easy *rbce = (ruby_curl_easy *)rbce_ptr;
 
-  if (!rbcm || !rbce || !rbcm->attached) {
+  if (!rbcm || !rbce) {
+    return;
+  }
+
+  /* May run during GC: only drop the pairing, whichever side goes first. */
+  if (rbce->hedge_peer) {
+    ((ruby_curl_easy *)rbce->hedge_peer)->hedge_peer = NULL;
+    ((ruby_curl_easy *)rbce->hedge_peer)->hedge_waiting = 0;
+    rbce->hedge_peer = NULL;
+  }
+  rbce->hedge_waiting = 0;
+
+  rb_curl_multi_release_host_slot(rbcm, rbce);
+  if (!rbcm->attached) {
     return;
   }
 
@@ -414,10 +544,16 @@ CURLMcode rb_curl_multi_detach_easy(ruby_curl_multi *rbcm, void *rbce_ptr) {
     return CURLM_OK;
   }
 
+  rb_curl_multi_unhedge(rbcm, rbce);
+  if (rb_curl_multi_cancel_retry(rbcm, rbce)) {
+    return CURLM_OK;
+  }
+
   key = (st_data_t)rbce;
   if (!st_delete(rbcm->attached, &key, NULL)) {
     return CURLM_OK;
   }
+  rb_curl_multi_release_host_slot(rbcm, rbce);
 
   if (rbcm->handle && rbce->curl) {
     CURLMcode result = curl_multi_remove_handle(rbcm->handle, rbce->curl);
@@ -444,6 +580,8 @@ static void rb_curl_multi_detach_all(ruby_curl_multi *rbcm) {
   st_foreach(attached, detach_easy_entry, (st_data_t)rbcm);
 
   st_free_table(attached);
+  rb_curl_multi_release_retrying(rbcm);
+  rbcm->timers_len = 0;
 
   rbcm->active = 0;
   rbcm->running = 0;
@@ -459,6 +597,12 @@ static int rb_curl_multi_has_easy(ruby_curl_multi *rbcm, ruby_curl_easy *rbce) {
   return st_lookup(rbcm->attached, (st_data_t)rbce, &value);
 }
 
+/* True while +rbce+ is attached to the Curl::Multi it references. */
+int rb_curl_multi_easy_attached_p(void *rbce_ptr) {
+  ruby_curl_easy *rbce = (ruby_curl_easy *)rbce_ptr;
+  return rb_curl_multi_has_easy(ruby_curl_multi_pointer_if_compatible(rbce->multi), rbce);
+}
+
 static void rb_curl_multi_remove_request_reference(VALUE self, VALUE easy) {
   VALUE requests;
   VALUE object_id;
@@ -493,6 +637,10 @@ static void curl_multi_free(void *ptr) {
     return;
   }
 
+  /* Step hooks must not run from the sweeper. */
+  rbcm->on_socket = Qnil;
+  rbcm->on_timer = Qnil;
+  rb_curl_multi_install_step_hooks(rbcm);
   rb_curl_multi_detach_all(rbcm);
 
   if (rbcm->handle) {
@@ -500,12 +648,39 @@ static void curl_multi_free(void *ptr) {
     rbcm->handle = NULL;
   }
 
+  if (rbcm->callback_adds) {
+    xfree(rbcm->callback_adds);
+    rbcm->callback_adds = NULL;
+  }
+
+  rb_curl_multi_free_queue(rbcm);
+
+  if (rbcm->timers) {
+    xfree(rbcm->timers);
+    rbcm->timers = NULL;
+  }
+
+  rb_curl_multi_wakeup_close(rbcm);
   free(rbcm);
 }
 
 static size_t curl_multi_memsize(const void *ptr) {
-  (void)ptr;
-  return sizeof(ruby_curl_multi);
+  const ruby_curl_multi *rbcm = (const ruby_curl_multi *)ptr;
+  size_t size = sizeof(ruby_curl_multi);
+
+  if (rbcm) {
+    size += rbcm->callback_adds_capa * sizeof(void *);
+    if (rbcm->queued) size += st_memsize(rbcm->queued);
+    if (rbcm->queued_in_flight) size += st_memsize(rbcm->queued_in_flight);
+    if (rbcm->host_queues) {
+      size += st_memsize(rbcm->host_queues);
+      size += rbcm->host_queues->num_entries * sizeof(curb_host);
+    }
+    if (rbcm->ready) size += sizeof(curb_ready_rings);
+    size += rbcm->timers_capa * sizeof(curb_multi_timer);
+    if (rbcm->retrying) size += st_memsize(rbcm->retrying);
+  }
+  return size;
 }
 
 const rb_data_type_t ruby_curl_multi_data_type = {
@@ -548,6 +723,7 @@ static void ruby_curl_multi_init(ruby_curl_multi *rbcm) {
     rbcm->handle = NULL;
     rb_raise(rb_eNoMemError, "Failed to allocate multi attachment table");
   }
+  rb_curl_multi_install_step_hooks(rbcm);
 }
 
 static void ruby_curl_multi_ensure_handle(ruby_curl_multi *rbcm) {
@@ -571,6 +747,7 @@ static VALUE ruby_curl_multi_alloc(VALUE klass) {
 
   self = TypedData_Make_Struct(klass, ruby_curl_multi, &ruby_curl_multi_data_type, rbcm);
   MEMZERO(rbcm, ruby_curl_multi, 1);
+  rbcm->wake_fds[0] = rbcm->wake_fds[1] = -1;
 
   return self;
 }
@@ -581,6 +758,13 @@ static VALUE ruby_curl_multi_initialize(VALUE self) {
   TypedData_Get_Struct(self, ruby_curl_multi, &ruby_curl_multi_data_type, rbcm);
 
   ruby_curl_multi_init(rbcm);
+  rbcm->release_gvl = curb_multi_release_gvl_default();
+  rbcm->completed_sink = Qnil;
+  rbcm->on_socket = Qnil;
+  rbcm->on_timer = Qnil;
+  rbcm->step_error = Qnil;
+  rbcm->step_curl_deadline_ms = -1;
+  rbcm->step_timer_deadline_ms = -1;
 
   /*
    * The mark routine will be called by the garbage collector during its ``mark'' phase.
@@ -651,6 +835,36 @@ VALUE ruby_curl_multi_get_autoclose(VALUE klass) {
   return curb_multi_autoclose_enabled() ? Qtrue : Qfalse;
 }
 
+/*
+ * call-seq:
+ *   Curl::Multi.release_gvl = true => true
+ *
+ * Set whether Curl::Multi handles created in the current Ractor drive their
+ * transfers without the GVL. See Curl::Multi#release_gvl=. Builds that
+ * cannot release the GVL ignore it.
+ *
+ */
+VALUE ruby_curl_multi_set_release_gvl_default(VALUE klass, VALUE onoff) {
+  VALUE value = RTEST(onoff) ? Qtrue : Qfalse;
+  if (NIL_P(cRubyRactor)) {
+    cCurlMutiReleaseGVL = RTEST(value) ? 1 : 0;
+  } else {
+    curb_multi_set_ractor_setting(id_ractor_release_gvl_key, value);
+  }
+  return onoff;
+}
+
+/*
+ * call-seq:
+ *   Curl::Multi.release_gvl => true|false
+ *
+ * Get the current Ractor's default for Curl::Multi#release_gvl.
+ *
+ */
+VALUE ruby_curl_multi_get_release_gvl_default(VALUE klass) {
+  return curb_multi_release_gvl_default() ? Qtrue : Qfalse;
+}
+
 /*
  * call-seq:
  *   multi.requests                                   => [#<Curl::Easy...>, ...]
@@ -697,6 +911,59 @@ static VALUE ruby_curl_multi_max_host_connections(VALUE self, VALUE count) {
   return count;
 }
 
+/*
+ * call-seq:
+ * multi = Curl::Multi.new
+ * multi.max_concurrent_streams = 1000
+ *
+ * Set the max number of streams libcurl opens on one HTTP/2 connection
+ * (100 by default); the server's own limit still applies. (Added in 7.67.0)
+ */
+static VALUE ruby_curl_multi_max_concurrent_streams(VALUE self, VALUE count) {
+#ifdef HAVE_CURLMOPT_MAX_CONCURRENT_STREAMS
+  ruby_curl_multi *rbcm;
+
+  TypedData_Get_Struct(self, ruby_curl_multi, &ruby_curl_multi_data_type, rbcm);
+  ruby_curl_multi_ensure_handle(rbcm);
+
+  curl_multi_setopt(rbcm->handle, CURLMOPT_MAX_CONCURRENT_STREAMS, NUM2LONG(count));
+#else
+  rb_raise(rb_eNotImpError, "max_concurrent_streams requires libcurl 7.67.0 or later");
+#endif
+
+  return count;
+}
+
+/*
+ * call-seq:
+ * multi = Curl::Multi.new
+ * multi.pipewait = true
+ *
+ * Turn CURLOPT_PIPEWAIT on for every easy added to this multi that does not
+ * set Curl::Easy#pipewait= itself. A burst of requests to one HTTP/2 origin
+ * then waits for the first connection and multiplexes over it, instead of
+ * opening a connection per request while the first is still handshaking.
+ */
+static VALUE ruby_curl_multi_pipewait_set(VALUE self, VALUE pipewait) {
+  ruby_curl_multi *rbcm;
+
+  TypedData_Get_Struct(self, ruby_curl_multi, &ruby_curl_multi_data_type, rbcm);
+  rbcm->pipewait = RTEST(pipewait) ? 1 : 0;
+
+  return pipewait;
+}
+
+/*
+ * call-seq:
+ *   multi.pipewait?                                  => boolean
+ */
+static VALUE ruby_curl_multi_pipewait_p(VALUE self) {
+  ruby_curl_multi *rbcm;
+
+  TypedData_Get_Struct(self, ruby_curl_multi, &ruby_curl_multi_data_type, rbcm);
+  return rbcm->pipewait ? Qtrue : Qfalse;
+}
+
 /*
  * call-seq:
  * multi = Curl::Multi.new
@@ -730,6 +997,117 @@ static VALUE ruby_curl_multi_pipeline(VALUE self, VALUE method) {
   return method == Qtrue ? 1 : 0;
 }
 
+/*
+ * call-seq:
+ * multi = Curl::Multi.new
+ * multi.event_backend = :epoll
+ *
+ * Select how perform waits for socket readiness when no fiber scheduler is
+ * active. :select uses the legacy curl_multi_fdset loop, :epoll drives
+ * libcurl's socket-action interface from an epoll set (Linux only), and :auto
+ * (the default) picks epoll whenever it was compiled in.
+ *
+ * :io_uring (Linux 5.4+) drives the same socket-action loop from an io_uring
+ * instance: socket interest changes are queued as poll SQEs (multishot from
+ * Linux 5.13) and submitted together with the wait, so each tick costs a
+ * single io_uring_enter. If the kernel refuses to create a ring (old kernel,
+ * seccomp, io_uring_disabled) perform falls back to epoll. Multi#stats
+ * reports the backend actually used and its syscall count.
+ */
+static VALUE ruby_curl_multi_event_backend_set(VALUE self, VALUE backend) {
+  ruby_curl_multi *rbcm;
+  ID id;
+
+  TypedData_Get_Struct(self, ruby_curl_multi, &ruby_curl_multi_data_type, rbcm);
+  if (!SYMBOL_P(backend)) {
+    rb_raise(rb_eTypeError, "event backend must be a Symbol");
+  }
+
+  id = SYM2ID(backend);
+  if (id == rb_intern("auto")) {
+    rbcm->event_backend = CURB_MULTI_EVENT_BACKEND_AUTO;
+  } else if (id == rb_intern("select")) {
+    rbcm->event_backend = CURB_MULTI_EVENT_BACKEND_SELECT;
+  } else if (id == rb_intern("epoll")) {
+#ifdef CURB_HAVE_EPOLL
+    rbcm->event_backend = CURB_MULTI_EVENT_BACKEND_EPOLL;
+#else
+    rb_raise(rb_eNotImpError, "epoll event backend is not available in this build");
+#endif
+  } else if (id == rb_intern("io_uring")) {
+#ifdef CURB_HAVE_IO_URING
+    rbcm->event_backend = CURB_MULTI_EVENT_BACKEND_IO_URING;
+#else
+    rb_raise(rb_eNotImpError, "io_uring event backend is not available in this build");
+#endif
+  } else {
+    rb_raise(rb_eArgError, "unknown event backend: %"PRIsVALUE, backend);
+  }
+
+  return backend;
+}
+
+/*
+ * call-seq:
+ *   multi.event_backend => :auto, :select, :epoll or :io_uring
+ *
+ * Returns the readiness backend configured with event_backend=.
+ */
+static VALUE ruby_curl_multi_event_backend_get(VALUE self) {
+  ruby_curl_multi *rbcm;
+
+  TypedData_Get_Struct(self, ruby_curl_multi, &ruby_curl_multi_data_type, rbcm);
+  switch (rbcm->event_backend) {
+    case CURB_MULTI_EVENT_BACKEND_SELECT: return ID2SYM(rb_intern("select"));
+    case CURB_MULTI_EVENT_BACKEND_EPOLL: return ID2SYM(rb_intern("epoll"));
+    case CURB_MULTI_EVENT_BACKEND_IO_URING: return ID2SYM(rb_intern("io_uring"));
+    default: return ID2SYM(rb_intern("auto"));
+  }
+}
+
+/*
+ * call-seq:
+ *   multi.release_gvl = true                        => true
+ *
+ * When enabled, perform runs libcurl (socket I/O, TLS, decompression and
+ * protocol parsing) with the GVL released so other Ruby threads keep running
+ * during large batches. The default body and header handlers buffer natively
+ * in the meantime; on_body, on_header, on_progress and on_debug blocks and
+ * upload streams still run, reacquiring the GVL for each call. Completion
+ * callbacks run once the GVL is held again.
+ *
+ * While perform runs in this mode the multi and its easy handles must not be
+ * touched from other threads. The initial value comes from
+ * Curl::Multi.release_gvl. Has no effect under a fiber scheduler.
+ */
+static VALUE ruby_curl_multi_release_gvl_set(VALUE self, VALUE onoff) {
+  ruby_curl_multi *rbcm;
+
+  TypedData_Get_Struct(self, ruby_curl_multi, &ruby_curl_multi_data_type, rbcm);
+#ifdef CURB_HAVE_TRANSFER_WITHOUT_GVL
+  rbcm->release_gvl = RTEST(onoff) ? 1 : 0;
+#else
+  if (RTEST(onoff)) {
+    rb_raise(rb_eNotImpError, "releasing the GVL during transfers is not supported by this Ruby");
+  }
+  rbcm->release_gvl = 0;
+#endif
+  return onoff;
+}
+
+/*
+ * call-seq:
+ *   multi.release_gvl?                              => true or false
+ *
+ * Whether perform drives transfers without the GVL.
+ */
+static VALUE ruby_curl_multi_release_gvl_p(VALUE self) {
+  ruby_curl_multi *rbcm;
+
+  TypedData_Get_Struct(self, ruby_curl_multi, &ruby_curl_multi_data_type, rbcm);
+  return rbcm->release_gvl ? Qtrue : Qfalse;
+}
+
 /*
  * call-seq:
  * multi = Curl::Multi.new
@@ -747,6 +1125,7 @@ VALUE ruby_curl_multi_add(VALUE self, VALUE easy) {
 
   TypedData_Get_Struct(self, ruby_curl_multi, &ruby_curl_multi_data_type, rbcm);
   TypedData_Get_Struct(easy, ruby_curl_easy, &ruby_curl_easy_data_type, rbce);
+  rb_curl_multi_check_transfer_without_gvl(rbcm);
   ruby_curl_multi_ensure_handle(rbcm);
 
   if (rb_curl_multi_has_easy(rbcm, rbce)) {
@@ -754,12 +1133,26 @@ VALUE ruby_curl_multi_add(VALUE self, VALUE easy) {
   }
 
   existing_rbcm = ruby_curl_multi_pointer_if_compatible(rbce->multi);
+  if (rbce->reactor_active) {
+    rb_raise(rb_eRuntimeError, "Cannot add a Curl::Easy handle that a Curl::Reactor is transferring");
+  }
+
   if (existing_rbcm && existing_rbcm != rbcm && rb_curl_multi_has_easy(existing_rbcm, rbce)) {
     rb_raise(rb_eRuntimeError, "Cannot add an active Curl::Easy handle to another Curl::Multi");
   }
 
+  /* A retry attempt continues the request; anything else starts a new one. */
+  if (!rbce->retry_pending) {
+    rbce->retry_count = 0;
+  }
+
   /* setup the easy handle */
   ruby_curl_easy_setup( rbce );
+#ifdef HAVE_CURLOPT_PIPEWAIT
+  if (rbce->pipewait < 0 && rbcm->pipewait) {
+    curl_easy_setopt(rbce->curl, CURLOPT_PIPEWAIT, 1L);
+  }
+#endif
 
   mcode = curl_multi_add_handle(rbcm->handle, rbce->curl);
   if (mcode != CURLM_CALL_MULTI_PERFORM && mcode != CURLM_OK) {
@@ -783,15 +1176,38 @@ VALUE ruby_curl_multi_add(VALUE self, VALUE easy) {
     }
   }
 
-  rbce->multi_attachment_generation++;
+  rbce->multi_attachment_generation = ++rbcm->attachment_generation;
   st_insert(rbcm->attached, (st_data_t)rbce, (st_data_t)easy);
+  if (rbce->hedge_after_ms > 0 && !rbce->hedge_clone) {
+    rb_curl_multi_schedule_timer(rbcm, rbce, CURB_TIMER_HEDGE, rbce->hedge_after_ms, 0);
+  }
+  if (rbcm->callback_active) {
+    rb_curl_multi_log_callback_add(rbcm, rbce);
+  }
 
   /* track a reference to associated multi handle */
   rbce->multi = self;
+  rb_curl_multi_wakeup(rbcm);
 
   return self;
 }
 
+/*
+ * call-seq:
+ *   multi._completed_sink = array or nil           => array or nil
+ *
+ * While set, every easy that finishes is appended to +array+ as soon as its
+ * CURLMSG_DONE is read, before its status callbacks run.
+ */
+static VALUE ruby_curl_multi_completed_sink_set(VALUE self, VALUE sink) {
+  ruby_curl_multi *rbcm;
+
+  TypedData_Get_Struct(self, ruby_curl_multi, &ruby_curl_multi_data_type, rbcm);
+  if (!NIL_P(sink)) Check_Type(sink, T_ARRAY);
+  rbcm->completed_sink = sink;
+  return sink;
+}
+
 /*
  * call-seq:
  * multi = Curl::Multi.new
@@ -821,6 +1237,12 @@ static void rb_curl_multi_remove(ruby_curl_multi *rbcm, VALUE easy) {
   ruby_curl_easy *rbce;
 
   TypedData_Get_Struct(easy, ruby_curl_easy, &ruby_curl_easy_data_type, rbce);
+  rb_curl_multi_check_transfer_without_gvl(rbcm);
+  rb_curl_multi_unhedge(rbcm, rbce);
+  if (rb_curl_multi_cancel_retry(rbcm, rbce)) {
+    rbce->multi = Qnil;
+    return;
+  }
   result = curl_multi_remove_handle(rbcm->handle, rbce->curl);
   if (result != 0) {
     raise_curl_multi_error_exception(result);
@@ -836,148 +1258,1533 @@ static void rb_curl_multi_remove(ruby_curl_multi *rbcm, VALUE easy) {
   rb_curl_multi_forget_easy(rbcm, rbce);
 }
 
-// on_success, on_failure, on_complete
-static VALUE call_status_handler1(VALUE ary) {
-  return rb_funcall(rb_ary_entry(ary, 0), idCall, 1, rb_ary_entry(ary, 1));
-}
-static VALUE call_status_handler2(VALUE ary) {
-  return rb_funcall(rb_ary_entry(ary, 0), idCall, 2, rb_ary_entry(ary, 1), rb_ary_entry(ary, 2));
+static void rb_curl_multi_add_request_reference(VALUE self, VALUE easy) {
+  VALUE requests = rb_funcall(self, rb_intern("requests"), 0);
+  if (RB_TYPE_P(requests, T_HASH)) {
+    rb_hash_aset(requests, rb_obj_id(easy), easy);
+  }
 }
 
-static void flush_stderr_if_any(ruby_curl_easy *rbce) {
-  VALUE stderr_io = rb_easy_get("stderr_io");
-  if (stderr_io != Qnil) {
-    /* Flush via Ruby IO API */
-    rb_funcall(stderr_io, rb_intern("flush"), 0);
-#ifdef HAVE_RUBY_IO_H
-    /* Additionally flush underlying FILE* to be extra safe. */
-    rb_io_t *open_f_ptr;
-    if (RB_TYPE_P(stderr_io, T_FILE)) {
-      GetOpenFile(stderr_io, open_f_ptr);
-      FILE *fp = rb_io_stdio_file(open_f_ptr);
-      if (fp) fflush(fp);
-    }
+/* ---- admission queue ----
+ *
+ * Enqueued easies wait in one FIFO per host and priority. A FIFO whose host
+ * has a free slot sits on the ready ring for its priority; admission serves
+ * the highest priority ring that has anything ready, takes one easy from the
+ * FIFO at its head and moves that FIFO to the back. Within a priority hosts
+ * therefore take turns, so a host with a deep backlog gets one slot per turn
+ * like everyone else, and no bulk backlog can hold back a more urgent
+ * request. Every step is O(1) apart from refreshing the handful of FIFOs a
+ * host has when its in-flight count changes.
+ */
+static int curb_ready_rings_highest(curb_ready_rings *rings) {
+  int word;
+
+  for (word = CURB_PRIORITY_LEVELS / 64 - 1; word >= 0; --word) {
+    uint64_t bits = rings->levels[word];
+    if (bits) {
+#if defined(__GNUC__)
+      return word * 64 + 63 - __builtin_clzll(bits);
+#else
+      int bit = 63;
+      while (!(bits & ((uint64_t)1 << bit))) --bit;
+      return word * 64 + bit;
 #endif
+    }
   }
+  return -1;
 }
 
-/* Helper to locate the Ruby Easy VALUE from the attached table using the
- * underlying CURL* handle when CURLINFO_PRIVATE is unavailable or stale. */
-struct find_easy_ctx { CURL *handle; VALUE easy; };
-static int find_easy_by_handle_i(st_data_t key, st_data_t val, st_data_t arg) {
-  ruby_curl_easy *rbce = (ruby_curl_easy *)key;
-  struct find_easy_ctx *ctx = (struct find_easy_ctx *)arg;
-  if (rbce && rbce->curl == ctx->handle) {
-    ctx->easy = (VALUE)val;
-    return ST_STOP;
-  }
-  return ST_CONTINUE;
+static long curb_host_cap(ruby_curl_multi *rbcm, curb_host *host) {
+  return host->max_in_flight >= 0 ? host->max_in_flight : rbcm->max_in_flight_per_host;
 }
 
-static VALUE find_easy_by_handle(ruby_curl_multi *rbcm, CURL *easy_handle) {
-  if (!rbcm || !rbcm->attached) return Qnil;
-  struct find_easy_ctx ctx; ctx.handle = easy_handle; ctx.easy = Qnil;
-  st_foreach(rbcm->attached, find_easy_by_handle_i, (st_data_t)&ctx);
-  return ctx.easy;
+static int curb_host_has_room_p(ruby_curl_multi *rbcm, curb_host *host) {
+  long cap = curb_host_cap(rbcm, host);
+  return cap <= 0 || host->in_flight < cap;
 }
 
-static VALUE find_easy_value_for_handle(ruby_curl_multi *rbcm, CURL *easy_handle) {
-  VALUE easy = Qnil;
-  ruby_curl_easy *rbce = NULL;
+static void curb_host_queue_unlink(ruby_curl_multi *rbcm, curb_host_queue *hq) {
+  curb_ready_rings *rings = rbcm->ready;
+  int level = hq->priority - 1;
 
-  CURLcode private_rc = curl_easy_getinfo(easy_handle, CURLINFO_PRIVATE, (char **)&rbce);
-  if (private_rc == CURLE_OK && rbce) {
-    easy = rbce->self;
+  if (!hq->ready) {
+    return;
   }
-
-  if (NIL_P(easy) || !RB_TYPE_P(easy, T_DATA)) {
-    easy = find_easy_by_handle(rbcm, easy_handle);
+  if (hq->prev) hq->prev->next = hq->next; else rings->head[level] = hq->next;
+  if (hq->next) hq->next->prev = hq->prev; else rings->tail[level] = hq->prev;
+  if (!rings->head[level]) {
+    rings->levels[level / 64] &= ~((uint64_t)1 << (level % 64));
   }
-
-  return easy;
+  hq->prev = hq->next = NULL;
+  hq->ready = 0;
 }
 
-struct multi_complete_callback_args {
-  VALUE self;
-  VALUE easy;
-  ruby_curl_multi *rbcm;
-  ruby_curl_easy *rbce;
-  int result;
-  st_table *attached_snapshot;
-};
-
-static int snapshot_attached_easy_i(st_data_t key, st_data_t val, st_data_t arg) {
-  st_table *snapshot = (st_table *)arg;
-  ruby_curl_easy *rbce = (ruby_curl_easy *)key;
+/* Put +hq+ at the back of its ready ring if it can admit, or take it off. */
+static void curb_host_queue_refresh(ruby_curl_multi *rbcm, curb_host_queue *hq) {
+  int ready = hq->pending->num_entries > 0 && curb_host_has_room_p(rbcm, hq->host);
+  int level = hq->priority - 1;
 
-  if (!rbce) {
-    return ST_CONTINUE;
+  if (ready && !hq->ready) {
+    curb_ready_rings *rings = rbcm->ready;
+    if (!rings) {
+      rings = rbcm->ready = ALLOC(curb_ready_rings);
+      MEMZERO(rings, curb_ready_rings, 1);
+    }
+    hq->prev = rings->tail[level];
+    hq->next = NULL;
+    if (rings->tail[level]) rings->tail[level]->next = hq; else rings->head[level] = hq;
+    rings->tail[level] = hq;
+    rings->levels[level / 64] |= (uint64_t)1 << (level % 64);
+    hq->ready = 1;
+  } else if (!ready && hq->ready) {
+    curb_host_queue_unlink(rbcm, hq);
   }
-
-  st_insert(snapshot, key, (st_data_t)rbce->multi_attachment_generation);
-  return ST_CONTINUE;
 }
 
-static st_table *capture_attached_easy_snapshot(ruby_curl_multi *rbcm) {
-  st_table *snapshot = st_init_numtable();
-
-  if (!snapshot) {
-    rb_raise(rb_eNoMemError, "Failed to allocate multi callback snapshot table");
+static void curb_host_refresh(ruby_curl_multi *rbcm, curb_host *host) {
+  curb_host_queue *hq;
+  for (hq = host->queues; hq; hq = hq->host_next) {
+    curb_host_queue_refresh(rbcm, hq);
   }
+}
+
+static void curb_host_queue_free(ruby_curl_multi *rbcm, curb_host_queue *hq) {
+  curb_host_queue **link;
 
-  if (rbcm && rbcm->attached) {
-    st_foreach(rbcm->attached, snapshot_attached_easy_i, (st_data_t)snapshot);
+  curb_host_queue_unlink(rbcm, hq);
+  for (link = &hq->host->queues; *link; link = &(*link)->host_next) {
+    if (*link == hq) {
+      *link = hq->host_next;
+      break;
+    }
   }
+  st_free_table(hq->pending);
+  xfree(hq);
+}
 
-  return snapshot;
+static void curb_host_free(curb_host *host) {
+  xfree(host->key);
+  xfree(host);
 }
 
-struct collect_new_attached_easies_ctx {
-  st_table *snapshot;
-  VALUE easies;
-};
+static int curb_host_idle_p(curb_host *host) {
+  return !host->queues && host->in_flight == 0 && host->max_in_flight < 0;
+}
 
-static int collect_new_attached_easies_i(st_data_t key, st_data_t val, st_data_t arg) {
-  st_data_t existing = 0;
-  ruby_curl_easy *rbce = (ruby_curl_easy *)key;
-  struct collect_new_attached_easies_ctx *ctx = (struct collect_new_attached_easies_ctx *)arg;
+/* Drop an emptied FIFO, and its host once nothing is queued or running for
+ * it and it carries no Multi#limit_host override. */
+static void curb_host_queue_release_if_empty(ruby_curl_multi *rbcm, curb_host_queue *hq) {
+  curb_host *host = hq->host;
 
-  if (!rbce) {
-    return ST_CONTINUE;
+  if (hq->pending->num_entries == 0) {
+    curb_host_queue_free(rbcm, hq);
   }
-
-  if (!ctx->snapshot || !st_lookup(ctx->snapshot, key, &existing) ||
-      existing != (st_data_t)rbce->multi_attachment_generation) {
-    rb_ary_push(ctx->easies, (VALUE)val);
+  if (curb_host_idle_p(host)) {
+    st_data_t key = (st_data_t)host->key;
+    st_delete(rbcm->host_queues, &key, NULL);
+    curb_host_free(host);
   }
-
-  return ST_CONTINUE;
 }
 
-static void rb_curl_multi_remove_added_easies_since_snapshot(VALUE self, ruby_curl_multi *rbcm, st_table *snapshot) {
-  struct collect_new_attached_easies_ctx ctx;
-  VALUE easies = rb_ary_new();
-  long index;
+static curb_host *curb_host_fetch(ruby_curl_multi *rbcm, VALUE name) {
+  const char *key = StringValueCStr(name);
+  size_t len = strlen(key);
+  st_data_t val;
+  curb_host *host;
 
-  if (!rbcm || !snapshot || !rbcm->attached) {
-    return;
+  if (!rbcm->host_queues) {
+    rbcm->host_queues = st_init_strtable();
+  }
+  if (st_lookup(rbcm->host_queues, (st_data_t)key, &val)) {
+    return (curb_host *)val;
   }
 
-  ctx.snapshot = snapshot;
-  ctx.easies = easies;
-  st_foreach(rbcm->attached, collect_new_attached_easies_i, (st_data_t)&ctx);
+  host = ALLOC(curb_host);
+  MEMZERO(host, curb_host, 1);
+  host->key = ALLOC_N(char, len + 1);
+  memcpy(host->key, key, len + 1);
+  host->max_in_flight = -1;
+  st_insert(rbcm->host_queues, (st_data_t)host->key, (st_data_t)host);
 
-  for (index = 0; index < RARRAY_LEN(easies); index++) {
-    VALUE easy = rb_ary_entry(easies, index);
-    ruby_curl_easy *rbce = NULL;
+  return host;
+}
 
-    if (NIL_P(easy) || !RB_TYPE_P(easy, T_DATA)) {
-      continue;
-    }
+static curb_host_queue *curb_host_queue_fetch(curb_host *host, int priority) {
+  curb_host_queue *hq;
 
-    TypedData_Get_Struct(easy, ruby_curl_easy, &ruby_curl_easy_data_type, rbce);
-    if (!rbce || rbce->multi != self || !rb_curl_multi_has_easy(rbcm, rbce)) {
-      continue;
+  for (hq = host->queues; hq; hq = hq->host_next) {
+    if (hq->priority == priority) {
+      return hq;
+    }
+  }
+
+  hq = ALLOC(curb_host_queue);
+  MEMZERO(hq, curb_host_queue, 1);
+  hq->host = host;
+  hq->priority = priority;
+  hq->pending = st_init_numtable();
+  hq->host_next = host->queues;
+  host->queues = hq;
+
+  return hq;
+}
+
+/* Port libcurl connects to when a URL names none, or NULL for schemes it
+ * has no fixed default for. A URL without a scheme is guessed as http. */
+static const char *rb_curl_multi_default_port(const char *scheme, long len) {
+  static const struct { const char *scheme; const char *port; } ports[] = {
+    { "http", "80" }, { "https", "443" }, { "ws", "80" }, { "wss", "443" },
+    { "ftp", "21" }, { "ftps", "990" }
+  };
+  size_t i;
+
+  if (!scheme) return "80";
+  for (i = 0; i < sizeof(ports) / sizeof(ports[0]); ++i) {
+    if ((long)strlen(ports[i].scheme) == len && !STRNCASECMP(scheme, ports[i].scheme, len)) {
+      return ports[i].port;
+    }
+  }
+  return NULL;
+}
+
+/* "scheme://user@Host:port/path" => "host:port", filling in the scheme's
+ * default port when the URL leaves it out; anything else is its own key. */
+static VALUE rb_curl_multi_host_key_for_url(VALUE url) {
+  const char *ptr, *start, *end, *stop, *at = NULL, *scheme = NULL, *port;
+  VALUE key;
+  long i, len, scheme_len = 0;
+  int has_port = 0;
+
+  if (!RB_TYPE_P(url, T_STRING)) {
+    return rb_str_new_cstr("");
+  }
+
+  ptr = RSTRING_PTR(url);
+  len = RSTRING_LEN(url);
+  stop = ptr + len;
+  start = ptr;
+  for (i = 0; i + 2 < len; ++i) {
+    if (ptr[i] == ':' && ptr[i + 1] == '/' && ptr[i + 2] == '/') {
+      scheme = ptr;
+      scheme_len = i;
+      start = ptr + i + 3;
+      break;
+    }
+  }
+  for (end = start; end < stop && *end != '/' && *end != '?' && *end != '#'; ++end) {
+    if (*end == '@') at = end;
+  }
+  if (at) {
+    start = at + 1;
+  }
+
+  /* a ':' inside an IPv6 literal "[::1]" is not a port separator */
+  for (i = end - start - 1; i >= 0 && start[i] != ']'; --i) {
+    if (start[i] == ':') {
+      has_port = 1;
+      break;
+    }
+  }
+
+  key = rb_str_new(start, end - start);
+  for (i = 0; i < RSTRING_LEN(key); ++i) {
+    char c = RSTRING_PTR(key)[i];
+    if (c >= 'A' && c <= 'Z') RSTRING_PTR(key)[i] = (char)(c - 'A' + 'a');
+  }
+  if (!has_port && RSTRING_LEN(key) > 0 && (port = rb_curl_multi_default_port(scheme, scheme_len))) {
+    rb_str_cat_cstr(key, ":");
+    rb_str_cat_cstr(key, port);
+  }
+  return key;
+}
+
+/* Give back the per-host slot held by an easy admitted from the queue. */
+static void rb_curl_multi_release_host_slot(ruby_curl_multi *rbcm, ruby_curl_easy *rbce) {
+  st_data_t key = (st_data_t)rbce;
+  st_data_t val;
+  curb_host *host;
+
+  if (!rbcm->queued_in_flight || !st_delete(rbcm->queued_in_flight, &key, &val)) {
+    return;
+  }
+
+  host = (curb_host *)val;
+  if (host->in_flight > 0) {
+    host->in_flight--;
+  }
+  curb_host_refresh(rbcm, host);
+  if (curb_host_idle_p(host)) {
+    key = (st_data_t)host->key;
+    st_delete(rbcm->host_queues, &key, NULL);
+    curb_host_free(host);
+  }
+}
+
+static int reset_host_i(st_data_t key, st_data_t val, st_data_t arg) {
+  curb_host *host = (curb_host *)val;
+
+  while (host->queues) {
+    curb_host_queue *hq = host->queues;
+    host->queues = hq->host_next;
+    st_free_table(hq->pending);
+    xfree(hq);
+  }
+  if (arg) {
+    host->in_flight = 0;
+  }
+
+  if (curb_host_idle_p(host)) {
+    curb_host_free(host);
+    return ST_DELETE;
+  }
+  return ST_CONTINUE;
+}
+
+/*
+ * Drop all queued work. When +detached+ is set every admitted easy has also
+ * been detached, so per-host in-flight counts start over as well.
+ */
+static void rb_curl_multi_reset_queue(ruby_curl_multi *rbcm, int detached) {
+  if (rbcm->ready) {
+    MEMZERO(rbcm->ready, curb_ready_rings, 1);
+  }
+  if (rbcm->queued) {
+    st_clear(rbcm->queued);
+  }
+  if (detached && rbcm->queued_in_flight) {
+    st_clear(rbcm->queued_in_flight);
+  }
+  if (rbcm->host_queues) {
+    st_foreach(rbcm->host_queues, reset_host_i, (st_data_t)detached);
+  }
+}
+
+static int free_host_i(st_data_t key, st_data_t val, st_data_t arg) {
+  /* reset_host_i frees idle hosts itself; what is left only has a limit */
+  if (reset_host_i(key, val, 1) == ST_CONTINUE) {
+    curb_host_free((curb_host *)val);
+  }
+  return ST_CONTINUE;
+}
+
+static void rb_curl_multi_free_queue(ruby_curl_multi *rbcm) {
+  if (rbcm->host_queues) {
+    st_foreach(rbcm->host_queues, free_host_i, 0);
+    st_free_table(rbcm->host_queues);
+    rbcm->host_queues = NULL;
+  }
+  if (rbcm->queued) {
+    st_free_table(rbcm->queued);
+    rbcm->queued = NULL;
+  }
+  if (rbcm->queued_in_flight) {
+    st_free_table(rbcm->queued_in_flight);
+    rbcm->queued_in_flight = NULL;
+  }
+  if (rbcm->ready) {
+    xfree(rbcm->ready);
+    rbcm->ready = NULL;
+  }
+}
+
+static int refresh_host_i(st_data_t key, st_data_t val, st_data_t arg) {
+  curb_host_refresh((ruby_curl_multi *)arg, (curb_host *)val);
+  return ST_CONTINUE;
+}
+
+static int rb_curl_multi_has_room_p(ruby_curl_multi *rbcm) {
+  return rbcm->max_in_flight <= 0 || rbcm->active < rbcm->max_in_flight;
+}
+
+struct multi_admit_args {
+  VALUE self;
+  VALUE easy;
+};
+
+static VALUE rb_curl_multi_admit_one(VALUE argp) {
+  struct multi_admit_args *args = (struct multi_admit_args *)argp;
+  ruby_curl_multi_add(args->self, args->easy);
+  rb_curl_multi_add_request_reference(args->self, args->easy);
+  return Qnil;
+}
+
+/*
+ * Move queued easies onto the multi handle while max_in_flight and the
+ * per-host limits allow. This runs straight after each completion, so a
+ * finished transfer's slot is reused before the drive loop waits again.
+ * Nothing is admitted while libcurl is running without the GVL or once a
+ * callback error is pending: like Multi#add, a failing perform drains what
+ * it has and starts no more.
+ */
+static void rb_curl_multi_admit_queued(VALUE self, ruby_curl_multi *rbcm) {
+  struct multi_admit_args args;
+  curb_host_queue *hq;
+  curb_host *host;
+  st_data_t key, val;
+  int level, state = 0;
+
+  if (!rbcm->ready || rbcm->transfer_without_gvl || rbcm->closed || !rbcm->handle) {
+    return;
+  }
+
+  while (rb_curl_multi_has_room_p(rbcm) && (level = curb_ready_rings_highest(rbcm->ready)) >= 0) {
+    if (rb_ivar_defined(self, id_deferred_exception_ivar)) {
+      return;
+    }
+
+    hq = rbcm->ready->head[level];
+    host = hq->host;
+    if (!st_shift(hq->pending, &key, &val)) {
+      curb_host_queue_release_if_empty(rbcm, hq);
+      continue;
+    }
+
+    st_delete(rbcm->queued, &key, NULL);
+    if (!rbcm->queued_in_flight) {
+      rbcm->queued_in_flight = st_init_numtable();
+    }
+    st_insert(rbcm->queued_in_flight, key, (st_data_t)host);
+    host->in_flight++;
+
+    /* Round robin: this FIFO goes to the back of its ring. */
+    curb_host_queue_unlink(rbcm, hq);
+    if (hq->pending->num_entries == 0) {
+      curb_host_queue_free(rbcm, hq);
+    }
+    curb_host_refresh(rbcm, host);
+
+    args.self = self;
+    args.easy = (VALUE)val;
+    rb_protect(rb_curl_multi_admit_one, (VALUE)&args, &state);
+    if (state) {
+      ruby_curl_easy *rbce = (ruby_curl_easy *)key;
+      if (!rb_curl_multi_has_easy(rbcm, rbce)) {
+        rb_curl_multi_release_host_slot(rbcm, rbce);
+      }
+      rb_jump_tag(state);
+    }
+  }
+}
+
+/*
+ * call-seq:
+ *   multi.max_in_flight = 16                         => 16
+ *
+ * Limit how many easy handles queued with Multi#enqueue are attached to the
+ * multi handle at once. 0 or nil (the default) admits everything straight
+ * away. Handles added directly with Multi#add count towards the limit but are
+ * never held back by it.
+ */
+static VALUE ruby_curl_multi_max_in_flight_set(VALUE self, VALUE count) {
+  ruby_curl_multi *rbcm;
+  long value = NIL_P(count) ? 0 : NUM2LONG(count);
+
+  if (value < 0) {
+    rb_raise(rb_eArgError, "max_in_flight must be >= 0");
+  }
+
+  TypedData_Get_Struct(self, ruby_curl_multi, &ruby_curl_multi_data_type, rbcm);
+  rbcm->max_in_flight = value;
+  rb_curl_multi_admit_queued(self, rbcm);
+
+  return count;
+}
+
+/*
+ * call-seq:
+ *   multi.max_in_flight                              => Integer
+ *
+ * The current admission limit for queued easy handles; 0 means unlimited.
+ */
+static VALUE ruby_curl_multi_max_in_flight_get(VALUE self) {
+  ruby_curl_multi *rbcm;
+
+  TypedData_Get_Struct(self, ruby_curl_multi, &ruby_curl_multi_data_type, rbcm);
+  return LONG2NUM(rbcm->max_in_flight);
+}
+
+/*
+ * call-seq:
+ *   multi.max_in_flight_per_host = 4                 => 4
+ *
+ * Default limit on queued easy handles admitted per host at once; 0 or nil
+ * (the default) leaves hosts limited only by max_in_flight. Multi#limit_host
+ * overrides it for individual hosts.
+ */
+static VALUE ruby_curl_multi_max_in_flight_per_host_set(VALUE self, VALUE count) {
+  ruby_curl_multi *rbcm;
+  long value = NIL_P(count) ? 0 : NUM2LONG(count);
+
+  if (value < 0) {
+    rb_raise(rb_eArgError, "max_in_flight_per_host must be >= 0");
+  }
+
+  TypedData_Get_Struct(self, ruby_curl_multi, &ruby_curl_multi_data_type, rbcm);
+  rbcm->max_in_flight_per_host = value;
+  if (rbcm->host_queues) {
+    st_foreach(rbcm->host_queues, refresh_host_i, (st_data_t)rbcm);
+  }
+  rb_curl_multi_admit_queued(self, rbcm);
+
+  return count;
+}
+
+/*
+ * call-seq:
+ *   multi.max_in_flight_per_host                     => Integer
+ *
+ * The default per-host admission limit; 0 means unlimited.
+ */
+static VALUE ruby_curl_multi_max_in_flight_per_host_get(VALUE self) {
+  ruby_curl_multi *rbcm;
+
+  TypedData_Get_Struct(self, ruby_curl_multi, &ruby_curl_multi_data_type, rbcm);
+  return LONG2NUM(rbcm->max_in_flight_per_host);
+}
+
+/*
+ * call-seq:
+ *   multi.limit_host("api.example.com", 2)           => multi
+ *   multi.limit_host("api.example.com", nil)         => multi
+ *
+ * Override max_in_flight_per_host for one host key (see Multi#enqueue); 0
+ * means unlimited and nil goes back to the multi default.
+ */
+static VALUE ruby_curl_multi_limit_host(VALUE self, VALUE name, VALUE count) {
+  ruby_curl_multi *rbcm;
+  curb_host *host;
+  long value = NIL_P(count) ? -1 : NUM2LONG(count);
+
+  if (!NIL_P(count) && value < 0) {
+    rb_raise(rb_eArgError, "host limit must be >= 0");
+  }
+
+  TypedData_Get_Struct(self, ruby_curl_multi, &ruby_curl_multi_data_type, rbcm);
+  host = curb_host_fetch(rbcm, name);
+  host->max_in_flight = value;
+  curb_host_refresh(rbcm, host);
+  if (curb_host_idle_p(host)) {
+    st_data_t key = (st_data_t)host->key;
+    st_delete(rbcm->host_queues, &key, NULL);
+    curb_host_free(host);
+  }
+  rb_curl_multi_admit_queued(self, rbcm);
+
+  return self;
+}
+
+/*
+ * call-seq:
+ *   multi._enqueue(easy, host)                       => multi
+ *
+ * Append +easy+ to the admission queue for +host+ (derived from the easy's
+ * URL when nil) at the easy's priority and admit whatever the limits allow.
+ * Multi#enqueue wraps this with the same safety bookkeeping Multi#add
+ * performs.
+ */
+static VALUE ruby_curl_multi_enqueue(VALUE self, VALUE easy, VALUE name) {
+  ruby_curl_multi *rbcm;
+  ruby_curl_easy *rbce;
+  curb_host_queue *hq;
+
+  TypedData_Get_Struct(self, ruby_curl_multi, &ruby_curl_multi_data_type, rbcm);
+  TypedData_Get_Struct(easy, ruby_curl_easy, &ruby_curl_easy_data_type, rbce);
+  ruby_curl_multi_ensure_handle(rbcm);
+
+  if (rb_curl_multi_has_easy(rbcm, rbce) ||
+      (rbcm->queued && st_lookup(rbcm->queued, (st_data_t)rbce, NULL))) {
+    return self;
+  }
+
+  if (!rbce->retry_pending) {
+    rbce->retry_count = 0;
+  }
+
+  if (NIL_P(name)) {
+    name = rb_curl_multi_host_key_for_url(rb_easy_get("url"));
+  }
+  hq = curb_host_queue_fetch(curb_host_fetch(rbcm, name),
+                             rbce->priority > 0 ? (int)rbce->priority : CURB_DEFAULT_PRIORITY);
+
+  if (!rbcm->queued) {
+    rbcm->queued = st_init_numtable();
+  }
+  st_insert(rbcm->queued, (st_data_t)rbce, (st_data_t)hq);
+  st_insert(hq->pending, (st_data_t)rbce, (st_data_t)easy);
+  curb_host_queue_refresh(rbcm, hq);
+  rb_curl_multi_admit_queued(self, rbcm);
+  /* A GVL-free perform holds admissions: let it come back for this one. */
+  if (rbcm->transfer_without_gvl && rb_curl_multi_has_room_p(rbcm)) {
+    rb_curl_multi_wakeup(rbcm);
+  }
+
+  return self;
+}
+
+/*
+ * call-seq:
+ *   multi._dequeue(easy)                             => true or false
+ *
+ * Drop +easy+ from the admission queue. Returns false if it was not queued.
+ */
+static VALUE ruby_curl_multi_dequeue(VALUE self, VALUE easy) {
+  ruby_curl_multi *rbcm;
+  ruby_curl_easy *rbce;
+  curb_host_queue *hq;
+  st_data_t key, val;
+
+  TypedData_Get_Struct(self, ruby_curl_multi, &ruby_curl_multi_data_type, rbcm);
+  TypedData_Get_Struct(easy, ruby_curl_easy, &ruby_curl_easy_data_type, rbce);
+
+  key = (st_data_t)rbce;
+  if (!rbcm->queued || !st_delete(rbcm->queued, &key, &val)) {
+    return Qfalse;
+  }
+
+  hq = (curb_host_queue *)val;
+  key = (st_data_t)rbce;
+  st_delete(hq->pending, &key, NULL);
+  curb_host_queue_refresh(rbcm, hq);
+  curb_host_queue_release_if_empty(rbcm, hq);
+  rbce->retry_pending = 0;
+  return Qtrue;
+}
+
+/*
+ * call-seq:
+ *   multi._clear_queue                               => multi
+ *
+ * Drop every easy handle still waiting in the admission queue.
+ */
+static VALUE ruby_curl_multi_clear_queue(VALUE self) {
+  ruby_curl_multi *rbcm;
+
+  TypedData_Get_Struct(self, ruby_curl_multi, &ruby_curl_multi_data_type, rbcm);
+  rb_curl_multi_reset_queue(rbcm, 0);
+  return self;
+}
+
+/*
+ * call-seq:
+ *   multi.queue_size                                 => Integer
+ *
+ * Number of easy handles enqueued but not yet attached to the multi handle.
+ */
+static VALUE ruby_curl_multi_queue_size(VALUE self) {
+  ruby_curl_multi *rbcm;
+
+  TypedData_Get_Struct(self, ruby_curl_multi, &ruby_curl_multi_data_type, rbcm);
+  return SIZET2NUM(rbcm->queued ? (size_t)rbcm->queued->num_entries : 0);
+}
+
+static int queue_stats_i(st_data_t key, st_data_t val, st_data_t arg) {
+  curb_host *host = (curb_host *)val;
+  ruby_curl_multi *rbcm = (ruby_curl_multi *)((VALUE *)arg)[1];
+  VALUE stats = rb_hash_new();
+  curb_host_queue *hq;
+  size_t queued = 0;
+
+  for (hq = host->queues; hq; hq = hq->host_next) {
+    queued += hq->pending->num_entries;
+  }
+  rb_hash_aset(stats, ID2SYM(rb_intern("queued")), SIZET2NUM(queued));
+  rb_hash_aset(stats, ID2SYM(rb_intern("in_flight")), LONG2NUM(host->in_flight));
+  rb_hash_aset(stats, ID2SYM(rb_intern("limit")), LONG2NUM(curb_host_cap(rbcm, host)));
+  rb_hash_aset(((VALUE *)arg)[0], rb_str_new_cstr(host->key), stats);
+  return ST_CONTINUE;
+}
+
+/*
+ * call-seq:
+ *   multi.queue_stats   => { "example.com:443" => { queued: 12, in_flight: 4, limit: 4 }, ... }
+ *
+ * Per-host view of the admission queue: how many handles are waiting, how
+ * many admitted from the queue are still running and the host's limit (0 is
+ * unlimited). Hosts drop out once they have nothing queued or running and no
+ * Multi#limit_host override.
+ */
+static VALUE ruby_curl_multi_queue_stats(VALUE self) {
+  ruby_curl_multi *rbcm;
+  VALUE args[2];
+
+  TypedData_Get_Struct(self, ruby_curl_multi, &ruby_curl_multi_data_type, rbcm);
+  args[0] = rb_hash_new();
+  args[1] = (VALUE)rbcm;
+  if (rbcm->host_queues) {
+    st_foreach(rbcm->host_queues, queue_stats_i, (st_data_t)args);
+  }
+  return args[0];
+}
+
+/* ---- native timers: hedged requests and retries ----
+ *
+ * One min-heap of deadlines per multi. The drive loops cap their waits at
+ * the earliest deadline and read_info fires whatever is due, so neither kind
+ * of timer ever blocks the loop.
+ *
+ * An easy with hedge_after set gets a timer when it is added. If it is still
+ * running once the timer is due, a clone of it is added as well and the two
+ * are linked through hedge_peer. Whichever succeeds first is reported on the
+ * original easy and the other transfer is removed. A failed clone is just
+ * dropped; a failed original leaves libcurl but stays attached
+ * (hedge_waiting) until its clone's result is reported in its place.
+ *
+ * An easy with a retry policy whose attempt failed in a retryable way is
+ * detached without running its callbacks, parked in rbcm->retrying, and
+ * attached again once its backoff timer is due.
+ */
+static long long curb_multi_monotonic_ms(void) {
+#if defined(CLOCK_MONOTONIC)
+  struct timespec ts;
+  if (clock_gettime(CLOCK_MONOTONIC, &ts) == 0) {
+    return ((long long)ts.tv_sec * 1000) + (ts.tv_nsec / 1000000);
+  }
+#endif
+
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return ((long long)tv.tv_sec * 1000) + (tv.tv_usec / 1000);
+}
+
+static void curb_timer_heap_swap(curb_multi_timer *heap, size_t a, size_t b) {
+  curb_multi_timer tmp = heap[a];
+  heap[a] = heap[b];
+  heap[b] = tmp;
+}
+
+static void rb_curl_multi_schedule_timer(ruby_curl_multi *rbcm, ruby_curl_easy *rbce, int kind, long delay_ms, int requeue) {
+  size_t i;
+
+  if (rbcm->timers_len == rbcm->timers_capa) {
+    size_t capa = rbcm->timers_capa ? rbcm->timers_capa * 2 : 16;
+    REALLOC_N(rbcm->timers, curb_multi_timer, capa);
+    rbcm->timers_capa = capa;
+  }
+
+  i = rbcm->timers_len++;
+  rbcm->timers[i].deadline_ms = curb_multi_monotonic_ms() + delay_ms;
+  rbcm->timers[i].rbce = rbce;
+  rbcm->timers[i].generation = rbce->multi_attachment_generation;
+  rbcm->timers[i].kind = (char)kind;
+  rbcm->timers[i].requeue = (char)requeue;
+
+  while (i > 0) {
+    size_t parent = (i - 1) / 2;
+    if (rbcm->timers[parent].deadline_ms <= rbcm->timers[i].deadline_ms) break;
+    curb_timer_heap_swap(rbcm->timers, parent, i);
+    i = parent;
+  }
+}
+
+static void rb_curl_multi_pop_timer(ruby_curl_multi *rbcm) {
+  curb_multi_timer *heap = rbcm->timers;
+  size_t len = --rbcm->timers_len;
+  size_t i = 0;
+
+  heap[0] = heap[len];
+  for (;;) {
+    size_t left = 2 * i + 1, smallest = i;
+    if (left < len && heap[left].deadline_ms < heap[smallest].deadline_ms) smallest = left;
+    if (left + 1 < len && heap[left + 1].deadline_ms < heap[smallest].deadline_ms) smallest = left + 1;
+    if (smallest == i) break;
+    curb_timer_heap_swap(heap, i, smallest);
+    i = smallest;
+  }
+}
+
+static int rb_curl_multi_retrying_p(ruby_curl_multi *rbcm, ruby_curl_easy *rbce) {
+  return rbcm->retrying && st_lookup(rbcm->retrying, (st_data_t)rbce, NULL);
+}
+
+/* True while the timer still refers to the same attachment of its easy. The
+ * easy is only dereferenced once a table shows it is still alive. */
+static int rb_curl_multi_timer_live_p(ruby_curl_multi *rbcm, curb_multi_timer *timer) {
+  int tracked = timer->kind == CURB_TIMER_RETRY ? rb_curl_multi_retrying_p(rbcm, timer->rbce)
+                                                : rb_curl_multi_has_easy(rbcm, timer->rbce);
+  return tracked && timer->rbce->multi_attachment_generation == timer->generation;
+}
+
+/* Drop timers whose easy already finished so they do not shorten waits. */
+static void rb_curl_multi_prune_timers(ruby_curl_multi *rbcm) {
+  while (rbcm->timers_len > 0 && !rb_curl_multi_timer_live_p(rbcm, &rbcm->timers[0])) {
+    rb_curl_multi_pop_timer(rbcm);
+  }
+}
+
+/* Cap +wait_ms+ (negative means no limit) at the next timer deadline. */
+static long rb_curl_multi_timer_wait_ms(ruby_curl_multi *rbcm, long wait_ms) {
+  long long remaining_ms;
+
+  if (rbcm->deadline_ms > 0) {
+    remaining_ms = rbcm->deadline_ms - curb_multi_monotonic_ms();
+    if (remaining_ms < 0) remaining_ms = 0;
+    if (wait_ms < 0 || remaining_ms < wait_ms) wait_ms = (long)remaining_ms;
+  }
+
+  rb_curl_multi_prune_timers(rbcm);
+  if (rbcm->timers_len == 0) {
+    return wait_ms;
+  }
+
+  remaining_ms = rbcm->timers[0].deadline_ms - curb_multi_monotonic_ms();
+  if (remaining_ms < 0) remaining_ms = 0;
+  if (wait_ms < 0 || remaining_ms < wait_ms) {
+    return (long)remaining_ms;
+  }
+  return wait_ms;
+}
+
+/* How long to sleep when libcurl has no descriptor to wait on. */
+static struct timeval rb_curl_multi_idle_sleep_tv(ruby_curl_multi *rbcm) {
+  long wait_ms = rb_curl_multi_timer_wait_ms(rbcm, 100);
+  struct timeval tv;
+
+  tv.tv_sec = wait_ms / 1000;
+  tv.tv_usec = (wait_ms % 1000) * 1000;
+  return tv;
+}
+
+/* True while transfers are running or retries are waiting for their turn. */
+static int rb_curl_multi_busy_p(ruby_curl_multi *rbcm) {
+  return rbcm->running || (rbcm->retrying && rbcm->retrying->num_entries > 0);
+}
+
+/*
+ * Perform wakeups. An add or enqueue from another thread or fiber while
+ * perform sits in its readiness wait writes to wake_fds[1]; every wait also
+ * watches wake_fds[0], so the new transfer starts at once instead of after
+ * the rest of the timeout.
+ */
+static void rb_curl_multi_wakeup_open(ruby_curl_multi *rbcm) {
+#ifndef _WIN32
+  if (rbcm->wake_fds[0] >= 0) return;
+#ifdef CURB_HAVE_EVENTFD
+  rbcm->wake_fds[0] = rbcm->wake_fds[1] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+#else
+  if (pipe(rbcm->wake_fds) == 0) {
+    int i;
+    for (i = 0; i < 2; i++) {
+      fcntl(rbcm->wake_fds[i], F_SETFL, fcntl(rbcm->wake_fds[i], F_GETFL) | O_NONBLOCK);
+      fcntl(rbcm->wake_fds[i], F_SETFD, FD_CLOEXEC);
+    }
+  } else {
+    rbcm->wake_fds[0] = rbcm->wake_fds[1] = -1;
+  }
+#endif
+#endif
+}
+
+static void rb_curl_multi_wakeup_close(ruby_curl_multi *rbcm) {
+#ifndef _WIN32
+  if (rbcm->wake_fds[0] >= 0) close(rbcm->wake_fds[0]);
+  if (rbcm->wake_fds[1] >= 0 && rbcm->wake_fds[1] != rbcm->wake_fds[0]) close(rbcm->wake_fds[1]);
+#endif
+  rbcm->wake_fds[0] = rbcm->wake_fds[1] = -1;
+}
+
+/* Cut the running perform's wait short, if it is waiting. */
+static void rb_curl_multi_wakeup(ruby_curl_multi *rbcm) {
+#ifndef _WIN32
+  ssize_t rc;
+#ifdef CURB_HAVE_EVENTFD
+  uint64_t one = 1;
+#else
+  char one = 0;
+#endif
+
+  if (rbcm->wake_fds[1] < 0 || !(rbcm->waiting || rbcm->transfer_without_gvl)) return;
+  /* A full pipe or counter already has a wakeup pending. */
+  rc = write(rbcm->wake_fds[1], &one, sizeof(one));
+  (void)rc;
+#endif
+}
+
+/* Consume pending wakeups once a wait saw wake_fds[0] readable. Safe
+ * without the GVL. */
+static void rb_curl_multi_wakeup_drain(ruby_curl_multi *rbcm) {
+#ifndef _WIN32
+  char buf[64];
+
+  while (read(rbcm->wake_fds[0], buf, sizeof(buf)) > 0) {
+#ifdef CURB_HAVE_EVENTFD
+    break;
+#endif
+  }
+  rbcm->stats.wakeups++;
+#endif
+}
+
+static int curb_retry_bit_p(const uint64_t *bits, size_t nbits, long value) {
+  if (value < 0 || (size_t)value >= nbits) return 0;
+  return (bits[value / 64] >> (value % 64)) & 1;
+}
+
+/*
+ * How long to wait before attempt +retry_count+ + 1 of a transfer that just
+ * finished with +result+, or -1 when it must not be retried.
+ */
+static long rb_curl_multi_retry_delay_ms(VALUE self, ruby_curl_multi *rbcm, ruby_curl_easy *rbce, int result) {
+  curb_retry_policy *policy = rbce->retry_policy;
+  double delay_ms;
+  long response_code = 0;
+
+  if (!policy || rbce->retry_count >= policy->attempts || rbcm->closed || rbcm->aborting ||
+      rb_ivar_defined(self, id_deferred_exception_ivar)) {
+    return -1;
+  }
+  /* Errors raised by callbacks or safety checks are final, and streamed or
+   * uploaded data cannot be replayed. */
+  if (!NIL_P(rbce->callback_error) || rbce->unsafe_destination_blocked ||
+      !rb_easy_nil("upload") || !rb_easy_nil("body_proc") || !rb_easy_nil("header_proc")) {
+    return -1;
+  }
+
+  if (result != CURLE_OK) {
+    if (!curb_retry_bit_p(policy->codes, CURB_RETRY_CODE_BITS, result)) return -1;
+  } else {
+    curl_easy_getinfo(rbce->curl, CURLINFO_RESPONSE_CODE, &response_code);
+    if (!curb_retry_bit_p(policy->statuses, CURB_RETRY_STATUS_BITS, response_code)) return -1;
+  }
+
+  delay_ms = (double)policy->base_delay_ms;
+  {
+    long i;
+    for (i = 0; i < rbce->retry_count && delay_ms < policy->max_delay_ms; i++) delay_ms *= 2;
+  }
+  if (delay_ms > policy->max_delay_ms) delay_ms = (double)policy->max_delay_ms;
+  delay_ms -= delay_ms * policy->jitter * rb_genrand_real();
+
+#ifdef HAVE_CURLINFO_RETRY_AFTER
+  if (policy->retry_after) {
+    curl_off_t retry_after = 0;
+    if (curl_easy_getinfo(rbce->curl, CURLINFO_RETRY_AFTER, &retry_after) == CURLE_OK && retry_after > 0) {
+      /* A server asking for more than we are willing to wait gets its
+       * response passed through instead. */
+      if (retry_after * 1000 > policy->max_delay_ms) return -1;
+      if (retry_after * 1000 > delay_ms) delay_ms = (double)(retry_after * 1000);
+    }
+  }
+#endif
+
+  return (long)delay_ms;
+}
+
+/*
+ * Park +easy+ for a retry: take it off libcurl and the attachment table but
+ * keep it in Multi#requests, so the multi stays busy and its status
+ * callbacks only run for the final attempt.
+ */
+static void rb_curl_multi_schedule_retry(ruby_curl_multi *rbcm, VALUE easy, ruby_curl_easy *rbce, long delay_ms) {
+  int requeue = rbcm->queued_in_flight && st_lookup(rbcm->queued_in_flight, (st_data_t)rbce, NULL);
+  CURLMcode mcode;
+
+  mcode = curl_multi_remove_handle(rbcm->handle, rbce->curl);
+  if (mcode != CURLM_OK) {
+    raise_curl_multi_error_exception(mcode);
+  }
+  if (rbcm->active > 0) {
+    rbcm->active--;
+  }
+  rb_curl_multi_forget_easy(rbcm, rbce);
+  ruby_curl_easy_cleanup(easy, rbce);
+
+  if (!rbcm->retrying) {
+    rbcm->retrying = st_init_numtable();
+  }
+  st_insert(rbcm->retrying, (st_data_t)rbce, (st_data_t)easy);
+  rbce->retry_count++;
+  rbcm->stats.retries++;
+  rbce->retry_pending = 1;
+  rb_curl_multi_schedule_timer(rbcm, rbce, CURB_TIMER_RETRY, delay_ms, requeue);
+}
+
+/* Stop waiting to retry +rbce+; true if it was waiting. */
+static int rb_curl_multi_cancel_retry(ruby_curl_multi *rbcm, ruby_curl_easy *rbce) {
+  st_data_t key = (st_data_t)rbce;
+
+  if (!rbcm->retrying || !st_delete(rbcm->retrying, &key, NULL)) {
+    return 0;
+  }
+  rbce->retry_pending = 0;
+  return 1;
+}
+
+static int release_retrying_i(st_data_t key, st_data_t val, st_data_t arg) {
+  ruby_curl_easy *rbce = (ruby_curl_easy *)key;
+  rbce->retry_pending = 0;
+  rbce->multi = Qnil;
+  return ST_CONTINUE;
+}
+
+/* Forget every parked retry, e.g. when the multi is closed. */
+static void rb_curl_multi_release_retrying(ruby_curl_multi *rbcm) {
+  st_table *retrying = rbcm->retrying;
+
+  if (!retrying) {
+    return;
+  }
+  rbcm->retrying = NULL;
+  st_foreach(retrying, release_retrying_i, 0);
+  st_free_table(retrying);
+}
+
+static VALUE rb_curl_multi_start_retry(VALUE argp) {
+  VALUE *args = (VALUE *)argp;
+
+  if (RTEST(args[2])) {
+    /* Back through the admission queue so max_in_flight still holds. */
+    rb_curl_multi_remove_request_reference(args[0], args[1]);
+    ruby_curl_multi_enqueue(args[0], args[1], Qnil);
+  } else {
+    ruby_curl_multi_add(args[0], args[1]);
+  }
+  return Qnil;
+}
+
+static int collect_retrying_i(st_data_t key, st_data_t val, st_data_t arg) {
+  rb_ary_push((VALUE)arg, (VALUE)val);
+  return ST_CONTINUE;
+}
+
+/*
+ * Once a callback error is pending perform only drains what is running, so
+ * parked retries are given up: their easies keep the failed attempt's
+ * result and leave the multi.
+ */
+static void rb_curl_multi_abandon_retries(VALUE self, ruby_curl_multi *rbcm) {
+  VALUE easies;
+  long i;
+
+  if (!rbcm->retrying || rbcm->retrying->num_entries == 0) {
+    return;
+  }
+
+  easies = rb_ary_new();
+  st_foreach(rbcm->retrying, collect_retrying_i, (st_data_t)easies);
+  for (i = 0; i < RARRAY_LEN(easies); i++) {
+    VALUE easy = rb_ary_entry(easies, i);
+    ruby_curl_easy *rbce;
+
+    TypedData_Get_Struct(easy, ruby_curl_easy, &ruby_curl_easy_data_type, rbce);
+    rb_curl_multi_cancel_retry(rbcm, rbce);
+    rbce->multi = Qnil;
+    rb_curl_multi_remove_request_reference(self, easy);
+  }
+  RB_GC_GUARD(easies);
+}
+
+static VALUE rb_curl_multi_start_hedge(VALUE argp) {
+  VALUE *args = (VALUE *)argp;
+  VALUE clone = rb_funcall(args[1], rb_intern("clone"), 0);
+  ruby_curl_easy *rbce;
+
+  TypedData_Get_Struct(clone, ruby_curl_easy, &ruby_curl_easy_data_type, rbce);
+  /* The clone starts from the original's prepared handle: drop the lists
+   * setup built so adding it does not append every header twice. */
+  ruby_curl_easy_cleanup(clone, rbce);
+  rbce->hedge_after_ms = 0;
+  rbce->hedge_clone = 1;
+  ruby_curl_multi_add(args[0], clone);
+  return clone;
+}
+
+static void rb_curl_multi_fire_hedge(VALUE self, ruby_curl_multi *rbcm, ruby_curl_easy *rbce) {
+  st_data_t easy;
+  VALUE args[2];
+  VALUE clone;
+  ruby_curl_easy *clone_rbce;
+  int state = 0;
+
+  if (rbce->hedge_peer) {
+    return;
+  }
+  /* Only requests that can safely run twice without Ruby seeing it, and
+   * not two bodies racing into one body_fd. */
+  if (rb_curl_easy_ruby_transfer_callbacks_p(rbce) || !rb_easy_nil("postdata_buffer") || rbce->body_fd >= 0) {
+    return;
+  }
+
+  st_lookup(rbcm->attached, (st_data_t)rbce, &easy);
+  args[0] = self;
+  args[1] = (VALUE)easy;
+  clone = rb_protect(rb_curl_multi_start_hedge, (VALUE)args, &state);
+  if (state) {
+    rb_set_errinfo(Qnil);
+    return;
+  }
+
+  TypedData_Get_Struct(clone, ruby_curl_easy, &ruby_curl_easy_data_type, clone_rbce);
+  rbce->hedge_peer = clone_rbce;
+  clone_rbce->hedge_peer = rbce;
+  rbcm->hedges_fired++;
+}
+
+static void rb_curl_multi_fire_retry(VALUE self, ruby_curl_multi *rbcm, ruby_curl_easy *rbce, int requeue) {
+  st_data_t easy;
+  VALUE args[3];
+  int state = 0;
+
+  st_lookup(rbcm->retrying, (st_data_t)rbce, &easy);
+  st_delete(rbcm->retrying, (st_data_t *)&rbce, NULL);
+  args[0] = self;
+  args[1] = (VALUE)easy;
+  args[2] = requeue ? Qtrue : Qfalse;
+  rb_protect(rb_curl_multi_start_retry, (VALUE)args, &state);
+  if (state) {
+    /* The easy could not be attached again: finish it with that error. */
+    stash_multi_exception_if_unset(self, rb_errinfo(), (VALUE)easy);
+    rb_set_errinfo(Qnil);
+    rbce->retry_pending = 0;
+    rbce->multi = Qnil;
+    rb_curl_multi_remove_request_reference(self, (VALUE)easy);
+  }
+  RB_GC_GUARD(args[1]);
+}
+
+static void rb_curl_multi_fire_timers(VALUE self, ruby_curl_multi *rbcm) {
+  long long now_ms;
+
+  if (rb_ivar_defined(self, id_deferred_exception_ivar)) {
+    rb_curl_multi_abandon_retries(self, rbcm);
+    return;
+  }
+
+  now_ms = curb_multi_monotonic_ms();
+  while (rbcm->timers_len > 0 && rbcm->timers[0].deadline_ms <= now_ms) {
+    curb_multi_timer timer = rbcm->timers[0];
+
+    rb_curl_multi_pop_timer(rbcm);
+    if (!rb_curl_multi_timer_live_p(rbcm, &timer)) {
+      continue;
+    }
+    if (timer.kind == CURB_TIMER_RETRY) {
+      rb_curl_multi_fire_retry(self, rbcm, timer.rbce, timer.requeue);
+    } else {
+      rb_curl_multi_fire_hedge(self, rbcm, timer.rbce);
+    }
+  }
+}
+
+/* Split a hedged pair. When +rbce+ is the original its clone is removed. */
+static void rb_curl_multi_unhedge(ruby_curl_multi *rbcm, ruby_curl_easy *rbce) {
+  ruby_curl_easy *peer = (ruby_curl_easy *)rbce->hedge_peer;
+
+  if (!peer) {
+    return;
+  }
+
+  rbce->hedge_peer = NULL;
+  peer->hedge_peer = NULL;
+  rbce->hedge_waiting = 0;
+  peer->hedge_waiting = 0;
+  if (rbce->hedge_clone) {
+    return;
+  }
+
+  rb_curl_multi_detach_easy(rbcm, peer);
+  peer->multi = Qnil;
+  ruby_curl_easy_cleanup(peer->self, peer);
+}
+
+#define CURB_SWAP(type, a, b) do { type curb_swap_tmp = (a); (a) = (b); (b) = curb_swap_tmp; } while (0)
+
+/*
+ * The clone of a hedged request is the one to report: it succeeded first,
+ * or the original already failed. Remove the original's transfer and move
+ * the clone's handle and response onto the original, so the rest of
+ * completion handling sees the original easy.
+ */
+static void rb_curl_multi_adopt_hedge(ruby_curl_multi *rbcm, ruby_curl_easy *clone, ruby_curl_easy *rbce) {
+  rbce->hedge_peer = NULL;
+  clone->hedge_peer = NULL;
+  rbce->hedge_waiting = 0;
+
+  /* The clone's transfer stays counted in active until it is reaped. */
+  rb_curl_multi_detach_easy(rbcm, rbce);
+  rb_curl_multi_forget_easy(rbcm, clone);
+  ruby_curl_easy_cleanup(rbce->self, rbce);
+
+  CURB_SWAP(CURL *, rbce->curl, clone->curl);
+  CURB_SWAP(struct curl_slist *, rbce->curl_headers, clone->curl_headers);
+  CURB_SWAP(struct curl_slist *, rbce->curl_proxy_headers, clone->curl_proxy_headers);
+  CURB_SWAP(struct curl_slist *, rbce->curl_ftp_commands, clone->curl_ftp_commands);
+  CURB_SWAP(struct curl_slist *, rbce->curl_resolve, clone->curl_resolve);
+  CURB_SWAP(struct curl_slist *, rbce->curl_connect_to, clone->curl_connect_to);
+  /* the clone's handle carries its CURLOPT_SHARE; the original's was
+   * detached by the cleanup above */
+  CURB_SWAP(void *, rbce->attached_share, clone->attached_share);
+
+  curl_easy_setopt(rbce->curl, CURLOPT_PRIVATE, (void *)rbce);
+  curl_easy_setopt(rbce->curl, CURLOPT_ERRORBUFFER, rbce->err_buf);
+  curl_easy_setopt(clone->curl, CURLOPT_PRIVATE, (void *)clone);
+  curl_easy_setopt(clone->curl, CURLOPT_ERRORBUFFER, clone->err_buf);
+  memcpy(rbce->err_buf, clone->err_buf, sizeof(rbce->err_buf));
+
+  rbce->downloaded_body_bytes = clone->downloaded_body_bytes;
+  rbce->body_collected = clone->body_collected;
+  CURB_SWAP(int, rbce->spill_fd, clone->spill_fd);
+#ifndef _WIN32
+  if (clone->spill_fd >= 0) close(clone->spill_fd);
+#endif
+  clone->spill_fd = -1;
+  rbce->callback_error = clone->callback_error;
+  rbce->unsafe_destination_blocked = clone->unsafe_destination_blocked;
+  memcpy(rbce->unsafe_destination_error, clone->unsafe_destination_error, sizeof(rbce->unsafe_destination_error));
+  rb_hash_aset(rbce->opts, rb_easy_hkey("body_data"), rb_hash_aref(clone->opts, rb_easy_hkey("body_data")));
+  rb_hash_aset(rbce->opts, rb_easy_hkey("header_data"), rb_hash_aref(clone->opts, rb_easy_hkey("header_data")));
+  rb_hash_delete(rbce->opts, rb_easy_hkey("response_headers"));
+
+  clone->callback_error = Qnil;
+  clone->multi = Qnil;
+  ruby_curl_easy_cleanup(clone->self, clone);
+}
+
+/*
+ * call-seq:
+ *   multi.hedge_stats                                => { fired: 3, won: 1 }
+ *
+ * How many hedged requests (see Curl::Easy#hedge_after=) started a clone,
+ * and how many of those clones finished before the original transfer.
+ */
+static VALUE ruby_curl_multi_hedge_stats(VALUE self) {
+  ruby_curl_multi *rbcm;
+  VALUE stats = rb_hash_new();
+
+  TypedData_Get_Struct(self, ruby_curl_multi, &ruby_curl_multi_data_type, rbcm);
+  rb_hash_aset(stats, ID2SYM(rb_intern("fired")), ULONG2NUM(rbcm->hedges_fired));
+  rb_hash_aset(stats, ID2SYM(rb_intern("won")), ULONG2NUM(rbcm->hedges_won));
+  return stats;
+}
+
+/* ---- transfer statistics ----
+ *
+ * Recorded from getinfo as each transfer completes, into fixed arrays on the
+ * multi: no Ruby objects are created until Multi#stats is called. Phase
+ * histograms hold the time spent in each phase rather than libcurl's
+ * cumulative timestamps. The DNS, connect and TLS phases only count
+ * transfers that opened a connection.
+ */
+
+/* Upper bounds of the histogram buckets in microseconds; the last bucket is open. */
+static const curl_off_t curb_stats_bucket_us[CURB_STATS_BUCKETS - 1] = {
+  1000, 2000, 5000, 10000, 20000, 50000, 100000, 200000, 500000,
+  1000000, 2000000, 5000000, 10000000, 30000000, 60000000
+};
+
+static const char *curb_stats_phase_names[CURB_STATS_PHASES] = {
+  "namelookup", "connect", "appconnect", "starttransfer", "total"
+};
+
+enum { CURB_PHASE_NAMELOOKUP, CURB_PHASE_CONNECT, CURB_PHASE_APPCONNECT,
+       CURB_PHASE_STARTTRANSFER, CURB_PHASE_TOTAL };
+
+static void curb_stats_observe(curb_multi_stats *stats, int phase, curl_off_t us) {
+  int bucket = 0;
+
+  if (us < 0) us = 0;
+  while (bucket < CURB_STATS_BUCKETS - 1 && us > curb_stats_bucket_us[bucket]) bucket++;
+  stats->phases[phase][bucket]++;
+}
+
+#ifdef HAVE_CURLINFO_TOTAL_TIME_T
+#define curb_stats_time_us(curl, info, info_t, out) curl_easy_getinfo((curl), (info_t), (out))
+#else
+static CURLcode curb_stats_time_us_double(CURL *curl, CURLINFO info, curl_off_t *out) {
+  double seconds = 0;
+  CURLcode code = curl_easy_getinfo(curl, info, &seconds);
+  *out = (curl_off_t)(seconds * 1e6);
+  return code;
+}
+#define curb_stats_time_us(curl, info, info_t, out) curb_stats_time_us_double((curl), (info), (out))
+#endif
+
+static void rb_curl_multi_record_stats(ruby_curl_multi *rbcm, CURL *curl, int result) {
+  curb_multi_stats *stats = &rbcm->stats;
+  curl_off_t namelookup = 0, connect = 0, appconnect = 0, starttransfer = 0, total = 0;
+  long connects = 0;
+
+  stats->completed++;
+  stats->results[result >= 0 && result < CURB_STATS_RESULTS ? result : CURB_STATS_RESULTS - 1]++;
+
+#if defined(HAVE_CURLINFO_SIZE_DOWNLOAD_T) && defined(HAVE_CURLINFO_SIZE_UPLOAD_T)
+  {
+    curl_off_t down = 0, up = 0;
+    curl_easy_getinfo(curl, CURLINFO_SIZE_DOWNLOAD_T, &down);
+    curl_easy_getinfo(curl, CURLINFO_SIZE_UPLOAD_T, &up);
+    stats->bytes_down += (unsigned long long)down;
+    stats->bytes_up += (unsigned long long)up;
+  }
+#else
+  {
+    double down = 0, up = 0;
+    curl_easy_getinfo(curl, CURLINFO_SIZE_DOWNLOAD, &down);
+    curl_easy_getinfo(curl, CURLINFO_SIZE_UPLOAD, &up);
+    stats->bytes_down += (unsigned long long)down;
+    stats->bytes_up += (unsigned long long)up;
+  }
+#endif
+
+#ifdef HAVE_CURLINFO_NUM_CONNECTS
+  curl_easy_getinfo(curl, CURLINFO_NUM_CONNECTS, &connects);
+#endif
+  if (connects > 0) {
+    stats->connections_created += (unsigned long)connects;
+  } else if (result == CURLE_OK) {
+    stats->connections_reused++;
+#ifdef HAVE_CURLINFO_HTTP_VERSION
+    {
+      long version = 0;
+      curl_easy_getinfo(curl, CURLINFO_HTTP_VERSION, &version);
+      if (version >= CURL_HTTP_VERSION_2_0) stats->connections_multiplexed++;
+    }
+#endif
+  }
+
+  curb_stats_time_us(curl, CURLINFO_NAMELOOKUP_TIME, CURLINFO_NAMELOOKUP_TIME_T, &namelookup);
+  curb_stats_time_us(curl, CURLINFO_CONNECT_TIME, CURLINFO_CONNECT_TIME_T, &connect);
+#ifdef HAVE_CURLINFO_APPCONNECT_TIME
+  curb_stats_time_us(curl, CURLINFO_APPCONNECT_TIME, CURLINFO_APPCONNECT_TIME_T, &appconnect);
+#endif
+  curb_stats_time_us(curl, CURLINFO_STARTTRANSFER_TIME, CURLINFO_STARTTRANSFER_TIME_T, &starttransfer);
+  curb_stats_time_us(curl, CURLINFO_TOTAL_TIME, CURLINFO_TOTAL_TIME_T, &total);
+
+  if (connects > 0 && connect > 0) {
+    curb_stats_observe(stats, CURB_PHASE_NAMELOOKUP, namelookup);
+    curb_stats_observe(stats, CURB_PHASE_CONNECT, connect - namelookup);
+    if (appconnect > 0) {
+      curb_stats_observe(stats, CURB_PHASE_APPCONNECT, appconnect - connect);
+    }
+  }
+  if (starttransfer > 0) {
+    curb_stats_observe(stats, CURB_PHASE_STARTTRANSFER,
+                       starttransfer - (appconnect > connect ? appconnect : connect));
+  }
+  curb_stats_observe(stats, CURB_PHASE_TOTAL, total);
+}
+
+/*
+ * call-seq:
+ *   multi.stats                                      => hash
+ *
+ * Live counters for this multi handle:
+ *
+ *   { active: 4, queued: 120, retrying: 1,
+ *     completed: 880, results: { 0 => 876, 28 => 4 },
+ *     bytes_down: 18022400, bytes_up: 0,
+ *     connections: { created: 12, reused: 868, multiplexed: 860 },
+ *     retries: 5, hedges: { fired: 3, won: 1 },
+ *     event_loop: { backend: :epoll, syscalls: 1730, wakeups: 2 },
+ *     phases: { namelookup: [...], connect: [...], appconnect: [...],
+ *               starttransfer: [...], total: [...] } }
+ *
+ * +completed+ counts every finished transfer, including attempts that were
+ * then retried; +results+ breaks it down by CURLcode. Each phase histogram
+ * has one count per bucket of Curl::Multi::STATS_BUCKETS (upper bounds in
+ * seconds) for the time spent in that phase: DNS, TCP connect, TLS
+ * handshake, waiting for the first byte after connecting, and the whole
+ * transfer. Transfers on a reused connection skip the first three.
+ * +multiplexed+ counts the reused connections that carried the transfer as
+ * an HTTP/2 or HTTP/3 stream.
+ *
+ * +event_loop+ names the readiness backend the last perform actually used
+ * (nil before the first) and counts the waits and interest updates it made:
+ * select/poll/epoll_wait and epoll_ctl calls, or io_uring_enter calls.
+ * +wakeups+ counts the waits that ended early because another thread or
+ * fiber added or enqueued work while perform was blocked.
+ */
+static VALUE ruby_curl_multi_stats(VALUE self) {
+  ruby_curl_multi *rbcm;
+  curb_multi_stats *stats;
+  VALUE hash = rb_hash_new();
+  VALUE results = rb_hash_new();
+  VALUE connections = rb_hash_new();
+  VALUE hedges = rb_hash_new();
+  VALUE event_loop = rb_hash_new();
+  VALUE phases = rb_hash_new();
+  VALUE backend;
+  int i, j;
+
+  TypedData_Get_Struct(self, ruby_curl_multi, &ruby_curl_multi_data_type, rbcm);
+  stats = &rbcm->stats;
+
+  rb_hash_aset(hash, ID2SYM(rb_intern("active")), INT2NUM(rbcm->active));
+  rb_hash_aset(hash, ID2SYM(rb_intern("queued")), SIZET2NUM(rbcm->queued ? (size_t)rbcm->queued->num_entries : 0));
+  rb_hash_aset(hash, ID2SYM(rb_intern("retrying")), SIZET2NUM(rbcm->retrying ? (size_t)rbcm->retrying->num_entries : 0));
+  rb_hash_aset(hash, ID2SYM(rb_intern("completed")), ULONG2NUM(stats->completed));
+
+  for (i = 0; i < CURB_STATS_RESULTS; i++) {
+    if (stats->results[i]) rb_hash_aset(results, INT2NUM(i), ULONG2NUM(stats->results[i]));
+  }
+  rb_hash_aset(hash, ID2SYM(rb_intern("results")), results);
+  rb_hash_aset(hash, ID2SYM(rb_intern("bytes_down")), ULL2NUM(stats->bytes_down));
+  rb_hash_aset(hash, ID2SYM(rb_intern("bytes_up")), ULL2NUM(stats->bytes_up));
+
+  rb_hash_aset(connections, ID2SYM(rb_intern("created")), ULONG2NUM(stats->connections_created));
+  rb_hash_aset(connections, ID2SYM(rb_intern("reused")), ULONG2NUM(stats->connections_reused));
+  rb_hash_aset(connections, ID2SYM(rb_intern("multiplexed")), ULONG2NUM(stats->connections_multiplexed));
+  rb_hash_aset(hash, ID2SYM(rb_intern("connections")), connections);
+
+  rb_hash_aset(hash, ID2SYM(rb_intern("retries")), ULONG2NUM(stats->retries));
+  rb_hash_aset(hedges, ID2SYM(rb_intern("fired")), ULONG2NUM(rbcm->hedges_fired));
+  rb_hash_aset(hedges, ID2SYM(rb_intern("won")), ULONG2NUM(rbcm->hedges_won));
+  rb_hash_aset(hash, ID2SYM(rb_intern("hedges")), hedges);
+
+  switch (rbcm->event_backend_used) {
+    case CURB_MULTI_EVENT_BACKEND_SELECT: backend = ID2SYM(rb_intern("select")); break;
+    case CURB_MULTI_EVENT_BACKEND_EPOLL: backend = ID2SYM(rb_intern("epoll")); break;
+    case CURB_MULTI_EVENT_BACKEND_IO_URING: backend = ID2SYM(rb_intern("io_uring")); break;
+    default: backend = Qnil;
+  }
+  rb_hash_aset(event_loop, ID2SYM(rb_intern("backend")), backend);
+  rb_hash_aset(event_loop, ID2SYM(rb_intern("syscalls")), ULONG2NUM(stats->event_syscalls));
+  rb_hash_aset(event_loop, ID2SYM(rb_intern("wakeups")), ULONG2NUM(stats->wakeups));
+  rb_hash_aset(hash, ID2SYM(rb_intern("event_loop")), event_loop);
+
+  for (i = 0; i < CURB_STATS_PHASES; i++) {
+    VALUE counts = rb_ary_new_capa(CURB_STATS_BUCKETS);
+    for (j = 0; j < CURB_STATS_BUCKETS; j++) {
+      rb_ary_push(counts, ULONG2NUM(stats->phases[i][j]));
+    }
+    rb_hash_aset(phases, ID2SYM(rb_intern(curb_stats_phase_names[i])), counts);
+  }
+  rb_hash_aset(hash, ID2SYM(rb_intern("phases")), phases);
+
+  return hash;
+}
+
+/*
+ * call-seq:
+ *   multi.reset_stats                                => multi
+ *
+ * Zero the counters reported by Multi#stats and Multi#hedge_stats.
+ */
+static VALUE ruby_curl_multi_reset_stats(VALUE self) {
+  ruby_curl_multi *rbcm;
+
+  TypedData_Get_Struct(self, ruby_curl_multi, &ruby_curl_multi_data_type, rbcm);
+  memset(&rbcm->stats, 0, sizeof(rbcm->stats));
+  rbcm->hedges_fired = 0;
+  rbcm->hedges_won = 0;
+  return self;
+}
+
+// on_success, on_failure, on_complete
+static VALUE call_status_handler1(VALUE ary) {
+  return rb_funcall(rb_ary_entry(ary, 0), idCall, 1, rb_ary_entry(ary, 1));
+}
+static VALUE call_status_handler2(VALUE ary) {
+  return rb_funcall(rb_ary_entry(ary, 0), idCall, 2, rb_ary_entry(ary, 1), rb_ary_entry(ary, 2));
+}
+
+static void flush_stderr_if_any(ruby_curl_easy *rbce) {
+  VALUE stderr_io = rb_easy_get("stderr_io");
+  if (stderr_io != Qnil) {
+    /* Flush via Ruby IO API */
+    rb_funcall(stderr_io, rb_intern("flush"), 0);
+#ifdef HAVE_RUBY_IO_H
+    /* Additionally flush underlying FILE* to be extra safe. */
+    rb_io_t *open_f_ptr;
+    if (RB_TYPE_P(stderr_io, T_FILE)) {
+      GetOpenFile(stderr_io, open_f_ptr);
+      FILE *fp = rb_io_stdio_file(open_f_ptr);
+      if (fp) fflush(fp);
+    }
+#endif
+  }
+}
+
+/* Helper to locate the Ruby Easy VALUE from the attached table using the
+ * underlying CURL* handle when CURLINFO_PRIVATE is unavailable or stale. */
+struct find_easy_ctx { CURL *handle; VALUE easy; };
+static int find_easy_by_handle_i(st_data_t key, st_data_t val, st_data_t arg) {
+  ruby_curl_easy *rbce = (ruby_curl_easy *)key;
+  struct find_easy_ctx *ctx = (struct find_easy_ctx *)arg;
+  if (rbce && rbce->curl == ctx->handle) {
+    ctx->easy = (VALUE)val;
+    return ST_STOP;
+  }
+  return ST_CONTINUE;
+}
+
+static VALUE find_easy_by_handle(ruby_curl_multi *rbcm, CURL *easy_handle) {
+  if (!rbcm || !rbcm->attached) return Qnil;
+  struct find_easy_ctx ctx; ctx.handle = easy_handle; ctx.easy = Qnil;
+  st_foreach(rbcm->attached, find_easy_by_handle_i, (st_data_t)&ctx);
+  return ctx.easy;
+}
+
+static VALUE find_easy_value_for_handle(ruby_curl_multi *rbcm, CURL *easy_handle) {
+  VALUE easy = Qnil;
+  ruby_curl_easy *rbce = NULL;
+
+  CURLcode private_rc = curl_easy_getinfo(easy_handle, CURLINFO_PRIVATE, (char **)&rbce);
+  if (private_rc == CURLE_OK && rbce) {
+    easy = rbce->self;
+  }
+
+  if (NIL_P(easy) || !RB_TYPE_P(easy, T_DATA)) {
+    easy = find_easy_by_handle(rbcm, easy_handle);
+  }
+
+  return easy;
+}
+
+struct multi_complete_callback_args {
+  VALUE self;
+  VALUE easy;
+  ruby_curl_multi *rbcm;
+  ruby_curl_easy *rbce;
+  int result;
+  unsigned long attachment_generation; /* multi generation before callbacks ran */
+  size_t callback_adds_start;
+};
+
+/*
+ * Easies are stamped with the multi's attachment generation when added, and
+ * adds made while completion callbacks run are logged. Undoing those adds
+ * after a raising callback only visits the log, so a completion costs O(1)
+ * however many easies are attached.
+ */
+static void rb_curl_multi_log_callback_add(ruby_curl_multi *rbcm, ruby_curl_easy *rbce) {
+  if (rbcm->callback_adds_len == rbcm->callback_adds_capa) {
+    size_t capa = rbcm->callback_adds_capa ? rbcm->callback_adds_capa * 2 : 8;
+    REALLOC_N(rbcm->callback_adds, void *, capa);
+    rbcm->callback_adds_capa = capa;
+  }
+  rbcm->callback_adds[rbcm->callback_adds_len++] = rbce;
+}
+
+static void rb_curl_multi_remove_added_easies_since(VALUE self, ruby_curl_multi *rbcm, struct multi_complete_callback_args *args) {
+  VALUE easies = rb_ary_new();
+  size_t index;
+  long i;
+
+  if (!rbcm || !rbcm->attached) {
+    return;
+  }
+
+  /* Collect first: removing can run Ruby code that logs further adds. */
+  for (index = args->callback_adds_start; index < rbcm->callback_adds_len; index++) {
+    ruby_curl_easy *rbce = (ruby_curl_easy *)rbcm->callback_adds[index];
+    st_data_t easy;
+
+    /* A logged pointer is only trusted while it is still attached here. */
+    if (!st_lookup(rbcm->attached, (st_data_t)rbce, &easy)) {
+      continue;
+    }
+    if (rbce->multi_attachment_generation <= args->attachment_generation) {
+      continue;
+    }
+    rb_ary_push(easies, (VALUE)easy);
+  }
+
+  for (i = 0; i < RARRAY_LEN(easies); i++) {
+    VALUE easy = rb_ary_entry(easies, i);
+    ruby_curl_easy *rbce = NULL;
+
+    TypedData_Get_Struct(easy, ruby_curl_easy, &ruby_curl_easy_data_type, rbce);
+    if (!rbce || rbce->multi != self || !rb_curl_multi_has_easy(rbcm, rbce)) {
+      continue;
     }
 
     rb_curl_multi_remove_request_reference(self, easy);
@@ -1000,7 +2807,7 @@ static void stash_and_raise_status_callback_error_if_unmasked(struct multi_compl
   }
 
   stash_multi_exception_if_unset(args->self, exception, args->easy);
-  rb_curl_multi_remove_added_easies_since_snapshot(args->self, args->rbcm, args->attached_snapshot);
+  rb_curl_multi_remove_added_easies_since(args->self, args->rbcm, args);
   rb_exc_raise(exception);
 }
 
@@ -1103,9 +2910,8 @@ static VALUE rb_curl_multi_finish_completion_callbacks(VALUE argp) {
     args->rbce->multi = Qnil;
   }
 
-  if (args->attached_snapshot) {
-    st_free_table(args->attached_snapshot);
-    args->attached_snapshot = NULL;
+  if (args->rbcm && args->rbcm->callback_adds_len > args->callback_adds_start) {
+    args->rbcm->callback_adds_len = args->callback_adds_start;
   }
 
   return Qnil;
@@ -1132,8 +2938,52 @@ static void rb_curl_mutli_handle_complete(VALUE self, CURL *easy_handle, int res
     return;
   }
 
+  if (rbce->hedge_clone) {
+    ruby_curl_easy *original = (ruby_curl_easy *)rbce->hedge_peer;
+
+    if (!original || (result != CURLE_OK && !original->hedge_waiting)) {
+      /* A failed clone is dropped; the original keeps running. */
+      rb_curl_multi_detach_easy(rbcm, rbce);
+      rbce->multi = Qnil;
+      ruby_curl_easy_cleanup(easy, rbce);
+      return;
+    }
+
+    if (result == CURLE_OK) {
+      rbcm->hedges_won++;
+    }
+    rb_curl_multi_adopt_hedge(rbcm, rbce, original);
+    rbce = original;
+    easy = original->self;
+  } else if (rbce->hedge_peer && result != CURLE_OK) {
+    /* A failed original waits for its clone, which may still succeed:
+     * only this transfer ends, and the clone's result is reported. */
+    curl_multi_remove_handle(rbcm->handle, rbce->curl);
+    rbce->hedge_waiting = 1;
+    return;
+  } else if (rbce->hedge_peer) {
+    rb_curl_multi_unhedge(rbcm, rbce);
+  }
+
+  /* on_body(min_chunk:) gets the tail of the body before anything else
+   * learns the transfer is over. */
+  if (!rb_curl_easy_flush_body_chunk(rbce) && result == CURLE_OK) {
+    result = CURLE_WRITE_ERROR;
+  }
+
+  rb_curl_multi_record_stats(rbcm, rbce->curl, result);
   rbce->last_result = result; /* save the last easy result code */
 
+  {
+    long retry_delay_ms = rb_curl_multi_retry_delay_ms(self, rbcm, rbce, result);
+    if (retry_delay_ms >= 0) {
+      flush_stderr_if_any(rbce);
+      rb_curl_multi_schedule_retry(rbcm, easy, rbce, retry_delay_ms);
+      return;
+    }
+  }
+  rbce->retry_pending = 0;
+
   /* Ensure any verbose output redirected via CURLOPT_STDERR is flushed
    * before we tear down handler state. */
   flush_stderr_if_any(rbce);
@@ -1162,13 +3012,19 @@ static void rb_curl_mutli_handle_complete(VALUE self, CURL *easy_handle, int res
   /* Flush again after removal to cover any last buffered data. */
   flush_stderr_if_any(rbce);
 
+  /* Report the easy even if one of its status callbacks raises below. */
+  if (RTEST(rbcm->completed_sink)) {
+    rb_ary_push(rbcm->completed_sink, easy);
+  }
+
   struct multi_complete_callback_args args = {
     self,
     easy,
     rbcm,
     rbce,
     result,
-    capture_attached_easy_snapshot(rbcm)
+    rbcm->attachment_generation,
+    rbcm->callback_adds_len
   };
   rb_ensure(rb_curl_multi_run_completion_callbacks, (VALUE)&args,
             rb_curl_multi_finish_completion_callbacks, (VALUE)&args);
@@ -1207,12 +3063,163 @@ static void rb_curl_multi_read_info(VALUE self, CURLM *multi_handle) {
     }
   }
 
+  rb_curl_multi_fire_timers(self, rbcm);
+  raise_multi_deferred_exception_if_idle(self);
+}
+
+static int collect_attached_i(st_data_t key, st_data_t val, st_data_t arg) {
+  rb_ary_push((VALUE)arg, (VALUE)val);
+  return ST_CONTINUE;
+}
+
+/* Complete +easy+ with +result+ as handle_complete would, stashing anything
+ * its callbacks raise. */
+static void rb_curl_multi_abort_easy(VALUE self, ruby_curl_multi *rbcm, VALUE easy, int result) {
+  ruby_curl_easy *rbce;
+  int state = 0;
+
+  TypedData_Get_Struct(easy, ruby_curl_easy, &ruby_curl_easy_data_type, rbce);
+  if (rb_curl_multi_cancel_retry(rbcm, rbce)) {
+    /* Parked for a retry: nothing is attached to libcurl. */
+    struct multi_complete_callback_args args = {
+      self, easy, rbcm, rbce, result, rbcm->attachment_generation, rbcm->callback_adds_len
+    };
+    rbce->last_result = result;
+    rb_curl_multi_remove_request_reference(self, easy);
+    if (RTEST(rbcm->completed_sink)) {
+      rb_ary_push(rbcm->completed_sink, easy);
+    }
+    rb_protect(rb_curl_multi_run_completion_callbacks, (VALUE)&args, &state);
+    rb_curl_multi_finish_completion_callbacks((VALUE)&args);
+  } else if (rb_curl_multi_has_easy(rbcm, rbce)) {
+    struct multi_handle_complete_args args = { self, rbce->curl, result };
+    rb_protect(rb_curl_mutli_handle_complete_protected, (VALUE)&args, &state);
+  }
+
+  if (state) {
+    stash_multi_exception_if_unset(self, rb_errinfo(), easy);
+    rb_set_errinfo(Qnil);
+  }
+}
+
+/*
+ * Once the deadline passes or the token is cancelled, fail everything the
+ * perform still owns in one go: queued work is dropped, transfers that
+ * already finished report their own result, and the rest (running or parked
+ * for a retry) complete with +result+. Easies that status callbacks add
+ * meanwhile stay attached for the next perform.
+ */
+static void rb_curl_multi_abort_pending(VALUE self, ruby_curl_multi *rbcm, int result) {
+  VALUE easies = rb_ary_new();
+  CURLMsg *msg;
+  int msgs_left;
+  long i;
+
+  rbcm->aborting = 1;
+  rb_curl_multi_reset_queue(rbcm, 0);
+
+  while ((msg = curl_multi_info_read(rbcm->handle, &msgs_left))) {
+    struct multi_handle_complete_args args = { self, msg->easy_handle, msg->data.result };
+    int state = 0;
+
+    if (msg->msg != CURLMSG_DONE) continue;
+    rb_protect(rb_curl_mutli_handle_complete_protected, (VALUE)&args, &state);
+    if (state) {
+      stash_multi_exception_if_unset(self, rb_errinfo(), find_easy_value_for_handle(rbcm, args.easy_handle));
+      rb_set_errinfo(Qnil);
+    }
+  }
+
+  if (rbcm->attached) st_foreach(rbcm->attached, collect_attached_i, (st_data_t)easies);
+  if (rbcm->retrying) st_foreach(rbcm->retrying, collect_retrying_i, (st_data_t)easies);
+  for (i = 0; i < RARRAY_LEN(easies); i++) {
+    rb_curl_multi_abort_easy(self, rbcm, rb_ary_entry(easies, i), result);
+  }
+  RB_GC_GUARD(easies);
+
+  rbcm->running = 0;
+  rbcm->aborting = 0;
+}
+
+/* Abort the running perform's pending work if its deadline passed or its
+ * token was cancelled; true if it did. */
+static int rb_curl_multi_stop_if_limited(VALUE self, ruby_curl_multi *rbcm) {
+  if (!rbcm->cancel && rbcm->deadline_ms <= 0) {
+    return 0;
+  }
+  if (ruby_curl_cancel_token_cancelled_p(rbcm->cancel)) {
+    rb_curl_multi_abort_pending(self, rbcm, CURLE_ABORTED_BY_CALLBACK);
+  } else if (rbcm->deadline_ms > 0 && curb_multi_monotonic_ms() >= rbcm->deadline_ms) {
+    rb_curl_multi_abort_pending(self, rbcm, CURLE_OPERATION_TIMEDOUT);
+  } else {
+    return 0;
+  }
   raise_multi_deferred_exception_if_idle(self);
+  return 1;
+}
+
+#ifdef CURB_HAVE_TRANSFER_WITHOUT_GVL
+/* True once the running perform's deadline passed or its token was
+ * cancelled. Safe to call without the GVL. */
+static int rb_curl_multi_limit_reached_p(ruby_curl_multi *rbcm) {
+  return ruby_curl_cancel_token_cancelled_p(rbcm->cancel) ||
+         (rbcm->deadline_ms > 0 && curb_multi_monotonic_ms() >= rbcm->deadline_ms);
+}
+
+struct multi_perform_without_gvl_args {
+  CURLM *handle;
+  int *still_running;
+  CURLMcode mcode;
+};
+
+static void *multi_perform_without_gvl(void *p) {
+  struct multi_perform_without_gvl_args *args = (struct multi_perform_without_gvl_args *)p;
+  do {
+    args->mcode = curl_multi_perform(args->handle, args->still_running);
+  } while (args->mcode == CURLM_CALL_MULTI_PERFORM && !rb_curl_easy_transfer_interrupted_p());
+  return NULL;
+}
+
+static VALUE rb_curl_multi_transfer_without_gvl_ensure(VALUE argp) {
+  ((ruby_curl_multi *)argp)->transfer_without_gvl = 0;
+  return Qnil;
+}
+
+struct multi_transfer_without_gvl_call {
+  void *(*func)(void *);
+  void *data;
+};
+
+static VALUE rb_curl_multi_transfer_without_gvl_body(VALUE argp) {
+  struct multi_transfer_without_gvl_call *call = (struct multi_transfer_without_gvl_call *)argp;
+  rb_curl_easy_transfer_without_gvl(call->func, call->data, RUBY_UBF_IO, NULL);
+  return Qnil;
 }
 
+/* Run +func+ without the GVL, refusing add/remove/close until it returns. */
+static void rb_curl_multi_transfer_without_gvl(ruby_curl_multi *rbcm, void *(*func)(void *), void *data) {
+  struct multi_transfer_without_gvl_call call = { func, data };
+  rbcm->transfer_without_gvl = 1;
+  rb_ensure(rb_curl_multi_transfer_without_gvl_body, (VALUE)&call, rb_curl_multi_transfer_without_gvl_ensure, (VALUE)rbcm);
+}
+#endif
+
 /* called within ruby_curl_multi_perform */
 static void rb_curl_multi_run(VALUE self, CURLM *multi_handle, int *still_running) {
   CURLMcode mcode;
+#ifdef CURB_HAVE_TRANSFER_WITHOUT_GVL
+  ruby_curl_multi *rbcm;
+
+  TypedData_Get_Struct(self, ruby_curl_multi, &ruby_curl_multi_data_type, rbcm);
+  if (rbcm->release_gvl) {
+    struct multi_perform_without_gvl_args args = { multi_handle, still_running, CURLM_OK };
+    rb_curl_multi_transfer_without_gvl(rbcm, multi_perform_without_gvl, &args);
+    if (args.mcode != CURLM_OK && args.mcode != CURLM_CALL_MULTI_PERFORM) {
+      raise_curl_multi_error_exception(args.mcode);
+    }
+    return;
+  }
+#endif
 
   /*
    * curl_multi_perform will return CURLM_CALL_MULTI_PERFORM only when it wants to be called again immediately.
@@ -1248,8 +3255,24 @@ typedef struct {
   st_table *sock_map;     /* key: int fd, value: int 'what' (CURL_POLL_*) */
   long long timeout_deadline_ms; /* absolute deadline for CURL_SOCKET_TIMEOUT */
   VALUE io_cache;         /* fd -> IO wrapper for fiber-scheduler waits */
+  int epfd;               /* epoll instance mirroring sock_map, or -1 */
+  unsigned long *syscalls; /* the multi's stats.event_syscalls */
+  int wake_fd;            /* the multi's wakeup descriptor, watched by every wait, or -1 */
+  char woken;             /* a wait consumed a wakeup the GVL-free drive must return for */
+#ifdef CURB_HAVE_IO_URING
+  curb_uring *uring;      /* io_uring instance with a poll armed per sock_map entry, or NULL */
+  st_table *uring_polls;  /* fd -> generation of its armed poll */
+  uint32_t uring_gen;
+  int uring_err;          /* errno of the first SQE that could not be queued */
+#endif
 } multi_socket_ctx;
 
+#ifdef CURB_HAVE_IO_URING
+#define multi_socket_event_set_p(ctx) ((ctx)->epfd >= 0 || (ctx)->uring)
+#else
+#define multi_socket_event_set_p(ctx) ((ctx)->epfd >= 0)
+#endif
+
 static long long multi_socket_current_time_ms(void) {
 #if defined(CLOCK_MONOTONIC)
   struct timespec ts;
@@ -1354,6 +3377,82 @@ static int multi_socket_fd_valid_p(int fd) {
   return fcntl(fd, F_GETFD) != -1 || errno != EBADF;
 }
 
+#ifdef CURB_HAVE_EPOLL
+/* Keep the epoll interest list in step with libcurl's socket callback so the
+ * wait never has to rebuild descriptor sets. */
+static void multi_socket_epoll_update(multi_socket_ctx *ctx, int fd, int what, int tracked) {
+  struct epoll_event ev;
+
+  if (ctx->epfd < 0) return;
+  (*ctx->syscalls)++;
+
+  if (what == CURL_POLL_REMOVE) {
+    /* libcurl may already have closed the descriptor, which drops it from
+     * the interest list on its own. */
+    epoll_ctl(ctx->epfd, EPOLL_CTL_DEL, fd, NULL);
+    return;
+  }
+
+  memset(&ev, 0, sizeof(ev));
+  if (what == CURL_POLL_IN || what == CURL_POLL_INOUT) ev.events |= EPOLLIN;
+  if (what == CURL_POLL_OUT || what == CURL_POLL_INOUT) ev.events |= EPOLLOUT;
+  ev.data.fd = fd;
+
+  if (tracked) {
+    if (epoll_ctl(ctx->epfd, EPOLL_CTL_MOD, fd, &ev) == 0 || errno != ENOENT) return;
+    epoll_ctl(ctx->epfd, EPOLL_CTL_ADD, fd, &ev);
+  } else if (epoll_ctl(ctx->epfd, EPOLL_CTL_ADD, fd, &ev) != 0 && errno == EEXIST) {
+    /* A recycled descriptor number that was never reported as removed. */
+    epoll_ctl(ctx->epfd, EPOLL_CTL_MOD, fd, &ev);
+  }
+}
+#endif
+
+#ifdef CURB_HAVE_IO_URING
+#include <poll.h>
+
+#define CURB_URING_ENTRIES 256
+#define CURB_URING_TIMEOUT_DATA UINT64_MAX
+#ifndef IORING_CQE_F_MORE
+#define IORING_CQE_F_MORE 0
+#endif
+
+/* Poll completions carry the socket and the generation of the poll request,
+ * so completions of polls since removed or replaced are recognised. */
+static uint64_t multi_socket_uring_data(int fd, uint32_t gen) {
+  return ((uint64_t)gen << 32) | (uint32_t)fd;
+}
+
+static void multi_socket_uring_arm(multi_socket_ctx *ctx, int fd, int what) {
+  unsigned mask = 0;
+  int rc;
+
+  if (what == CURL_POLL_IN || what == CURL_POLL_INOUT) mask |= POLLIN;
+  if (what == CURL_POLL_OUT || what == CURL_POLL_INOUT) mask |= POLLOUT;
+  if (++ctx->uring_gen == 0) ctx->uring_gen = 1;
+
+  rc = curb_uring_poll_add(ctx->uring, fd, mask, multi_socket_uring_data(fd, ctx->uring_gen));
+  if (rc < 0) {
+    if (!ctx->uring_err) ctx->uring_err = -rc;
+    return;
+  }
+  st_insert(ctx->uring_polls, (st_data_t)fd, (st_data_t)ctx->uring_gen);
+}
+
+/* The io_uring counterpart of multi_socket_epoll_update: replace the poll
+ * armed for fd. Nothing reaches the kernel until the next wait. */
+static void multi_socket_uring_update(multi_socket_ctx *ctx, int fd, int what) {
+  st_data_t key = (st_data_t)fd;
+  st_data_t gen;
+
+  if (st_delete(ctx->uring_polls, &key, &gen)) {
+    int rc = curb_uring_poll_remove(ctx->uring, multi_socket_uring_data(fd, (uint32_t)gen));
+    if (rc < 0 && !ctx->uring_err) ctx->uring_err = -rc;
+  }
+  if (what != CURL_POLL_REMOVE) multi_socket_uring_arm(ctx, fd, what);
+}
+#endif
+
 static int multi_socket_cb(CURL *easy, curl_socket_t s, int what, void *userp, void *socketp) {
   multi_socket_ctx *ctx = (multi_socket_ctx *)userp;
   (void)easy; (void)socketp;
@@ -1363,6 +3462,12 @@ static int multi_socket_cb(CURL *easy, curl_socket_t s, int what, void *userp, v
   if (fd < 0) return 0;
 
   if (what == CURL_POLL_REMOVE) {
+#ifdef CURB_HAVE_EPOLL
+    multi_socket_epoll_update(ctx, fd, what, 1);
+#endif
+#ifdef CURB_HAVE_IO_URING
+    if (ctx->uring) multi_socket_uring_update(ctx, fd, what);
+#endif
     multi_socket_forget_fd(ctx, fd);
 #if CURB_SOCKET_DEBUG
     {
@@ -1374,10 +3479,21 @@ static int multi_socket_cb(CURL *easy, curl_socket_t s, int what, void *userp, v
     /* store current interest mask for this fd */
     st_data_t key = (st_data_t)fd;
     st_data_t old_what;
-    if (st_lookup(ctx->sock_map, key, &old_what) && (int)old_what != what && !NIL_P(ctx->io_cache)) {
+    int tracked = st_lookup(ctx->sock_map, key, &old_what);
+    if (tracked && (int)old_what != what && !NIL_P(ctx->io_cache)) {
       rb_hash_delete(ctx->io_cache, INT2NUM(fd));
     }
+#ifdef CURB_HAVE_EPOLL
+    if (!tracked || (int)old_what != what) {
+      multi_socket_epoll_update(ctx, fd, what, tracked);
+    }
+#endif
     st_insert(ctx->sock_map, (st_data_t)fd, (st_data_t)what);
+#ifdef CURB_HAVE_IO_URING
+    if (ctx->uring && (!tracked || (int)old_what != what)) {
+      multi_socket_uring_update(ctx, fd, what);
+    }
+#endif
 #if CURB_SOCKET_DEBUG
     {
       char b[16];
@@ -1505,57 +3621,390 @@ static int build_io_select_arrays_i(st_data_t key, st_data_t val, st_data_t argp
   int io_state = 0;
   VALUE io;
 
-  if (!multi_socket_fd_valid_p(fd)) {
-    a->failed = 1;
-    return ST_STOP;
-  }
+  if (!multi_socket_fd_valid_p(fd)) {
+    a->failed = 1;
+    return ST_STOP;
+  }
+
+  io = rb_protect(multi_socket_io_for_fd_protected, (VALUE)&io_args, &io_state);
+  if (io_state || NIL_P(io)) {
+    if (io_state) {
+      a->state = io_state;
+    }
+    a->failed = 1;
+    return ST_STOP;
+  }
+
+  if (what == CURL_POLL_IN || what == CURL_POLL_INOUT) rb_ary_push(a->readables, io);
+  if (what == CURL_POLL_OUT || what == CURL_POLL_INOUT) rb_ary_push(a->writables, io);
+  rb_ary_push(a->exceptables, io);
+
+  return ST_CONTINUE;
+}
+
+struct collect_io_select_ready_args {
+  multi_socket_ctx *ctx;
+  VALUE readables;
+  VALUE writables;
+  VALUE exceptables;
+  struct ready_fd *fds;
+  int capacity;
+  int count;
+};
+
+static int collect_io_select_ready_i(st_data_t key, st_data_t val, st_data_t argp) {
+  (void)val;
+  struct collect_io_select_ready_args *a = (struct collect_io_select_ready_args *)argp;
+  VALUE io = rb_hash_aref(a->ctx->io_cache, INT2NUM((int)key));
+  int flags = 0;
+
+  if (NIL_P(io)) return ST_CONTINUE;
+  if (RTEST(rb_ary_includes(a->readables, io))) flags |= CURL_CSELECT_IN;
+  if (RTEST(rb_ary_includes(a->writables, io))) flags |= CURL_CSELECT_OUT;
+  if (RTEST(rb_ary_includes(a->exceptables, io))) flags |= CURL_CSELECT_ERR;
+
+  if (flags && a->count < a->capacity) {
+    a->fds[a->count].fd = (int)key;
+    a->fds[a->count].flags = flags;
+    a->count++;
+  }
+
+  return ST_CONTINUE;
+}
+#endif
+
+#ifdef CURB_HAVE_EPOLL
+#define CURB_EPOLL_MAX_EVENTS 256
+
+struct multi_epoll_wait_args {
+  int epfd;
+  struct epoll_event *events;
+  int maxevents;
+  int timeout_ms;
+  int rc;
+  int err;
+};
+
+static void *multi_epoll_wait_without_gvl(void *p) {
+  struct multi_epoll_wait_args *a = (struct multi_epoll_wait_args *)p;
+  a->rc = epoll_wait(a->epfd, a->events, a->maxevents, a->timeout_ms);
+  a->err = a->rc < 0 ? errno : 0;
+  return NULL;
+}
+
+static int multi_socket_cselect_flags_for_epoll_events(uint32_t events) {
+  int flags = 0;
+
+  if (events & EPOLLIN) flags |= CURL_CSELECT_IN;
+  if (events & EPOLLOUT) flags |= CURL_CSELECT_OUT;
+  if (events & (EPOLLERR | EPOLLHUP)) flags |= CURL_CSELECT_ERR;
+
+  return flags;
+}
+
+/*
+ * Wait on the epoll set with the GVL released and feed every ready
+ * descriptor to libcurl. Registration happens incrementally in
+ * multi_socket_cb, so each tick costs O(ready) instead of O(tracked).
+ */
+static void multi_socket_epoll_wait(ruby_curl_multi *rbcm, multi_socket_ctx *ctx, long wait_ms) {
+  struct epoll_event events[CURB_EPOLL_MAX_EVENTS];
+  struct multi_epoll_wait_args args;
+  CURLMcode mrc;
+  int i;
+
+  args.epfd = ctx->epfd;
+  args.events = events;
+  args.maxevents = CURB_EPOLL_MAX_EVENTS;
+  args.timeout_ms = (int)wait_ms;
+  args.rc = 0;
+  args.err = 0;
+
+  (*ctx->syscalls)++;
+  rbcm->waiting = 1;
+  rb_thread_call_without_gvl(multi_epoll_wait_without_gvl, &args, RUBY_UBF_IO, NULL);
+  rbcm->waiting = 0;
+  curb_debugf("[curb.socket] epoll_wait rc=%d timeout_ms=%ld", args.rc, wait_ms);
+
+  if (args.rc < 0) {
+    if (args.err != EINTR) rb_raise(rb_eRuntimeError, "epoll_wait(): %s", strerror(args.err));
+    return;
+  }
+
+  for (i = 0; i < args.rc; i++) {
+    int flags = multi_socket_cselect_flags_for_epoll_events(events[i].events);
+    if (events[i].data.fd == ctx->wake_fd) {
+      rb_curl_multi_wakeup_drain(rbcm);
+      continue;
+    }
+    mrc = curl_multi_socket_action(rbcm->handle, (curl_socket_t)events[i].data.fd, flags, &rbcm->running);
+    if (mrc != CURLM_OK) raise_curl_multi_error_exception(mrc);
+  }
+
+  /* Without tracked sockets (e.g. threaded DNS in flight) libcurl still
+   * expects to be driven after the wait, matching the select path. */
+  if ((args.rc == 0 && multi_socket_timer_due(ctx)) || ctx->sock_map->num_entries == 0) {
+    ctx->timeout_deadline_ms = -1;
+    mrc = curl_multi_socket_action(rbcm->handle, CURL_SOCKET_TIMEOUT, 0, &rbcm->running);
+    curb_debugf("[curb.socket] socket_action timeout -> mrc=%d running=%d", mrc, rbcm->running);
+    if (mrc != CURLM_OK) raise_curl_multi_error_exception(mrc);
+  }
+}
+
+#ifdef CURB_HAVE_IO_URING
+static int multi_socket_cselect_flags_for_poll_revents(int revents) {
+  int flags = 0;
+
+  if (revents & POLLIN) flags |= CURL_CSELECT_IN;
+  if (revents & POLLOUT) flags |= CURL_CSELECT_OUT;
+  if (revents & (POLLERR | POLLHUP | POLLNVAL)) flags |= CURL_CSELECT_ERR;
+
+  return flags;
+}
+
+/* Errors of io_uring_enter after which the completion queue is still worth
+ * reaping: a signal, or the kernel asking us to drain completions first. */
+static int multi_socket_uring_transient_p(int rc) {
+  return rc == -EINTR || rc == -EAGAIN || rc == -EBUSY;
+}
+
+/*
+ * Feed every poll completion to libcurl. Runs with or without the GVL: it
+ * only touches the st tables and the ring. A one-shot poll (or a multishot
+ * poll the kernel ended) is re-armed once libcurl has acted, if the socket is
+ * still tracked and multi_socket_cb did not replace it meanwhile.
+ */
+static int multi_socket_uring_reap(ruby_curl_multi *rbcm, multi_socket_ctx *ctx, CURLMcode *mrc) {
+  uint64_t user_data;
+  int res, events = 0;
+  unsigned flags;
+
+  while (curb_uring_next_cqe(ctx->uring, &user_data, &res, &flags)) {
+    int fd = (int)(uint32_t)user_data;
+    int more = (flags & IORING_CQE_F_MORE) != 0;
+    st_data_t key = (st_data_t)fd;
+    st_data_t gen, what;
+
+    if (user_data == 0 || user_data == CURB_URING_TIMEOUT_DATA) continue;
+    if (!st_lookup(ctx->uring_polls, key, &gen) || (uint32_t)gen != (uint32_t)(user_data >> 32)) continue;
+    if (!more) st_delete(ctx->uring_polls, &key, NULL);
+
+    if (fd == ctx->wake_fd) {
+      if (res == -EINVAL && ctx->uring->multishot) {
+        ctx->uring->multishot = 0;
+      } else if (res > 0) {
+        rb_curl_multi_wakeup_drain(rbcm);
+        ctx->woken = 1;
+      }
+      if (!more) multi_socket_uring_arm(ctx, fd, CURL_POLL_IN);
+      continue;
+    }
+
+    if (res == -EINVAL && ctx->uring->multishot) {
+      /* Kernels before 5.13 reject multishot polls: arm one-shot polls. */
+      ctx->uring->multishot = 0;
+      if (st_lookup(ctx->sock_map, key, &what)) multi_socket_uring_arm(ctx, fd, (int)what);
+      continue;
+    }
+
+    events++;
+    *mrc = curl_multi_socket_action(rbcm->handle, (curl_socket_t)fd,
+                                    res < 0 ? CURL_CSELECT_ERR : multi_socket_cselect_flags_for_poll_revents(res),
+                                    &rbcm->running);
+    if (*mrc != CURLM_OK) return events;
+
+    if (!more && !st_lookup(ctx->uring_polls, key, NULL) && st_lookup(ctx->sock_map, key, &what)) {
+      multi_socket_uring_arm(ctx, fd, (int)what);
+    }
+  }
+
+  return events;
+}
+
+struct multi_uring_wait_args {
+  curb_uring *ring;
+  long timeout_ms;
+  int rc;
+};
+
+static void *multi_uring_wait_without_gvl(void *p) {
+  struct multi_uring_wait_args *a = (struct multi_uring_wait_args *)p;
+  a->rc = curb_uring_submit_and_wait(a->ring, a->timeout_ms, CURB_URING_TIMEOUT_DATA);
+  return NULL;
+}
+
+/*
+ * The io_uring counterpart of multi_socket_epoll_wait: poll changes queued by
+ * multi_socket_cb and the timer are submitted by the same io_uring_enter that
+ * waits, so a tick costs one system call however many sockets changed.
+ */
+static void multi_socket_uring_wait(ruby_curl_multi *rbcm, multi_socket_ctx *ctx, long wait_ms) {
+  struct multi_uring_wait_args args;
+  CURLMcode mrc = CURLM_OK;
+  int events;
+
+  args.ring = ctx->uring;
+  args.timeout_ms = wait_ms;
+  args.rc = 0;
+
+  rbcm->waiting = 1;
+  rb_thread_call_without_gvl(multi_uring_wait_without_gvl, &args, RUBY_UBF_IO, NULL);
+  rbcm->waiting = 0;
+  curb_debugf("[curb.socket] io_uring_enter rc=%d timeout_ms=%ld", args.rc, wait_ms);
+
+  if (args.rc < 0 && !multi_socket_uring_transient_p(args.rc)) {
+    rb_raise(rb_eRuntimeError, "io_uring_enter(): %s", strerror(-args.rc));
+  }
+
+  events = multi_socket_uring_reap(rbcm, ctx, &mrc);
+  ctx->woken = 0;
+  if (mrc != CURLM_OK) raise_curl_multi_error_exception(mrc);
+  if (ctx->uring_err) rb_raise(rb_eRuntimeError, "io_uring poll: %s", strerror(ctx->uring_err));
+
+  if ((events == 0 && multi_socket_timer_due(ctx)) || ctx->sock_map->num_entries == 0) {
+    ctx->timeout_deadline_ms = -1;
+    mrc = curl_multi_socket_action(rbcm->handle, CURL_SOCKET_TIMEOUT, 0, &rbcm->running);
+    curb_debugf("[curb.socket] socket_action timeout -> mrc=%d running=%d", mrc, rbcm->running);
+    if (mrc != CURLM_OK) raise_curl_multi_error_exception(mrc);
+  }
+}
+#endif
+
+#ifdef CURB_HAVE_TRANSFER_WITHOUT_GVL
+struct multi_epoll_drive_args {
+  ruby_curl_multi *rbcm;
+  multi_socket_ctx *ctx;
+  long budget_ms;
+  int single_pass;
+  CURLMcode mrc;
+  int err;
+};
+
+/*
+ * Runs without the GVL: wait, act on ready sockets and expired timers, and
+ * keep going until every transfer finished, the budget is spent or Ruby needs
+ * the thread back. Completions collected meanwhile are then handled as one
+ * batch with the GVL held, so a busy process pays for one GVL handoff per
+ * budget rather than one per finished transfer.
+ */
+static void *multi_epoll_drive_without_gvl(void *p) {
+  struct multi_epoll_drive_args *a = (struct multi_epoll_drive_args *)p;
+  multi_socket_ctx *ctx = a->ctx;
+  struct epoll_event events[CURB_EPOLL_MAX_EVENTS];
+  long long started_ms = multi_socket_current_time_ms();
+  int rc, i;
+
+  for (;;) {
+    long long remaining_ms = a->budget_ms - (multi_socket_current_time_ms() - started_ms);
+    long wait_ms = remaining_ms < 0 ? 0 : (long)remaining_ms;
 
-  io = rb_protect(multi_socket_io_for_fd_protected, (VALUE)&io_args, &io_state);
-  if (io_state || NIL_P(io)) {
-    if (io_state) {
-      a->state = io_state;
+    if (ctx->timeout_deadline_ms >= 0) {
+      long long timer_ms = ctx->timeout_deadline_ms - multi_socket_current_time_ms();
+      if (timer_ms < wait_ms) wait_ms = timer_ms < 0 ? 0 : (long)timer_ms;
     }
-    a->failed = 1;
-    return ST_STOP;
-  }
 
-  if (what == CURL_POLL_IN || what == CURL_POLL_INOUT) rb_ary_push(a->readables, io);
-  if (what == CURL_POLL_OUT || what == CURL_POLL_INOUT) rb_ary_push(a->writables, io);
-  rb_ary_push(a->exceptables, io);
+#ifdef CURB_HAVE_IO_URING
+    if (ctx->uring) {
+      rc = curb_uring_submit_and_wait(ctx->uring, wait_ms, CURB_URING_TIMEOUT_DATA);
+      if (rc < 0 && !multi_socket_uring_transient_p(rc)) {
+        a->err = -rc;
+        return NULL;
+      }
+      multi_socket_uring_reap(a->rbcm, ctx, &a->mrc);
+      if (a->mrc != CURLM_OK) return NULL;
+      if (ctx->uring_err) {
+        a->err = ctx->uring_err;
+        return NULL;
+      }
+    } else
+#endif
+    {
+      (*ctx->syscalls)++;
+      rc = epoll_wait(ctx->epfd, events, CURB_EPOLL_MAX_EVENTS, (int)wait_ms);
+      if (rc < 0) {
+        a->err = errno;
+        return NULL;
+      }
 
-  return ST_CONTINUE;
+      for (i = 0; i < rc; i++) {
+        int flags = multi_socket_cselect_flags_for_epoll_events(events[i].events);
+        if (events[i].data.fd == ctx->wake_fd) {
+          rb_curl_multi_wakeup_drain(a->rbcm);
+          ctx->woken = 1;
+          continue;
+        }
+        a->mrc = curl_multi_socket_action(a->rbcm->handle, (curl_socket_t)events[i].data.fd, flags, &a->rbcm->running);
+        if (a->mrc != CURLM_OK) return NULL;
+      }
+    }
+
+    if (multi_socket_timer_due(ctx) || ctx->sock_map->num_entries == 0) {
+      ctx->timeout_deadline_ms = -1;
+      a->mrc = curl_multi_socket_action(a->rbcm->handle, CURL_SOCKET_TIMEOUT, 0, &a->rbcm->running);
+      if (a->mrc != CURLM_OK) return NULL;
+    }
+
+    if (a->single_pass || rb_curl_easy_transfer_interrupted_p()) return NULL;
+    if (rb_curl_multi_limit_reached_p(a->rbcm)) return NULL;
+    /* Work was enqueued meanwhile: Ruby has to admit it. */
+    if (ctx->woken) {
+      ctx->woken = 0;
+      return NULL;
+    }
+    if (a->rbcm->running == 0) return NULL;
+    /* A transfer finished and queued work could take its slot: go back and
+     * reap it so admission does not wait out the rest of the budget. */
+    if (a->rbcm->queued && a->rbcm->queued->num_entries > 0 && a->rbcm->running < a->rbcm->active) return NULL;
+    if (multi_socket_current_time_ms() - started_ms >= a->budget_ms) return NULL;
+  }
 }
 
-struct collect_io_select_ready_args {
-  multi_socket_ctx *ctx;
-  VALUE readables;
-  VALUE writables;
-  VALUE exceptables;
-  struct ready_fd *fds;
-  int capacity;
-  int count;
-};
+static void multi_socket_epoll_drive_without_gvl(ruby_curl_multi *rbcm, multi_socket_ctx *ctx, long budget_ms, int single_pass) {
+  struct multi_epoll_drive_args args;
 
-static int collect_io_select_ready_i(st_data_t key, st_data_t val, st_data_t argp) {
-  (void)val;
-  struct collect_io_select_ready_args *a = (struct collect_io_select_ready_args *)argp;
-  VALUE io = rb_hash_aref(a->ctx->io_cache, INT2NUM((int)key));
-  int flags = 0;
+  args.rbcm = rbcm;
+  args.ctx = ctx;
+  args.budget_ms = budget_ms;
+  args.single_pass = single_pass;
+  args.mrc = CURLM_OK;
+  args.err = 0;
 
-  if (NIL_P(io)) return ST_CONTINUE;
-  if (RTEST(rb_ary_includes(a->readables, io))) flags |= CURL_CSELECT_IN;
-  if (RTEST(rb_ary_includes(a->writables, io))) flags |= CURL_CSELECT_OUT;
-  if (RTEST(rb_ary_includes(a->exceptables, io))) flags |= CURL_CSELECT_ERR;
+  rb_curl_multi_transfer_without_gvl(rbcm, multi_epoll_drive_without_gvl, &args);
+  if (args.err && args.err != EINTR) {
+    rb_raise(rb_eRuntimeError, "%s: %s", ctx->epfd >= 0 ? "epoll_wait()" : "io_uring_enter()", strerror(args.err));
+  }
+  if (args.mrc != CURLM_OK) raise_curl_multi_error_exception(args.mrc);
+}
+#endif
+#endif
 
-  if (flags && a->count < a->capacity) {
-    a->fds[a->count].fd = (int)key;
-    a->fds[a->count].flags = flags;
-    a->count++;
+/* Sleep up to +tv+ while libcurl exposes no socket, ending early when an
+ * add or enqueue from elsewhere wakes the perform. */
+static void multi_socket_idle_wait(ruby_curl_multi *rbcm, multi_socket_ctx *ctx, struct timeval *tv) {
+  VALUE scheduler;
+  int woken;
+
+  if (ctx->wake_fd < 0) {
+    curb_multi_scheduler_sleep(tv);
+    return;
   }
 
-  return ST_CONTINUE;
+  scheduler = curb_fiber_scheduler_current();
+  if (scheduler != Qnil) {
+    VALUE io = multi_socket_io_for_fd(ctx, ctx->wake_fd, CURL_POLL_IN);
+    double timeout_s = (double)tv->tv_sec + ((double)tv->tv_usec / 1e6);
+    VALUE ready = curb_fiber_scheduler_io_wait(scheduler, io, INT2NUM(RB_WAITFD_IN), rb_float_new(timeout_s));
+    woken = ready != Qfalse && !NIL_P(ready);
+  } else {
+    rb_fdset_t rfds;
+    rb_fd_init(&rfds);
+    rb_fd_set(ctx->wake_fd, &rfds);
+    rbcm->stats.event_syscalls++;
+    woken = rb_thread_fd_select(ctx->wake_fd + 1, &rfds, NULL, NULL, tv) > 0;
+    rb_fd_term(&rfds);
+  }
+  if (woken) rb_curl_multi_wakeup_drain(rbcm);
 }
-#endif
 
 static void rb_curl_multi_socket_drive(VALUE self, ruby_curl_multi *rbcm, multi_socket_ctx *ctx, VALUE block) {
   CURLMcode mrc;
@@ -1568,9 +4017,21 @@ static void rb_curl_multi_socket_drive(VALUE self, ruby_curl_multi *rbcm, multi_
     rb_curl_multi_read_info(self, rbcm->handle);
     rb_curl_multi_yield_if_given(self, block);
 
-    while (rbcm->running) {
+    while (rb_curl_multi_busy_p(rbcm) && !rb_curl_multi_stop_if_limited(self, rbcm)) {
     struct timeval tv = {0, 0};
-    long wait_ms = curb_multi_default_timeout();
+    long wait_ms = rb_curl_multi_timer_wait_ms(rbcm, curb_multi_default_timeout());
+
+#if defined(CURB_HAVE_EPOLL) && defined(CURB_HAVE_TRANSFER_WITHOUT_GVL)
+    if (multi_socket_event_set_p(ctx) && rbcm->release_gvl) {
+      /* A block must be yielded to every tick; otherwise stay out of Ruby
+       * until the batch drains or the default timeout elapses. */
+      multi_socket_epoll_drive_without_gvl(rbcm, ctx, wait_ms, !NIL_P(block));
+      rb_curl_multi_admit_queued(self, rbcm);
+      rb_curl_multi_read_info(self, rbcm->handle);
+      rb_curl_multi_yield_if_given(self, block);
+      continue;
+    }
+#endif
 
     if (multi_socket_timer_due(ctx)) {
       ctx->timeout_deadline_ms = -1;
@@ -1590,6 +4051,23 @@ static void rb_curl_multi_socket_drive(VALUE self, ruby_curl_multi *rbcm, multi_
       long long remaining_ms = ctx->timeout_deadline_ms - multi_socket_current_time_ms();
       if (remaining_ms < wait_ms) wait_ms = remaining_ms < 0 ? 0 : (long)remaining_ms;
     }
+#ifdef CURB_HAVE_IO_URING
+    if (ctx->uring) {
+      multi_socket_uring_wait(rbcm, ctx, wait_ms);
+      rb_curl_multi_read_info(self, rbcm->handle);
+      rb_curl_multi_yield_if_given(self, block);
+      continue;
+    }
+#endif
+#ifdef CURB_HAVE_EPOLL
+    if (ctx->epfd >= 0) {
+      multi_socket_epoll_wait(rbcm, ctx, wait_ms);
+      rb_curl_multi_read_info(self, rbcm->handle);
+      rb_curl_multi_yield_if_given(self, block);
+      continue;
+    }
+#endif
+
     tv.tv_sec = wait_ms / 1000;
     tv.tv_usec = (wait_ms % 1000) * 1000;
 
@@ -1617,7 +4095,10 @@ static void rb_curl_multi_socket_drive(VALUE self, ruby_curl_multi *rbcm, multi_
     int ready_flags = 0;
 
 	    int handled_wait = 0;
-	    if (count_tracked > 1) {
+	    /* The wakeup descriptor makes even one socket a set. */
+	    int set_wait = count_tracked > 1 || (count_tracked == 1 && ctx->wake_fd >= 0);
+	    rbcm->waiting = 1;
+	    if (set_wait) {
 #if defined(HAVE_RB_FIBER_SCHEDULER_IO_SELECT) && defined(HAVE_RB_FIBER_SCHEDULER_CURRENT)
 	      {
 	        VALUE scheduler = curb_fiber_scheduler_current();
@@ -1626,8 +4107,13 @@ static void rb_curl_multi_socket_drive(VALUE self, ruby_curl_multi *rbcm, multi_
 	          VALUE writables = rb_ary_new();
 	          VALUE exceptables = rb_ary_new();
 	          struct build_io_select_arrays_args build_args = { ctx, readables, writables, exceptables, 0, 0 };
+	          VALUE wake_io = Qnil;
 	          st_foreach(ctx->sock_map, build_io_select_arrays_i, (st_data_t)&build_args);
 	          if (build_args.state) rb_jump_tag(build_args.state);
+	          if (!build_args.failed && ctx->wake_fd >= 0) {
+	            wake_io = multi_socket_io_for_fd(ctx, ctx->wake_fd, CURL_POLL_IN);
+	            rb_ary_push(readables, wake_io);
+	          }
 	          if (!build_args.failed) {
 	            double timeout_s = (double)tv.tv_sec + ((double)tv.tv_usec / 1e6);
 	            VALUE timeout = rb_float_new(timeout_s);
@@ -1652,6 +4138,9 @@ static void rb_curl_multi_socket_drive(VALUE self, ruby_curl_multi *rbcm, multi_
 	                if (!RB_TYPE_P(ready_readables, T_ARRAY)) ready_readables = rb_ary_new();
 	                if (!RB_TYPE_P(ready_writables, T_ARRAY)) ready_writables = rb_ary_new();
 	                if (!RB_TYPE_P(ready_exceptables, T_ARRAY)) ready_exceptables = rb_ary_new();
+	                if (!NIL_P(wake_io) && RTEST(rb_ary_includes(ready_readables, wake_io))) {
+	                  rb_curl_multi_wakeup_drain(rbcm);
+	                }
 	                d.ctx = ctx;
 	                d.readables = ready_readables;
 	                d.writables = ready_writables;
@@ -1710,6 +4199,11 @@ static void rb_curl_multi_socket_drive(VALUE self, ruby_curl_multi *rbcm, multi_
 	        rb_fd_init(&rfds); rb_fd_init(&wfds); rb_fd_init(&efds);
 	        int maxfd = -1;
 	        rb_fdset_from_sockmap(ctx->sock_map, &rfds, &wfds, &efds, &maxfd);
+	        if (ctx->wake_fd >= 0) {
+	          rb_fd_set(ctx->wake_fd, &rfds);
+	          if (ctx->wake_fd > maxfd) maxfd = ctx->wake_fd;
+	        }
+	        rbcm->stats.event_syscalls++;
 	        int rc = rb_thread_fd_select(maxfd + 1, &rfds, &wfds, &efds, &tv);
 	        curb_debugf("[curb.socket] rb_thread_fd_select(multi) rc=%d maxfd=%d", rc, maxfd);
 	        if (rc < 0) {
@@ -1717,6 +4211,9 @@ static void rb_curl_multi_socket_drive(VALUE self, ruby_curl_multi *rbcm, multi_
 	          if (errno != EINTR) rb_raise(rb_eRuntimeError, "select(): %s", strerror(errno));
 	          continue;
 	        }
+	        if (rc > 0 && ctx->wake_fd >= 0 && rb_fd_isset(ctx->wake_fd, &rfds)) {
+	          rb_curl_multi_wakeup_drain(rbcm);
+	        }
 	        any_ready = (rc > 0);
 	        did_timeout = (rc == 0 && multi_socket_timer_due(ctx));
 	        if (any_ready) {
@@ -1797,6 +4294,7 @@ static void rb_curl_multi_socket_drive(VALUE self, ruby_curl_multi *rbcm, multi_
 #if defined(HAVE_RB_WAIT_FOR_SINGLE_FD)
       if (!handled_wait && wait_fd >= 0) {
         int ev = multi_socket_wait_events_for_curl_poll(wait_what);
+        rbcm->stats.event_syscalls++;
         int rc = rb_wait_for_single_fd(wait_fd, ev, &tv);
         curb_debugf("[curb.socket] rb_wait_for_single_fd rc=%d fd=%d ev=%d", rc, wait_fd, ev);
         if (rc < 0) {
@@ -1820,6 +4318,7 @@ static void rb_curl_multi_socket_drive(VALUE self, ruby_curl_multi *rbcm, multi_
           rb_fd_set(wait_fd, &efds);
           maxfd = wait_fd;
         }
+        rbcm->stats.event_syscalls++;
         int rc = rb_thread_fd_select(maxfd + 1, &rfds, &wfds, &efds, &tv);
         curb_debugf("[curb.socket] rb_thread_fd_select(single) rc=%d fd=%d", rc, wait_fd);
         if (rc < 0) {
@@ -1840,20 +4339,21 @@ static void rb_curl_multi_socket_drive(VALUE self, ruby_curl_multi *rbcm, multi_
       /* No sockets exposed yet (e.g. libcurl's threaded resolver doing DNS):
        * sleep via the scheduler's kernel_sleep when one is active so sibling
        * fibers keep running, otherwise a plain thread wait. */
-      curb_multi_scheduler_sleep(&tv);
+      multi_socket_idle_wait(rbcm, ctx, &tv);
       /* libcurl can report active work without a socket callback or deadline;
        * drive the timeout socket after the sleep so the state machine does
        * not stall indefinitely. */
       did_timeout = 1;
     }
 
+    rbcm->waiting = 0;
     if (did_timeout) {
       ctx->timeout_deadline_ms = -1;
       mrc = curl_multi_socket_action(rbcm->handle, CURL_SOCKET_TIMEOUT, 0, &rbcm->running);
       curb_debugf("[curb.socket] socket_action timeout -> mrc=%d running=%d", mrc, rbcm->running);
       if (mrc != CURLM_OK) raise_curl_multi_error_exception(mrc);
     } else if (any_ready) {
-      if (count_tracked == 1 && wait_fd >= 0) {
+      if (!set_wait && wait_fd >= 0) {
         int flags = ready_flags;
         if (flags == 0) flags = multi_socket_cselect_flags_for_curl_poll(wait_what);
 #if CURB_SOCKET_DEBUG
@@ -1877,7 +4377,7 @@ static void rb_curl_multi_socket_drive(VALUE self, ruby_curl_multi *rbcm, multi_
      * and work queued from that yield is driven before perform returns. */
     rb_curl_multi_read_info(self, rbcm->handle);
     rb_curl_multi_yield_if_given(self, block);
-  } while (rbcm->running);
+  } while (rb_curl_multi_busy_p(rbcm) && !rb_curl_multi_stop_if_limited(self, rbcm));
 }
 
 struct socket_drive_args { VALUE self; ruby_curl_multi *rbcm; multi_socket_ctx *ctx; VALUE block; };
@@ -1899,6 +4399,20 @@ static VALUE ruby_curl_multi_socket_drive_ensure(VALUE argp) {
     st_free_table(c->ctx->sock_map);
     c->ctx->sock_map = NULL;
   }
+#ifdef CURB_HAVE_EPOLL
+  if (c->ctx && c->ctx->epfd >= 0) {
+    close(c->ctx->epfd);
+    c->ctx->epfd = -1;
+  }
+#endif
+#ifdef CURB_HAVE_IO_URING
+  if (c->ctx && c->ctx->uring) {
+    curb_uring_close(c->ctx->uring);
+    c->ctx->uring = NULL;
+    st_free_table(c->ctx->uring_polls);
+    c->ctx->uring_polls = NULL;
+  }
+#endif
   if (c->ctx) {
     if (!NIL_P(c->ctx->io_cache)) {
       rb_hash_clear(c->ctx->io_cache);
@@ -1923,10 +4437,54 @@ static VALUE ruby_curl_multi_socket_perform_impl(int argc, VALUE *argv, VALUE se
   }
 
   multi_socket_ctx ctx;
+#ifdef CURB_HAVE_IO_URING
+  curb_uring uring;
+#endif
   ctx.sock_map = st_init_numtable();
   ctx.timeout_deadline_ms = -1;
-  ctx.io_cache = rb_hash_new();
-  rb_ivar_set(self, id_socket_io_cache_ivar, ctx.io_cache);
+  ctx.io_cache = Qnil;
+  ctx.epfd = -1;
+  ctx.syscalls = &rbcm->stats.event_syscalls;
+  ctx.wake_fd = rbcm->wake_fds[0];
+  ctx.woken = 0;
+  rbcm->event_backend_used = CURB_MULTI_EVENT_BACKEND_SELECT;
+#ifdef CURB_HAVE_IO_URING
+  ctx.uring = NULL;
+  ctx.uring_polls = NULL;
+  ctx.uring_gen = 0;
+  ctx.uring_err = 0;
+#endif
+#ifdef CURB_HAVE_EPOLL
+  /* Scheduler waits go through io_wait/io_select; epoll only replaces the
+   * thread-level select. Fall back to epoll, then select, if the kernel
+   * refuses. */
+  if (rbcm->event_backend != CURB_MULTI_EVENT_BACKEND_SELECT && curb_fiber_scheduler_current() == Qnil) {
+#ifdef CURB_HAVE_IO_URING
+    if (rbcm->event_backend == CURB_MULTI_EVENT_BACKEND_IO_URING &&
+        curb_uring_open(&uring, CURB_URING_ENTRIES) == 0) {
+      uring.syscalls = ctx.syscalls;
+      ctx.uring = &uring;
+      ctx.uring_polls = st_init_numtable();
+      rbcm->event_backend_used = CURB_MULTI_EVENT_BACKEND_IO_URING;
+    }
+    if (!ctx.uring)
+#endif
+    ctx.epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (ctx.epfd >= 0) rbcm->event_backend_used = CURB_MULTI_EVENT_BACKEND_EPOLL;
+    if (ctx.wake_fd >= 0) {
+#ifdef CURB_HAVE_IO_URING
+      if (ctx.uring) multi_socket_uring_arm(&ctx, ctx.wake_fd, CURL_POLL_IN);
+#endif
+      if (ctx.epfd >= 0) multi_socket_epoll_update(&ctx, ctx.wake_fd, CURL_POLL_IN, 0);
+    }
+  }
+#endif
+  /* IO wrappers are only needed by the select/scheduler waits; the epoll and
+   * io_uring socket callbacks may run without the GVL and must not touch them. */
+  if (!multi_socket_event_set_p(&ctx)) {
+    ctx.io_cache = rb_hash_new();
+    rb_ivar_set(self, id_socket_io_cache_ivar, ctx.io_cache);
+  }
 
   /* install socket/timer callbacks */
   curl_multi_setopt(rbcm->handle, CURLMOPT_SOCKETFUNCTION, multi_socket_cb);
@@ -1950,6 +4508,265 @@ static VALUE ruby_curl_multi_socket_perform_impl(int argc, VALUE *argv, VALUE se
 }
 #endif /* socket-action implementation */
 
+#if defined(HAVE_CURL_MULTI_SOCKET_ACTION) && defined(HAVE_CURLMOPT_SOCKETFUNCTION) && defined(HAVE_CURLMOPT_TIMERFUNCTION)
+/*
+ * Step API: an outside event loop owns the waiting. libcurl's socket and
+ * timer callbacks are forwarded to the on_socket/on_timer hooks, and the
+ * loop calls back into socket_action/timeout_action when something is due.
+ * Hooks run inside libcurl calls, so anything they raise is held in
+ * step_error and re-raised once the libcurl call has returned.
+ */
+struct step_hook_call_args { VALUE hook; int argc; VALUE argv[2]; };
+
+static VALUE rb_curl_multi_step_hook_call(VALUE argp) {
+  struct step_hook_call_args *a = (struct step_hook_call_args *)argp;
+  return rb_funcallv(a->hook, idCall, a->argc, a->argv);
+}
+
+static void rb_curl_multi_step_call_hook(ruby_curl_multi *rbcm, VALUE hook, int argc, VALUE arg0, VALUE arg1) {
+  struct step_hook_call_args a;
+  int state = 0;
+
+  a.hook = hook;
+  a.argc = argc;
+  a.argv[0] = arg0;
+  a.argv[1] = arg1;
+  rb_protect(rb_curl_multi_step_hook_call, (VALUE)&a, &state);
+  if (state) {
+    if (NIL_P(rbcm->step_error)) rbcm->step_error = rb_errinfo();
+    rb_set_errinfo(Qnil);
+  }
+}
+
+static VALUE rb_curl_multi_step_what_sym(int what) {
+  switch (what) {
+    case CURL_POLL_IN: return ID2SYM(rb_intern("in"));
+    case CURL_POLL_OUT: return ID2SYM(rb_intern("out"));
+    case CURL_POLL_INOUT: return ID2SYM(rb_intern("inout"));
+    default: return ID2SYM(rb_intern("remove"));
+  }
+}
+
+static int multi_step_socket_cb(CURL *easy, curl_socket_t s, int what, void *userp, void *socketp) {
+  ruby_curl_multi *rbcm = (ruby_curl_multi *)userp;
+
+  if (RTEST(rbcm->on_socket)) {
+    rb_curl_multi_step_call_hook(rbcm, rbcm->on_socket, 2, INT2NUM((int)s), rb_curl_multi_step_what_sym(what));
+  }
+  return 0;
+}
+
+/* Tell on_timer about the earlier of libcurl's timeout and curb's own retry,
+ * hedge and deadline timers. Without +force+ only a changed deadline is
+ * reported. */
+static void rb_curl_multi_step_report_timer(ruby_curl_multi *rbcm, int force) {
+  long long now_ms = curb_multi_monotonic_ms();
+  long long deadline_ms;
+  long wait_ms = -1;
+
+  if (!RTEST(rbcm->on_timer)) return;
+  if (rbcm->step_curl_deadline_ms >= 0) {
+    wait_ms = rbcm->step_curl_deadline_ms > now_ms ? (long)(rbcm->step_curl_deadline_ms - now_ms) : 0;
+  }
+  wait_ms = rb_curl_multi_timer_wait_ms(rbcm, wait_ms);
+  deadline_ms = wait_ms < 0 ? -1 : now_ms + wait_ms;
+  if (!force && deadline_ms == rbcm->step_timer_deadline_ms) return;
+
+  rbcm->step_timer_deadline_ms = deadline_ms;
+  rb_curl_multi_step_call_hook(rbcm, rbcm->on_timer, 1, wait_ms < 0 ? Qnil : LONG2NUM(wait_ms), Qnil);
+}
+
+static int multi_step_timer_cb(CURLM *multi, long timeout_ms, void *userp) {
+  ruby_curl_multi *rbcm = (ruby_curl_multi *)userp;
+
+  rbcm->step_curl_deadline_ms = timeout_ms < 0 ? -1 : curb_multi_monotonic_ms() + timeout_ms;
+  rb_curl_multi_step_report_timer(rbcm, 1);
+  return 0;
+}
+
+static void rb_curl_multi_install_step_hooks(ruby_curl_multi *rbcm) {
+  int on_socket = RTEST(rbcm->on_socket), on_timer = RTEST(rbcm->on_timer);
+
+  if (!rbcm->handle) return;
+  curl_multi_setopt(rbcm->handle, CURLMOPT_SOCKETFUNCTION, on_socket ? multi_step_socket_cb : NULL);
+  curl_multi_setopt(rbcm->handle, CURLMOPT_SOCKETDATA, on_socket ? rbcm : NULL);
+  curl_multi_setopt(rbcm->handle, CURLMOPT_TIMERFUNCTION, on_timer ? multi_step_timer_cb : NULL);
+  curl_multi_setopt(rbcm->handle, CURLMOPT_TIMERDATA, on_timer ? rbcm : NULL);
+}
+
+static ruby_curl_multi *rb_curl_multi_step_check(VALUE self) {
+  ruby_curl_multi *rbcm;
+
+  TypedData_Get_Struct(self, ruby_curl_multi, &ruby_curl_multi_data_type, rbcm);
+  if (rbcm->perform_active) {
+    rb_raise(rb_eRuntimeError, "Cannot step a Curl::Multi handle during perform");
+  }
+  ruby_curl_multi_ensure_handle(rbcm);
+  return rbcm;
+}
+
+static VALUE rb_curl_multi_step_set_hook(VALUE self, VALUE *slot, VALUE block) {
+  ruby_curl_multi *rbcm = rb_curl_multi_step_check(self);
+
+  *slot = block;
+  rbcm->step_curl_deadline_ms = -1;
+  rbcm->step_timer_deadline_ms = -1;
+  rb_curl_multi_install_step_hooks(rbcm);
+  return self;
+}
+
+/* Raise whatever a hook raised during the last libcurl call. */
+static void rb_curl_multi_step_raise_hook_error(ruby_curl_multi *rbcm) {
+  VALUE error = rbcm->step_error;
+
+  if (NIL_P(error)) return;
+  rbcm->step_error = Qnil;
+  rb_exc_raise(error);
+}
+
+/* After a socket or timeout action: finish completed transfers (which may
+ * admit queued work and fire due retries and hedges), then re-report the
+ * timer if curb's own deadlines moved it. */
+static VALUE rb_curl_multi_step_finish(VALUE self, ruby_curl_multi *rbcm, CURLMcode mrc) {
+  if (mrc != CURLM_OK) {
+    rbcm->step_error = Qnil;
+    raise_curl_multi_error_exception(mrc);
+  }
+  rb_curl_multi_read_info(self, rbcm->handle);
+  rb_curl_multi_step_report_timer(rbcm, 0);
+  rb_curl_multi_step_raise_hook_error(rbcm);
+  return INT2NUM(rbcm->running);
+}
+
+/*
+ * call-seq:
+ *   multi.on_socket { |fd, what| ... }              => multi
+ *   multi.on_socket                                 => multi
+ *
+ * Register the hook libcurl uses to say which sockets to watch. +what+ is
+ * :in, :out or :inout to (re)register +fd+ for reading and/or writing, or
+ * :remove to stop watching it. Together with #on_timer, #socket_action and
+ * #timeout_action this lets an outside event loop (nio4r, EventMachine, a
+ * hand-rolled epoll) drive the transfers instead of #perform: watch what
+ * on_socket asks for, call socket_action when a socket is ready and
+ * timeout_action when the timer expires.
+ *
+ * Hooks run inside libcurl, so they should only update the loop's interest
+ * set. An exception raised by a hook is re-raised from the next
+ * socket_action or timeout_action. A multi with hooks installed cannot
+ * #perform; call without a block to remove the hook.
+ */
+static VALUE ruby_curl_multi_on_socket(int argc, VALUE *argv, VALUE self) {
+  ruby_curl_multi *rbcm;
+  VALUE block = Qnil;
+
+  rb_scan_args(argc, argv, "0&", &block);
+  TypedData_Get_Struct(self, ruby_curl_multi, &ruby_curl_multi_data_type, rbcm);
+  return rb_curl_multi_step_set_hook(self, &rbcm->on_socket, block);
+}
+
+/*
+ * call-seq:
+ *   multi.on_timer { |ms| ... }                     => multi
+ *   multi.on_timer                                  => multi
+ *
+ * Register the hook that (re)arms the outside loop's single timer: call
+ * #timeout_action once +ms+ milliseconds have passed (0 means right away).
+ * +ms+ is nil when no timer is needed. Each call replaces the previous
+ * timer. It already accounts for retry_policy backoffs, hedge delays and
+ * the libcurl timeouts of the running transfers.
+ */
+static VALUE ruby_curl_multi_on_timer(int argc, VALUE *argv, VALUE self) {
+  ruby_curl_multi *rbcm;
+  VALUE block = Qnil;
+
+  rb_scan_args(argc, argv, "0&", &block);
+  TypedData_Get_Struct(self, ruby_curl_multi, &ruby_curl_multi_data_type, rbcm);
+  return rb_curl_multi_step_set_hook(self, &rbcm->on_timer, block);
+}
+
+static int rb_curl_multi_step_flags(VALUE flags) {
+  if (SYMBOL_P(flags)) {
+    ID id = SYM2ID(flags);
+    if (id == rb_intern("in")) return CURL_CSELECT_IN;
+    if (id == rb_intern("out")) return CURL_CSELECT_OUT;
+    if (id == rb_intern("inout")) return CURL_CSELECT_IN | CURL_CSELECT_OUT;
+    if (id == rb_intern("err")) return CURL_CSELECT_ERR;
+    rb_raise(rb_eArgError, "socket_action flags must be :in, :out, :inout, :err or an Integer");
+  }
+  return NUM2INT(flags);
+}
+
+/*
+ * call-seq:
+ *   multi.socket_action(fd, flags)                  => Integer
+ *   multi.socket_action(io, :in)                    => Integer
+ *
+ * Tell libcurl that +fd+ (an Integer or an IO) is ready. +flags+ is :in,
+ * :out, :inout, :err or a bitmask of Curl::Multi::CSELECT_IN, CSELECT_OUT
+ * and CSELECT_ERR; 0 lets libcurl find out itself. Completed transfers run
+ * their callbacks before this returns. Returns the number of transfers
+ * still running.
+ */
+static VALUE ruby_curl_multi_socket_action(VALUE self, VALUE fd, VALUE flags) {
+  ruby_curl_multi *rbcm = rb_curl_multi_step_check(self);
+  CURLMcode mrc;
+  int sock;
+
+  if (!RB_INTEGER_TYPE_P(fd)) {
+    fd = rb_funcall(rb_io_get_io(fd), rb_intern("fileno"), 0);
+  }
+  sock = NUM2INT(fd);
+  mrc = curl_multi_socket_action(rbcm->handle, (curl_socket_t)sock, rb_curl_multi_step_flags(flags), &rbcm->running);
+  return rb_curl_multi_step_finish(self, rbcm, mrc);
+}
+
+/*
+ * call-seq:
+ *   multi.timeout_action                            => Integer
+ *
+ * Let libcurl act on expired timeouts, and start retries and hedges that
+ * are due. Call it when the on_timer timer fires, and once after adding
+ * handles when no on_timer hook is installed. Returns the number of
+ * transfers still running.
+ */
+static VALUE ruby_curl_multi_timeout_action(VALUE self) {
+  ruby_curl_multi *rbcm = rb_curl_multi_step_check(self);
+  CURLMcode mrc;
+
+  /* The reported timer has fired; libcurl re-arms its own if needed. */
+  if (rbcm->step_curl_deadline_ms >= 0 && rbcm->step_curl_deadline_ms <= curb_multi_monotonic_ms()) {
+    rbcm->step_curl_deadline_ms = -1;
+  }
+  rbcm->step_timer_deadline_ms = -1;
+  mrc = curl_multi_socket_action(rbcm->handle, CURL_SOCKET_TIMEOUT, 0, &rbcm->running);
+  return rb_curl_multi_step_finish(self, rbcm, mrc);
+}
+#else
+static VALUE ruby_curl_multi_on_socket(int argc, VALUE *argv, VALUE self) {
+  rb_raise(rb_eNotImpError, "on_socket requires libcurl's socket interface");
+  return Qnil;
+}
+
+static VALUE ruby_curl_multi_on_timer(int argc, VALUE *argv, VALUE self) {
+  rb_raise(rb_eNotImpError, "on_timer requires libcurl's socket interface");
+  return Qnil;
+}
+
+static VALUE ruby_curl_multi_socket_action(VALUE self, VALUE fd, VALUE flags) {
+  rb_raise(rb_eNotImpError, "socket_action requires libcurl's socket interface");
+  return Qnil;
+}
+
+static VALUE ruby_curl_multi_timeout_action(VALUE self) {
+  rb_raise(rb_eNotImpError, "timeout_action requires libcurl's socket interface");
+  return Qnil;
+}
+
+static void rb_curl_multi_install_step_hooks(ruby_curl_multi *rbcm) {
+}
+#endif /* step API */
+
 #ifdef _WIN32
 void create_crt_fd(fd_set *os_set, fd_set *crt_set)
 {
@@ -2015,7 +4832,20 @@ static void *curb_select_without_gvl(void *args) {
  *  # while idle other code my execute here
  * end
  *
+ * multi.perform(deadline: 2.5)
+ * multi.perform(deadline: Time.now + 2.5, cancel: token)
+ *
  * Run multi handles, looping selecting when data can be transfered
+ *
+ * +deadline+ (seconds from now, or a Time) and +cancel+ (a
+ * Curl::CancelToken) bound the whole perform. The drive loop checks both
+ * between socket actions and never waits past the deadline; a cancel from
+ * another thread is noticed within Curl::Multi.default_timeout. Once either
+ * fires, queued work is dropped as by cancel!, and every transfer still
+ * running or waiting to retry fails at once with
+ * Curl::Err::TimeoutError (deadline) or Curl::Err::AbortedByCallbackError
+ * (cancel): its on_failure and on_complete handlers run and last_result
+ * holds the code. perform then returns normally.
  */
 static VALUE ruby_curl_multi_perform_impl(int argc, VALUE *argv, VALUE self) {
   CURLMcode mcode;
@@ -2027,7 +4857,6 @@ static VALUE ruby_curl_multi_perform_impl(int argc, VALUE *argv, VALUE self) {
 #endif
   long timeout_milliseconds;
   struct timeval tv = {0, 0};
-  struct timeval tv_100ms = {0, 100000};
   VALUE block = Qnil;
 #if !defined(HAVE_RB_THREAD_FD_SELECT) && (defined(HAVE_RB_THREAD_BLOCKING_REGION) || defined(HAVE_RB_THREAD_CALL_WITHOUT_GVL))
   struct _select_set fdset_args;
@@ -2037,6 +4866,7 @@ static VALUE ruby_curl_multi_perform_impl(int argc, VALUE *argv, VALUE self) {
 
   TypedData_Get_Struct(self, ruby_curl_multi, &ruby_curl_multi_data_type, rbcm);
   ruby_curl_multi_ensure_handle(rbcm);
+  rbcm->event_backend_used = CURB_MULTI_EVENT_BACKEND_SELECT;
   if (!rb_ivar_defined(self, id_deferred_exception_ivar)) {
     clear_multi_deferred_exception_source_id_if_any(self);
   }
@@ -2059,7 +4889,7 @@ static VALUE ruby_curl_multi_perform_impl(int argc, VALUE *argv, VALUE self) {
   rb_curl_multi_yield_if_given(self, block);
 
   do {
-    while (rbcm->running) {
+    while (rb_curl_multi_busy_p(rbcm) && !rb_curl_multi_stop_if_limited(self, rbcm)) {
 #ifdef HAVE_CURL_MULTI_TIMEOUT
       /* get the curl suggested time out */
       mcode = curl_multi_timeout(rbcm->handle, &timeout_milliseconds);
@@ -2070,6 +4900,7 @@ static VALUE ruby_curl_multi_perform_impl(int argc, VALUE *argv, VALUE self) {
       /* libcurl doesn't have a timeout method defined, initialize to -1 we'll pick up the default later */
       timeout_milliseconds = -1;
 #endif
+      timeout_milliseconds = rb_curl_multi_timer_wait_ms(rbcm, timeout_milliseconds);
 
       if (timeout_milliseconds == 0) { /* no delay */
         rb_curl_multi_run( self, rbcm->handle, &(rbcm->running) );
@@ -2089,9 +4920,21 @@ static VALUE ruby_curl_multi_perform_impl(int argc, VALUE *argv, VALUE self) {
 #if defined(HAVE_CURL_MULTI_WAIT) && !defined(HAVE_RB_THREAD_FD_SELECT)
       {
         struct wait_args wait_args;
+        struct curl_waitfd wake_waitfd;
         wait_args.handle     = rbcm->handle;
+        wait_args.extra_fds  = NULL;
+        wait_args.extra_nfds = 0;
         wait_args.timeout_ms = timeout_milliseconds;
         wait_args.numfds     = 0;
+        wake_waitfd.revents  = 0;
+#ifndef _WIN32
+        if (rbcm->wake_fds[0] >= 0) {
+          wake_waitfd.fd = rbcm->wake_fds[0];
+          wake_waitfd.events = CURL_WAIT_POLLIN;
+          wait_args.extra_fds = &wake_waitfd;
+          wait_args.extra_nfds = 1;
+        }
+#endif
         /*
          * Wait via curl_multi_wait with the GVL released so other Ruby
          * threads can continue to run. Like rb_thread_fd_select, this wait
@@ -2100,18 +4943,25 @@ static VALUE ruby_curl_multi_perform_impl(int argc, VALUE *argv, VALUE self) {
          * scheduler is active (see ruby_curl_multi_perform).
          */
         CURLMcode wait_rc;
+        rbcm->stats.event_syscalls++;
+        rbcm->waiting = 1;
 #if defined(HAVE_RB_THREAD_CALL_WITHOUT_GVL)
         wait_rc = (CURLMcode)(intptr_t)rb_thread_call_without_gvl(
           curl_multi_wait_wrapper, &wait_args, RUBY_UBF_IO, NULL
         );
 #else
-        wait_rc = curl_multi_wait(rbcm->handle, NULL, 0, timeout_milliseconds, &wait_args.numfds);
+        wait_rc = curl_multi_wait(rbcm->handle, wait_args.extra_fds, wait_args.extra_nfds, timeout_milliseconds, &wait_args.numfds);
 #endif
+        rbcm->waiting = 0;
         if (wait_rc != CURLM_OK) {
           raise_curl_multi_error_exception(wait_rc);
         }
+        if (wake_waitfd.revents) {
+          rb_curl_multi_wakeup_drain(rbcm);
+        }
         if (wait_args.numfds == 0) {
-          curb_multi_scheduler_sleep(&tv_100ms);
+          struct timeval idle_tv = rb_curl_multi_idle_sleep_tv(rbcm);
+          curb_multi_scheduler_sleep(&idle_tv);
         }
         /* Process pending transfers after waiting */
         rb_curl_multi_run(self, rbcm->handle, &(rbcm->running));
@@ -2134,13 +4984,25 @@ static VALUE ruby_curl_multi_perform_impl(int argc, VALUE *argv, VALUE self) {
       }
 
       if (maxfd == -1) {
-        /* libcurl recommends sleeping for 100ms */
-        curb_multi_scheduler_sleep(&tv_100ms);
-        rb_curl_multi_run( self, rbcm->handle, &(rbcm->running) );
-        rb_curl_multi_read_info( self, rbcm->handle );
-        rb_curl_multi_yield_if_given(self, block);
-        continue;
+        /* libcurl recommends sleeping for 100ms, less if a timer is due */
+        struct timeval idle_tv = rb_curl_multi_idle_sleep_tv(rbcm);
+        if (rbcm->wake_fds[0] < 0) {
+          curb_multi_scheduler_sleep(&idle_tv);
+          rb_curl_multi_run( self, rbcm->handle, &(rbcm->running) );
+          rb_curl_multi_read_info( self, rbcm->handle );
+          rb_curl_multi_yield_if_given(self, block);
+          continue;
+        }
+        /* Sleep on the wakeup descriptor alone so an add can end it. */
+        tv = idle_tv;
+      }
+
+#ifndef _WIN32
+      if (rbcm->wake_fds[0] >= 0) {
+        FD_SET(rbcm->wake_fds[0], &fdread);
+        if (rbcm->wake_fds[0] > maxfd) maxfd = rbcm->wake_fds[0];
       }
+#endif
 
 #ifdef _WIN32
       create_crt_fd(&fdread, &crt_fdread);
@@ -2173,6 +5035,7 @@ static VALUE ruby_curl_multi_perform_impl(int argc, VALUE *argv, VALUE self) {
         for (i = 0; i < crt_fdread.fd_count; i++) rb_fd_set(crt_fdread.fd_array[i], &rfds);
         for (i = 0; i < crt_fdwrite.fd_count; i++) rb_fd_set(crt_fdwrite.fd_array[i], &wfds);
         for (i = 0; i < crt_fdexcep.fd_count; i++) rb_fd_set(crt_fdexcep.fd_array[i], &efds);
+        rbcm->stats.event_syscalls++;
         rc = rb_thread_fd_select(0, &rfds, &wfds, &efds, &tv);
 #else
         int fd;
@@ -2181,18 +5044,33 @@ static VALUE ruby_curl_multi_perform_impl(int argc, VALUE *argv, VALUE self) {
           if (FD_ISSET(fd, &fdwrite)) rb_fd_set(fd, &wfds);
           if (FD_ISSET(fd, &fdexcep)) rb_fd_set(fd, &efds);
         }
+        rbcm->stats.event_syscalls++;
+        rbcm->waiting = 1;
         rc = rb_thread_fd_select(maxfd+1, &rfds, &wfds, &efds, &tv);
+        rbcm->waiting = 0;
+        if (rc > 0 && rbcm->wake_fds[0] >= 0 && rb_fd_isset(rbcm->wake_fds[0], &rfds)) {
+          rb_curl_multi_wakeup_drain(rbcm);
+        }
 #endif
         rb_fd_term(&rfds);
         rb_fd_term(&wfds);
         rb_fd_term(&efds);
       }
-#elif defined(HAVE_RB_THREAD_CALL_WITHOUT_GVL)
+#else
+      rbcm->waiting = 1;
+#if defined(HAVE_RB_THREAD_CALL_WITHOUT_GVL)
       rc = (int)(intptr_t) rb_thread_call_without_gvl(curb_select_without_gvl, &fdset_args, RUBY_UBF_IO, 0);
 #elif HAVE_RB_THREAD_BLOCKING_REGION
       rc = rb_thread_blocking_region(curb_select, &fdset_args, RUBY_UBF_IO, 0);
 #else
       rc = select(maxfd+1, &fdread, &fdwrite, &fdexcep, &tv);
+#endif
+      rbcm->waiting = 0;
+#ifndef _WIN32
+      if (rc > 0 && rbcm->wake_fds[0] >= 0 && FD_ISSET(rbcm->wake_fds[0], &fdread)) {
+        rb_curl_multi_wakeup_drain(rbcm);
+      }
+#endif
 #endif
 
 #ifdef _WIN32
@@ -2219,7 +5097,7 @@ static VALUE ruby_curl_multi_perform_impl(int argc, VALUE *argv, VALUE self) {
 
     rb_curl_multi_read_info( self, rbcm->handle );
     rb_curl_multi_yield_if_given(self, block);
-  } while( rbcm->running );
+  } while (rb_curl_multi_busy_p(rbcm) && !rb_curl_multi_stop_if_limited(self, rbcm));
 
   if (curb_multi_autoclose_enabled()) {
     rbcm->allow_close_during_perform = 1;
@@ -2239,6 +5117,12 @@ struct multi_perform_call_args {
 
 static VALUE ruby_curl_multi_perform_guard_body(VALUE argp) {
   struct multi_perform_call_args *args = (struct multi_perform_call_args *)argp;
+  ruby_curl_multi *rbcm;
+
+  /* Pick up anything enqueued while a GVL-free transfer held admissions. */
+  TypedData_Get_Struct(args->self, ruby_curl_multi, &ruby_curl_multi_data_type, rbcm);
+  rb_curl_multi_admit_queued(args->self, rbcm);
+
   args->result = args->func(args->argc, args->argv, args->self);
   return args->result;
 }
@@ -2246,24 +5130,75 @@ static VALUE ruby_curl_multi_perform_guard_body(VALUE argp) {
 static VALUE ruby_curl_multi_perform_guard_ensure(VALUE self) {
   ruby_curl_multi *rbcm;
   TypedData_Get_Struct(self, ruby_curl_multi, &ruby_curl_multi_data_type, rbcm);
+  rbcm->deadline_ms = 0;
+  rbcm->cancel = NULL;
+  rbcm->cancel_token = 0;
+  rbcm->waiting = 0;
   rbcm->perform_active = 0;
   rbcm->callback_active = 0;
   rbcm->allow_close_during_perform = 0;
   return Qnil;
 }
 
+/* Monotonic deadline for perform(deadline:), given in seconds from now or as a Time. */
+static long long rb_curl_multi_deadline_ms(VALUE deadline) {
+  double seconds;
+
+  if (rb_obj_is_kind_of(deadline, rb_cTime)) {
+    seconds = NUM2DBL(rb_funcall(deadline, '-', 1, rb_funcall(rb_cTime, rb_intern("now"), 0)));
+  } else if (rb_obj_is_kind_of(deadline, rb_cNumeric)) {
+    seconds = NUM2DBL(deadline);
+  } else {
+    rb_raise(rb_eTypeError, "deadline must be a Numeric (seconds) or a Time");
+  }
+
+  if (seconds < 0) seconds = 0;
+  return curb_multi_monotonic_ms() + (long long)(seconds * 1000.0);
+}
+
 static VALUE ruby_curl_multi_with_perform_guard(int argc, VALUE *argv, VALUE self, VALUE (*func)(int, VALUE *, VALUE)) {
   ruby_curl_multi *rbcm;
   struct multi_perform_call_args args;
+  VALUE opts = Qnil;
+  long long deadline_ms = 0;
+  ruby_curl_cancel_token *cancel = NULL;
 
   TypedData_Get_Struct(self, ruby_curl_multi, &ruby_curl_multi_data_type, rbcm);
   if (rbcm->perform_active) {
     rb_raise(rb_eRuntimeError, "Cannot recursively perform an active Curl::Multi handle");
   }
+  if (RTEST(rbcm->on_socket) || RTEST(rbcm->on_timer)) {
+    rb_raise(rb_eRuntimeError, "Cannot perform a Curl::Multi handle driven by on_socket/on_timer");
+  }
+
+  rb_scan_args(argc, argv, "0:", &opts);
+  if (!NIL_P(opts)) {
+    ID keys[2];
+    VALUE values[2];
+
+    keys[0] = rb_intern("deadline");
+    keys[1] = rb_intern("cancel");
+    rb_get_kwargs(opts, keys, 0, 2, values);
+    if (values[0] != Qundef && !NIL_P(values[0])) {
+      deadline_ms = rb_curl_multi_deadline_ms(values[0]);
+    }
+    if (values[1] != Qundef && !NIL_P(values[1])) {
+      if (!rb_obj_is_kind_of(values[1], cCurlCancelToken)) {
+        rb_raise(rb_eTypeError, "cancel must be a Curl::CancelToken");
+      }
+      cancel = ruby_curl_cancel_token_get(values[1]);
+      rbcm->cancel_token = values[1];
+    }
+  }
+  RB_GC_GUARD(opts);
 
+  rbcm->deadline_ms = deadline_ms;
+  rbcm->cancel = cancel;
+  rb_curl_multi_wakeup_open(rbcm);
   rbcm->perform_active = 1;
-  args.argc = argc;
-  args.argv = argv;
+  /* The perform implementations only take the block. */
+  args.argc = 0;
+  args.argv = NULL;
   args.self = self;
   args.result = Qnil;
   args.func = func;
@@ -2284,6 +5219,17 @@ VALUE ruby_curl_multi_perform(int argc, VALUE *argv, VALUE self) {
   if (curb_fiber_scheduler_current() != Qnil) {
     return ruby_curl_multi_with_perform_guard(argc, argv, self, ruby_curl_multi_socket_perform_impl);
   }
+#ifdef CURB_HAVE_EPOLL
+  /* Without a scheduler, prefer the epoll-backed socket-action loop over
+   * rebuilding fd_sets every tick: it is not capped at FD_SETSIZE. */
+  {
+    ruby_curl_multi *rbcm;
+    TypedData_Get_Struct(self, ruby_curl_multi, &ruby_curl_multi_data_type, rbcm);
+    if (rbcm->event_backend != CURB_MULTI_EVENT_BACKEND_SELECT) {
+      return ruby_curl_multi_with_perform_guard(argc, argv, self, ruby_curl_multi_socket_perform_impl);
+    }
+  }
+#endif
 #endif
   return ruby_curl_multi_with_perform_guard(argc, argv, self, ruby_curl_multi_perform_impl);
 }
@@ -2308,13 +5254,16 @@ VALUE ruby_curl_multi_close(VALUE self) {
   if ((rbcm->perform_active || rbcm->callback_active) && !rbcm->allow_close_during_perform) {
     rb_raise(rb_eRuntimeError, "Cannot close an active Curl::Multi handle during perform");
   }
+  rb_curl_multi_check_transfer_without_gvl(rbcm);
 
   rb_curl_multi_detach_all(rbcm);
+  rb_curl_multi_reset_queue(rbcm, 1);
 
   if (rbcm->handle) {
     curl_multi_cleanup(rbcm->handle);
     rbcm->handle = NULL;
   }
+  rb_curl_multi_wakeup_close(rbcm);
 
   rbcm->active = 0;
   rbcm->running = 0;
@@ -2339,12 +5288,35 @@ static int mark_attached_i(st_data_t key, st_data_t val, st_data_t arg) {
   return ST_CONTINUE;
 }
 
+static int mark_host_queue_i(st_data_t key, st_data_t val, st_data_t arg) {
+  curb_host_queue *hq;
+  for (hq = ((curb_host *)val)->queues; hq; hq = hq->host_next) {
+    st_foreach(hq->pending, mark_attached_i, arg);
+  }
+  return ST_CONTINUE;
+}
+
 static void curl_multi_mark(void *ptr) {
   ruby_curl_multi *rbcm = (ruby_curl_multi *)ptr;
   if (!rbcm) return;
   if (rbcm->attached) {
     st_foreach(rbcm->attached, mark_attached_i, (st_data_t)0);
   }
+  if (rbcm->host_queues) {
+    st_foreach(rbcm->host_queues, mark_host_queue_i, (st_data_t)0);
+  }
+  if (RTEST(rbcm->completed_sink)) {
+    rb_gc_mark(rbcm->completed_sink);
+  }
+  if (rbcm->cancel) {
+    rb_gc_mark(rbcm->cancel_token);
+  }
+  rb_gc_mark(rbcm->on_socket);
+  rb_gc_mark(rbcm->on_timer);
+  rb_gc_mark(rbcm->step_error);
+  if (rbcm->retrying) {
+    st_foreach(rbcm->retrying, mark_attached_i, (st_data_t)0);
+  }
 }
 
 
@@ -2359,6 +5331,7 @@ void init_curb_multi() {
   id_ractor_aset = rb_intern("[]=");
   id_ractor_default_timeout_key = rb_intern("__curb_multi_default_timeout");
   id_ractor_autoclose_key = rb_intern("__curb_multi_autoclose");
+  id_ractor_release_gvl_key = rb_intern("__curb_multi_release_gvl");
   if (rb_const_defined(rb_cObject, rb_intern("Ractor"))) {
     VALUE ractor = rb_const_get(rb_cObject, rb_intern("Ractor"));
     VALUE current = rb_funcall(ractor, id_ractor_current, 0);
@@ -2384,23 +5357,65 @@ void init_curb_multi() {
   rb_define_singleton_method(cCurlMulti, "default_timeout", ruby_curl_multi_get_default_timeout, 0);
   rb_define_singleton_method(cCurlMulti, "autoclose=", ruby_curl_multi_set_autoclose, 1);
   rb_define_singleton_method(cCurlMulti, "autoclose", ruby_curl_multi_get_autoclose, 0);
+  rb_define_singleton_method(cCurlMulti, "release_gvl=", ruby_curl_multi_set_release_gvl_default, 1);
+  rb_define_singleton_method(cCurlMulti, "release_gvl", ruby_curl_multi_get_release_gvl_default, 0);
   /* Instance methods */
   rb_define_method(cCurlMulti, "initialize", ruby_curl_multi_initialize, 0);
   rb_define_method(cCurlMulti, "max_connects=", ruby_curl_multi_max_connects, 1);
   rb_define_method(cCurlMulti, "max_host_connections=", ruby_curl_multi_max_host_connections, 1);
+  rb_define_method(cCurlMulti, "max_concurrent_streams=", ruby_curl_multi_max_concurrent_streams, 1);
+  rb_define_method(cCurlMulti, "pipewait=", ruby_curl_multi_pipewait_set, 1);
+  rb_define_method(cCurlMulti, "pipewait?", ruby_curl_multi_pipewait_p, 0);
   rb_define_method(cCurlMulti, "pipeline=", ruby_curl_multi_pipeline, 1);
+  rb_define_method(cCurlMulti, "event_backend=", ruby_curl_multi_event_backend_set, 1);
+  rb_define_method(cCurlMulti, "event_backend", ruby_curl_multi_event_backend_get, 0);
+  rb_define_method(cCurlMulti, "release_gvl=", ruby_curl_multi_release_gvl_set, 1);
+  rb_define_method(cCurlMulti, "release_gvl?", ruby_curl_multi_release_gvl_p, 0);
   rb_define_method(cCurlMulti, "_add", ruby_curl_multi_add, 1);
   rb_define_method(cCurlMulti, "_remove", ruby_curl_multi_remove, 1);
+  rb_define_method(cCurlMulti, "_enqueue", ruby_curl_multi_enqueue, 2);
+  rb_define_method(cCurlMulti, "_dequeue", ruby_curl_multi_dequeue, 1);
+  rb_define_method(cCurlMulti, "_clear_queue", ruby_curl_multi_clear_queue, 0);
+  rb_define_method(cCurlMulti, "queue_size", ruby_curl_multi_queue_size, 0);
+  rb_define_method(cCurlMulti, "max_in_flight=", ruby_curl_multi_max_in_flight_set, 1);
+  rb_define_method(cCurlMulti, "max_in_flight", ruby_curl_multi_max_in_flight_get, 0);
+  rb_define_method(cCurlMulti, "max_in_flight_per_host=", ruby_curl_multi_max_in_flight_per_host_set, 1);
+  rb_define_method(cCurlMulti, "max_in_flight_per_host", ruby_curl_multi_max_in_flight_per_host_get, 0);
+  rb_define_method(cCurlMulti, "limit_host", ruby_curl_multi_limit_host, 2);
+  rb_define_method(cCurlMulti, "queue_stats", ruby_curl_multi_queue_stats, 0);
+  rb_define_method(cCurlMulti, "hedge_stats", ruby_curl_multi_hedge_stats, 0);
+  rb_define_method(cCurlMulti, "stats", ruby_curl_multi_stats, 0);
+  rb_define_method(cCurlMulti, "reset_stats", ruby_curl_multi_reset_stats, 0);
+
+  {
+    VALUE bounds = rb_ary_new_capa(CURB_STATS_BUCKETS);
+    int i;
+    for (i = 0; i < CURB_STATS_BUCKETS - 1; i++) {
+      rb_ary_push(bounds, rb_float_new(curb_stats_bucket_us[i] / 1e6));
+    }
+    rb_ary_push(bounds, rb_float_new(HUGE_VAL));
+    /* Upper bounds, in seconds, of the Multi#stats phase histogram buckets. */
+    rb_define_const(cCurlMulti, "STATS_BUCKETS", rb_obj_freeze(bounds));
+  }
+  rb_define_private_method(cCurlMulti, "_completed_sink=", ruby_curl_multi_completed_sink_set, 1);
   /*
-   * perform uses the legacy fdset loop by default, but routes to the
-   * socket-action drive loop when the calling fiber runs under a fiber
-   * scheduler so sibling fibers keep running during transfers. The
-   * socket-action path is also exposed directly as _socket_perform.
+   * perform drives transfers through the socket-action loop when the calling
+   * fiber runs under a fiber scheduler (so sibling fibers keep running) or
+   * when the epoll backend is available, and through the legacy fdset loop
+   * otherwise. The socket-action path is also exposed as _socket_perform.
    */
   rb_define_method(cCurlMulti, "perform", ruby_curl_multi_perform, -1);
 #if defined(HAVE_CURL_MULTI_SOCKET_ACTION) && defined(HAVE_CURLMOPT_SOCKETFUNCTION) && defined(HAVE_CURLMOPT_TIMERFUNCTION) && defined(HAVE_RB_THREAD_FD_SELECT) && !defined(_WIN32)
   rb_define_private_method(cCurlMulti, "_socket_perform", ruby_curl_multi_socket_perform, -1);
 #endif
+  rb_define_method(cCurlMulti, "on_socket", ruby_curl_multi_on_socket, -1);
+  rb_define_method(cCurlMulti, "on_timer", ruby_curl_multi_on_timer, -1);
+  rb_define_method(cCurlMulti, "socket_action", ruby_curl_multi_socket_action, 2);
+  rb_define_method(cCurlMulti, "timeout_action", ruby_curl_multi_timeout_action, 0);
+  /* Readiness flags for Multi#socket_action. */
+  rb_define_const(cCurlMulti, "CSELECT_IN", INT2NUM(CURL_CSELECT_IN));
+  rb_define_const(cCurlMulti, "CSELECT_OUT", INT2NUM(CURL_CSELECT_OUT));
+  rb_define_const(cCurlMulti, "CSELECT_ERR", INT2NUM(CURL_CSELECT_ERR));
   rb_define_method(cCurlMulti, "_close", ruby_curl_multi_close, 0);
   rb_define_private_method(cCurlMulti, "_mark_closed", ruby_curl_multi_mark_closed, 0);
 }
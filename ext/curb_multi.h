@@ -8,9 +8,31 @@
 #define __CURB_MULTI_H
 
 #include "curb.h"
+#include "curb_cancel.h"
 #include <curl/multi.h>
 
 struct st_table;
+struct curb_ready_rings;
+struct curb_multi_timer;
+
+#define CURB_STATS_RESULTS 128  /* CURLcodes counted one by one; larger ones share the last slot */
+#define CURB_STATS_PHASES 5     /* namelookup, connect, appconnect, starttransfer, total */
+#define CURB_STATS_BUCKETS 16
+
+/* Counters behind Multi#stats, updated as each transfer completes. */
+typedef struct {
+  unsigned long completed;
+  unsigned long results[CURB_STATS_RESULTS];
+  unsigned long long bytes_down;
+  unsigned long long bytes_up;
+  unsigned long connections_created;
+  unsigned long connections_reused;
+  unsigned long connections_multiplexed; /* reused ones that were HTTP/2 or HTTP/3 */
+  unsigned long retries;
+  unsigned long event_syscalls;  /* readiness waits and interest updates issued by perform */
+  unsigned long wakeups;         /* waits cut short by an add or enqueue from elsewhere */
+  unsigned long phases[CURB_STATS_PHASES][CURB_STATS_BUCKETS];
+} curb_multi_stats;
 
 typedef struct {
   int active;
@@ -19,8 +41,42 @@ typedef struct {
   char perform_active;
   char callback_active;
   char allow_close_during_perform;
+  char event_backend;
+  char event_backend_used;   /* backend the last perform ran on, 0 before any */
+  char release_gvl;
+  char transfer_without_gvl; /* libcurl is running on the perform thread without the GVL */
+  char pipewait;             /* CURLOPT_PIPEWAIT for added easies that leave it unset */
+  char waiting;              /* perform is blocked in a readiness wait */
+  int wake_fds[2];           /* read/write ends that end that wait early (eventfd: one fd), -1 = none */
   CURLM *handle;
   struct st_table *attached;
+  unsigned long attachment_generation; /* bumped by every add; stamped on the easy */
+  void **callback_adds;                /* easies added while completion callbacks run */
+  size_t callback_adds_len;
+  size_t callback_adds_capa;
+  long max_in_flight;                  /* 0 = unlimited; caps admissions from the queue */
+  long max_in_flight_per_host;         /* default per-host cap for queued work; 0 = unlimited */
+  struct st_table *queued;             /* queued easy -> its host/priority FIFO */
+  struct st_table *queued_in_flight;   /* easy admitted from the queue -> its host */
+  struct st_table *host_queues;        /* host key -> struct curb_host */
+  struct curb_ready_rings *ready;      /* per-priority round-robin rings of FIFOs that can admit */
+  VALUE completed_sink;                /* Array receiving each finished easy (each_completed), or nil */
+  struct curb_multi_timer *timers;     /* min-heap of hedge and retry deadlines */
+  size_t timers_len;
+  size_t timers_capa;
+  unsigned long hedges_fired;          /* clones started for slow hedged requests */
+  unsigned long hedges_won;            /* clones that finished before their original */
+  struct st_table *retrying;           /* easy waiting for a retry timer -> its VALUE */
+  long long deadline_ms;               /* monotonic deadline of the running perform, 0 = none */
+  VALUE cancel_token;                  /* Curl::CancelToken of the running perform, or 0 */
+  ruby_curl_cancel_token *cancel;      /* its flag, read by drive loops without the GVL */
+  char aborting;                       /* failing pending work after the deadline or a cancel */
+  VALUE on_socket;                     /* step API hooks driven by an outside event loop, or nil */
+  VALUE on_timer;
+  VALUE step_error;                    /* first exception a hook raised inside libcurl, or nil */
+  long long step_curl_deadline_ms;     /* monotonic deadline libcurl last asked for, -1 = none */
+  long long step_timer_deadline_ms;    /* deadline last reported to on_timer, -1 = none */
+  curb_multi_stats stats;
 } ruby_curl_multi;
 
 extern VALUE cCurlMulti;
@@ -29,6 +85,7 @@ extern const rb_data_type_t ruby_curl_multi_data_type;
 void init_curb_multi();
 void rb_curl_multi_forget_easy(ruby_curl_multi *rbcm, void *rbce_ptr);
 CURLMcode rb_curl_multi_detach_easy(ruby_curl_multi *rbcm, void *rbce_ptr);
+int rb_curl_multi_easy_attached_p(void *rbce_ptr);
 
 
 #endif
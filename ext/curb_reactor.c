@@ -0,0 +1,808 @@
+/* curb_reactor.c - Curl multi handle driven by a native thread
+ * Licensed under the Ruby License. See LICENSE for details.
+ *
+ * A Curl::Reactor owns a CURLM that lives on its own pthread. Ruby threads
+ * prepare an easy handle with the GVL held and hand it over through a
+ * mutex-protected list; only the reactor thread ever touches the CURLM.
+ * The reactor never enters Ruby: the default body/header handlers stage
+ * bytes natively on the easy and the waiting thread collects them.
+ */
+#include "curb_config.h"
+#include <ruby.h>
+#ifdef HAVE_RB_THREAD_CALL_WITHOUT_GVL
+  #include <ruby/thread.h>
+#endif
+
+#include "curb_easy.h"
+#include "curb_errors.h"
+#include "curb_multi.h"
+#include "curb_reactor.h"
+
+extern VALUE mCurl;
+VALUE cCurlReactor;
+VALUE cCurlReactorFuture;
+
+#ifdef RDOC_NEVER_DEFINED
+  mCurl = rb_define_module("Curl");
+#endif
+
+#ifdef CURB_HAVE_REACTOR
+#include <pthread.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(HAVE_CURL_MULTI_POLL) && defined(HAVE_CURL_MULTI_WAKEUP)
+/* libcurl wakes its own poll; otherwise a self-pipe is passed to curl_multi_wait. */
+#define CURB_REACTOR_MULTI_WAKEUP 1
+#endif
+
+/* Upper bound on a single wait so a missed wakeup cannot stall the loop. */
+#define CURB_REACTOR_WAIT_MS 1000
+
+/* One submitted transfer. Shared by the reactor thread and the future, so
+ * it is plain malloc memory released by whichever side lets go last. */
+typedef struct curb_reactor_job {
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  ruby_curl_easy *rbce;
+  VALUE easy;
+  CURLcode result;
+  int refs;               /* guarded by lock */
+  char done;              /* guarded by lock */
+  char orphaned;          /* guarded by lock; the easy was collected mid-transfer */
+  unsigned long wakeups;  /* guarded by lock; bumped to interrupt waiters */
+  struct curb_reactor_job *prev;
+  struct curb_reactor_job *next;
+} curb_reactor_job;
+
+typedef struct {
+  pthread_mutex_t lock;   /* guards the job lists and counters */
+  pthread_t thread;
+  CURLM *handle;
+  char started;
+  char stopping;
+  char closed;
+  char detached;          /* collected while running: the thread frees the reactor */
+  pid_t pid;
+  curb_reactor_job *incoming;      /* submitted, not yet added to handle */
+  curb_reactor_job *incoming_tail;
+  curb_reactor_job *running;       /* added to handle */
+  long pending;
+  unsigned long completed;
+#ifndef CURB_REACTOR_MULTI_WAKEUP
+  int wake_fds[2];
+#endif
+} ruby_curl_reactor;
+
+typedef struct {
+  curb_reactor_job *job;
+  VALUE reactor;
+  VALUE easy;
+  char collected;
+} ruby_curl_reactor_future;
+
+/* Finished jobs whose easy was garbage collected while in flight. Freeing
+ * an easy needs the GVL, so they wait here for the next Ruby thread that
+ * comes through the reactor. */
+static pthread_mutex_t curb_reactor_orphans_lock = PTHREAD_MUTEX_INITIALIZER;
+static curb_reactor_job *curb_reactor_orphans;
+
+static void curb_reactor_job_release(curb_reactor_job *job) {
+  int refs;
+
+  pthread_mutex_lock(&job->lock);
+  refs = --job->refs;
+  pthread_mutex_unlock(&job->lock);
+
+  if (refs == 0) {
+    pthread_cond_destroy(&job->cond);
+    pthread_mutex_destroy(&job->lock);
+    free(job);
+  }
+}
+
+/* Reactor thread: hand the easy back and wake everyone waiting on it. The
+ * job must already be off the reactor's lists. */
+static void curb_reactor_job_finish(curb_reactor_job *job, CURLcode result) {
+  int orphaned;
+
+  curl_easy_setopt(job->rbce->curl, CURLOPT_PRIVATE, (void *)job->rbce);
+
+  pthread_mutex_lock(&job->lock);
+  job->result = result;
+  job->done = 1;
+  orphaned = job->orphaned;
+  pthread_cond_broadcast(&job->cond);
+  pthread_mutex_unlock(&job->lock);
+
+  if (orphaned) {
+    /* The easy's reference now belongs to the orphan list. */
+    pthread_mutex_lock(&curb_reactor_orphans_lock);
+    job->next = curb_reactor_orphans;
+    curb_reactor_orphans = job;
+    pthread_mutex_unlock(&curb_reactor_orphans_lock);
+  }
+  curb_reactor_job_release(job);
+}
+
+/* Requires the GVL: free the easies of finished orphaned jobs. */
+static void curb_reactor_reap_orphans(void) {
+  curb_reactor_job *job, *next;
+
+  pthread_mutex_lock(&curb_reactor_orphans_lock);
+  job = curb_reactor_orphans;
+  curb_reactor_orphans = NULL;
+  pthread_mutex_unlock(&curb_reactor_orphans_lock);
+
+  for (; job; job = next) {
+    next = job->next;
+    job->rbce->reactor_job = NULL;
+    job->rbce->multi = Qnil; /* collected along with the easy, never attached */
+    ruby_curl_easy_free_wrapper(job->rbce);
+    curb_reactor_job_release(job);
+  }
+}
+
+/*
+ * Called from Curl::Easy's dfree while the easy still belongs to a job.
+ * Returns 1 when the reactor thread may still be using it: the job then
+ * keeps the easy and it is freed once the transfer is over. Otherwise the
+ * easy lets go of the job and is freed as usual.
+ */
+int rb_curl_reactor_disown_easy(ruby_curl_easy *rbce) {
+  curb_reactor_job *job = (curb_reactor_job *)rbce->reactor_job;
+  int orphaned;
+
+  pthread_mutex_lock(&job->lock);
+  orphaned = !job->done;
+  if (orphaned) job->orphaned = 1;
+  pthread_mutex_unlock(&job->lock);
+
+  if (!orphaned) {
+    rbce->reactor_job = NULL;
+    curb_reactor_job_release(job);
+  }
+  return orphaned;
+}
+
+static void curb_reactor_unlink_running(ruby_curl_reactor *rbcr, curb_reactor_job *job) {
+  if (job->prev) job->prev->next = job->next;
+  else rbcr->running = job->next;
+  if (job->next) job->next->prev = job->prev;
+  job->prev = job->next = NULL;
+}
+
+static void curb_reactor_wake(ruby_curl_reactor *rbcr) {
+#ifdef CURB_REACTOR_MULTI_WAKEUP
+  curl_multi_wakeup(rbcr->handle);
+#else
+  char byte = 1;
+  ssize_t written = write(rbcr->wake_fds[1], &byte, 1);
+  (void)written; /* a full pipe already guarantees a wakeup */
+#endif
+}
+
+static void curb_reactor_wait(ruby_curl_reactor *rbcr) {
+#ifdef CURB_REACTOR_MULTI_WAKEUP
+  curl_multi_poll(rbcr->handle, NULL, 0, CURB_REACTOR_WAIT_MS, NULL);
+#else
+  struct curl_waitfd wake;
+  char drain[64];
+
+  wake.fd = rbcr->wake_fds[0];
+  wake.events = CURL_WAIT_POLLIN;
+  wake.revents = 0;
+  curl_multi_wait(rbcr->handle, &wake, 1, CURB_REACTOR_WAIT_MS, NULL);
+  if (wake.revents) {
+    while (read(rbcr->wake_fds[0], drain, sizeof(drain)) > 0);
+  }
+#endif
+}
+
+/* Called with rbcr->lock held: move submitted jobs onto the multi handle. */
+static void curb_reactor_admit_incoming(ruby_curl_reactor *rbcr) {
+  curb_reactor_job *job;
+  int orphaned;
+
+  while ((job = rbcr->incoming)) {
+    rbcr->incoming = job->next;
+    if (!rbcr->incoming) rbcr->incoming_tail = NULL;
+    job->next = NULL;
+
+    pthread_mutex_lock(&job->lock);
+    orphaned = job->orphaned;
+    pthread_mutex_unlock(&job->lock);
+    if (orphaned) {
+      /* Nobody is left to read the response. */
+      rbcr->pending--;
+      rbcr->completed++;
+      curb_reactor_job_finish(job, CURLE_ABORTED_BY_CALLBACK);
+      continue;
+    }
+
+    curl_easy_setopt(job->rbce->curl, CURLOPT_PRIVATE, (void *)job);
+    if (curl_multi_add_handle(rbcr->handle, job->rbce->curl) != CURLM_OK) {
+      rbcr->pending--;
+      rbcr->completed++;
+      curb_reactor_job_finish(job, CURLE_FAILED_INIT);
+      continue;
+    }
+
+    job->next = rbcr->running;
+    if (rbcr->running) rbcr->running->prev = job;
+    rbcr->running = job;
+  }
+}
+
+static void curb_reactor_read_info(ruby_curl_reactor *rbcr) {
+  CURLMsg *msg;
+  int left;
+
+  while ((msg = curl_multi_info_read(rbcr->handle, &left))) {
+    CURL *curl = msg->easy_handle;
+    CURLcode result = msg->data.result;
+    char *priv = NULL;
+    curb_reactor_job *job;
+
+    if (msg->msg != CURLMSG_DONE) continue;
+
+    curl_easy_getinfo(curl, CURLINFO_PRIVATE, &priv);
+    job = (curb_reactor_job *)priv;
+    curl_multi_remove_handle(rbcr->handle, curl);
+
+    pthread_mutex_lock(&rbcr->lock);
+    curb_reactor_unlink_running(rbcr, job);
+    rbcr->pending--;
+    rbcr->completed++;
+    pthread_mutex_unlock(&rbcr->lock);
+
+    curb_reactor_job_finish(job, result);
+  }
+}
+
+/* Called with rbcr->lock held once stopping: abort everything still owned. */
+static void curb_reactor_abort_all(ruby_curl_reactor *rbcr) {
+  curb_reactor_job *job;
+
+  while ((job = rbcr->running)) {
+    curl_multi_remove_handle(rbcr->handle, job->rbce->curl);
+    curb_reactor_unlink_running(rbcr, job);
+    curb_reactor_job_finish(job, CURLE_ABORTED_BY_CALLBACK);
+  }
+
+  while ((job = rbcr->incoming)) {
+    rbcr->incoming = job->next;
+    job->next = NULL;
+    curb_reactor_job_finish(job, CURLE_ABORTED_BY_CALLBACK);
+  }
+
+  rbcr->incoming_tail = NULL;
+  rbcr->pending = 0;
+}
+
+static void curb_reactor_release_handle(ruby_curl_reactor *rbcr);
+
+static void *curb_reactor_main(void *arg) {
+  ruby_curl_reactor *rbcr = (ruby_curl_reactor *)arg;
+  int running;
+  int detached;
+
+  rb_curl_easy_enter_foreign_transfer();
+
+  pthread_mutex_lock(&rbcr->lock);
+  while (!rbcr->stopping) {
+    curb_reactor_admit_incoming(rbcr);
+    pthread_mutex_unlock(&rbcr->lock);
+
+    curl_multi_perform(rbcr->handle, &running);
+    curb_reactor_read_info(rbcr);
+    curb_reactor_wait(rbcr);
+
+    pthread_mutex_lock(&rbcr->lock);
+  }
+  curb_reactor_abort_all(rbcr);
+  detached = rbcr->detached;
+  pthread_mutex_unlock(&rbcr->lock);
+
+  rb_curl_easy_leave_foreign_transfer();
+
+  if (detached) {
+    curb_reactor_release_handle(rbcr);
+    pthread_mutex_destroy(&rbcr->lock);
+    free(rbcr);
+  }
+  return NULL;
+}
+
+static void *curb_reactor_join_i(void *arg) {
+  ruby_curl_reactor *rbcr = (ruby_curl_reactor *)arg;
+  pthread_join(rbcr->thread, NULL);
+  return NULL;
+}
+
+static void curb_reactor_stop(ruby_curl_reactor *rbcr, int release_gvl) {
+  if (!rbcr->started) return;
+
+  pthread_mutex_lock(&rbcr->lock);
+  rbcr->stopping = 1;
+  pthread_mutex_unlock(&rbcr->lock);
+  curb_reactor_wake(rbcr);
+
+  /* Removing a handle can wait on libcurl's resolver thread. */
+  if (release_gvl) {
+    rb_thread_call_without_gvl(curb_reactor_join_i, rbcr, NULL, NULL);
+  } else {
+    curb_reactor_join_i(rbcr);
+  }
+  rbcr->started = 0;
+}
+
+static void curb_reactor_release_handle(ruby_curl_reactor *rbcr) {
+  if (rbcr->handle) {
+    curl_multi_cleanup(rbcr->handle);
+    rbcr->handle = NULL;
+  }
+#ifndef CURB_REACTOR_MULTI_WAKEUP
+  if (rbcr->wake_fds[0] >= 0) close(rbcr->wake_fds[0]);
+  if (rbcr->wake_fds[1] >= 0) close(rbcr->wake_fds[1]);
+  rbcr->wake_fds[0] = rbcr->wake_fds[1] = -1;
+#endif
+}
+
+static void curl_reactor_mark(void *ptr) {
+  ruby_curl_reactor *rbcr = (ruby_curl_reactor *)ptr;
+  curb_reactor_job *job;
+
+  if (!rbcr) return;
+
+  /* In-flight easies are pinned: the reactor thread holds raw pointers. */
+  pthread_mutex_lock(&rbcr->lock);
+  for (job = rbcr->incoming; job; job = job->next) rb_gc_mark(job->easy);
+  for (job = rbcr->running; job; job = job->next) rb_gc_mark(job->easy);
+  pthread_mutex_unlock(&rbcr->lock);
+}
+
+static void curl_reactor_free(void *ptr) {
+  ruby_curl_reactor *rbcr = (ruby_curl_reactor *)ptr;
+
+  if (!rbcr) return;
+
+  curb_reactor_reap_orphans();
+
+  if (rbcr->started && rbcr->pid == getpid()) {
+    /* Never join from the GC: removing handles can wait on libcurl's
+     * resolver. The thread aborts what it still owns and frees the rest. */
+    pthread_t thread = rbcr->thread;
+
+    pthread_mutex_lock(&rbcr->lock);
+    rbcr->stopping = 1;
+    rbcr->detached = 1;
+    curb_reactor_wake(rbcr);
+    pthread_mutex_unlock(&rbcr->lock);
+    pthread_detach(thread);
+    return;
+  }
+  if (rbcr->started) {
+    /* A forked child has no reactor thread; its jobs are the parent's. */
+    return;
+  }
+
+  curb_reactor_release_handle(rbcr);
+  pthread_mutex_destroy(&rbcr->lock);
+  free(rbcr);
+}
+
+static size_t curl_reactor_memsize(const void *ptr) {
+  (void)ptr;
+  return sizeof(ruby_curl_reactor);
+}
+
+static const rb_data_type_t ruby_curl_reactor_data_type = {
+  "Curl::Reactor",
+  {
+    curl_reactor_mark,
+    curl_reactor_free,
+    curl_reactor_memsize,
+#ifdef RUBY_TYPED_FREE_IMMEDIATELY
+    NULL, /* compact */
+#endif
+  },
+#ifdef RUBY_TYPED_FREE_IMMEDIATELY
+  NULL, NULL, /* parent, data */
+  RUBY_TYPED_FREE_IMMEDIATELY
+#endif
+};
+
+static void curl_reactor_future_mark(void *ptr) {
+  ruby_curl_reactor_future *future = (ruby_curl_reactor_future *)ptr;
+
+  if (!future) return;
+  rb_gc_mark(future->reactor);
+  rb_gc_mark(future->easy);
+}
+
+static void curl_reactor_future_free(void *ptr) {
+  ruby_curl_reactor_future *future = (ruby_curl_reactor_future *)ptr;
+
+  if (!future) return;
+  if (future->job) curb_reactor_job_release(future->job);
+  free(future);
+}
+
+static size_t curl_reactor_future_memsize(const void *ptr) {
+  (void)ptr;
+  return sizeof(ruby_curl_reactor_future) + sizeof(curb_reactor_job);
+}
+
+static const rb_data_type_t ruby_curl_reactor_future_data_type = {
+  "Curl::Reactor::Future",
+  {
+    curl_reactor_future_mark,
+    curl_reactor_future_free,
+    curl_reactor_future_memsize,
+#ifdef RUBY_TYPED_FREE_IMMEDIATELY
+    NULL, /* compact */
+#endif
+  },
+#ifdef RUBY_TYPED_FREE_IMMEDIATELY
+  NULL, NULL, /* parent, data */
+  RUBY_TYPED_FREE_IMMEDIATELY
+#endif
+};
+
+static VALUE ruby_curl_reactor_alloc(VALUE klass) {
+  ruby_curl_reactor *rbcr = (ruby_curl_reactor *)calloc(1, sizeof(ruby_curl_reactor));
+  VALUE self;
+
+  if (!rbcr) {
+    rb_raise(rb_eNoMemError, "Failed to allocate memory for Curl::Reactor");
+  }
+
+  pthread_mutex_init(&rbcr->lock, NULL);
+#ifndef CURB_REACTOR_MULTI_WAKEUP
+  rbcr->wake_fds[0] = rbcr->wake_fds[1] = -1;
+#endif
+  self = TypedData_Wrap_Struct(klass, &ruby_curl_reactor_data_type, rbcr);
+  return self;
+}
+
+/*
+ * call-seq:
+ *   Curl::Reactor.new                                => #<Curl::Reactor...>
+ *
+ * Start a native thread that owns a multi handle. Easy handles submitted
+ * from any Ruby thread are transferred there while Ruby keeps running.
+ */
+static VALUE ruby_curl_reactor_initialize(VALUE self) {
+  ruby_curl_reactor *rbcr;
+  int err;
+
+  TypedData_Get_Struct(self, ruby_curl_reactor, &ruby_curl_reactor_data_type, rbcr);
+
+  if (rbcr->handle) {
+    rb_raise(rb_eRuntimeError, "Curl::Reactor is already initialized");
+  }
+
+  rbcr->handle = curl_multi_init();
+  if (!rbcr->handle) {
+    rb_raise(mCurlErrFailedInit, "Failed to initialize multi handle");
+  }
+
+#ifndef CURB_REACTOR_MULTI_WAKEUP
+  if (pipe(rbcr->wake_fds) != 0) {
+    rbcr->wake_fds[0] = rbcr->wake_fds[1] = -1;
+    curb_reactor_release_handle(rbcr);
+    rb_sys_fail("pipe");
+  }
+  fcntl(rbcr->wake_fds[0], F_SETFL, fcntl(rbcr->wake_fds[0], F_GETFL) | O_NONBLOCK);
+  fcntl(rbcr->wake_fds[1], F_SETFL, fcntl(rbcr->wake_fds[1], F_GETFL) | O_NONBLOCK);
+#endif
+
+  err = pthread_create(&rbcr->thread, NULL, curb_reactor_main, rbcr);
+  if (err != 0) {
+    curb_reactor_release_handle(rbcr);
+    rb_syserr_fail(err, "pthread_create");
+  }
+
+  rbcr->started = 1;
+  rbcr->pid = getpid();
+  return self;
+}
+
+/*
+ * call-seq:
+ *   reactor._submit(easy)                            => Curl::Reactor::Future
+ *
+ * Configure +easy+ on the calling thread and queue it for the reactor.
+ */
+static VALUE ruby_curl_reactor_submit(VALUE self, VALUE easy) {
+  ruby_curl_reactor *rbcr;
+  ruby_curl_reactor_future *future;
+  ruby_curl_easy *rbce;
+  curb_reactor_job *job;
+  VALUE future_obj;
+
+  TypedData_Get_Struct(self, ruby_curl_reactor, &ruby_curl_reactor_data_type, rbcr);
+  TypedData_Get_Struct(easy, ruby_curl_easy, &ruby_curl_easy_data_type, rbce);
+
+  curb_reactor_reap_orphans();
+
+  if (rbcr->closed || !rbcr->started) {
+    rb_raise(rb_eRuntimeError, "Cannot submit to a closed Curl::Reactor");
+  }
+  if (rbcr->pid != getpid()) {
+    rb_raise(rb_eRuntimeError, "Curl::Reactor cannot be used in a forked child");
+  }
+  if (rbce->reactor_active) {
+    rb_raise(rb_eRuntimeError, "Curl::Easy handle is already being transferred by a Curl::Reactor");
+  }
+  if (rbce->native_active || rbce->callback_active || rb_curl_multi_easy_attached_p(rbce)) {
+    rb_raise(rb_eRuntimeError, "Cannot submit an active Curl::Easy handle to a Curl::Reactor");
+  }
+  if (rb_curl_easy_ruby_transfer_callbacks_p(rbce)) {
+    rb_raise(rb_eArgError, "Curl::Reactor cannot run Ruby transfer callbacks (on_body, on_header, on_progress, on_debug or uploads)");
+  }
+
+  future_obj = TypedData_Make_Struct(cCurlReactorFuture, ruby_curl_reactor_future,
+                                     &ruby_curl_reactor_future_data_type, future);
+  future->reactor = self;
+  future->easy = easy;
+
+  ruby_curl_easy_setup(rbce);
+  rbce->last_result = 0;
+
+  job = (curb_reactor_job *)calloc(1, sizeof(curb_reactor_job));
+  if (!job) {
+    ruby_curl_easy_cleanup(easy, rbce);
+    rb_raise(rb_eNoMemError, "Failed to allocate Curl::Reactor job");
+  }
+  pthread_mutex_init(&job->lock, NULL);
+  pthread_cond_init(&job->cond, NULL);
+  job->rbce = rbce;
+  job->easy = easy;
+  job->refs = 3; /* the reactor thread, the future and the easy */
+  future->job = job;
+
+  /* Held until the future collects the result. */
+  rbce->reactor_active = 1;
+  rbce->reactor_job = job;
+  rbce->native_active++;
+
+  pthread_mutex_lock(&rbcr->lock);
+  if (rbcr->incoming_tail) rbcr->incoming_tail->next = job;
+  else rbcr->incoming = job;
+  rbcr->incoming_tail = job;
+  rbcr->pending++;
+  pthread_mutex_unlock(&rbcr->lock);
+
+  curb_reactor_wake(rbcr);
+  return future_obj;
+}
+
+/*
+ * call-seq:
+ *   reactor.close                                    => nil
+ *
+ * Stop the reactor thread. Transfers still in flight are aborted and their
+ * futures resolve with Curl::Err::AbortedByCallbackError.
+ */
+static VALUE ruby_curl_reactor_close(VALUE self) {
+  ruby_curl_reactor *rbcr;
+
+  TypedData_Get_Struct(self, ruby_curl_reactor, &ruby_curl_reactor_data_type, rbcr);
+
+  if (rbcr->closed) return Qnil;
+  rbcr->closed = 1;
+  curb_reactor_stop(rbcr, 1);
+  curb_reactor_release_handle(rbcr);
+  curb_reactor_reap_orphans();
+  return Qnil;
+}
+
+/*
+ * call-seq:
+ *   reactor.closed?                                  => true or false
+ */
+static VALUE ruby_curl_reactor_closed_p(VALUE self) {
+  ruby_curl_reactor *rbcr;
+
+  TypedData_Get_Struct(self, ruby_curl_reactor, &ruby_curl_reactor_data_type, rbcr);
+  return rbcr->closed ? Qtrue : Qfalse;
+}
+
+/*
+ * call-seq:
+ *   reactor.pending                                  => integer
+ *
+ * Number of submitted transfers that have not completed yet.
+ */
+static VALUE ruby_curl_reactor_pending(VALUE self) {
+  ruby_curl_reactor *rbcr;
+  long pending;
+
+  TypedData_Get_Struct(self, ruby_curl_reactor, &ruby_curl_reactor_data_type, rbcr);
+  pthread_mutex_lock(&rbcr->lock);
+  pending = rbcr->pending;
+  pthread_mutex_unlock(&rbcr->lock);
+  return LONG2NUM(pending);
+}
+
+/*
+ * call-seq:
+ *   reactor.completed                                => integer
+ *
+ * Number of transfers the reactor thread has finished since it started.
+ */
+static VALUE ruby_curl_reactor_completed(VALUE self) {
+  ruby_curl_reactor *rbcr;
+  unsigned long completed;
+
+  TypedData_Get_Struct(self, ruby_curl_reactor, &ruby_curl_reactor_data_type, rbcr);
+  pthread_mutex_lock(&rbcr->lock);
+  completed = rbcr->completed;
+  pthread_mutex_unlock(&rbcr->lock);
+  return ULONG2NUM(completed);
+}
+
+/* Requires the GVL: give the finished easy back to Ruby, exactly once. */
+static void curb_reactor_future_collect(ruby_curl_reactor_future *future) {
+  ruby_curl_easy *rbce = future->job->rbce;
+
+  if (future->collected) return;
+  future->collected = 1;
+
+  rbce->reactor_active = 0;
+  if (rbce->native_active > 0) rbce->native_active--;
+  rbce->last_result = future->job->result;
+  if (rbce->reactor_job == future->job) {
+    rbce->reactor_job = NULL;
+    curb_reactor_job_release(future->job);
+  }
+  rb_curl_easy_collect_native(rbce);
+  ruby_curl_easy_cleanup(future->easy, rbce);
+}
+
+static int curb_reactor_job_done_p(curb_reactor_job *job) {
+  int done;
+
+  pthread_mutex_lock(&job->lock);
+  done = job->done;
+  pthread_mutex_unlock(&job->lock);
+  return done;
+}
+
+struct curb_future_wait_args {
+  curb_reactor_job *job;
+  struct timespec deadline;
+  int has_deadline;
+  int done;
+  int timed_out;
+};
+
+static void *curb_future_wait_without_gvl(void *arg) {
+  struct curb_future_wait_args *args = (struct curb_future_wait_args *)arg;
+  curb_reactor_job *job = args->job;
+  unsigned long wakeups;
+
+  pthread_mutex_lock(&job->lock);
+  wakeups = job->wakeups;
+  while (!job->done && job->wakeups == wakeups) {
+    if (args->has_deadline) {
+      if (pthread_cond_timedwait(&job->cond, &job->lock, &args->deadline) == ETIMEDOUT) {
+        args->timed_out = 1;
+        break;
+      }
+    } else {
+      pthread_cond_wait(&job->cond, &job->lock);
+    }
+  }
+  args->done = job->done;
+  pthread_mutex_unlock(&job->lock);
+  return NULL;
+}
+
+static void curb_future_wait_ubf(void *arg) {
+  curb_reactor_job *job = (curb_reactor_job *)arg;
+
+  pthread_mutex_lock(&job->lock);
+  job->wakeups++;
+  pthread_cond_broadcast(&job->cond);
+  pthread_mutex_unlock(&job->lock);
+}
+
+/*
+ * call-seq:
+ *   future.wait                                      => future
+ *   future.wait(timeout)                             => future or nil
+ *
+ * Block until the transfer finishes, with the GVL released, or until
+ * +timeout+ seconds pass (then nil is returned). Other Ruby threads keep
+ * running and Thread#raise / Thread#kill interrupt the wait.
+ */
+static VALUE ruby_curl_reactor_future_wait(int argc, VALUE *argv, VALUE self) {
+  ruby_curl_reactor_future *future;
+  struct curb_future_wait_args args;
+  VALUE timeout;
+
+  TypedData_Get_Struct(self, ruby_curl_reactor_future, &ruby_curl_reactor_future_data_type, future);
+  rb_scan_args(argc, argv, "01", &timeout);
+
+  memset(&args, 0, sizeof(args));
+  args.job = future->job;
+
+  if (!NIL_P(timeout)) {
+    double seconds = NUM2DBL(timeout);
+    struct timeval now;
+
+    if (seconds < 0) seconds = 0;
+    gettimeofday(&now, NULL);
+    args.deadline.tv_sec = now.tv_sec + (time_t)seconds;
+    args.deadline.tv_nsec = (long)now.tv_usec * 1000 + (long)((seconds - floor(seconds)) * 1e9);
+    if (args.deadline.tv_nsec >= 1000000000L) {
+      args.deadline.tv_sec++;
+      args.deadline.tv_nsec -= 1000000000L;
+    }
+    args.has_deadline = 1;
+  }
+
+  while (!curb_reactor_job_done_p(future->job)) {
+    rb_thread_call_without_gvl(curb_future_wait_without_gvl, &args, curb_future_wait_ubf, future->job);
+    if (args.done) break;
+    rb_thread_check_ints();
+    if (args.timed_out) return Qnil;
+  }
+
+  curb_reactor_future_collect(future);
+  return self;
+}
+
+/*
+ * call-seq:
+ *   future.ready?                                    => true or false
+ *
+ * True once the transfer has finished. Never blocks.
+ */
+static VALUE ruby_curl_reactor_future_ready_p(VALUE self) {
+  ruby_curl_reactor_future *future;
+
+  TypedData_Get_Struct(self, ruby_curl_reactor_future, &ruby_curl_reactor_future_data_type, future);
+  if (!curb_reactor_job_done_p(future->job)) return Qfalse;
+
+  curb_reactor_future_collect(future);
+  return Qtrue;
+}
+
+/*
+ * call-seq:
+ *   future.easy                                      => Curl::Easy
+ */
+static VALUE ruby_curl_reactor_future_easy(VALUE self) {
+  ruby_curl_reactor_future *future;
+
+  TypedData_Get_Struct(self, ruby_curl_reactor_future, &ruby_curl_reactor_future_data_type, future);
+  return future->easy;
+}
+#endif /* CURB_HAVE_REACTOR */
+
+void init_curb_reactor() {
+#ifdef CURB_HAVE_REACTOR
+  cCurlReactor = rb_define_class_under(mCurl, "Reactor", rb_cObject);
+  rb_define_alloc_func(cCurlReactor, ruby_curl_reactor_alloc);
+  rb_define_method(cCurlReactor, "initialize", ruby_curl_reactor_initialize, 0);
+  rb_define_method(cCurlReactor, "_submit", ruby_curl_reactor_submit, 1);
+  rb_define_method(cCurlReactor, "close", ruby_curl_reactor_close, 0);
+  rb_define_method(cCurlReactor, "closed?", ruby_curl_reactor_closed_p, 0);
+  rb_define_method(cCurlReactor, "pending", ruby_curl_reactor_pending, 0);
+  rb_define_method(cCurlReactor, "completed", ruby_curl_reactor_completed, 0);
+
+  cCurlReactorFuture = rb_define_class_under(cCurlReactor, "Future", rb_cObject);
+  rb_undef_alloc_func(cCurlReactorFuture);
+  rb_define_method(cCurlReactorFuture, "wait", ruby_curl_reactor_future_wait, -1);
+  rb_define_method(cCurlReactorFuture, "ready?", ruby_curl_reactor_future_ready_p, 0);
+  rb_define_method(cCurlReactorFuture, "easy", ruby_curl_reactor_future_easy, 0);
+#endif
+}
@@ -0,0 +1,23 @@
+/* curb_reactor.h - Curl multi handle driven by a native thread
+ * Licensed under the Ruby License. See LICENSE for details.
+ */
+#ifndef __CURB_REACTOR_H
+#define __CURB_REACTOR_H
+
+#include "curb_easy.h"
+
+#if defined(CURB_HAVE_TRANSFER_WITHOUT_GVL) && defined(HAVE_PTHREAD_H) && \
+    ((defined(HAVE_CURL_MULTI_POLL) && defined(HAVE_CURL_MULTI_WAKEUP)) || (defined(HAVE_CURL_MULTI_WAIT) && !defined(_WIN32)))
+#define CURB_HAVE_REACTOR 1
+#endif
+
+extern VALUE cCurlReactor;
+extern VALUE cCurlReactorFuture;
+
+#ifdef CURB_HAVE_REACTOR
+int rb_curl_reactor_disown_easy(ruby_curl_easy *rbce);
+#endif
+
+void init_curb_reactor();
+
+#endif
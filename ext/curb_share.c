@@ -0,0 +1,320 @@
+/* curb_share.c - Curl share handles
+ * Licensed under the Ruby License. See LICENSE for details.
+ *
+ * A Curl::Share wraps a CURLSH so easy handles in different multis (and
+ * different threads) can use one DNS cache, TLS session cache, connection
+ * cache, cookie jar, HSTS cache or PSL. Every kind of shared data gets its
+ * own rwlock: libcurl asks for shared access for lookups and exclusive
+ * access for updates, so readers of one cache never wait on another.
+ */
+#include "curb_config.h"
+#include <ruby.h>
+
+#include "curb_easy.h"
+#include "curb_errors.h"
+#include "curb_share.h"
+
+extern VALUE mCurl;
+VALUE cCurlShare;
+
+#ifdef RDOC_NEVER_DEFINED
+  mCurl = rb_define_module("Curl");
+#endif
+
+typedef struct {
+  const char *name;
+  curl_lock_data data;
+} curb_share_kind;
+
+static const curb_share_kind curb_share_kinds[] = {
+  { "cookie", CURL_LOCK_DATA_COOKIE },
+  { "dns", CURL_LOCK_DATA_DNS },
+  { "ssl_session", CURL_LOCK_DATA_SSL_SESSION },
+#ifdef HAVE_CURL_LOCK_DATA_CONNECT
+  { "connect", CURL_LOCK_DATA_CONNECT },
+#endif
+#ifdef HAVE_CURL_LOCK_DATA_PSL
+  { "psl", CURL_LOCK_DATA_PSL },
+#endif
+#ifdef HAVE_CURL_LOCK_DATA_HSTS
+  { "hsts", CURL_LOCK_DATA_HSTS },
+#endif
+};
+
+#define CURB_SHARE_KIND_COUNT (sizeof(curb_share_kinds) / sizeof(curb_share_kinds[0]))
+
+#ifdef CURB_SHARE_LOCKS
+static void curb_share_lock(CURL *handle, curl_lock_data data, curl_lock_access access, void *userptr) {
+  ruby_curl_share *rbcsh = (ruby_curl_share *)userptr;
+  (void)handle;
+
+  if ((int)data < 0 || data >= CURL_LOCK_DATA_LAST) return;
+  if (access == CURL_LOCK_ACCESS_SHARED) {
+    pthread_rwlock_rdlock(&rbcsh->locks[data]);
+  } else {
+    pthread_rwlock_wrlock(&rbcsh->locks[data]);
+  }
+}
+
+static void curb_share_unlock(CURL *handle, curl_lock_data data, void *userptr) {
+  ruby_curl_share *rbcsh = (ruby_curl_share *)userptr;
+  (void)handle;
+
+  if ((int)data < 0 || data >= CURL_LOCK_DATA_LAST) return;
+  pthread_rwlock_unlock(&rbcsh->locks[data]);
+}
+#endif
+
+static void curb_share_release(ruby_curl_share *rbcsh) {
+  int i;
+
+  if (rbcsh->handle && curl_share_cleanup(rbcsh->handle) != CURLSHE_OK) return;
+
+#ifdef CURB_SHARE_LOCKS
+  for (i = 0; i < CURL_LOCK_DATA_LAST; i++) {
+    pthread_rwlock_destroy(&rbcsh->locks[i]);
+  }
+#else
+  (void)i;
+#endif
+  xfree(rbcsh);
+}
+
+static void curl_share_free(void *ptr) {
+  ruby_curl_share *rbcsh = (ruby_curl_share *)ptr;
+
+  if (!rbcsh) return;
+
+  /* Easy handles only hold the share for the length of a transfer, so it is
+   * normally idle here. If one is still attached (both became garbage in
+   * the same GC, or the easy belongs to a reactor), that easy's cleanup
+   * locks the share: it frees it once detached. */
+  if (rbcsh->attached > 0) {
+    rbcsh->collected = 1;
+    return;
+  }
+  curb_share_release(rbcsh);
+}
+
+static size_t curl_share_memsize(const void *ptr) {
+  (void)ptr;
+  return sizeof(ruby_curl_share);
+}
+
+static const rb_data_type_t ruby_curl_share_data_type = {
+  "Curl::Share",
+  {
+    NULL,
+    curl_share_free,
+    curl_share_memsize,
+#ifdef RUBY_TYPED_FREE_IMMEDIATELY
+    NULL, /* compact */
+#endif
+  },
+#ifdef RUBY_TYPED_FREE_IMMEDIATELY
+  NULL, NULL, /* parent, data */
+  RUBY_TYPED_FREE_IMMEDIATELY
+#endif
+};
+
+static VALUE ruby_curl_share_alloc(VALUE klass) {
+  ruby_curl_share *rbcsh;
+  VALUE self = TypedData_Make_Struct(klass, ruby_curl_share, &ruby_curl_share_data_type, rbcsh);
+  int i;
+
+  rbcsh->handle = curl_share_init();
+  if (!rbcsh->handle) {
+    rb_raise(rb_eNoMemError, "Failed to initialize share handle");
+  }
+
+#ifdef CURB_SHARE_LOCKS
+  for (i = 0; i < CURL_LOCK_DATA_LAST; i++) {
+    pthread_rwlock_init(&rbcsh->locks[i], NULL);
+  }
+  curl_share_setopt(rbcsh->handle, CURLSHOPT_USERDATA, rbcsh);
+  curl_share_setopt(rbcsh->handle, CURLSHOPT_LOCKFUNC, curb_share_lock);
+  curl_share_setopt(rbcsh->handle, CURLSHOPT_UNLOCKFUNC, curb_share_unlock);
+#else
+  (void)i;
+#endif
+
+  return self;
+}
+
+/* Requires the GVL: make +rbce+'s transfers use +share+. */
+void ruby_curl_share_attach(ruby_curl_easy *rbce, VALUE share) {
+  ruby_curl_share *rbcsh;
+
+  TypedData_Get_Struct(share, ruby_curl_share, &ruby_curl_share_data_type, rbcsh);
+  if (rbce->attached_share == rbcsh) return;
+
+  ruby_curl_share_detach(rbce);
+#ifdef HAVE_CURLOPT_SHARE
+  curl_easy_setopt(rbce->curl, CURLOPT_SHARE, rbcsh->handle);
+#endif
+  rbcsh->attached++;
+  rbce->attached_share = rbcsh;
+}
+
+/* Requires the GVL (dfree included): let go of the share +rbce+ holds. */
+void ruby_curl_share_detach(ruby_curl_easy *rbce) {
+  ruby_curl_share *rbcsh = (ruby_curl_share *)rbce->attached_share;
+
+  if (!rbcsh) return;
+
+  rbce->attached_share = NULL;
+#ifdef HAVE_CURLOPT_SHARE
+  if (rbce->curl) curl_easy_setopt(rbce->curl, CURLOPT_SHARE, NULL);
+#endif
+  if (--rbcsh->attached == 0 && rbcsh->collected) {
+    curb_share_release(rbcsh);
+  }
+}
+
+static const curb_share_kind *curb_share_kind_for(VALUE kind) {
+  const char *name;
+  size_t i;
+
+  if (SYMBOL_P(kind)) kind = rb_sym2str(kind);
+  name = StringValueCStr(kind);
+  for (i = 0; i < CURB_SHARE_KIND_COUNT; i++) {
+    if (strcmp(curb_share_kinds[i].name, name) == 0) return &curb_share_kinds[i];
+  }
+
+  rb_raise(rb_eArgError, "cannot share %s with this libcurl", name);
+  return NULL;
+}
+
+static void curb_share_toggle(ruby_curl_share *rbcsh, VALUE kind, int on) {
+  const curb_share_kind *k = curb_share_kind_for(kind);
+  CURLSHcode code;
+
+  code = curl_share_setopt(rbcsh->handle, on ? CURLSHOPT_SHARE : CURLSHOPT_UNSHARE, k->data);
+  if (code != CURLSHE_OK) {
+    rb_raise(eCurlErrError, "cannot %sshare %s: %s", on ? "" : "un", k->name, curl_share_strerror(code));
+  }
+
+  if (on) {
+    rbcsh->shared |= 1L << k->data;
+  } else {
+    rbcsh->shared &= ~(1L << k->data);
+  }
+}
+
+/*
+ * call-seq:
+ *   Curl::Share.new                                  => #<Curl::Share>
+ *   Curl::Share.new(:dns, :ssl_session, :connect)    => #<Curl::Share>
+ *
+ * Create a share handle for the named kinds of data (see
+ * Curl::Share::KINDS); without arguments the DNS and TLS session caches are
+ * shared. Attach it with Curl::Easy#share=.
+ *
+ * When the extension is built with pthreads, libcurl's lock callbacks use
+ * one rwlock per kind of data, so easies in different threads and
+ * different multis may use the same share concurrently.
+ */
+static VALUE ruby_curl_share_initialize(int argc, VALUE *argv, VALUE self) {
+  ruby_curl_share *rbcsh;
+  int i;
+
+  TypedData_Get_Struct(self, ruby_curl_share, &ruby_curl_share_data_type, rbcsh);
+
+  if (argc == 0) {
+    curb_share_toggle(rbcsh, ID2SYM(rb_intern("dns")), 1);
+    curb_share_toggle(rbcsh, ID2SYM(rb_intern("ssl_session")), 1);
+  }
+  for (i = 0; i < argc; i++) {
+    curb_share_toggle(rbcsh, argv[i], 1);
+  }
+
+  return self;
+}
+
+/*
+ * call-seq:
+ *   share.share(:cookie)                             => share
+ *
+ * Start sharing another kind of data.
+ */
+static VALUE ruby_curl_share_share(VALUE self, VALUE kind) {
+  ruby_curl_share *rbcsh;
+
+  TypedData_Get_Struct(self, ruby_curl_share, &ruby_curl_share_data_type, rbcsh);
+  curb_share_toggle(rbcsh, kind, 1);
+  return self;
+}
+
+/*
+ * call-seq:
+ *   share.unshare(:cookie)                           => share
+ *
+ * Stop sharing a kind of data. Raises Curl::Err::CurlError while an easy
+ * using the share is transferring.
+ */
+static VALUE ruby_curl_share_unshare(VALUE self, VALUE kind) {
+  ruby_curl_share *rbcsh;
+
+  TypedData_Get_Struct(self, ruby_curl_share, &ruby_curl_share_data_type, rbcsh);
+  curb_share_toggle(rbcsh, kind, 0);
+  return self;
+}
+
+/*
+ * call-seq:
+ *   share.shared                                     => [:dns, :ssl_session]
+ *
+ * The kinds of data currently shared.
+ */
+static VALUE ruby_curl_share_shared(VALUE self) {
+  ruby_curl_share *rbcsh;
+  VALUE kinds = rb_ary_new();
+  size_t i;
+
+  TypedData_Get_Struct(self, ruby_curl_share, &ruby_curl_share_data_type, rbcsh);
+  for (i = 0; i < CURB_SHARE_KIND_COUNT; i++) {
+    if (rbcsh->shared & (1L << curb_share_kinds[i].data)) {
+      rb_ary_push(kinds, ID2SYM(rb_intern(curb_share_kinds[i].name)));
+    }
+  }
+
+  return kinds;
+}
+
+/*
+ * call-seq:
+ *   share.shared?(:dns)                              => true or false
+ */
+static VALUE ruby_curl_share_shared_p(VALUE self, VALUE kind) {
+  ruby_curl_share *rbcsh;
+  const curb_share_kind *k;
+
+  TypedData_Get_Struct(self, ruby_curl_share, &ruby_curl_share_data_type, rbcsh);
+  k = curb_share_kind_for(kind);
+  return (rbcsh->shared & (1L << k->data)) ? Qtrue : Qfalse;
+}
+
+void init_curb_share() {
+  VALUE kinds = rb_ary_new();
+  size_t i;
+
+  cCurlShare = rb_define_class_under(mCurl, "Share", rb_cObject);
+  rb_define_alloc_func(cCurlShare, ruby_curl_share_alloc);
+  rb_define_method(cCurlShare, "initialize", ruby_curl_share_initialize, -1);
+  rb_define_method(cCurlShare, "share", ruby_curl_share_share, 1);
+  rb_define_method(cCurlShare, "unshare", ruby_curl_share_unshare, 1);
+  rb_define_method(cCurlShare, "shared", ruby_curl_share_shared, 0);
+  rb_define_method(cCurlShare, "shared?", ruby_curl_share_shared_p, 1);
+
+  /* Kinds of data this build of libcurl can share. */
+  for (i = 0; i < CURB_SHARE_KIND_COUNT; i++) {
+    rb_ary_push(kinds, ID2SYM(rb_intern(curb_share_kinds[i].name)));
+  }
+  rb_define_const(cCurlShare, "KINDS", rb_obj_freeze(kinds));
+  /* True when the share's lock callbacks make it safe across threads. */
+#ifdef CURB_SHARE_LOCKS
+  rb_define_const(cCurlShare, "THREAD_SAFE", Qtrue);
+#else
+  rb_define_const(cCurlShare, "THREAD_SAFE", Qfalse);
+#endif
+}
@@ -0,0 +1,30 @@
+/* curb_share.h - Curl share handles
+ * Licensed under the Ruby License. See LICENSE for details.
+ */
+#ifndef __CURB_SHARE_H
+#define __CURB_SHARE_H
+
+#include "curb_easy.h"
+
+#ifdef HAVE_PTHREAD_H
+#define CURB_SHARE_LOCKS 1
+#include <pthread.h>
+#endif
+
+typedef struct {
+  CURLSH *handle;
+  long shared;   /* bitmask of CURL_LOCK_DATA_* currently shared */
+  long attached; /* easy handles holding CURLOPT_SHARE on it */
+  char collected; /* the Curl::Share is gone: the last easy to detach frees this */
+#ifdef CURB_SHARE_LOCKS
+  pthread_rwlock_t locks[CURL_LOCK_DATA_LAST];
+#endif
+} ruby_curl_share;
+
+extern VALUE cCurlShare;
+
+void ruby_curl_share_attach(ruby_curl_easy *rbce, VALUE share);
+void ruby_curl_share_detach(ruby_curl_easy *rbce);
+void init_curb_share();
+
+#endif
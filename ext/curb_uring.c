@@ -0,0 +1,192 @@
+/* curb_uring.c - minimal io_uring ring for the multi socket-action loop
+ * Licensed under the Ruby License. See LICENSE for details.
+ *
+ * Just enough of io_uring, through the raw syscalls, to wait for socket
+ * readiness: poll-add (multishot where the kernel supports it),
+ * poll-remove and a timeout. Interest changes queue SQEs that go to the
+ * kernel with the next wait, so a tick costs one io_uring_enter however many
+ * sockets libcurl re-armed.
+ */
+#include "curb_uring.h"
+
+#ifdef CURB_HAVE_IO_URING
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+static int curb_uring_setup(unsigned entries, struct io_uring_params *params) {
+  return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int curb_uring_enter(curb_uring *ring, unsigned to_submit, unsigned min_complete, unsigned flags) {
+  if (ring->syscalls) (*ring->syscalls)++;
+  return (int)syscall(__NR_io_uring_enter, ring->fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+int curb_uring_open(curb_uring *ring, unsigned entries) {
+  struct io_uring_params params;
+  int err;
+
+  memset(ring, 0, sizeof(*ring));
+  memset(&params, 0, sizeof(params));
+  ring->fd = curb_uring_setup(entries, &params);
+  if (ring->fd < 0) return -errno;
+
+  ring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  ring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+
+  ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                       ring->fd, IORING_OFF_SQ_RING);
+  if (ring->sq_ring == MAP_FAILED) goto fail;
+  ring->cq_ring = mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                       ring->fd, IORING_OFF_CQ_RING);
+  if (ring->cq_ring == MAP_FAILED) goto fail;
+  ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                    ring->fd, IORING_OFF_SQES);
+  if (ring->sqes == MAP_FAILED) goto fail;
+
+  ring->sq_head = (unsigned *)((char *)ring->sq_ring + params.sq_off.head);
+  ring->sq_tail = (unsigned *)((char *)ring->sq_ring + params.sq_off.tail);
+  ring->sq_mask = (unsigned *)((char *)ring->sq_ring + params.sq_off.ring_mask);
+  ring->sq_entries = (unsigned *)((char *)ring->sq_ring + params.sq_off.ring_entries);
+  ring->sq_array = (unsigned *)((char *)ring->sq_ring + params.sq_off.array);
+  ring->cq_head = (unsigned *)((char *)ring->cq_ring + params.cq_off.head);
+  ring->cq_tail = (unsigned *)((char *)ring->cq_ring + params.cq_off.tail);
+  ring->cq_mask = (unsigned *)((char *)ring->cq_ring + params.cq_off.ring_mask);
+  ring->cqes = (struct io_uring_cqe *)((char *)ring->cq_ring + params.cq_off.cqes);
+  ring->sq_local_tail = *ring->sq_tail;
+#ifdef IORING_POLL_ADD_MULTI
+  ring->multishot = 1;
+#endif
+  return 0;
+
+fail:
+  err = -errno;
+  if (ring->sq_ring == MAP_FAILED) ring->sq_ring = NULL;
+  if (ring->cq_ring == MAP_FAILED) ring->cq_ring = NULL;
+  if (ring->sqes == MAP_FAILED) ring->sqes = NULL;
+  curb_uring_close(ring);
+  return err;
+}
+
+void curb_uring_close(curb_uring *ring) {
+  if (ring->sqes) munmap(ring->sqes, ring->sqes_size);
+  if (ring->cq_ring) munmap(ring->cq_ring, ring->cq_ring_size);
+  if (ring->sq_ring) munmap(ring->sq_ring, ring->sq_ring_size);
+  if (ring->fd >= 0) close(ring->fd);
+  ring->sqes = NULL;
+  ring->cq_ring = ring->sq_ring = NULL;
+  ring->fd = -1;
+}
+
+/* Hand queued SQEs to the kernel, waiting for min_complete completions. */
+static int curb_uring_flush(curb_uring *ring, unsigned min_complete) {
+  int rc;
+
+  __atomic_store_n(ring->sq_tail, ring->sq_local_tail, __ATOMIC_RELEASE);
+  if (ring->to_submit == 0 && min_complete == 0) return 0;
+
+  rc = curb_uring_enter(ring, ring->to_submit, min_complete, min_complete ? IORING_ENTER_GETEVENTS : 0);
+  if (rc < 0) return -errno;
+  ring->to_submit -= (unsigned)rc < ring->to_submit ? (unsigned)rc : ring->to_submit;
+  return 0;
+}
+
+static struct io_uring_sqe *curb_uring_get_sqe(curb_uring *ring) {
+  struct io_uring_sqe *sqe;
+  unsigned head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+  unsigned index;
+
+  if (ring->sq_local_tail - head >= *ring->sq_entries) {
+    /* Full: submit what is queued without waiting and try again. */
+    if (curb_uring_flush(ring, 0) < 0) return NULL;
+    head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+    if (ring->sq_local_tail - head >= *ring->sq_entries) return NULL;
+  }
+
+  index = ring->sq_local_tail & *ring->sq_mask;
+  sqe = &ring->sqes[index];
+  memset(sqe, 0, sizeof(*sqe));
+  ring->sq_array[index] = index;
+  ring->sq_local_tail++;
+  ring->to_submit++;
+  return sqe;
+}
+
+int curb_uring_poll_add(curb_uring *ring, int fd, unsigned poll_mask, uint64_t user_data) {
+  struct io_uring_sqe *sqe = curb_uring_get_sqe(ring);
+
+  if (!sqe) return -EBUSY;
+  sqe->opcode = IORING_OP_POLL_ADD;
+  sqe->fd = fd;
+#ifdef IORING_FEAT_POLL_32BITS
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  poll_mask = (poll_mask << 16) | (poll_mask >> 16);
+#endif
+  sqe->poll32_events = poll_mask;
+#else
+  sqe->poll_events = (uint16_t)poll_mask;
+#endif
+#ifdef IORING_POLL_ADD_MULTI
+  if (ring->multishot) sqe->len = IORING_POLL_ADD_MULTI;
+#endif
+  sqe->user_data = user_data;
+  return 0;
+}
+
+int curb_uring_poll_remove(curb_uring *ring, uint64_t user_data) {
+  struct io_uring_sqe *sqe = curb_uring_get_sqe(ring);
+
+  if (!sqe) return -EBUSY;
+  sqe->opcode = IORING_OP_POLL_REMOVE;
+  sqe->fd = -1;
+  sqe->addr = user_data;
+  /* user_data 0 marks completions the caller ignores */
+  sqe->user_data = 0;
+  return 0;
+}
+
+/*
+ * Submit everything queued and wait up to timeout_ms for a completion
+ * (0 only submits and returns). The wait is bounded by a timeout SQE whose
+ * count is 1: it completes as soon as any other completion is posted, so it
+ * never outlives the wait it belongs to.
+ */
+int curb_uring_submit_and_wait(curb_uring *ring, long timeout_ms, uint64_t timeout_user_data) {
+  struct io_uring_sqe *sqe;
+
+  if (timeout_ms <= 0) return curb_uring_flush(ring, 0);
+
+  sqe = curb_uring_get_sqe(ring);
+  if (!sqe) return -EBUSY;
+  /* Kept in the ring: if the enter is interrupted before submitting, the
+   * SQE goes out with the next one and must still find its timespec. */
+  ring->timeout.tv_sec = timeout_ms / 1000;
+  ring->timeout.tv_nsec = (long long)(timeout_ms % 1000) * 1000000LL;
+  sqe->opcode = IORING_OP_TIMEOUT;
+  sqe->fd = -1;
+  sqe->addr = (uint64_t)(uintptr_t)&ring->timeout;
+  sqe->len = 1;
+  sqe->off = 1;
+  sqe->user_data = timeout_user_data;
+  return curb_uring_flush(ring, 1);
+}
+
+/* Pop one completion; returns 0 when the completion queue is empty. */
+int curb_uring_next_cqe(curb_uring *ring, uint64_t *user_data, int *res, unsigned *flags) {
+  unsigned head = *ring->cq_head;
+  struct io_uring_cqe *cqe;
+
+  if (head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) return 0;
+
+  cqe = &ring->cqes[head & *ring->cq_mask];
+  *user_data = cqe->user_data;
+  *res = cqe->res;
+  *flags = cqe->flags;
+  __atomic_store_n(ring->cq_head, head + 1, __ATOMIC_RELEASE);
+  return 1;
+}
+#endif
@@ -0,0 +1,60 @@
+/* curb_uring.h - minimal io_uring ring for the multi socket-action loop
+ * Licensed under the Ruby License. See LICENSE for details.
+ */
+#ifndef __CURB_URING_H
+#define __CURB_URING_H
+
+#include "curb_config.h"
+
+#if defined(HAVE_LINUX_IO_URING_H) && defined(__linux__)
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+/* IORING_FEAT_SINGLE_MMAP arrived with IORING_OP_TIMEOUT (Linux 5.4). */
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter) && defined(IORING_FEAT_SINGLE_MMAP)
+#define CURB_HAVE_IO_URING 1
+#endif
+#endif
+
+#ifdef CURB_HAVE_IO_URING
+#include <stddef.h>
+#include <stdint.h>
+
+/* struct __kernel_timespec, which older headers do not export */
+struct curb_uring_timespec {
+  int64_t tv_sec;
+  long long tv_nsec;
+};
+
+typedef struct {
+  int fd;
+  unsigned *sq_head;
+  unsigned *sq_tail;
+  unsigned *sq_mask;
+  unsigned *sq_entries;
+  unsigned *sq_array;
+  unsigned *cq_head;
+  unsigned *cq_tail;
+  unsigned *cq_mask;
+  struct io_uring_sqe *sqes;
+  struct io_uring_cqe *cqes;
+  void *sq_ring;
+  size_t sq_ring_size;
+  void *cq_ring;
+  size_t cq_ring_size;
+  size_t sqes_size;
+  unsigned sq_local_tail;  /* next free SQE slot; published on enter */
+  unsigned to_submit;
+  char multishot;          /* cleared once the kernel rejects multishot polls */
+  unsigned long *syscalls; /* bumped for every io_uring_enter, when set */
+  struct curb_uring_timespec timeout; /* read by the kernel when the timeout SQE is submitted */
+} curb_uring;
+
+int curb_uring_open(curb_uring *ring, unsigned entries);
+void curb_uring_close(curb_uring *ring);
+int curb_uring_poll_add(curb_uring *ring, int fd, unsigned poll_mask, uint64_t user_data);
+int curb_uring_poll_remove(curb_uring *ring, uint64_t user_data);
+int curb_uring_submit_and_wait(curb_uring *ring, long timeout_ms, uint64_t timeout_user_data);
+int curb_uring_next_cqe(curb_uring *ring, uint64_t *user_data, int *res, unsigned *flags);
+#endif
+
+#endif
@@ -333,6 +333,8 @@ have_constant "curlinfo_speed_upload_t"
 have_constant "curlinfo_speed_download_t"
 have_constant "curlinfo_content_length_download_t"
 have_constant "curlinfo_content_length_upload_t"
+# CURLINFO_*_TIME -> CURLINFO_*_TIME_T (since 7.61.0)
+have_constant "curlinfo_total_time_t"
 
 # additional consts
 have_constant "curle_conv_failed"
@@ -348,6 +350,9 @@ have_constant "curle_ssl_issuer_error"
 # added in 7.18.2
 have_constant "curlinfo_redirect_url"
 
+# added in 7.66.0
+have_constant "curlinfo_retry_after"
+
 # username/password added in 7.19.1
 have_constant "curlopt_username"
 have_constant "curlopt_password"
@@ -594,6 +599,10 @@ have_constant "curlkhstat_defer"
 have_constant "curlopt_ssh_keydata"
 have_constant "curlopt_private"
 have_constant "curlopt_share"
+# share lock data kinds, added in 7.57.0, 7.61.0 and 7.88.0
+have_constant "curl_lock_data_connect"
+have_constant "curl_lock_data_psl"
+have_constant "curl_lock_data_hsts"
 have_constant "curlopt_new_file_perms"
 have_constant "curlopt_new_directory_perms"
 have_constant "curlopt_telnetoptions"
@@ -628,6 +637,17 @@ have_constant "curlopt_path_as_is"
 # added in 7.43.0
 have_constant "curlopt_pipewait"
 
+# added in 7.46.0
+have_constant "curlopt_stream_weight"
+have_constant "curlopt_stream_depends"
+have_constant "curlopt_stream_depends_e"
+
+# added in 7.50.0
+have_constant "curlinfo_http_version"
+
+# added in 7.67.0
+have_constant "curlmopt_max_concurrent_streams"
+
 have_constant "curlopt_proxy_ssl_verifyhost"
 
 # protocol constants
@@ -696,6 +716,7 @@ test_for("curl_easy_escape", "CURL_EASY_ESCAPE", %{
 
 have_func('rb_thread_blocking_region')
 have_header('ruby/thread.h') && have_func('rb_thread_call_without_gvl', 'ruby/thread.h')
+have_func('rb_thread_call_with_gvl', 'ruby/thread.h')
 have_header('ruby/io.h')
 # Ruby 4.x exports rb_thread_fd_select without declaring it in ruby/io.h.
 have_func('rb_thread_fd_select')
@@ -717,6 +738,26 @@ have_func('curl_multi_timer_callback')
 have_constant 'curlmopt_socketfunction'
 have_constant 'curlmopt_timerfunction'
 have_func('curl_easy_duphandle')
+# Easy#response_headers reads libcurl's header store when there is one.
+have_func('curl_easy_nextheader')
+have_func('rb_str_to_interned_str')
+# Linux readiness backend for the socket-action drive loop.
+have_header('sys/epoll.h') && have_func('epoll_create1', 'sys/epoll.h')
+# Wakes a blocked Multi#perform when work is added from another thread.
+have_header('sys/eventfd.h') && have_func('eventfd', 'sys/eventfd.h')
+# io_uring is driven through raw syscalls; only the UAPI header is needed.
+have_header('linux/io_uring.h')
+# Curl::Reactor runs its multi handle on a native thread.
+have_header('pthread.h')
+# Multi#release_gvl= and Curl::Reactor keep per-thread transfer state.
+# Ruby only exports RB_THREAD_LOCAL_SPECIFIER from 3.3, so find our own.
+checking_for("thread-local storage") do
+  specifier = %w[_Thread_local __thread].find do |spec|
+    try_compile("static #{spec} int counter; int main() { counter = 1; return counter; }")
+  end
+  $defs.push("-DCURB_THREAD_LOCAL=#{specifier}") if specifier
+  specifier || false
+end
 
 # Optional: enable verbose socket-action debug logging.
 # Set CURB_SOCKET_DEBUG=1 in the environment before running extconf to enable.
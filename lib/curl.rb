@@ -3,6 +3,8 @@ require 'curb_core'
 require 'curl/download'
 require 'curl/easy'
 require 'curl/multi'
+require 'curl/reactor'
+require 'curl/ractor_pool'
 require 'ipaddr'
 require 'uri'
 
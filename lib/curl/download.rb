@@ -98,6 +98,29 @@ module Curl
     def open_safe_download_output(path, overwrite: false)
       SafeDownloadOutput.new(path, overwrite: overwrite)
     end
+
+    # The IO whose descriptor a download can write(2) to directly, or nil
+    # when chunks have to go through Ruby, e.g. for an IO that overrides
+    # #write.
+    def download_output_io(output)
+      io = output.is_a?(SafeDownloadOutput) ? output.to_io : output
+      io if io.is_a?(IO) && !io.closed? && io.method(:write).owner == IO
+    end
+
+    # A multi that drives its transfers with the GVL released, so other
+    # threads keep running while bodies stream to disk. nil under a fiber
+    # scheduler, where a blocking drive would stall the other fibers, and on
+    # Rubies that cannot release the GVL.
+    def download_multi
+      return nil if scheduler_active?
+
+      multi = Curl::Multi.new
+      multi.release_gvl = true
+      multi
+    rescue NotImplementedError
+      multi.close if multi
+      nil
+    end
   end
 
   class SafeDownloadOutput
@@ -121,6 +144,10 @@ module Curl
       write(data)
     end
 
+    def to_io
+      @tmp.to_io
+    end
+
     def close(success = false)
       return if @closed
 
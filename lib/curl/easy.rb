@@ -85,6 +85,94 @@ module Curl
           end
         end
       end
+
+      #
+      # call-seq:
+      #   Curl::Easy.connection_pool = true
+      #   Curl::Easy.connection_pool = { max_connections: 8, idle_timeout: 30 }
+      #   Curl::Easy.connection_pool = nil
+      #
+      # Let Curl::Easy#perform on an easy without a multi of its own (and so
+      # Curl.get, Curl.post, Curl::Easy.perform, ...) run on a Curl::Multi
+      # kept per thread, so consecutive requests from that thread reuse
+      # keep-alive connections instead of connecting and handshaking anew.
+      #
+      # +max_connections+ (default 16) caps the connections the pooled multi
+      # keeps open. When a thread's pool has been idle for +idle_timeout+
+      # seconds (default 60) its connections are closed before the next
+      # request. The setting applies to the current Ractor, like
+      # Curl::Multi.autoclose; nil turns pooling off and closes this thread's
+      # pool.
+      #
+      def connection_pool=(options)
+        options = { max_connections: 16, idle_timeout: 60 }.merge(options == true ? {} : options.to_h) if options
+        if options
+          unknown = options.keys - [:max_connections, :idle_timeout]
+          raise ArgumentError, "unknown connection_pool option: #{unknown.first.inspect}" unless unknown.empty?
+          raise ArgumentError, "max_connections must be > 0" unless Integer(options[:max_connections]) > 0
+          raise ArgumentError, "idle_timeout must be >= 0" if Float(options[:idle_timeout]) < 0
+          options = options.freeze
+        end
+        Curl.__send__(:ractor_local_state)[:connection_pool] = options
+        close_connection_pool unless options
+      end
+
+      #
+      # call-seq:
+      #   Curl::Easy.connection_pool                     => hash or nil
+      #
+      def connection_pool
+        Curl.__send__(:ractor_local_state)[:connection_pool]
+      end
+
+      #
+      # call-seq:
+      #   Curl::Easy.close_connection_pool               => nil
+      #
+      # Close the current thread's pooled multi and its connections.
+      #
+      def close_connection_pool
+        pool = Thread.current.thread_variable_get(:__curb_connection_pool)
+        Thread.current.thread_variable_set(:__curb_connection_pool, nil)
+        pool[:multi].close if pool && !pool[:busy] && pool[:pid] == Process.pid
+        nil
+      end
+
+      # The current thread's pooled multi, created on first use; nil when
+      # pooling is off or the multi is already driving a transfer (a perform
+      # from inside a callback), which then gets a multi of its own.
+      def pooled_multi
+        options = connection_pool
+        return nil unless options
+
+        pool = Thread.current.thread_variable_get(:__curb_connection_pool)
+        pool = nil if pool && pool[:pid] != Process.pid # inherited over fork
+        return nil if pool && pool[:busy]
+
+        now = Process.clock_gettime(Process::CLOCK_MONOTONIC)
+        if pool && now - pool[:used_at] > options[:idle_timeout]
+          pool[:multi].close
+          pool = nil
+        end
+        unless pool
+          multi = Curl::Multi.new
+          multi.max_connects = options[:max_connections]
+          pool = { multi: multi, pid: Process.pid, busy: false }
+          Thread.current.thread_variable_set(:__curb_connection_pool, pool)
+        end
+        pool[:used_at] = now
+        pool
+      end
+
+      # Drop the current thread's pooled multi after a failed perform; it is
+      # closed like any implicit multi once +easy+ lets go of it.
+      def discard_pooled_multi(pool, easy)
+        if Thread.current.thread_variable_get(:__curb_connection_pool).equal?(pool)
+          Thread.current.thread_variable_set(:__curb_connection_pool, nil)
+        end
+        defer_multi_close(pool[:multi], easy) unless release_deferred_multi_close(pool[:multi], easy)
+      end
+      private :pooled_multi, :discard_pooled_multi
     end
 
     at_exit do
@@ -268,6 +356,21 @@ module Curl
 
       if Curl.scheduler_active? && self.multi.nil?
         ret = Curl.perform_with_scheduler(self)
+      elsif self.multi.nil? && (pool = self.class.__send__(:pooled_multi))
+        multi = pool[:multi]
+        pool[:busy] = true
+        begin
+          multi.add(self)
+          ret = multi.perform
+          multi.remove(self) if self.multi == multi
+        rescue Exception
+          self.class.__send__(:discard_pooled_multi, pool, self)
+          self.multi = nil if self.multi == multi
+          raise
+        ensure
+          pool[:busy] = false
+          pool[:used_at] = Process.clock_gettime(Process::CLOCK_MONOTONIC)
+        end
       else
         multi = self.multi
         created_multi = multi.nil?
@@ -363,6 +466,49 @@ module Curl
       http_version
     end
 
+    # Transport errors retried by default under Easy#retry_policy=.
+    RETRYABLE_ERRORS = [
+      Curl::Err::ConnectionFailedError, Curl::Err::TimeoutError,
+      Curl::Err::GotNothingError, Curl::Err::SendError,
+      Curl::Err::RecvError, Curl::Err::PartialFileError
+    ].freeze
+
+    # HTTP statuses retried by default under Easy#retry_policy=.
+    RETRYABLE_STATUSES = [408, 429, 502, 503, 504].freeze
+
+    #
+    # call-seq:
+    #   easy.retry_policy = 3                            => 3
+    #   easy.retry_policy = { attempts: 3, backoff: 0.2, statuses: [503] }
+    #   easy.retry_policy = nil                          => nil
+    #
+    # Retry failed transfers from within the multi handle that runs them
+    # (Easy#perform uses one too). A retryable attempt is taken off the
+    # multi, and put back once its backoff has passed, without blocking the
+    # loop: other transfers keep running meanwhile, and status callbacks
+    # (on_complete, on_failure, ...) only see the final attempt.
+    #
+    # Options, with their defaults:
+    #
+    # attempts::    retries after the first attempt (an Integer policy sets only this)
+    # backoff::     0.1 seconds before the first retry, doubled for each next one
+    # max_backoff:: 30 seconds; the backoff never grows beyond this
+    # jitter::      0.5; up to this fraction of each backoff is taken off at random
+    # on::          CURLcodes or Curl::Err classes to retry, default RETRYABLE_ERRORS
+    # statuses::    HTTP statuses to retry, default RETRYABLE_STATUSES
+    # retry_after:: true; wait at least as long as a Retry-After header asks.
+    #               A response asking for more than max_backoff is returned
+    #               as is rather than retried.
+    #
+    # Requests with an upload stream, on_body or on_header are never
+    # retried, because the data they already streamed cannot be replayed.
+    # Easy#retry_count tells how many retries the last request took.
+    #
+    def retry_policy=(policy)
+      self._retry_policy = policy && self.class.__send__(:normalize_retry_policy, policy)
+      policy
+    end
+
     #
     # call-seq:
     #   easy.url = "http://some.url/"                    => "http://some.url/"
@@ -548,6 +694,25 @@ module Curl
       set :cookielist, value
     end
 
+    #
+    # call-seq:
+    #   easy.prewarm(per_host: 1)                        => hash
+    #
+    # Open +per_host+ connections to this easy's origin in the multi handle
+    # it performs on (the thread's pool with Curl::Easy.connection_pool,
+    # otherwise its own multi, created and kept if needed), so the next
+    # perform reuses a warm connection. See Curl::Multi#prewarm for the
+    # returned report. With Curl::Multi.autoclose the multi, and its
+    # connections, are closed after each perform.
+    #
+    def prewarm(per_host: 1)
+      if multi.nil? && (pool = self.class.__send__(:pooled_multi))
+        return pool[:multi].prewarm([self], per_host: per_host)
+      end
+      self.multi ||= Curl::Multi.new
+      multi.prewarm([self], per_host: per_host)
+    end
+
     #
     # call-seq:
     #  easy = Curl::Easy.new("url") do|c|
@@ -759,6 +924,10 @@ module Curl
       # If a block is supplied, it will be passed the curl instance prior to the
       # perform call.
       #
+      # Without an on_body handler the body is written to the file's descriptor
+      # straight from the transfer (see #body_io=), with the GVL released where
+      # Curl::Multi#release_gvl= is supported.
+      #
       # *Note* that the semantics of the on_body handler are subtly changed when using
       # download, to account for the automatic routing of data to the specified file: The
       # data string is passed to the handler *before* it is written
@@ -772,15 +941,31 @@ module Curl
         _download_path, output, safe_output = Curl.prepare_download_output(url, filename, download_options)
 
         performed = false
+        multi = nil
         begin
-          old_on_body = curl.on_body do |data|
-            result = old_on_body ?  old_on_body.call(data) : data.length
-            output << data if result == data.length
-            result
+          min_chunk = curl.body_min_chunk
+          old_on_body = curl.on_body
+          io = Curl.download_output_io(output) unless old_on_body
+          if io
+            # Nothing needs to see the chunks: write them from C, off the GVL.
+            curl.body_io = io
+            if curl.multi.nil? && (multi = Curl.download_multi)
+              curl.multi = multi
+            end
+          else
+            curl.on_body(min_chunk: min_chunk) do |data|
+              result = old_on_body ?  old_on_body.call(data) : data.length
+              output << data if result == data.length
+              result
+            end
           end
           curl.perform
           performed = true
         ensure
+          if multi
+            curl.multi = nil if curl.multi == multi
+            multi.close
+          end
           if safe_output
             output.close(performed)
           else
@@ -790,6 +975,33 @@ module Curl
 
         return curl
       end
+
+      def normalize_retry_policy(policy)
+        policy = { attempts: policy } if policy.is_a?(Integer)
+        unknown = policy.keys - [:attempts, :backoff, :max_backoff, :jitter, :on, :statuses, :retry_after]
+        raise ArgumentError, "unknown retry_policy option: #{unknown.first.inspect}" unless unknown.empty?
+
+        {
+          attempts: Integer(policy.fetch(:attempts)),
+          backoff: Float(policy.fetch(:backoff, 0.1)),
+          max_backoff: Float(policy.fetch(:max_backoff, 30.0)),
+          jitter: Float(policy.fetch(:jitter, 0.5)),
+          on: Array(policy.fetch(:on, RETRYABLE_ERRORS)).map { |error| retry_error_code(error) }.uniq.freeze,
+          statuses: Array(policy.fetch(:statuses, RETRYABLE_STATUSES)).map { |status| Integer(status) }.uniq.freeze,
+          retry_after: policy.fetch(:retry_after, true) ? true : false
+        }.freeze
+      end
+
+      def retry_error_code(error)
+        return Integer(error) unless error.is_a?(Class)
+
+        @retry_error_codes ||= (1...128).each_with_object({}) do |code, codes|
+          klass, = Curl::Easy.error(code)
+          codes[klass] ||= code
+        end
+        @retry_error_codes.fetch(error) { raise ArgumentError, "no CURLcode maps to #{error}" }
+      end
+      private :normalize_retry_policy, :retry_error_code
     end
 
     # Allow the incoming cert string to be file:password
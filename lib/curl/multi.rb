@@ -101,20 +101,20 @@ module Curl
         # maintain a sane number of easy handles
         multi_options[:max_connects] = max_connects = multi_options.key?(:max_connects) ? multi_options[:max_connects] : 10
 
-        free_handles = [] # keep a list of free easy handles
-
         # configure the multi handle
         multi_options.each { |k,v| m.send("#{k}=", v) }
+        # the native queue admits the next url as soon as a transfer finishes
+        m.max_in_flight = max_connects unless multi_options.key?(:max_in_flight)
         callbacks = [:on_progress,:on_debug,:on_failure,:on_success,:on_redirect,:on_missing,:on_body,:on_header]
 
-        add_free_handle = proc do|conf, easy|
+        enqueue_handle = proc do|conf|
           c       = conf.dup # avoid being destructive to input
           url     = c.delete(:url)
           method  = c.delete(:method)
           headers = c.delete(:headers)
           internal_info = c.delete(:__curb_internal_info)
 
-          easy    = Curl::Easy.new if easy.nil?
+          easy    = Curl::Easy.new
 
           easy.url = url
 
@@ -150,7 +150,6 @@ module Curl
           c.each { |k,v| easy.send("#{k}=",v) }
 
           easy.on_complete {|curl|
-            free_handles << curl
             if blk
               if internal_info
                 blk.call(curl,curl.response_code,method,internal_info)
@@ -159,35 +158,29 @@ module Curl
               end
             end
           }
-          m.add(easy)
-        end
-
-        max_connects.times do
-          conf = urls_with_config.pop
-          add_free_handle.call(conf, nil) if conf
-          break if urls_with_config.empty?
+          m.enqueue(easy)
         end
 
-        consume_free_handles = proc do
-          # as we idle consume free handles
-          if urls_with_config.size > 0 && free_handles.size > 0
-            easy = free_handles.pop
-            conf = urls_with_config.pop
-            add_free_handle.call(conf, easy) if conf
+        # feed the queue as it drains instead of building every easy up
+        # front, so about two handles per slot exist however many urls come in
+        prefetch = m.max_in_flight > 0 ? m.max_in_flight : urls_with_config.size
+        refill = proc do
+          while m.queue_size < prefetch && (conf = urls_with_config.pop)
+            enqueue_handle.call(conf)
           end
         end
 
         begin
-          if urls_with_config.empty?
-            m.perform
-          else
-            until urls_with_config.empty?
-              m.perform do
-                consume_free_handles.call
-              end
-              consume_free_handles.call
+          refill.call
+          until urls_with_config.empty? && m.idle?
+            # a perform block is yielded every tick: only pass one while
+            # there is something left to feed
+            if urls_with_config.empty?
+              m.perform
+            else
+              m.perform { refill.call }
             end
-            free_handles = nil
+            refill.call
           end
         ensure
           m.close
@@ -249,19 +242,34 @@ module Curl
           }
         end
 
+        custom_body = easy_options.key?(:on_body) || easy_options.key?(:body_io) || easy_options.key?(:body_fd)
         download_infos.each do |info|
           info[:file] ||= Curl.open_safe_download_output(info[:path], :overwrite => info[:overwrite])
           file = info[:file]
-          procs << (lambda {|data| file.write data; data.size })
           files << file
 
+          # write(2) straight to the file from C unless something wants the chunks
+          io = Curl.download_output_io(file) unless custom_body || (info[:urlcfg].is_a?(Hash) && info[:urlcfg].key?(:on_body))
+          sink = if io
+            {:body_io => io}
+          else
+            procs << (lambda {|data| file.write data; data.size })
+            {:on_body => procs.last}
+          end
+
           if info[:urlcfg].is_a?(Hash)
-            urls_with_config << info[:urlcfg].merge({:on_body => procs.last, :__curb_internal_info => info}.merge(easy_options))
+            urls_with_config << info[:urlcfg].merge(sink).merge({:__curb_internal_info => info}.merge(easy_options))
           else
-            urls_with_config << {:url => info[:url], :on_body => procs.last, :method => :get, :__curb_internal_info => info}.merge(easy_options)
+            urls_with_config << {:url => info[:url], :method => :get, :__curb_internal_info => info}.merge(sink).merge(easy_options)
           end
         end
 
+        # no Ruby runs per chunk, so let other threads have the GVL meanwhile
+        if procs.empty? && !multi_options.key?(:release_gvl) && (probe = Curl.download_multi)
+          probe.close
+          multi_options = multi_options.merge(:release_gvl => true)
+        end
+
         finalize_download = lambda do |curl, info|
           file = info[:file]
           files.reject!{|f| f == file }
@@ -326,10 +334,11 @@ module Curl
       requests.each do |_,easy|
         remove(easy)
       end
+      _clear_queue
     end
 
     def idle?
-      requests.empty?
+      requests.empty? && queue_size.zero?
     end
 
     def requests
@@ -425,7 +434,7 @@ module Curl
 
     alias_method :_curb_native_perform, :perform
 
-    def perform(*args, &block)
+    def perform(*args, **options, &block)
       requests.each_value do |easy|
         Curl.__send__(:apply_safety!, easy) if Curl.respond_to?(:apply_safety!, true)
         signature = __curb_safety_signature_for(easy)
@@ -436,7 +445,7 @@ module Curl
         end
       end
 
-      _curb_native_perform(*args, &block)
+      _curb_native_perform(*args, **options, &block)
     end
 
     def add(easy)
@@ -452,14 +461,188 @@ module Curl
       self
     end
 
+    # call-seq:
+    #   multi.max_in_flight = 8
+    #   multi.max_in_flight_per_host = 2
+    #   urls.each { |url| multi.enqueue(Curl::Easy.new(url)) }
+    #   multi.enqueue(easy, host: "search-backends")
+    #   multi.perform
+    #
+    # Queue +easy+ for this multi handle. Queued handles are attached at most
+    # max_in_flight at a time, and the drive loop attaches the next one as
+    # soon as a transfer completes, without waiting for a perform block to
+    # refill the slot.
+    #
+    # Each handle waits in a FIFO for its +host+, which defaults to the
+    # "host:port" of the easy's URL (the scheme's default port when the URL
+    # names none, so "https://example.com/" and "https://example.com:443/"
+    # share a queue) but can be any string used to group requests. Hosts
+    # take turns round-robin and each is capped by max_in_flight_per_host or
+    # Multi#limit_host, so one origin with a deep backlog cannot starve the
+    # rest. See Multi#queue_stats.
+    def enqueue(easy, host: nil)
+      return self if requests[easy.object_id]
+      # Match #add: no new work once a callback error is pending.
+      return self if instance_variable_defined?(:@__curb_deferred_exception)
+      Curl.__send__(:apply_safety!, easy) if Curl.respond_to?(:apply_safety!, true)
+      __unregister_idle_easy_reference(easy)
+      __record_native_safety_signature(easy)
+      _enqueue(easy, host)
+      self
+    end
+
     def remove(easy)
-      return self if !requests[easy.object_id]
+      if !requests[easy.object_id]
+        __curb_native_safety_signatures.delete(easy.object_id) if _dequeue(easy)
+        return self
+      end
       requests.delete(easy.object_id)
       __curb_native_safety_signatures.delete(easy.object_id)
       _remove(easy)
       self
     end
 
+    # call-seq:
+    #   multi.each_completed { |easy| ... }                       => multi
+    #   multi.each_completed(source, concurrency: 50) { |easy| ... }
+    #   multi.each_completed(source)                              => Enumerator
+    #
+    # Drive the multi handle and yield every easy as soon as its transfer
+    # finishes, instead of routing results through on_complete procs:
+    #
+    #   urls = File.foreach("urls.txt").lazy.map(&:chomp)
+    #   multi.each_completed(urls).lazy.map { |c| parse(c.body) }
+    #        .each_slice(1000) { |rows| bulk_insert(rows) }
+    #
+    # +source+ is any Enumerable (or external enumerator) of Curl::Easy
+    # handles or URLs. It is pulled lazily: only enough items are taken to
+    # keep +concurrency+ handles (default max_in_flight, else 64) attached or
+    # queued, so memory stays bounded by the concurrency rather than by the
+    # size of the source. Handles already added or enqueued are yielded too.
+    #
+    # Leaving the block early (break, an exception, Enumerator#first, ...)
+    # cancels the transfers still in flight.
+    def each_completed(source = nil, concurrency: nil, &block)
+      return enum_for(:each_completed, source, concurrency: concurrency) unless block
+
+      source = source.each if source && !source.respond_to?(:next)
+      limit = concurrency || (max_in_flight > 0 ? max_in_flight : 64)
+      raise ArgumentError, "concurrency must be > 0" unless limit > 0
+
+      completed = []
+      finished = false
+      fill = lambda do
+        while source && requests.size + queue_size < limit
+          begin
+            item = source.next
+          rescue StopIteration
+            source = nil
+            break
+          end
+          enqueue(item.is_a?(Curl::Easy) ? item : Curl::Easy.new(item.to_s))
+        end
+      end
+      drain = lambda do
+        while (easy = completed.shift)
+          block.call(easy)
+          fill.call
+        end
+      end
+
+      self._completed_sink = completed
+      begin
+        fill.call
+        until idle? && completed.empty?
+          perform { drain.call }
+          drain.call
+        end
+        finished = true
+      ensure
+        self._completed_sink = nil
+        cancel! unless finished
+      end
+      self
+    end
+
+    # call-seq:
+    #   multi.prewarm(urls, per_host: 1)                        => hash
+    #
+    # Open +per_host+ connections to the origin of each URL (duplicates are
+    # folded) before the real traffic arrives, so the first requests added
+    # afterwards skip DNS, TCP and TLS setup:
+    #
+    #   multi.prewarm(%w[https://api.example.com https://cdn.example.com], per_host: 4)
+    #   # => {warmed: 8, reused: 0, failed: 0, connections: [{url: ..., name_lookup_time: ...}, ...]}
+    #
+    # Each connection is opened by a HEAD request whose connection stays in
+    # this multi's connection cache (libcurl does not hand CONNECT_ONLY
+    # connections to later transfers). Items may be Curl::Easy handles: their
+    # options (TLS, proxy, headers, ...) are copied onto the HEAD requests so
+    # the warmed connections match, and their handlers are not run.
+    #
+    # +connections+ has the phase timings (seconds from the start of each
+    # request) and the error, if any, of every warm-up request. Transfers
+    # already attached to the multi are driven along with the warm-up.
+    def prewarm(urls, per_host: 1)
+      per_host = Integer(per_host)
+      raise ArgumentError, "per_host must be > 0" unless per_host > 0
+
+      templates = {}
+      Array(urls).each do |item|
+        url = item.is_a?(Curl::Easy) ? item.url : item.to_s
+        origin = begin
+          uri = URI.parse(url)
+          uri.host ? "#{uri.scheme}://#{uri.host}:#{uri.port}" : url
+        rescue URI::InvalidURIError
+          url
+        end
+        templates[origin] ||= item
+      end
+
+      report = { warmed: 0, reused: 0, failed: 0, connections: [] }
+      templates.each_value do |item|
+        per_host.times do
+          warm = __prewarm_easy(item)
+          warm.on_complete do |easy|
+            connection = {
+              url: easy.url,
+              name_lookup_time: easy.name_lookup_time,
+              connect_time: easy.connect_time,
+              app_connect_time: easy.app_connect_time,
+              total_time: easy.total_time,
+              error: nil
+            }
+            if easy.last_result != 0
+              connection[:error] = Curl::Easy.error(easy.last_result).first
+              report[:failed] += 1
+            elsif easy.num_connects > 0
+              report[:warmed] += 1
+            else
+              report[:reused] += 1
+            end
+            report[:connections] << connection
+          end
+          add(warm)
+        end
+      end
+      perform
+      report
+    end
+
+    def __prewarm_easy(item)
+      return Curl::Easy.new(item.to_s).tap { |easy| easy.head = true } unless item.is_a?(Curl::Easy)
+
+      easy = item.dup
+      %i[on_body on_header on_progress on_debug on_success on_failure
+         on_missing on_redirect on_complete].each { |handler| easy.__send__(handler) }
+      easy.retry_policy = nil
+      easy.hedge_after = nil
+      easy.head = true
+      easy
+    end
+
+    private :__prewarm_easy
+
     def close
       __close(true)
     end
@@ -0,0 +1,266 @@
+# frozen_string_literal: true
+module Curl
+  #
+  # Spreads requests over several Ractors, each driving its own Curl::Multi,
+  # so response handling (TLS, decompression, header and body copies) runs on
+  # as many cores as there are workers instead of behind one GVL:
+  #
+  #   Curl::RactorPool.open(4) do |pool|
+  #     pool.each(urls) { |result| puts "#{result.status} #{result.url}" }
+  #   end
+  #
+  # Requests are given as URLs or as hashes in the shape Curl::Multi.http
+  # accepts (:url, :method, :headers, :post_fields, :put_data, plus easy
+  # options such as :timeout), without callbacks. Each is deep-frozen and
+  # handed to worker <tt>index % size</tt>. Workers send back frozen
+  # Curl::RactorPool::Result values as transfers finish.
+  #
+  # Needs Ruby 3.0+ and a build that sets Curl::RACTOR_SAFE.
+  #
+  class RactorPool
+    TIMINGS = {
+      name_lookup: :name_lookup_time,
+      connect: :connect_time,
+      app_connect: :app_connect_time,
+      pre_transfer: :pre_transfer_time,
+      start_transfer: :start_transfer_time,
+      redirect: :redirect_time,
+      total: :total_time,
+    }.freeze
+
+    #
+    # One finished request. +index+ is the position of the request in the
+    # list given to #each or #map. +headers+ holds the final response's
+    # headers with lower-cased names; repeated fields are joined with ", ".
+    # +timings+ maps the TIMINGS keys to seconds. A failed transfer has the
+    # Curl::Err class in +error+ and libcurl's explanation in +error_message+.
+    #
+    Result = Struct.new(:index, :url, :status, :headers, :body, :timings, :error, :error_message) do
+      def success?
+        error.nil?
+      end
+    end
+
+    #
+    # call-seq:
+    #   Curl::RactorPool.open(size = 4, **options) { |pool| ... }  => block result
+    #
+    # Yield a new pool and close it once the block returns.
+    #
+    def self.open(*args, **options)
+      pool = new(*args, **options)
+      begin
+        yield pool
+      ensure
+        pool.close
+      end
+    end
+
+    def self.supported?
+      defined?(Ractor) && Curl.const_defined?(:RACTOR_SAFE) && Curl::RACTOR_SAFE ? true : false
+    end
+
+    attr_reader :size
+
+    #
+    # call-seq:
+    #   Curl::RactorPool.new(size = 4, max_in_flight: 32, safe: nil)  => pool
+    #
+    # Start +size+ worker Ractors. +max_in_flight+ caps the transfers each
+    # worker's multi runs at once. +safe+, a hash of Curl::SafetyConfig
+    # settings such as <tt>{ protocols: [:https], max_body_bytes: 1 << 20 }</tt>,
+    # is applied with Curl.safe! in every worker, since the safety policy is
+    # per Ractor.
+    #
+    def initialize(size = 4, max_in_flight: 32, safe: nil)
+      raise NotImplementedError, "Curl::RactorPool needs Ractor and a Ractor-safe curb build" unless self.class.supported?
+      raise ArgumentError, "size must be positive" unless size.is_a?(Integer) && size > 0
+      raise ArgumentError, "max_in_flight must be positive" unless max_in_flight.is_a?(Integer) && max_in_flight > 0
+
+      @size = size
+      safe = Ractor.make_shareable(safe.to_h, copy: true) if safe
+      # Ruby 4.0 removed Ractor.yield/take in favour of ports.
+      @port = Ractor::Port.new if defined?(Ractor::Port)
+      @workers = Array.new(size) do
+        Ractor.new(@port, max_in_flight, safe) do |port, limit, safety|
+          Curl::RactorPool.__send__(:work, port, limit, safety)
+        end
+      end
+      @generation = 0
+      @closed = false
+    end
+
+    #
+    # call-seq:
+    #   pool.each(requests) { |result| ... }          => pool
+    #   pool.each(requests)                           => Enumerator
+    #
+    # Run +requests+ across the workers and yield each Result as soon as its
+    # transfer completes, in completion order. An exception that aborted a
+    # worker's perform is raised once the other workers are done. Leaving
+    # early (break, an exception in the block, Enumerator#first) is fine:
+    # what the abandoned run still sends back is dropped, never handed to a
+    # later #each or #map.
+    #
+    def each(requests)
+      return enum_for(:each, requests) unless block_given?
+      raise RuntimeError, "Curl::RactorPool is closed" if @closed
+
+      shards = Array.new(@size) { [] }
+      requests.each_with_index do |request, index|
+        request = { url: request.to_s } unless request.is_a?(Hash)
+        shards[index % @size] << [index, Ractor.make_shareable(request, copy: true)]
+      end
+
+      # Workers tag everything they send back with the batch's generation,
+      # so leftovers from a run the caller walked away from can be told
+      # apart from this one's.
+      generation = @generation += 1
+      busy = 0
+      failure = nil
+      shards.each_with_index do |shard, i|
+        next if shard.empty?
+        @workers[i].send(Ractor.make_shareable([generation, shard]))
+        busy += 1
+      end
+
+      while busy > 0
+        message = receive(generation)
+        if message == :done
+          busy -= 1
+        elsif message.is_a?(Array)
+          busy -= 1
+          failure ||= message
+        else
+          yield message
+        end
+      end
+      raise failure[1], failure[2] if failure
+      self
+    end
+
+    #
+    # call-seq:
+    #   pool.map(requests)                            => [Result, ...]
+    #
+    # Run +requests+ and return their results in request order.
+    #
+    def map(requests)
+      results = []
+      each(requests) { |result| results[result.index] = result }
+      results
+    end
+
+    #
+    # call-seq:
+    #   pool.close                                    => nil
+    #
+    # Stop the workers and wait for them to exit.
+    #
+    def close
+      return if @closed
+      @closed = true
+      @workers.each { |worker| worker.send(nil) }
+      @workers.each do |worker|
+        if worker.respond_to?(:value)
+          worker.value
+        else
+          # Take whatever an abandoned run left queued until the worker
+          # exits with nil.
+          nil until worker.take.nil?
+        end
+      end
+      @port.close if @port
+      nil
+    end
+
+    def closed?
+      @closed
+    end
+
+    private
+
+    def receive(generation)
+      loop do
+        tag, message = @port ? @port.receive : Ractor.select(*@workers).last
+        return message if tag == generation
+      end
+    end
+
+    class << self
+      private
+
+      # Worker Ractor body: run each shard on one multi until told to stop.
+      def work(port, max_in_flight, safe)
+        Curl.safe! { |config| safe.each { |name, value| config.public_send("#{name}=", value) } } if safe
+        multi = Curl::Multi.new
+        multi.max_in_flight = max_in_flight
+
+        while (batch = Ractor.receive)
+          generation, shard = batch
+          shard.each do |index, request|
+            begin
+              multi.enqueue(build_easy(port, generation, index, request))
+            rescue StandardError => e
+              emit(port, generation, Result.new(index, request[:url], nil, {}, nil, {}, e.class, e.message))
+            end
+          end
+          begin
+            multi.perform
+            emit(port, generation, :done)
+          rescue StandardError => e
+            # Report instead of dying so the caller is not left waiting, and
+            # start over on a clean multi.
+            emit(port, generation, [:failed, e.class, e.message])
+            multi.close
+            multi = Curl::Multi.new
+            multi.max_in_flight = max_in_flight
+          end
+        end
+        nil
+      ensure
+        multi.close if multi
+      end
+
+      def build_easy(port, generation, index, request)
+        options = request.dup
+        url = options.delete(:url)
+        method = options.delete(:method)
+        headers = options.delete(:headers)
+        easy = Curl::Easy.new(url)
+
+        case method
+        when :post
+          fields = options.delete(:post_fields)
+          easy.post_body = fields.map { |f, v| "#{easy.escape(f)}=#{easy.escape(v)}" }.join('&') if fields
+        when :put
+          easy.put_data = options.delete(:put_data)
+        when :head
+          easy.head = true
+        when :delete
+          easy.delete = true
+        end
+        headers.each { |k, v| easy.headers[k] = v } if headers
+        options.each { |k, v| easy.send("#{k}=", v) }
+
+        easy.on_complete { |curl| emit(port, generation, result_for(index, curl)) }
+        easy
+      end
+
+      def result_for(index, easy)
+        if easy.last_result != 0
+          error, summary = Curl::Easy.error(easy.last_result)
+          message = [summary, easy.last_error].compact.join(": ")
+        end
+        timings = TIMINGS.each_with_object({}) { |(key, reader), h| h[key] = easy.public_send(reader) }
+        Result.new(index, easy.last_effective_url || easy.url, easy.response_code,
+                   easy.response_headers.to_h, easy.body_str, timings, error, message)
+      end
+
+      def emit(port, generation, message)
+        message = Ractor.make_shareable([generation, message])
+        port ? port.send(message) : Ractor.yield(message)
+      end
+    end
+  end
+end
@@ -0,0 +1,80 @@
+# frozen_string_literal: true
+module Curl
+  # Curl::Reactor is only defined when the extension was built with pthreads
+  # and a libcurl that can wake a waiting multi handle.
+  if defined?(Curl::Reactor)
+    #
+    # A multi handle driven by a dedicated native thread. Any Ruby thread can
+    # submit work and wait for it without holding the GVL:
+    #
+    #   reactor = Curl::Reactor.new
+    #   futures = urls.map { |url| reactor.submit(url) }
+    #   futures.each { |f| puts f.value.body }
+    #   reactor.close
+    #
+    # The reactor thread never runs Ruby code, so easies with on_body,
+    # on_header, on_progress, on_debug or an upload stream are rejected, and
+    # status callbacks (on_complete, on_success, ...) are not invoked: check
+    # the easy returned by Future#value instead.
+    #
+    class Reactor
+      #
+      # call-seq:
+      #   Curl::Reactor.open { |reactor| ... }          => block result
+      #
+      # Yield a new reactor and close it once the block returns.
+      #
+      def self.open
+        reactor = new
+        begin
+          yield reactor
+        ensure
+          reactor.close
+        end
+      end
+
+      #
+      # call-seq:
+      #   reactor.submit(easy)                          => Curl::Reactor::Future
+      #   reactor.submit(url)                           => Curl::Reactor::Future
+      #
+      # Hand +easy+ (or a new Curl::Easy for +url+) to the reactor thread.
+      # The easy must not be used elsewhere until its future is resolved.
+      #
+      def submit(easy)
+        easy = Curl::Easy.new(easy.to_s) unless easy.is_a?(Curl::Easy)
+        Curl.__send__(:apply_safety!, easy) if Curl.respond_to?(:apply_safety!, true)
+        _submit(easy)
+      end
+
+      class Future
+        #
+        # call-seq:
+        #   future.value                                => Curl::Easy
+        #
+        # Wait for the transfer with the GVL released and return its easy,
+        # raising the error Curl::Easy#perform would have raised.
+        #
+        def value
+          wait
+          easy = self.easy
+
+          if (callback_error = easy.__send__(:_take_callback_error))
+            raise callback_error
+          end
+
+          if (unsafe_destination_error = easy.unsafe_destination_error)
+            raise Curl::Err::UnsafeDestinationError, unsafe_destination_error
+          end
+
+          if easy.last_result != 0
+            err_class, err_summary = Curl::Easy.error(easy.last_result)
+            raise err_class.new([err_summary, easy.last_error].compact.join(": "))
+          end
+
+          easy
+        end
+      end
+    end
+  end
+end
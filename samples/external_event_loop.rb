@@ -0,0 +1,56 @@
+# Use local curb
+#
+
+$:.unshift(File.join(File.dirname(__FILE__), '..', 'ext'))
+$:.unshift(File.join(File.dirname(__FILE__), '..', 'lib'))
+require 'curb'
+
+# Driving Curl::Multi from an event loop you own. Instead of handing the
+# thread to Multi#perform, the multi tells the loop which sockets to watch
+# (on_socket) and when to wake up (on_timer); the loop reports readiness
+# back with socket_action and timeout_action. IO.select stands in for
+# nio4r, EventMachine or any other reactor here.
+#
+
+urls = ["https://www.ruby-lang.org/",
+        "https://rubygems.org/",
+        "https://curl.se/"]
+
+multi = Curl::Multi.new
+watched = {}   # fd => :in, :out or :inout
+timer_at = nil
+
+multi.on_socket do |fd, what|
+  if what == :remove
+    watched.delete(fd)
+  else
+    watched[fd] = what
+  end
+end
+
+multi.on_timer do |ms|
+  timer_at = ms && Process.clock_gettime(Process::CLOCK_MONOTONIC) + ms / 1000.0
+end
+
+urls.each do |url|
+  easy = Curl::Easy.new(url)
+  easy.on_complete { |c| puts "#{c.response_code} #{c.url} (#{c.body_str.bytesize} bytes)" }
+  multi.add(easy)
+end
+
+until multi.requests.empty?
+  ios = watched.to_h { |fd, _| [fd, IO.for_fd(fd, autoclose: false)] }
+  readers = ios.reject { |fd, _| watched[fd] == :out }.values
+  writers = ios.reject { |fd, _| watched[fd] == :in }.values
+  wait = timer_at ? [timer_at - Process.clock_gettime(Process::CLOCK_MONOTONIC), 0].max : nil
+
+  if (ready = IO.select(readers, writers, nil, wait))
+    ready[0].each { |io| multi.socket_action(io, :in) }
+    ready[1].each { |io| multi.socket_action(io, :out) }
+  else
+    timer_at = nil
+    multi.timeout_action
+  end
+end
+
+multi.close
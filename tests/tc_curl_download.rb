@@ -1,5 +1,6 @@
 require File.expand_path(File.join(File.dirname(__FILE__), 'helper'))
 require 'tmpdir'
+require 'io/nonblock'
 
 class TestCurbCurlDownload < Test::Unit::TestCase
   include TestServerMethods 
@@ -152,6 +153,74 @@ class TestCurbCurlDownload < Test::Unit::TestCase
     File.unlink(dl_path) if dl_path && File.exist?(dl_path)
   end
 
+  def test_body_fd_writes_the_body_across_short_writes
+    omit('pipes are not pollable on this platform') if WINDOWS
+    source = File.binread(File.join(File.dirname(__FILE__), '..', 'ext', 'curb_easy.c'))
+
+    [false, true].each do |nonblock|
+      begin
+        reader, writer = IO.pipe
+        # a blocking pipe blocks write(2) until the reader drains it, a
+        # non-blocking one comes up short; either way the reader thread
+        # must get to run meanwhile
+        writer.nonblock = nonblock
+        drained = Thread.new { sleep 0.1; reader.read }
+
+        curl = Curl::Easy.new("http://127.0.0.1:9129/ext/curb_easy.c")
+        curl.body_fd = writer.fileno
+        assert_equal writer.fileno, curl.body_fd
+        curl.perform
+        writer.close
+
+        assert_equal source.bytesize, drained.value.bytesize, "nonblock=#{nonblock}"
+        assert_equal source, drained.value
+        assert_equal "", curl.body_str.to_s
+      ensure
+        reader.close if reader && !reader.closed?
+        writer.close if writer && !writer.closed?
+      end
+    end
+  end
+
+  def test_body_fd_write_blocked_on_a_full_pipe_can_be_interrupted
+    omit('pipes are not pollable on this platform') if WINDOWS
+    reader, writer = IO.pipe
+    writer.nonblock = false
+    performer = Thread.current
+    interrupter = Thread.new { sleep 0.3; performer.raise(RuntimeError, 'stop writing') }
+
+    curl = Curl::Easy.new("http://127.0.0.1:9129/ext/curb_easy.c")
+    curl.body_fd = writer.fileno
+    error = assert_raise(RuntimeError) { curl.perform }
+    assert_equal 'stop writing', error.message
+  ensure
+    interrupter.join if interrupter
+    reader.close if reader && !reader.closed?
+    writer.close if writer && !writer.closed?
+  end
+
+  def test_body_io_raises_write_error_when_the_fd_rejects_writes
+    Dir.mktmpdir('curb-download-') do |dir|
+      File.open(File.join(dir, 'readonly'), 'wb') { |f| f << 'x' }
+      File.open(File.join(dir, 'readonly'), 'rb') do |io|
+        curl = Curl::Easy.new("http://127.0.0.1:9129/ext/curb_easy.c")
+        curl.body_io = io
+        assert_same io, curl.body_io
+
+        error = assert_raise(Curl::Err::WriteError) { curl.perform }
+        assert_match(/fd #{io.fileno}/, error.message)
+      end
+    end
+  end
+
+  def test_body_fd_rejects_invalid_descriptors
+    curl = Curl::Easy.new
+    assert_raise(ArgumentError) { curl.body_fd = -1 }
+    assert_raise(TypeError) { curl.body_io = "not an io" }
+    curl.body_fd = nil
+    assert_nil curl.body_fd
+  end
+
   def test_download_bad_url_gives_404
     dl_url = "http://127.0.0.1:9129/this_file_does_not_exist.html"
     dl_path = File.join(Dir::tmpdir, "dl_url_test.file")
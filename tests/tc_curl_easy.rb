@@ -131,6 +131,208 @@ class TestCurbCurlEasy < Test::Unit::TestCase
     assert_equal "", easy.body_str.to_s
   end
 
+  def test_response_buffers_are_allocated_on_demand_and_sized_from_content_length
+    require 'objspace'
+    easy = Curl::Easy.new(TestServlet.url)
+    assert_nil easy.body_str
+
+    easy.http("HEAD")
+    assert_equal "", easy.body_str
+
+    easy.http_get
+    assert_equal "GET", easy.body_str
+    assert_equal Encoding::BINARY, easy.body_str.encoding
+    # a three byte reply no longer pins a 32 KB buffer
+    assert_operator ObjectSpace.memsize_of(easy.body_str), :<, 1024
+  end
+
+  def test_reuse_buffers_refills_the_previous_strings
+    easy = Curl::Easy.new(TestServlet.url + "?first")
+    assert_equal false, easy.reuse_buffers?
+    easy.reuse_buffers = true
+    assert_equal true, easy.reuse_buffers?
+
+    easy.perform
+    body, header = easy.body_str, easy.header_str
+    assert_equal "GETfirst", body
+    clone = easy.clone
+
+    easy.url = TestServlet.url
+    easy.perform
+    assert_same body, easy.body_str
+    assert_same header, easy.header_str
+    assert_equal "GET", body
+
+    clone.perform
+    assert_equal "GETfirst", clone.body_str
+    assert_equal "GET", easy.body_str
+
+    body.freeze
+    easy.perform
+    assert_not_same body, easy.body_str
+    assert_equal "GET", easy.body_str
+
+    easy.reuse_buffers = false
+    kept = easy.body_str
+    easy.perform
+    assert_not_same kept, easy.body_str
+  end
+
+  def test_on_body_min_chunk_coalesces_writes
+    url = "http://127.0.0.1:#{TestServlet.port}/ext/curb_easy.c"
+    source = File.binread(File.join(File.dirname(__FILE__), '..', 'ext', 'curb_easy.c'))
+    min_chunk = 64 * 1024
+
+    easy = Curl::Easy.new(url)
+    plain = 0
+    easy.on_body { |data| plain += 1; data.bytesize }
+    easy.perform
+    assert_equal 0, easy.body_min_chunk
+
+    chunks = []
+    easy.on_body(min_chunk: min_chunk) { |data| chunks << data; data.bytesize }
+    assert_equal min_chunk, easy.body_min_chunk
+    easy.perform
+
+    assert_equal source, chunks.join
+    assert chunks[0..-2].all? { |chunk| chunk.bytesize >= min_chunk }
+    assert_operator chunks.size, :<=, source.bytesize / min_chunk + 1
+    assert_operator chunks.size, :<, plain
+
+    # a body smaller than min_chunk arrives in one call once the transfer ends
+    chunks.clear
+    easy.url = TestServlet.url
+    easy.perform
+    assert_equal ["GET"], chunks
+
+    easy.on_body { |data| data.bytesize }
+    assert_equal 0, easy.body_min_chunk
+    assert_raise(ArgumentError) { easy.on_body(min_chunk: -1) { |data| data.bytesize } }
+  end
+
+  def test_on_body_min_chunk_rejected_tail_fails_the_request
+    easy = Curl::Easy.new(TestServlet.url)
+    easy.on_body(min_chunk: 1 << 20) { |_data| 0 }
+    assert_raise(Curl::Err::WriteError) { easy.perform }
+
+    callback_error = Class.new(StandardError)
+    easy.on_body(min_chunk: 1 << 20) { |_data| raise callback_error, "tail blew up" }
+    error = assert_raise(callback_error) { easy.perform }
+    assert_equal "tail blew up", error.message
+  end
+
+  def test_body_spill_threshold_moves_large_bodies_to_disk
+    omit('spill files need POSIX temp files') if WINDOWS
+    url = "http://127.0.0.1:#{TestServlet.port}/ext/curb_easy.c"
+    source = File.binread(File.join(File.dirname(__FILE__), '..', 'ext', 'curb_easy.c'))
+
+    Dir.mktmpdir('curb-spill-') do |dir|
+      easy = Curl::Easy.new(url)
+      easy.body_spill_threshold = 16 * 1024
+      easy.body_spill_dir = dir
+      assert_equal 16 * 1024, easy.body_spill_threshold
+      assert_equal dir, easy.body_spill_dir
+
+      easy.perform
+      assert easy.body_spilled?
+      # unlinked as soon as it is created
+      assert_equal [], Dir.children(dir)
+      spilled = easy.body_spill_io
+      assert_equal source, spilled.read
+      assert_equal source, easy.body_str
+
+      easy.url = TestServlet.url
+      easy.perform
+      assert !easy.body_spilled?
+      assert_nil easy.body_spill_io
+      assert_equal "GET", easy.body_str
+      spilled.rewind
+      assert_equal source, spilled.read
+      spilled.close
+
+      easy.body_spill_dir = File.join(dir, 'missing')
+      easy.url = url
+      assert_raise(Curl::Err::WriteError) { easy.perform }
+      assert_raise(ArgumentError) { easy.body_spill_threshold = -1 }
+    end
+  end
+
+  def test_response_headers_index
+    easy = Curl::Easy.new(TestServlet.url)
+    assert_predicate easy.response_headers, :empty?
+
+    easy.perform
+    headers = easy.response_headers
+    assert_kind_of Curl::Easy::ResponseHeaders, headers
+    assert_predicate headers, :frozen?
+    assert_same headers, easy.response_headers
+    assert_equal "text/plain", headers["Content-Type"]
+    assert_equal "text/plain", headers["content-type"]
+    assert_equal "text/plain", headers[:content_type]
+    assert_equal ["3"], headers.values("CONTENT-LENGTH")
+    assert_equal [], headers.values("x-missing")
+    assert_nil headers["x-missing"]
+    assert headers.key?("Content-Length")
+    assert headers.keys.all?(&:frozen?)
+    assert_equal headers.keys, headers.keys.map(&:downcase)
+    assert_equal "3", headers.to_h["content-length"]
+    assert_includes headers.to_a, ["content-type", "text/plain"]
+
+    easy.on_header { |data| data.bytesize }
+    easy.perform
+    assert_not_same headers, easy.response_headers
+    assert_equal "text/plain", easy.response_headers["content-type"]
+  end
+
+  def test_response_headers_index_keeps_repeated_fields_of_the_final_response
+    redirect = "HTTP/1.1 100 Continue\r\nX-Interim: 1\r\n\r\n" \
+               "HTTP/1.1 302 Found\r\nLocation: /final\r\nSet-Cookie: old=1\r\nX-Hop: 1\r\nContent-Length: 0\r\n\r\n"
+    final = "HTTP/1.1 200 OK\r\nSet-Cookie: a=1\r\nContent-Type: text/plain\r\nset-cookie: b=2\r\n" \
+            "Content-Length: 2\r\nConnection: close\r\n\r\nok"
+    with_raw_responses(redirect, final) do |url|
+      easy = Curl::Easy.new(url)
+      easy.follow_location = true
+      easy.perform
+      assert_equal "ok", easy.body_str
+      assert_match(/old=1/, easy.header_str)
+
+      headers = easy.response_headers
+      assert_equal ["a=1", "b=2"], headers.values("set-cookie")
+      assert_equal "a=1, b=2", headers["Set-Cookie"]
+      assert_equal "text/plain", headers["content-type"]
+      assert_nil headers["location"]
+      assert_nil headers["x-hop"]
+      assert_nil headers["x-interim"]
+    end
+  end
+
+  # Answers successive requests on one connection with +responses+.
+  def with_raw_responses(*responses)
+    server = TCPServer.new('127.0.0.1', 0)
+    port = server.addr[1]
+    thread = Thread.new do
+      socket = server.accept
+      begin
+        responses.each do |response|
+          request = +''
+          request << socket.readpartial(4096) until request.include?("\r\n\r\n")
+          socket.write(response)
+        end
+      rescue IOError, SystemCallError
+      ensure
+        socket.close
+      end
+    end
+
+    yield "http://127.0.0.1:#{port}/"
+  ensure
+    server.close if server && !server.closed?
+    if thread
+      thread.join(5)
+      thread.kill if thread.alive?
+    end
+  end
+
   def test_head_request_restores_easy_state_after_callback_exception
     easy = Curl::Easy.new(TestServlet.url)
     easy.on_complete { raise "head complete blew up" }
@@ -1068,6 +1270,153 @@ class TestCurbCurlEasy < Test::Unit::TestCase
     assert_equal Curl::HTTP_NONE, c.http_version
   end
 
+  def test_priority_accessors
+    c = Curl::Easy.new
+    assert_nil c.priority
+
+    c.priority = 256
+    assert_equal 256, c.priority
+    c.priority = 1
+    assert_equal 1, c.priority
+
+    assert_raise(ArgumentError) { c.priority = 0 }
+    assert_raise(ArgumentError) { c.priority = 257 }
+
+    c.priority = nil
+    assert_nil c.priority
+  end
+
+  def test_http2_stream_accessors
+    parent = Curl::Easy.new
+    c = Curl::Easy.new
+    assert_nil c.stream_weight
+    assert_nil c.stream_depends
+    assert_equal false, c.stream_exclusive?
+    assert_nil c.pipewait
+
+    c.stream_weight = 256
+    assert_equal 256, c.stream_weight
+    assert_raise(ArgumentError) { c.stream_weight = 0 }
+    assert_raise(ArgumentError) { c.stream_weight = 257 }
+    c.stream_weight = nil
+    assert_nil c.stream_weight
+
+    c.stream_depends = parent
+    assert_same parent, c.stream_depends
+    c.stream_exclusive = true
+    assert_equal true, c.stream_exclusive?
+    assert_raise(TypeError) { c.stream_depends = 'parent' }
+    assert_raise(ArgumentError) { c.stream_depends = c }
+    c.stream_depends = nil
+    assert_nil c.stream_depends
+
+    c.pipewait = true
+    assert_equal true, c.pipewait
+    c.pipewait = false
+    assert_equal false, c.pipewait
+    c.pipewait = nil
+    assert_nil c.pipewait
+  end
+
+  def test_setopt_long_flags_are_not_taken_as_pipewait
+    c = Curl::Easy.new(TestServlet.url)
+    [Curl::CURLOPT_HEADER, Curl::CURLOPT_NOPROGRESS, Curl::CURLOPT_NOSIGNAL].each do |opt|
+      c.setopt(opt, 1)
+      assert_nil c.pipewait
+    end
+
+    omit('CURLOPT_PATH_AS_IS not available') unless Curl.const_defined?(:CURLOPT_PATH_AS_IS)
+    c = Curl::Easy.new("#{TestServlet.url}/a/../b")
+    sent = ''
+    c.on_debug { |type, data| sent << data if type == Curl::CURLINFO_HEADER_OUT }
+    c.setopt(Curl::CURLOPT_PATH_AS_IS, 1)
+    assert_nil c.pipewait
+    c.perform
+    assert_match(%r{\AGET #{Regexp.escape(TestServlet.path)}/a/\.\./b HTTP}, sent)
+  end
+
+  def test_prewarm_warms_the_multi_used_by_perform
+    c = Curl::Easy.new(TestServlet.url)
+    assert_equal 2, c.prewarm(per_host: 2)[:warmed]
+    assert_not_nil c.multi
+    c.perform
+    assert_equal 0, c.num_connects
+    assert_equal 'GET', c.body_str
+  end
+
+  def test_connection_pool_reuses_connections_across_easies
+    Curl::Easy.connection_pool = true
+    assert_equal({ max_connections: 16, idle_timeout: 60 }, Curl::Easy.connection_pool)
+
+    assert_equal [1, 0, 0], 3.times.map { Curl.get(TestServlet.url).num_connects }
+    easy = Curl::Easy.new(TestServlet.url)
+    easy.perform
+    assert_equal 0, easy.num_connects
+    assert_nil easy.multi
+
+    other_thread = Thread.new { 2.times.map { Curl.get(TestServlet.url).num_connects } }.value
+    assert_equal [1, 0], other_thread
+  ensure
+    Curl::Easy.connection_pool = nil
+  end
+
+  def test_connection_pool_nested_perform_and_idle_timeout
+    Curl::Easy.connection_pool = { idle_timeout: 0.05 }
+    outer = Curl::Easy.new(TestServlet.url)
+    inner = nil
+    outer.on_complete { inner = Curl.get(TestServlet.url) }
+    outer.perform
+    assert_equal 'GET', inner.body_str
+
+    sleep 0.1
+    assert_equal 1, Curl.get(TestServlet.url).num_connects
+
+    assert_raise(ArgumentError) { Curl::Easy.connection_pool = { max_connections: 0 } }
+    assert_raise(ArgumentError) { Curl::Easy.connection_pool = { bogus: 1 } }
+    Curl::Easy.connection_pool = nil
+    assert_equal [1, 1], 2.times.map { Curl.get(TestServlet.url).num_connects }
+  ensure
+    Curl::Easy.connection_pool = nil
+  end
+
+  def test_retry_policy_accessors
+    c = Curl::Easy.new
+    assert_nil c.retry_policy
+    assert_equal 0, c.retry_count
+
+    c.retry_policy = 2
+    assert_equal 2, c.retry_policy[:attempts]
+    assert_includes c.retry_policy[:on], 7
+    assert_equal Curl::Easy::RETRYABLE_STATUSES, c.retry_policy[:statuses]
+
+    c.retry_policy = { attempts: 1, on: [Curl::Err::HostResolutionError], statuses: [500] }
+    assert_equal [6], c.retry_policy[:on]
+    assert_equal [500], c.retry_policy[:statuses]
+
+    assert_raise(ArgumentError) { c.retry_policy = { attempts: -1 } }
+    assert_raise(ArgumentError) { c.retry_policy = { attempts: 1, jitter: 2 } }
+    assert_raise(ArgumentError) { c.retry_policy = { attempts: 1, backoff: 2, max_backoff: 1 } }
+    assert_raise(ArgumentError) { c.retry_policy = { attempts: 1, statuses: [1000] } }
+    assert_raise(ArgumentError) { c.retry_policy = { attempts: 1, bogus: true } }
+
+    c.retry_policy = nil
+    assert_nil c.retry_policy
+  end
+
+  def test_hedge_after_accessors
+    c = Curl::Easy.new
+    assert_nil c.hedge_after
+
+    c.hedge_after = 250
+    assert_equal 250, c.hedge_after
+    assert_raise(ArgumentError) { c.hedge_after = -1 }
+
+    c.hedge_after = 0
+    assert_nil c.hedge_after
+    c.hedge_after = nil
+    assert_nil c.hedge_after
+  end
+
   def test_enable_cookies
     c = Curl::Easy.new
     assert !c.enable_cookies?
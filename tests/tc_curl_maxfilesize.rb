@@ -38,6 +38,23 @@ class TestCurbCurlMaxFileSize < Test::Unit::TestCase
     end
   end
 
+  def test_max_body_bytes_applies_to_body_io
+    with_raw_http_response("HTTP/1.1 200 OK\r\nContent-Length: 64\r\n\r\n#{'x' * 64}") do |url|
+      Tempfile.create('curb-body-io') do |file|
+        file.binmode
+        @easy.url = url
+        @easy.max_body_bytes = 10
+        @easy.body_io = file
+
+        assert_body_limit_error do
+          @easy.perform
+        end
+
+        assert_operator File.size(file.path), :<=, 10
+      end
+    end
+  end
+
   def test_safe_get_accepts_max_body_bytes_as_second_argument
     with_raw_http_response("HTTP/1.1 200 OK\r\nContent-Length: 64\r\n\r\n#{'x' * 64}") do |url|
       assert_body_limit_error do
@@ -1,4 +1,5 @@
 require File.expand_path(File.join(File.dirname(__FILE__), 'helper'))
+require 'json'
 require 'set'
 require 'tmpdir'
 
@@ -586,6 +587,29 @@ class TestCurbCurlMulti < Test::Unit::TestCase
     end
   end
 
+  def test_multi_perform_keeps_work_added_by_an_earlier_on_complete_when_a_later_one_fails
+    with_queue_refill_test_server do |port, hits|
+      multi = Curl::Multi.new
+      first = Curl::Easy.new("http://127.0.0.1:#{port}/fail")
+      queued = Curl::Easy.new("http://127.0.0.1:#{port}/queued")
+      slow = Curl::Easy.new("http://127.0.0.1:#{port}/slow")
+
+      first.on_complete { multi.add(queued) }
+      slow.on_complete { raise "complete blew up" }
+
+      assert_raise(Curl::Err::AbortedByCallbackError) do
+        multi.add(first)
+        multi.add(slow)
+        multi.perform
+      end
+
+      assert_equal 1, hits[:queued],
+                   "work added by a successful on_complete should not be undone by a later failing callback"
+    ensure
+      multi.close if multi
+    end
+  end
+
   def test_multi_perform_does_not_start_work_added_within_on_complete_after_on_body_exception
     with_queue_refill_test_server do |port, hits|
       multi = Curl::Multi.new
@@ -1297,6 +1321,22 @@ class TestCurbCurlMulti < Test::Unit::TestCase
     end
   end
 
+  def test_multi_easy_http_builds_handles_as_the_queue_drains
+    urls = 40.times.map { |i| { :url => TestServlet.url + "?q=#{i}", :method => :get } }
+    unread_at_first_completion = nil
+    completed = 0
+    Curl::Multi.http(urls, {:max_connects => 4}) do |easy, code, method|
+      assert_equal 200, code
+      unread_at_first_completion ||= urls.size
+      completed += 1
+    end
+
+    assert_equal 40, completed
+    # at most max_connects in flight plus max_connects queued were built
+    assert_operator unread_at_first_completion, :>=, 40 - 8
+    assert urls.empty?
+  end
+
   def test_multi_easy_http_with_max_host_connections
     urls = [
       { :url => TestServlet.url + '?q=1', :method => :get },
@@ -1467,6 +1507,986 @@ class TestCurbCurlMulti < Test::Unit::TestCase
     assert_equal 100, (Curl::Multi.default_timeout = 100)
   end
 
+  def test_event_backend_setting
+    m = Curl::Multi.new
+    assert_equal :auto, m.event_backend
+    assert_equal :select, (m.event_backend = :select)
+    assert_equal :select, m.event_backend
+    assert_raise(ArgumentError) { m.event_backend = :kqueue }
+    assert_raise(TypeError) { m.event_backend = 'select' }
+  ensure
+    m.close if m
+  end
+
+  def test_select_and_epoll_event_backends_complete_the_same_transfers
+    backends = [:select]
+    begin
+      Curl::Multi.new.event_backend = :epoll
+      backends << :epoll
+    rescue NotImplementedError
+    end
+
+    backends.each do |backend|
+      m = Curl::Multi.new
+      m.event_backend = backend
+      bodies = []
+      8.times do
+        c = Curl::Easy.new(TestServlet.url)
+        c.on_complete { |curl| bodies << curl.body_str }
+        m.add(c)
+      end
+      m.perform
+      assert_equal ['GET'] * 8, bodies, "backend #{backend}"
+      m.close
+    end
+  end
+
+  def test_epoll_event_backend_registers_an_epoll_instance_during_perform
+    omit('epoll backend requires Linux /proc') unless File.directory?('/proc/self/fd')
+    begin
+      Curl::Multi.new.event_backend = :epoll
+    rescue NotImplementedError
+      omit('epoll backend is not available in this build')
+    end
+
+    count_epoll_fds = lambda do
+      Dir['/proc/self/fd/*'].count { |fd| (File.readlink(fd) rescue '').include?('eventpoll') }
+    end
+
+    baseline = count_epoll_fds.call
+    m = Curl::Multi.new
+    m.event_backend = :epoll
+    m.add(Curl::Easy.new(TestServlet.url))
+    during = baseline
+    m.perform { during = [during, count_epoll_fds.call].max }
+
+    assert_operator during, :>, baseline
+    assert_equal baseline, count_epoll_fds.call
+  ensure
+    m.close if m
+  end
+
+  def test_io_uring_event_backend_completes_transfers_and_reports_itself
+    begin
+      Curl::Multi.new.event_backend = :io_uring
+    rescue NotImplementedError
+      omit('io_uring backend is not available in this build')
+    end
+
+    [false, true].each do |release_gvl|
+      next if release_gvl && !release_gvl_supported?
+      m = Curl::Multi.new
+      m.event_backend = :io_uring
+      m.release_gvl = release_gvl
+      assert_equal :io_uring, m.event_backend
+      assert_nil m.stats[:event_loop][:backend]
+
+      bodies = []
+      8.times do |i|
+        c = Curl::Easy.new("#{TestServlet.url}?i=#{i}")
+        c.on_complete { |curl| bodies << curl.body_str }
+        m.add(c)
+      end
+      m.perform
+
+      assert_equal 8.times.map { |i| "GETi=#{i}" }.sort, bodies.sort
+      event_loop = m.stats[:event_loop]
+      # A kernel that refuses io_uring falls back to epoll.
+      assert_include [:io_uring, :epoll], event_loop[:backend]
+      assert_operator event_loop[:syscalls], :>, 0
+      m.close
+    end
+  end
+
+  def test_release_gvl_defaults_from_class_setting
+    assert_equal false, Curl::Multi.new.release_gvl?
+    Curl::Multi.release_gvl = true
+    # builds that cannot release the GVL ignore the default
+    assert_equal release_gvl_supported?, Curl::Multi.new.release_gvl?
+  ensure
+    Curl::Multi.release_gvl = false
+  end
+
+  def test_release_gvl_buffers_default_handlers_natively
+    omit_unless_release_gvl
+    [:auto, :select].each do |backend|
+      m = Curl::Multi.new
+      m.event_backend = backend
+      m.release_gvl = true
+      results = []
+      5.times do |i|
+        c = Curl::Easy.new("#{TestServlet.url}?n=#{i}")
+        c.on_complete { |curl| results << [curl.body_str, curl.header_str.start_with?('HTTP/1.1 200')] }
+        m.add(c)
+      end
+      m.perform
+      assert_equal (0...5).map { |i| ["GETn=#{i}", true] }.sort, results.sort, "backend #{backend}"
+      m.close
+    end
+  end
+
+  def test_release_gvl_runs_ruby_callbacks_with_the_gvl
+    omit_unless_release_gvl
+    m = Curl::Multi.new
+    m.release_gvl = true
+    chunks = []
+    headers = []
+    progress = 0
+    c = Curl::Easy.new(TestServlet.url)
+    c.on_body { |data| chunks << data; data.bytesize }
+    c.on_header { |data| headers << data; data.bytesize }
+    c.on_progress { |*| progress += 1; true }
+    m.add(c)
+    m.perform
+
+    assert_equal 'GET', chunks.join
+    assert_match(/\AHTTP\/1\.1 200/, headers.first)
+    assert_operator progress, :>, 0
+  end
+
+  def test_release_gvl_reraises_body_callback_errors
+    omit_unless_release_gvl
+    m = Curl::Multi.new
+    m.release_gvl = true
+    c = Curl::Easy.new(TestServlet.url)
+    c.on_body { |_| raise 'body failure' }
+    m.add(c)
+    error = assert_raise(RuntimeError) { m.perform }
+    assert_equal 'body failure', error.message
+  end
+
+  def test_release_gvl_enforces_max_body_bytes
+    omit_unless_release_gvl
+    m = Curl::Multi.new
+    m.release_gvl = true
+    c = Curl::Easy.new(TestServlet.url)
+    c.max_body_bytes = 1
+    m.add(c)
+    assert_raise(Curl::Err::FileSizeExceededError) { m.perform }
+    assert_equal '', c.body_str.to_s
+  end
+
+  def test_release_gvl_refuses_add_from_a_running_callback
+    omit_unless_release_gvl
+    m = Curl::Multi.new
+    m.release_gvl = true
+    raised = nil
+    c = Curl::Easy.new(TestServlet.url)
+    c.on_body do |data|
+      begin
+        m.add(Curl::Easy.new(TestServlet.url))
+      rescue RuntimeError => e
+        raised = e
+      end
+      data.bytesize
+    end
+    m.add(c)
+    m.perform
+    assert_match(/without the GVL/, raised.message)
+  end
+
+  def test_enqueue_admits_at_most_max_in_flight_handles
+    [false, true].each do |release_gvl|
+      next if release_gvl && !release_gvl_supported?
+      m = Curl::Multi.new
+      m.release_gvl = release_gvl
+      m.max_in_flight = 2
+      in_flight = []
+      results = []
+      6.times do |i|
+        c = Curl::Easy.new("#{TestServlet.url}?n=#{i}")
+        c.on_complete { |curl| in_flight << m.requests.size + 1; results << curl.body_str }
+        m.enqueue(c)
+      end
+      assert_equal 2, m.requests.size
+      assert_equal 4, m.queue_size
+      assert !m.idle?
+
+      m.perform
+
+      assert_equal (0...6).map { |i| "GETn=#{i}" }.sort, results.sort, "release_gvl=#{release_gvl}"
+      assert in_flight.max <= 2, "more than max_in_flight attached: #{in_flight.inspect}"
+      assert_equal 0, m.queue_size
+      assert m.idle?
+      m.close
+    end
+  end
+
+  def test_enqueue_refills_from_completions_without_a_perform_block
+    m = Curl::Multi.new
+    m.max_in_flight = 1
+    order = []
+    3.times do |i|
+      c = Curl::Easy.new("#{TestServlet.url}?n=#{i}")
+      c.on_complete { |curl| order << curl.body_str }
+      m.enqueue(c)
+    end
+    m.perform
+    assert_equal %w[GETn=0 GETn=1 GETn=2], order
+  ensure
+    m.close if m
+  end
+
+  def test_remove_drops_a_queued_handle
+    m = Curl::Multi.new
+    m.max_in_flight = 1
+    done = []
+    easies = 3.times.map do |i|
+      c = Curl::Easy.new("#{TestServlet.url}?n=#{i}")
+      c.on_complete { |curl| done << curl.body_str }
+      m.enqueue(c)
+      c
+    end
+    m.remove(easies.last)
+    assert_equal 1, m.queue_size
+    m.perform
+    assert_equal %w[GETn=0 GETn=1], done
+  ensure
+    m.close if m
+  end
+
+  def test_enqueue_takes_turns_between_hosts
+    m = Curl::Multi.new
+    m.max_in_flight = 1
+    order = []
+    enqueue = lambda do |host, i|
+      c = Curl::Easy.new("#{TestServlet.url}?#{host}=#{i}")
+      c.on_complete { order << host }
+      m.enqueue(c, host: host)
+    end
+    6.times { |i| enqueue.call("a", i) }
+    2.times { |i| enqueue.call("b", i) }
+
+    m.perform
+
+    # the first "a" is admitted by enqueue itself, before "b" has any work
+    assert_equal %w[a a b a b a a a], order
+  ensure
+    m.close if m
+  end
+
+  def test_enqueue_admits_higher_priority_first
+    m = Curl::Multi.new
+    m.max_in_flight = 1
+    order = []
+    enqueue = lambda do |name, priority|
+      c = Curl::Easy.new("#{TestServlet.url}?#{name}")
+      c.priority = priority
+      c.on_complete { order << name }
+      m.enqueue(c)
+    end
+    3.times { |i| enqueue.call("bulk#{i}", 1) }
+    2.times { |i| enqueue.call("interactive#{i}", 256) }
+    enqueue.call("default", nil)
+
+    m.perform
+
+    # bulk0 is admitted by enqueue itself, before anything else is queued
+    assert_equal %w[bulk0 interactive0 interactive1 default bulk1 bulk2], order
+  ensure
+    m.close if m
+  end
+
+  def test_enqueue_caps_in_flight_per_host
+    m = Curl::Multi.new
+    m.max_in_flight_per_host = 1
+    busiest = 0
+    attached = 0
+    %w[a b c].each do |host|
+      3.times do |i|
+        c = Curl::Easy.new("#{TestServlet.url}?#{host}=#{i}")
+        c.on_complete do
+          attached = [attached, m.requests.size + 1].max
+          busiest = [busiest, *m.queue_stats.values.map { |s| s[:in_flight] }].max
+        end
+        m.enqueue(c, host: host)
+      end
+    end
+    assert_equal 3, m.requests.size
+    assert_equal 6, m.queue_size
+
+    m.perform
+
+    assert_equal 0, m.queue_size
+    assert busiest <= 1, "a host exceeded its limit: #{busiest}"
+    assert attached > 1, "hosts should still run in parallel"
+  ensure
+    m.close if m
+  end
+
+  def test_queue_stats_and_limit_host
+    m = Curl::Multi.new
+    m.max_in_flight_per_host = 1
+    key = URI(TestServlet.url).then { |u| "#{u.host}:#{u.port}" }
+    2.times { m.enqueue(Curl::Easy.new(TestServlet.url)) }
+    assert_equal({ key => { queued: 1, in_flight: 1, limit: 1 } }, m.queue_stats)
+
+    m.limit_host(key, 2)
+    assert_equal({ key => { queued: 0, in_flight: 2, limit: 2 } }, m.queue_stats)
+
+    m.perform
+    assert_equal({ key => { queued: 0, in_flight: 0, limit: 2 } }, m.queue_stats)
+
+    m.limit_host(key, nil)
+    assert_equal({}, m.queue_stats)
+    assert_raise(ArgumentError) { m.max_in_flight_per_host = -1 }
+  ensure
+    m.close if m
+  end
+
+  def test_default_host_key_fills_in_the_schemes_port
+    m = Curl::Multi.new
+    m.max_in_flight_per_host = 1
+    { "http://Example.com/a" => "example.com:80",
+      "https://user:pw@example.com?q=1" => "example.com:443",
+      "https://example.com:8443/" => "example.com:8443",
+      "ftp://example.com/f" => "example.com:21",
+      "example.org/path" => "example.org:80",
+      "http://[::1]/" => "[::1]:80",
+      "http://[::1]:8080/" => "[::1]:8080",
+      "gopher://example.com/" => "example.com" }.each do |url, key|
+      m.enqueue(Curl::Easy.new(url))
+      assert_equal({ queued: 0, in_flight: 1, limit: 1 }, m.queue_stats[key], url)
+    end
+    m.enqueue(Curl::Easy.new("https://example.com:443/"))
+    assert_equal 1, m.queue_stats["example.com:443"][:queued]
+  ensure
+    m.close if m
+  end
+
+  def test_max_in_flight_setting
+    m = Curl::Multi.new
+    assert_equal 0, m.max_in_flight
+    m.max_in_flight = 4
+    assert_equal 4, m.max_in_flight
+    m.max_in_flight = nil
+    assert_equal 0, m.max_in_flight
+    assert_raise(ArgumentError) { m.max_in_flight = -1 }
+  ensure
+    m.close if m
+  end
+
+  def test_http2_multiplexing_settings
+    m = Curl::Multi.new
+    assert_equal false, m.pipewait?
+    m.pipewait = true
+    assert_equal true, m.pipewait?
+    begin
+      m.max_concurrent_streams = 50
+    rescue NotImplementedError
+    end
+
+    easy = Curl::Easy.new(TestServlet.url)
+    m.add(easy)
+    m.perform
+    assert_equal 'GET', easy.body_str
+    # HTTP/1.1 reuse is not multiplexing
+    assert_equal 0, m.stats[:connections][:multiplexed]
+  ensure
+    m.close if m
+  end
+
+  # Drive +m+ the way an outside reactor would: IO.select over what
+  # on_socket asked for, timeout_action when on_timer's timer expires.
+  def drive_step_loop(m, limit: 10)
+    watched = {}
+    timer_at = nil
+    m.on_socket { |fd, what| what == :remove ? watched.delete(fd) : watched[fd] = what }
+    m.on_timer { |ms| timer_at = ms && Process.clock_gettime(Process::CLOCK_MONOTONIC) + ms / 1000.0 }
+    yield
+    deadline = Process.clock_gettime(Process::CLOCK_MONOTONIC) + limit
+    running = nil
+    until running == 0 && m.requests.empty?
+      flunk 'step loop stalled' if Process.clock_gettime(Process::CLOCK_MONOTONIC) > deadline
+      ios = watched.to_h { |fd, what| [fd, IO.for_fd(fd, autoclose: false)] }
+      readers = ios.select { |fd, _| watched[fd] != :out }.values
+      writers = ios.select { |fd, _| watched[fd] != :in }.values
+      wait = timer_at ? [timer_at - Process.clock_gettime(Process::CLOCK_MONOTONIC), 0].max : 1
+      ready = IO.select(readers, writers, nil, wait)
+      if ready
+        ready[0].each { |io| running = m.socket_action(io.fileno, :in) }
+        ready[1].each { |io| running = m.socket_action(io, Curl::Multi::CSELECT_OUT) }
+      elsif timer_at
+        timer_at = nil
+        running = m.timeout_action
+      end
+    end
+  end
+
+  def test_step_api_drives_transfers_from_an_outside_loop
+    m = Curl::Multi.new
+    m.max_in_flight = 2
+    completed = []
+    drive_step_loop(m) do
+      5.times do |i|
+        easy = Curl::Easy.new("#{TestServlet.url}?i=#{i}")
+        easy.on_complete { |c| completed << c }
+        m.enqueue(easy)
+      end
+      refused = Curl::Easy.new('http://127.0.0.1:1/')
+      refused.retry_policy = { attempts: 1, backoff: 0.05 }
+      refused.on_failure { }
+      m.add(refused)
+    end
+    assert_equal 5, completed.size
+    assert_equal 1, m.stats[:retries]
+    assert_equal 2, m.stats[:results][7]
+    assert_equal 5.times.map { |i| "GETi=#{i}" }, completed.map(&:body_str).sort
+    assert_equal 5, m.stats[:results][0]
+  ensure
+    m.close if m
+  end
+
+  def test_step_api_hooks_exclude_perform_and_reraise_errors
+    m = Curl::Multi.new
+    m.on_timer { |ms| raise 'timer hook failed' }
+    m.add(Curl::Easy.new(TestServlet.url))
+    assert_raise(RuntimeError) { m.perform }
+    error = assert_raise(RuntimeError) { m.timeout_action }
+    assert_equal 'timer hook failed', error.message
+
+    m.on_timer
+    assert_raise(ArgumentError) { m.socket_action(0, :sideways) }
+  ensure
+    m.close if m
+  end
+
+  def test_each_completed_pulls_a_lazy_source_at_the_concurrency_limit
+    m = Curl::Multi.new
+    pulled = 0
+    source = (0...20).lazy.map { |i| pulled += 1; "#{TestServlet.url}?n=#{i}" }
+    in_flight = []
+    unyielded = []
+    bodies = []
+    m.each_completed(source, concurrency: 3) do |easy|
+      in_flight << m.requests.size + m.queue_size
+      unyielded << pulled - bodies.size
+      bodies << easy.body_str
+    end
+
+    assert_equal (0...20).map { |i| "GETn=#{i}" }.sort, bodies.sort
+    assert in_flight.max <= 3, "more than concurrency in flight: #{in_flight.inspect}"
+    # at most one batch of finished easies waits to be yielded
+    assert unyielded.max <= 6, "pulled ahead of concurrency: #{unyielded.inspect}"
+    assert m.idle?
+  ensure
+    m.close if m
+  end
+
+  def test_each_completed_enumerator_cancels_remaining_work_when_left_early
+    m = Curl::Multi.new
+    c = Curl::Easy.new("#{TestServlet.url}?n=added")
+    m.add(c)
+    pending = m.each_completed
+    assert_equal 1, m.requests.size
+    assert_equal [c], pending.to_a
+    assert_equal 200, c.response_code
+
+    m.add(c)
+    urls = (0...10).map { |i| "#{TestServlet.url}?n=#{i}" }
+    first = m.each_completed(urls, concurrency: 4).first(2)
+
+    assert_equal 2, first.size
+    assert first.all? { |easy| easy.is_a?(Curl::Easy) && easy.response_code == 200 }
+    assert m.idle?
+  ensure
+    m.close if m
+  end
+
+  def test_hedge_takes_the_first_of_two_transfers
+    with_slow_first_connection(1.5) do |url, connections|
+      m = Curl::Multi.new
+      c = Curl::Easy.new(url)
+      c.hedge_after = 100
+      completed = 0
+      c.on_complete { completed += 1 }
+      m.add(c)
+      started = Process.clock_gettime(Process::CLOCK_MONOTONIC)
+      m.perform
+
+      assert_operator Process.clock_gettime(Process::CLOCK_MONOTONIC) - started, :<, 1.0
+      assert_equal 2, connections.size
+      assert_equal 1, completed
+      assert_equal 200, c.response_code
+      assert_equal 'fast', c.body_str
+      assert_match(/X-Connection: 2/, c.header_str)
+      assert_equal({ fired: 1, won: 1 }, m.hedge_stats)
+      assert m.requests.empty?
+      assert_nil c.multi
+
+      # the easy keeps working on its own afterwards
+      c.hedge_after = nil
+      c.perform
+      assert_equal 'fast', c.body_str
+    ensure
+      m.close if m
+    end
+  end
+
+  def test_hedge_hands_the_clones_share_to_the_original
+    cookies = "http://localhost:#{TestServlet.port}#{TestServlet.path}"
+    share = Curl::Share.new(:cookie)
+    setter = Curl::Easy.new("#{cookies}/set_cookies")
+    setter.enable_cookies = true
+    setter.share = share
+    setter.post_body = JSON.generate([{ name: 'c1', value: 'v1', domain: 'localhost', path: '/' }])
+    setter.perform
+
+    with_slow_first_connection(1.5) do |url, connections|
+      m = Curl::Multi.new
+      c = Curl::Easy.new(url)
+      c.enable_cookies = true
+      c.share = share
+      c.hedge_after = 100
+      m.add(c)
+      m.perform
+      assert_equal 'fast', c.body_str
+      assert_equal({ fired: 1, won: 1 }, m.hedge_stats)
+
+      # the adopted handle must let go of the share like any other
+      c.share = nil
+      c.hedge_after = nil
+      c.url = "#{cookies}/get_cookies"
+      c.perform
+      assert_equal '', c.body_str
+
+      c.share = share
+      c.perform
+      assert_equal 'c1=v1', c.body_str
+    ensure
+      m.close if m
+    end
+  end
+
+  def test_hedge_waits_for_the_clone_when_the_original_fails_first
+    # the first connection is dropped without a reply while the clone's
+    # transfer is still running
+    with_slow_first_connection(0.3, later_delay: 0.5, drop: :first) do |url, connections|
+      m = Curl::Multi.new
+      c = Curl::Easy.new(url)
+      c.hedge_after = 100
+      completed = failed = 0
+      c.on_complete { completed += 1 }
+      c.on_failure { failed += 1 }
+      m.add(c)
+      m.perform
+
+      assert_equal 2, connections.size
+      assert_equal 1, completed
+      assert_equal 0, failed
+      assert_equal 200, c.response_code
+      assert_equal 'fast', c.body_str
+      assert_match(/X-Connection: 2/, c.header_str)
+      assert_equal({ fired: 1, won: 1 }, m.hedge_stats)
+      assert m.requests.empty?
+    ensure
+      m.close if m
+    end
+
+    # when both transfers fail the error is reported once, on the original
+    with_slow_first_connection(0.3, later_delay: 0.3, drop: :all) do |url, connections|
+      m = Curl::Multi.new
+      c = Curl::Easy.new(url)
+      c.hedge_after = 100
+      failed = 0
+      c.on_failure { failed += 1 }
+      m.add(c)
+      m.perform
+
+      assert_equal 2, connections.size
+      assert_equal 1, failed
+      assert_not_equal 0, c.last_result
+      assert_equal({ fired: 1, won: 0 }, m.hedge_stats)
+      assert m.requests.empty?
+    ensure
+      m.close if m
+    end
+  end
+
+  def test_hedge_does_not_fire_for_fast_responses
+    m = Curl::Multi.new
+    easies = 5.times.map do |i|
+      c = Curl::Easy.new("#{TestServlet.url}?n=#{i}")
+      c.hedge_after = 2000
+      m.add(c)
+      c
+    end
+    m.perform
+
+    assert_equal 5.times.map { |i| "GETn=#{i}" }, easies.map(&:body_str)
+    assert_equal({ fired: 0, won: 0 }, m.hedge_stats)
+  ensure
+    m.close if m
+  end
+
+  def test_hedge_is_skipped_for_ruby_transfer_callbacks
+    with_slow_first_connection(0.4) do |url, connections|
+      m = Curl::Multi.new
+      c = Curl::Easy.new(url)
+      c.hedge_after = 50
+      body = +''
+      c.on_body { |data| body << data; data.bytesize }
+      m.add(c)
+      m.perform
+
+      assert_equal 'slow', body
+      assert_equal 1, connections.size
+      assert_equal({ fired: 0, won: 0 }, m.hedge_stats)
+    ensure
+      m.close if m
+    end
+  end
+
+  def test_retry_policy_retries_statuses_until_success
+    responses = [
+      "HTTP/1.1 503 Service Unavailable\r\nContent-Length: 4\r\n\r\nbusy",
+      "HTTP/1.1 503 Service Unavailable\r\nContent-Length: 4\r\n\r\nbusy",
+      "HTTP/1.1 200 OK\r\nContent-Length: 2\r\n\r\nok"
+    ]
+    with_scripted_responses(responses) do |url, served|
+      c = Curl::Easy.new(url)
+      c.retry_policy = { attempts: 3, backoff: 0.05, jitter: 0 }
+      completed = []
+      c.on_complete { |easy| completed << easy.response_code }
+      c.perform
+
+      assert_equal 3, served.size
+      assert_equal 200, c.response_code
+      assert_equal 'ok', c.body_str
+      assert_equal 2, c.retry_count
+      assert_equal [200], completed
+    end
+  end
+
+  def test_retry_policy_gives_up_after_attempts
+    c = Curl::Easy.new('http://127.0.0.1:1/')
+    c.retry_policy = { attempts: 2, backoff: 0.01 }
+    assert_raise(Curl::Err::ConnectionFailedError) { c.perform }
+    assert_equal 2, c.retry_count
+
+    c.retry_policy = nil
+    assert_raise(Curl::Err::ConnectionFailedError) { c.perform }
+    assert_equal 0, c.retry_count
+  end
+
+  def test_retry_policy_honours_retry_after
+    responses = [
+      "HTTP/1.1 429 Too Many Requests\r\nRetry-After: 1\r\nContent-Length: 0\r\n\r\n",
+      "HTTP/1.1 200 OK\r\nContent-Length: 2\r\n\r\nok"
+    ]
+    with_scripted_responses(responses) do |url, served|
+      c = Curl::Easy.new(url)
+      c.retry_policy = { attempts: 1, backoff: 0.01, max_backoff: 5 }
+      started = Process.clock_gettime(Process::CLOCK_MONOTONIC)
+      c.perform
+
+      assert_operator Process.clock_gettime(Process::CLOCK_MONOTONIC) - started, :>=, 0.9
+      assert_equal 'ok', c.body_str
+    end
+
+    with_scripted_responses(responses) do |url, served|
+      c = Curl::Easy.new(url)
+      c.retry_policy = { attempts: 1, backoff: 0.01, max_backoff: 0.5 }
+      c.perform
+
+      # asked to wait longer than max_backoff: the 429 is returned as is
+      assert_equal 429, c.response_code
+      assert_equal 1, served.size
+      assert_equal 0, c.retry_count
+    end
+  end
+
+  def test_retry_backoff_does_not_block_other_transfers
+    responses = [
+      "HTTP/1.1 503 Service Unavailable\r\nContent-Length: 0\r\n\r\n",
+      "HTTP/1.1 200 OK\r\nContent-Length: 2\r\n\r\nok"
+    ]
+    with_scripted_responses(responses) do |url, served|
+      m = Curl::Multi.new
+      order = []
+      retried = Curl::Easy.new(url)
+      retried.retry_policy = { attempts: 1, backoff: 0.5, jitter: 0 }
+      retried.on_complete { order << :retried }
+      m.add(retried)
+      m.perform do
+        if order.empty? && served.size == 1 && m.requests.size == 1
+          fast = Curl::Easy.new(TestServlet.url)
+          fast.on_complete { order << :fast }
+          m.add(fast)
+        end
+      end
+
+      assert_equal [:fast, :retried], order
+      assert_equal 'ok', retried.body_str
+      assert m.requests.empty?
+    ensure
+      m.close if m
+    end
+  end
+
+  def test_remove_cancels_a_waiting_retry
+    responses = ["HTTP/1.1 503 Service Unavailable\r\nContent-Length: 0\r\n\r\n"] * 2
+    with_scripted_responses(responses) do |url, served|
+      m = Curl::Multi.new
+      c = Curl::Easy.new(url)
+      c.retry_policy = { attempts: 1, backoff: 5 }
+      m.add(c)
+      started = Process.clock_gettime(Process::CLOCK_MONOTONIC)
+      m.perform { m.remove(c) if served.size == 1 && c.retry_count == 1 }
+
+      assert_operator Process.clock_gettime(Process::CLOCK_MONOTONIC) - started, :<, 3
+      assert_equal 1, served.size
+      assert_nil c.multi
+      assert m.idle?
+    ensure
+      m.close if m
+    end
+  end
+
+  def test_prewarm_opens_connections_later_requests_reuse
+    m = Curl::Multi.new
+    report = m.prewarm([TestServlet.url, "#{TestServlet.url}?other=1"], per_host: 3)
+
+    assert_equal 3, report[:warmed]
+    assert_equal 0, report[:failed]
+    assert_equal 3, report[:connections].size
+    assert report[:connections].all? { |c| c[:connect_time] > 0 && c[:error].nil? }
+
+    easies = 3.times.map { Curl::Easy.new(TestServlet.url) }
+    easies.each { |easy| m.add(easy) }
+    m.perform
+    assert_equal [0, 0, 0], easies.map(&:num_connects)
+    assert_equal ['GET'] * 3, easies.map(&:body_str)
+  ensure
+    m.close if m
+  end
+
+  def test_prewarm_copies_easy_options_without_running_handlers
+    m = Curl::Multi.new
+    template = Curl::Easy.new(TestServlet.url)
+    template.headers['X-Warm'] = '1'
+    called = false
+    template.on_complete { called = true }
+    template.on_body { |data| called = true; data.bytesize }
+
+    report = m.prewarm([template, 'http://127.0.0.1:1/'])
+    assert_equal 1, report[:warmed]
+    assert_equal 1, report[:failed]
+    assert_equal Curl::Err::ConnectionFailedError, report[:connections].map { |c| c[:error] }.compact.first
+    assert !called
+    assert_equal({ 'X-Warm' => '1' }, template.headers)
+    assert_raise(ArgumentError) { m.prewarm([TestServlet.url], per_host: 0) }
+  ensure
+    m.close if m
+  end
+
+  def test_perform_deadline_aborts_remaining_transfers
+    server = TCPServer.new('127.0.0.1', 0) # accepts connections, never answers
+    m = Curl::Multi.new
+    m.max_in_flight = 3
+    failures = []
+    completed = []
+    3.times do
+      c = Curl::Easy.new("http://127.0.0.1:#{server.addr[1]}/")
+      c.on_failure { |easy, err| failures << err.first }
+      c.on_complete { |easy| completed << easy.last_result }
+      m.add(c)
+    end
+    m.enqueue(Curl::Easy.new(TestServlet.url))
+
+    started = Process.clock_gettime(Process::CLOCK_MONOTONIC)
+    m.perform(deadline: 0.2)
+    elapsed = Process.clock_gettime(Process::CLOCK_MONOTONIC) - started
+
+    assert_operator elapsed, :<, 1.5
+    assert_equal [Curl::Err::TimeoutError] * 3, failures
+    assert_equal [28] * 3, completed
+    assert m.idle?
+    assert_equal({ 28 => 3 }, m.stats[:results])
+  ensure
+    m.close if m
+    server.close if server
+  end
+
+  def test_add_from_another_thread_wakes_a_blocked_perform
+    server = TCPServer.new('127.0.0.1', 0) # keeps one transfer waiting
+    timeout = Curl::Multi.default_timeout
+    Curl::Multi.default_timeout = 3000
+    m = Curl::Multi.new
+    slow = Curl::Easy.new("http://127.0.0.1:#{server.addr[1]}/")
+    slow.timeout = 1.5
+    slow.on_failure { }
+    m.add(slow)
+
+    late = Curl::Easy.new(TestServlet.url)
+    added_at = finished_at = nil
+    late.on_complete { finished_at = Process.clock_gettime(Process::CLOCK_MONOTONIC) }
+    adder = Thread.new do
+      sleep 0.2
+      added_at = Process.clock_gettime(Process::CLOCK_MONOTONIC)
+      m.enqueue(late)
+    end
+    m.perform
+    adder.join
+
+    assert_equal 'GET', late.body_str
+    assert_operator finished_at - added_at, :<, 0.75
+    assert_operator m.stats[:event_loop][:wakeups], :>=, 1
+  ensure
+    Curl::Multi.default_timeout = timeout if timeout
+    m.close if m
+    server.close if server
+  end
+
+  def test_cancel_token_aborts_perform_from_another_thread
+    server = TCPServer.new('127.0.0.1', 0)
+    token = Curl::CancelToken.new
+    m = Curl::Multi.new
+    easies = 2.times.map { Curl::Easy.new("http://127.0.0.1:#{server.addr[1]}/") }
+    easies.each { |easy| m.add(easy) }
+
+    canceller = Thread.new { sleep 0.2; token.cancel! }
+    m.perform(cancel: token, deadline: Time.now + 10)
+
+    assert_equal true, canceller.value
+    assert token.cancelled?
+    assert_equal false, token.cancel!
+    assert_equal [42, 42], easies.map(&:last_result)
+    assert m.idle?
+  ensure
+    m.close if m
+    server.close if server
+  end
+
+  def test_perform_limits_leave_finished_transfers_alone
+    token = Curl::CancelToken.new
+    m = Curl::Multi.new
+    c = Curl::Easy.new(TestServlet.url)
+    m.add(c)
+    m.perform(deadline: 5, cancel: token)
+    assert_equal 0, c.last_result
+    assert_equal 'GET', c.body_str
+
+    assert_raise(TypeError) { m.perform(deadline: 'soon') }
+    assert_raise(TypeError) { m.perform(cancel: true) }
+    assert_raise(ArgumentError) { m.perform(budget: 1) }
+  ensure
+    m.close if m
+  end
+
+  def test_stats_counts_results_bytes_connections_and_phases
+    m = Curl::Multi.new
+    m.max_in_flight = 1
+    easies = 4.times.map { |i| Curl::Easy.new("#{TestServlet.url}?i=#{i}") }
+    easies.each { |easy| m.enqueue(easy) }
+    failed = Curl::Easy.new('http://127.0.0.1:1/')
+    failed.on_failure { }
+    m.add(failed)
+    m.perform
+
+    stats = m.stats
+    assert_equal 0, stats[:active]
+    assert_equal 0, stats[:queued]
+    assert_equal 5, stats[:completed]
+    assert_equal({ 0 => 4, 7 => 1 }, stats[:results])
+    assert_equal easies.sum { |easy| easy.body_str.bytesize }, stats[:bytes_down]
+    assert_equal 0, stats[:bytes_up]
+    assert_equal 1, stats[:connections][:created]
+    assert_equal 3, stats[:connections][:reused]
+    assert_equal({ fired: 0, won: 0 }, stats[:hedges])
+    assert_include [:select, :epoll, :io_uring], stats[:event_loop][:backend]
+
+    assert_equal Curl::Multi::STATS_BUCKETS.size, stats[:phases][:total].size
+    assert_equal Float::INFINITY, Curl::Multi::STATS_BUCKETS.last
+    assert_equal 5, stats[:phases][:total].sum
+    assert_equal 1, stats[:phases][:connect].sum
+    assert_equal 0, stats[:phases][:appconnect].sum
+    assert_equal 4, stats[:phases][:starttransfer].sum
+
+    m.reset_stats
+    assert_equal 0, m.stats[:completed]
+    assert_equal({}, m.stats[:results])
+  ensure
+    m.close if m
+  end
+
+  def test_stats_counts_retries_and_queued_work
+    m = Curl::Multi.new
+    m.max_in_flight = 1
+    c = Curl::Easy.new('http://127.0.0.1:1/')
+    c.retry_policy = { attempts: 2, backoff: 0.01 }
+    c.on_failure { }
+    m.enqueue(c)
+    m.enqueue(Curl::Easy.new(TestServlet.url))
+    assert_equal 1, m.stats[:queued]
+    m.perform
+
+    stats = m.stats
+    assert_equal 2, stats[:retries]
+    assert_equal 4, stats[:completed]
+    assert_equal 3, stats[:results][7]
+  ensure
+    m.close if m
+  end
+
+  # Answers each connection with the next response and closes it.
+  def with_scripted_responses(responses)
+    served = []
+    handler = lambda do |sock, n|
+      response = responses[n - 1]
+      return unless response
+      served << response
+      sock.write(response.sub("\r\n", "\r\nConnection: close\r\n"))
+    end
+    with_raw_connections(handler) { |url, _| yield url, served }
+  end
+
+  # Serve every connection to a local server from its own thread: +handler+
+  # gets the socket, once the request has been read, and the connection's
+  # number counting from 1.
+  def with_raw_connections(handler)
+    server = TCPServer.new('127.0.0.1', 0)
+    port = server.addr[1]
+    connections = []
+    threads = []
+    acceptor = Thread.new do
+      loop do
+        socket = server.accept
+        number = connections.size + 1
+        connections << number
+        threads << Thread.new(socket, number) do |sock, n|
+          begin
+            sock.readpartial(4096)
+            handler.call(sock, n)
+          rescue IOError, SystemCallError
+          ensure
+            sock.close
+          end
+        end
+      end
+    rescue IOError, SystemCallError
+    end
+
+    yield "http://127.0.0.1:#{port}/", connections
+  ensure
+    server.close if server && !server.closed?
+    acceptor.join(5) if acceptor
+    threads.each { |t| t.join(5) }
+  end
+
+  # The first connection answers "slow" after +delay+ seconds, later ones
+  # answer "fast" after +later_delay+. +drop+ closes the :first or :all
+  # connections after their delay without a reply instead.
+  def with_slow_first_connection(delay, later_delay: 0, drop: nil, &block)
+    handler = lambda do |sock, n|
+      sleep(n == 1 ? delay : later_delay)
+      return if drop == :all || (drop == :first && n == 1)
+      body = n == 1 ? 'slow' : 'fast'
+      sock.write("HTTP/1.1 200 OK\r\nContent-Length: 4\r\nX-Connection: #{n}\r\nConnection: close\r\n\r\n#{body}")
+    end
+    with_raw_connections(handler, &block)
+  end
+
   def with_queue_refill_test_server(wait_fail_until_slow: false)
     port_socket = TCPServer.new('127.0.0.1', 0)
     port = port_socket.addr[1]
@@ -1515,6 +2535,20 @@ class TestCurbCurlMulti < Test::Unit::TestCase
     server_thread.kill if defined?(server_thread) && server_thread&.alive?
   end
 
+  def release_gvl_supported?
+    m = Curl::Multi.new
+    m.release_gvl = true
+    true
+  rescue NotImplementedError
+    false
+  ensure
+    m.close if m
+  end
+
+  def omit_unless_release_gvl
+    omit('releasing the GVL is not supported by this build') unless release_gvl_supported?
+  end
+
   def with_raw_http_response(response)
     server = TCPServer.new('127.0.0.1', 0)
     port = server.addr[1]
@@ -0,0 +1,148 @@
+require File.expand_path(File.join(File.dirname(__FILE__), 'helper'))
+
+class TestCurbCurlReactor < Test::Unit::TestCase
+  include TestServerMethods
+
+  def setup
+    omit('Curl::Reactor is not available in this build') unless defined?(Curl::Reactor)
+    server_setup
+    @reactor = Curl::Reactor.new
+  end
+
+  def teardown
+    @reactor.close if @reactor
+    super
+  end
+
+  def test_submit_returns_future_resolving_to_easy
+    future = @reactor.submit(Curl::Easy.new("#{TestServlet.url}?n=1"))
+    easy = future.value
+
+    assert future.ready?
+    assert_same easy, future.easy
+    assert_equal 200, easy.response_code
+    assert_equal 'GETn=1', easy.body_str
+    assert_match(/HTTP\/1\.1 200/, easy.header_str)
+    assert_equal 0, @reactor.pending
+  end
+
+  def test_submit_from_many_threads_shares_one_reactor
+    threads = 8.times.map do |t|
+      Thread.new do
+        4.times.map { |i| @reactor.submit("#{TestServlet.url}?t=#{t}&i=#{i}") }.map { |f| f.value.body_str }
+      end
+    end
+    bodies = threads.flat_map(&:value)
+
+    expected = 8.times.flat_map { |t| 4.times.map { |i| "GETt=#{t}&i=#{i}" } }
+    assert_equal expected.sort, bodies.sort
+    assert_equal 32, @reactor.completed
+  end
+
+  def test_value_lets_other_threads_run
+    with_delayed_response(0.5) do |url|
+      future = @reactor.submit(url)
+      ticks = 0
+      ticker = Thread.new { loop { ticks += 1; sleep 0.01 } }
+      future.value
+      ticker.kill
+      assert_operator ticks, :>, 10
+    end
+  end
+
+  def test_wait_with_timeout_returns_nil_until_done
+    with_delayed_response(0.5) do |url|
+      future = @reactor.submit(url)
+      assert_nil future.wait(0.05)
+      assert !future.ready?
+      assert_same future, future.wait(5)
+      assert_equal 'slow', future.value.body_str
+    end
+  end
+
+  def test_value_raises_like_perform
+    future = @reactor.submit(Curl::Easy.new('http://127.0.0.1:1/'))
+    assert_raise(Curl::Err::ConnectionFailedError) { future.value }
+  end
+
+  def test_max_body_bytes_is_enforced_on_the_reactor_thread
+    easy = Curl::Easy.new(TestServlet.url)
+    easy.max_body_bytes = 2
+    assert_raise(Curl::Err::FileSizeExceededError) { @reactor.submit(easy).value }
+  end
+
+  def test_easy_is_reserved_until_its_future_resolves
+    with_delayed_response(0.3) do |url|
+      easy = Curl::Easy.new(url)
+      future = @reactor.submit(easy)
+      assert_raise(RuntimeError) { @reactor.submit(easy) }
+      assert_raise(RuntimeError) { Curl::Multi.new.add(easy) }
+      future.value
+    end
+
+    easy = Curl::Easy.new(TestServlet.url)
+    @reactor.submit(easy).value
+    assert_equal 'GET', @reactor.submit(easy).value.body_str
+  end
+
+  def test_rejects_ruby_transfer_callbacks
+    easy = Curl::Easy.new(TestServlet.url)
+    easy.on_body { |data| data.bytesize }
+    assert_raise(ArgumentError) { @reactor.submit(easy) }
+    assert_equal 0, @reactor.pending
+  end
+
+  def test_close_aborts_in_flight_transfers
+    with_delayed_response(2) do |url|
+      future = @reactor.submit(url)
+      sleep 0.1
+      @reactor.close
+      assert @reactor.closed?
+      assert_raise(Curl::Err::AbortedByCallbackError) { future.value }
+      assert_raise(RuntimeError) { @reactor.submit(TestServlet.url) }
+    end
+  end
+
+  def test_reactor_collected_with_its_in_flight_easies
+    with_delayed_response(0.3) do |url|
+      submit_and_drop = lambda do
+        reactor = Curl::Reactor.new
+        4.times { reactor.submit(Curl::Easy.new(url)) }
+        nil
+      end
+      submit_and_drop.call
+      3.times { GC.start(full_mark: true, immediate_sweep: true) }
+      sleep 0.5
+      GC.start(full_mark: true, immediate_sweep: true)
+    end
+
+    # the orphaned easies are freed on the next pass through a reactor
+    assert_equal 'GETn=2', @reactor.submit("#{TestServlet.url}?n=2").value.body_str
+  end
+
+  private
+
+  def with_delayed_response(delay)
+    server = TCPServer.new('127.0.0.1', 0)
+    port = server.addr[1]
+    thread = Thread.new do
+      socket = server.accept
+      begin
+        socket.readpartial(4096)
+        sleep delay
+        socket.write("HTTP/1.1 200 OK\r\nContent-Length: 4\r\nConnection: close\r\n\r\nslow")
+      rescue IOError, SystemCallError
+      ensure
+        socket.close
+      end
+    end
+
+    yield "http://127.0.0.1:#{port}/"
+  ensure
+    server.close if server && !server.closed?
+    if thread
+      thread.join(5)
+      thread.kill if thread.alive?
+    end
+  end
+end
@@ -0,0 +1,129 @@
+require File.expand_path(File.join(File.dirname(__FILE__), 'helper'))
+require 'json'
+
+class TestCurbCurlShare < Test::Unit::TestCase
+  include TestServerMethods
+
+  def setup
+    server_setup
+  end
+
+  def test_new_shares_dns_and_ssl_sessions_by_default
+    share = Curl::Share.new
+    assert_equal [:dns, :ssl_session], share.shared
+    assert share.shared?(:dns)
+    assert !share.shared?(:cookie)
+  end
+
+  def test_share_and_unshare_kinds
+    share = Curl::Share.new(:cookie)
+    assert_equal [:cookie], share.shared
+    assert_same share, share.share(:dns)
+    assert_equal [:cookie, :dns], share.shared
+    share.unshare('cookie')
+    assert_equal [:dns], share.shared
+
+    assert_raise(ArgumentError) { Curl::Share.new(:bogus) }
+    assert_raise(ArgumentError) { share.shared?(:bogus) }
+    assert_include Curl::Share::KINDS, :ssl_session
+  end
+
+  def test_easy_share_accessor
+    share = Curl::Share.new
+    easy = Curl::Easy.new(TestServlet.url)
+    assert_nil easy.share
+    easy.share = share
+    assert_same share, easy.share
+    assert_raise(TypeError) { easy.share = Object.new }
+    easy.perform
+    assert_equal 'GET', easy.body_str
+    easy.share = nil
+    assert_nil easy.share
+  end
+
+  def test_cookies_are_shared_between_easies
+    share = Curl::Share.new(:cookie)
+    setter = Curl::Easy.new("http://localhost:#{TestServlet.port}#{TestServlet.path}/set_cookies")
+    setter.enable_cookies = true
+    setter.share = share
+    setter.post_body = JSON.generate([{ name: 'c1', value: 'v1', domain: 'localhost', path: '/' }])
+    setter.perform
+
+    getter = Curl::Easy.new("http://localhost:#{TestServlet.port}#{TestServlet.path}/get_cookies")
+    getter.enable_cookies = true
+    getter.share = share
+    getter.perform
+    assert_equal 'c1=v1', getter.body_str
+
+    alone = Curl::Easy.new(getter.url)
+    alone.enable_cookies = true
+    alone.perform
+    assert_equal '', alone.body_str
+  end
+
+  def test_connections_are_reused_across_multis
+    omit('connection sharing is not supported by this libcurl') unless Curl::Share::KINDS.include?(:connect)
+    share = Curl::Share.new(:dns, :connect)
+
+    first = Curl::Easy.new(TestServlet.url)
+    first.share = share
+    Curl::Multi.new.tap { |m| m.add(first); m.perform; m.close }
+    assert_equal 1, first.num_connects
+
+    second = Curl::Easy.new(TestServlet.url)
+    second.share = share
+    Curl::Multi.new.tap { |m| m.add(second); m.perform; m.close }
+    assert_equal 0, second.num_connects
+  end
+
+  def test_share_is_used_from_many_threads
+    omit('Curl::Share is not thread safe in this build') unless Curl::Share::THREAD_SAFE
+    share = Curl::Share.new(:dns, :ssl_session)
+    bodies = 8.times.map do |t|
+      Thread.new do
+        multi = Curl::Multi.new
+        easies = 4.times.map do |i|
+          easy = Curl::Easy.new("#{TestServlet.url}?t=#{t}&i=#{i}")
+          easy.share = share
+          multi.add(easy)
+          easy
+        end
+        multi.perform
+        multi.close
+        easies.map(&:body_str)
+      end
+    end.flat_map(&:value)
+
+    assert_equal 32, bodies.size
+    assert bodies.all? { |body| body.start_with?('GETt=') }
+  end
+
+  def test_share_collected_while_easies_are_attached
+    omit('Curl::Reactor is not available in this build') unless defined?(Curl::Reactor)
+    silent = TCPServer.new('127.0.0.1', 0)
+    url = "http://127.0.0.1:#{silent.addr[1]}/"
+    # the easies stay attached to the share until the abandoned reactor's
+    # thread aborts them, after the share itself was collected
+    abandon = lambda do
+      share = Curl::Share.new
+      reactor = Curl::Reactor.new
+      4.times do
+        easy = Curl::Easy.new(url)
+        easy.share = share
+        reactor.submit(easy)
+      end
+      nil
+    end
+    abandon.call
+    3.times { GC.start(full_mark: true, immediate_sweep: true) }
+    sleep 0.3
+    Curl::Reactor.new.close
+
+    easy = Curl::Easy.new(TestServlet.url)
+    easy.share = Curl::Share.new
+    easy.perform
+    assert_equal 'GET', easy.body_str
+  ensure
+    silent.close if silent
+  end
+end
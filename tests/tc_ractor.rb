@@ -76,6 +76,67 @@ class TestCurbRactor < Test::Unit::TestCase
     Curl::Multi.autoclose = original_autoclose if defined?(original_autoclose)
   end
 
+  def test_connection_pool_is_configured_per_ractor
+    omit_unless_curb_ractor_safe
+
+    worker = Ractor.new(TestServlet.url) do |target|
+      Curl::Easy.connection_pool = true
+      connects = 2.times.map { Curl.get(target).num_connects }
+      Curl::Easy.connection_pool = nil
+      connects
+    end
+
+    assert_equal [1, 0], ractor_value(worker)
+    assert_nil Curl::Easy.connection_pool
+  end
+
+  def test_ractor_pool_streams_shareable_results
+    omit_unless_curb_ractor_safe
+
+    url = TestServlet.url
+    requests = 6.times.map { |i| "#{url}?i=#{i}" }
+    requests << { url: url, method: :post, post_fields: { 'a' => 'b' } }
+    requests << 'http://127.0.0.1:1/'
+
+    streamed = []
+    results = Curl::RactorPool.open(3, safe: { protocols: [:http] }) do |pool|
+      pool.each(requests.first(2)) { |result| streamed << result.index }
+      pool.map(requests)
+    end
+
+    assert_equal [0, 1], streamed.sort
+    assert_equal (0...requests.size).to_a, results.map(&:index)
+    results.each { |result| assert Ractor.shareable?(result) }
+
+    results.first(6).each_with_index do |result, i|
+      assert result.success?
+      assert_equal 200, result.status
+      assert_equal "GETi=#{i}", result.body
+      assert_match(/text\/plain/, result.headers['content-type'])
+      assert_operator result.timings[:total], :>, 0
+    end
+    assert_equal "POST\na=b", results[6].body
+    assert_equal Curl::Err::ConnectionFailedError, results[7].error
+    refute results[7].success?
+  end
+
+  def test_ractor_pool_drops_results_of_a_run_left_early
+    omit_unless_curb_ractor_safe
+
+    url = TestServlet.url
+    first = 6.times.map { |i| "#{url}?a=#{i}" }
+    second = 2.times.map { |i| "#{url}?b=#{i}" }
+    Curl::RactorPool.open(3) do |pool|
+      assert_equal 1, pool.each(first).first(1).size
+      pool.each(first) { |result| break result }
+      assert_raise(RuntimeError) { pool.each(first) { raise RuntimeError, 'left' } }
+
+      results = pool.map(second)
+      assert_equal ["GETb=0", "GETb=1"], results.map(&:body)
+      assert_equal [0, 1], results.map(&:index)
+    end
+  end
+
   private
 
   def omit_unless_curb_ractor_safe